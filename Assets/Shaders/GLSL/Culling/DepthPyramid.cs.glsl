@@ -0,0 +1,33 @@
+#version 450
+
+// 1スレッドが出力の1テクセルを担当し、覆う入力テクセルの最大深度を書き込みます。
+layout (local_size_x=8, local_size_y=8) in;
+
+// 深度アタッチメント(レベル0)または1つ前のレベル
+layout (binding=0) uniform sampler2D Src;
+layout (binding=1, r32f) uniform writeonly image2D Dst;
+
+layout (push_constant) uniform PushConstants {
+    ivec2 SrcSize;
+    ivec2 DstSize;
+} pushConsts;
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pos, pushConsts.DstSize))) {
+        return;
+    }
+
+    // 出力テクセルが覆う入力の範囲[begin, end)です。
+    // 奇数幅を切り捨てて縮小するレベルでは、端を取りこぼさないよう3テクセルを読みます。
+    ivec2 begin = pos * pushConsts.SrcSize / pushConsts.DstSize;
+    ivec2 end = ((pos + 1) * pushConsts.SrcSize + pushConsts.DstSize - 1) / pushConsts.DstSize;
+
+    float depth = 0.0;
+    for (int y = begin.y; y < end.y; y++) {
+        for (int x = begin.x; x < end.x; x++) {
+            depth = max(depth, texelFetch(Src, ivec2(x, y), 0).r);
+        }
+    }
+    imageStore(Dst, pos, vec4(depth));
+}
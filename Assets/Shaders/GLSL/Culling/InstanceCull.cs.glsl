@@ -0,0 +1,176 @@
+#version 450
+
+// 1スレッドが1つのインスタンスを担当します。
+layout (local_size_x=64) in;
+
+struct Instance {
+    mat4 Model;
+    vec4 Sphere;
+    uint MeshOffset;
+    uint MeshCount;
+    uint Material;
+    uint Padding;
+};
+
+struct Lod {
+    uint IndexBase;
+    uint IndexCount;
+    float Error;
+    uint Padding;
+};
+
+struct DrawIndexedIndirectCommand {
+    uint IndexCount;
+    uint InstanceCount;
+    uint FirstIndex;
+    int VertexOffset;
+    uint FirstInstance;
+};
+
+layout (binding=0) uniform Params {
+    mat4 ViewProj;
+    vec4 Planes[6];
+    vec4 CameraPos;
+    float LodFactor;
+    float Near;
+    uint InstanceCount;
+    uint MaxDraws;
+    uint Occlusion;
+    uint PyramidLevels;
+    vec2 PyramidSize;
+} params;
+
+// 0: Early(前フレームのピラミッドで判定), 1: Late(Earlyで描画しなかったものを再判定)
+layout (push_constant) uniform PushConstants {
+    uint Phase;
+} pushConsts;
+
+layout (std430, binding=1) readonly buffer Instances {
+    Instance instances[];
+};
+
+// x: LODの先頭, y: LOD数
+layout (std430, binding=2) readonly buffer Meshes {
+    uvec2 meshes[];
+};
+
+layout (std430, binding=3) readonly buffer Lods {
+    Lod lods[];
+};
+
+layout (std430, binding=4) writeonly buffer DrawCommands {
+    DrawIndexedIndirectCommand draws[];
+};
+
+// 段階ごとの描画数
+layout (std430, binding=5) buffer DrawCount {
+    uint drawCount[2];
+};
+
+// Earlyで描画したインスタンスは1
+layout (std430, binding=6) buffer Visibility {
+    uint visibility[];
+};
+
+// 各ミップに下位レベルの最大深度を格納した深度ピラミッド
+layout (binding=7) uniform sampler2D DepthPyramid;
+
+bool FrustumTest(vec3 center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        if (dot(params.Planes[i].xyz, center) + params.Planes[i].w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 境界球を囲む箱の投影矩形を覆うミップレベルで、ピラミッドの最大深度と比べます。
+bool OcclusionTest(vec3 center, float radius) {
+    vec2 minUV = vec2(1.0);
+    vec2 maxUV = vec2(0.0);
+    float minZ = 1.0;
+    for (int i = 0; i < 8; i++) {
+        vec3 offset = vec3((i & 1) != 0 ? 1.0 : -1.0,
+                           (i & 2) != 0 ? 1.0 : -1.0,
+                           (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = params.ViewProj * vec4(center + radius * offset, 1.0);
+        // 視点をまたぐ場合は可視とみなします。
+        if (clip.w <= 0.0) {
+            return true;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        minZ = min(minZ, ndc.z);
+    }
+    minUV = clamp(minUV, 0.0, 1.0);
+    maxUV = clamp(maxUV, 0.0, 1.0);
+
+    vec2 extent = (maxUV - minUV) * params.PyramidSize;
+    float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+    level = min(level, float(params.PyramidLevels - 1));
+
+    float maxDepth = max(max(textureLod(DepthPyramid, minUV, level).r,
+                             textureLod(DepthPyramid, vec2(maxUV.x, minUV.y), level).r),
+                         max(textureLod(DepthPyramid, vec2(minUV.x, maxUV.y), level).r,
+                             textureLod(DepthPyramid, maxUV, level).r));
+    return minZ <= maxDepth;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= params.InstanceCount) {
+        return;
+    }
+    // Lateでは、Earlyで描画済みのインスタンスを除きます。
+    bool late = pushConsts.Phase != 0;
+    if (late && (params.Occlusion == 0 || visibility[index] != 0)) {
+        return;
+    }
+    Instance instance = instances[index];
+
+    mat4 model = instance.Model;
+    vec3 center = vec3(model * vec4(instance.Sphere.xyz, 1.0));
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = instance.Sphere.w * scale;
+    bool visible = FrustumTest(center, radius);
+    if (visible && params.Occlusion != 0) {
+        visible = OcclusionTest(center, radius);
+    }
+    if (!late) {
+        visibility[index] = visible ? 1 : 0;
+    }
+    if (!visible) {
+        return;
+    }
+
+    // Model::SelectLodと同じく、境界球の最近点での許容誤差を超えない最も粗いレベルを
+    // 全メッシュで共通に選び、メッシュ間の継ぎ目に隙間ができないようにします。
+    float distance = max(length(center - params.CameraPos.xyz) - radius, params.Near);
+    float threshold = params.LodFactor * distance;
+    uint level = 0xffffffffu;
+    for (uint m = 0; m < instance.MeshCount; m++) {
+        uvec2 mesh = meshes[instance.MeshOffset + m];
+        uint meshLevel = 0;
+        for (uint l = 1; l < mesh.y; l++) {
+            if (lods[mesh.x + l].Error * scale > threshold) {
+                break;
+            }
+            meshLevel = l;
+        }
+        level = min(level, meshLevel);
+    }
+
+    uint slot = atomicAdd(drawCount[pushConsts.Phase], instance.MeshCount);
+    uint base = pushConsts.Phase * params.MaxDraws;
+    for (uint m = 0; m < instance.MeshCount && slot + m < params.MaxDraws; m++) {
+        uvec2 mesh = meshes[instance.MeshOffset + m];
+        Lod lod = lods[mesh.x + min(level, mesh.y - 1)];
+        draws[base + slot + m].IndexCount = lod.IndexCount;
+        draws[base + slot + m].InstanceCount = 1;
+        draws[base + slot + m].FirstIndex = lod.IndexBase;
+        draws[base + slot + m].VertexOffset = 0;
+        draws[base + slot + m].FirstInstance = index;
+    }
+}
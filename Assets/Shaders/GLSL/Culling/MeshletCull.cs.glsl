@@ -0,0 +1,149 @@
+#version 450
+
+// 1ワークグループが1つのメッシュレットの1インスタンスを担当します。
+layout (local_size_x=128) in;
+
+struct Meshlet {
+    vec4 Sphere;
+    vec4 Cone;
+    uint VertexOffset;
+    uint TriangleOffset;
+    uint VertexCount;
+    uint TriangleCount;
+};
+
+struct DrawIndexedIndirectCommand {
+    uint IndexCount;
+    uint InstanceCount;
+    uint FirstIndex;
+    int VertexOffset;
+    uint FirstInstance;
+};
+
+layout (binding=0) uniform Params {
+    mat4 ViewProj;
+    vec4 Planes[6];
+    vec4 CameraPos;
+    uint MeshletCount;
+    uint MaxIndices;
+    uint Occlusion;
+    uint PyramidLevels;
+    vec2 PyramidSize;
+} params;
+
+layout (std430, binding=1) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout (std430, binding=2) readonly buffer MeshletVertices {
+    uint meshletVertices[];
+};
+
+layout (std430, binding=3) readonly buffer MeshletTriangles {
+    uint meshletTriangles[];
+};
+
+layout (std430, binding=4) readonly buffer Instances {
+    mat4 instances[];
+};
+
+layout (std430, binding=5) buffer DrawCommands {
+    DrawIndexedIndirectCommand draws[];
+};
+
+layout (std430, binding=6) writeonly buffer Indices {
+    uint indices[];
+};
+
+// 各ミップに下位レベルの最大深度を格納した深度ピラミッド
+layout (binding=7) uniform sampler2D DepthPyramid;
+
+shared bool visible;
+shared uint indexBase;
+
+bool FrustumTest(vec3 center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        if (dot(params.Planes[i].xyz, center) + params.Planes[i].w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 全三角形が裏向きであればfalseを返します。
+bool ConeTest(vec3 center, float radius, vec3 axis, float cutoff) {
+    vec3 v = center - params.CameraPos.xyz;
+    return dot(v, axis) < cutoff * length(v) + radius;
+}
+
+// 境界球を囲む立方体の投影矩形を深度ピラミッドと比較します。
+bool OcclusionTest(vec3 center, float radius) {
+    vec2 minUV = vec2(1.0);
+    vec2 maxUV = vec2(0.0);
+    float minZ = 1.0;
+    for (int i = 0; i < 8; i++) {
+        vec3 offset = vec3((i & 1) != 0 ? 1.0 : -1.0,
+                           (i & 2) != 0 ? 1.0 : -1.0,
+                           (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = params.ViewProj * vec4(center + radius * offset, 1.0);
+        // 視点をまたぐ場合は可視とみなします。
+        if (clip.w <= 0.0) {
+            return true;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        minZ = min(minZ, ndc.z);
+    }
+    minUV = clamp(minUV, 0.0, 1.0);
+    maxUV = clamp(maxUV, 0.0, 1.0);
+
+    vec2 extent = (maxUV - minUV) * params.PyramidSize;
+    float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+    level = min(level, float(params.PyramidLevels - 1));
+
+    float maxDepth = max(max(textureLod(DepthPyramid, minUV, level).r,
+                             textureLod(DepthPyramid, vec2(maxUV.x, minUV.y), level).r),
+                         max(textureLod(DepthPyramid, vec2(minUV.x, maxUV.y), level).r,
+                             textureLod(DepthPyramid, maxUV, level).r));
+    return minZ <= maxDepth;
+}
+
+void main() {
+    uint meshletIndex = gl_WorkGroupID.x;
+    uint instance = gl_WorkGroupID.y;
+    Meshlet meshlet = meshlets[meshletIndex];
+
+    if (gl_LocalInvocationIndex == 0) {
+        mat4 model = instances[instance];
+        vec3 center = vec3(model * vec4(meshlet.Sphere.xyz, 1.0));
+        float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+        float radius = meshlet.Sphere.w * scale;
+        vec3 axis = normalize(mat3(model) * meshlet.Cone.xyz);
+
+        bool result = FrustumTest(center, radius) && ConeTest(center, radius, axis, meshlet.Cone.w);
+        if (result && params.Occlusion != 0) {
+            result = OcclusionTest(center, radius);
+        }
+        visible = result;
+        if (result) {
+            indexBase = atomicAdd(draws[instance].IndexCount, meshlet.TriangleCount * 3);
+        }
+    }
+    memoryBarrierShared();
+    barrier();
+
+    if (!visible) {
+        return;
+    }
+
+    uint triangle = gl_LocalInvocationIndex;
+    if (triangle < meshlet.TriangleCount) {
+        uint packed = meshletTriangles[meshlet.TriangleOffset + triangle];
+        uint dst = draws[instance].FirstIndex + indexBase + triangle * 3;
+        indices[dst + 0] = meshletVertices[meshlet.VertexOffset + (packed & 0xff)];
+        indices[dst + 1] = meshletVertices[meshlet.VertexOffset + ((packed >> 8) & 0xff)];
+        indices[dst + 2] = meshletVertices[meshlet.VertexOffset + ((packed >> 16) & 0xff)];
+    }
+}
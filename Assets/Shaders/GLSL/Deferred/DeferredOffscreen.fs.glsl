@@ -1,15 +1,23 @@
 #version 450
 
-layout (location = 0) in vec3 WorldPos;
+// G-Bufferのマテリアルのビット(GBuffer::kMaterialGeometry)
+const uint MATERIAL_GEOMETRY = 1u;
+
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec3 Color;
 
-layout (location = 0) out vec4 PositionData;
-layout (location = 1) out vec4 NormalData;
-layout (location = 2) out vec4 AlbedoData;
+// 位置は深度から復元するため書き込みません。
+layout (location = 0) out vec2 NormalData;
+layout (location = 1) out vec4 AlbedoData;
+
+// 単位ベクトルを八面体へ写像し、[-1, 1]の2成分に符号化します。
+vec2 EncodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
 
 void main() {
-    PositionData = vec4(WorldPos, 1.0);
-    NormalData = vec4(Normal, 1.0);
-    AlbedoData = vec4(Color, 1.0);
+    NormalData = EncodeNormal(normalize(Normal));
+    AlbedoData = vec4(Color, float(MATERIAL_GEOMETRY) / 255.0);
 }
@@ -0,0 +1,39 @@
+#version 450
+
+// GPUカリングの間接描画で使用する頂点シェーダです。
+// ワールド行列は、gl_InstanceIndex(firstInstanceに書き込まれたインスタンス番号)で参照します。
+
+layout (location = 0) in vec3 VertexPosition;
+layout (location = 1) in vec3 VertexNormal;
+layout (location = 2) in vec3 VertexColor;
+
+struct Instance {
+    mat4 Model;
+    vec4 Sphere;
+    uint MeshOffset;
+    uint MeshCount;
+    uint Material;
+    uint Padding;
+};
+
+layout (binding = 0) uniform UniformBufferObject {
+    mat4 View;
+    mat4 Proj;
+} ubo;
+
+layout (std430, binding = 5) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout (location = 0) out vec3 WorldPos;
+layout (location = 1) out vec3 Normal;
+layout (location = 2) out vec3 Color;
+
+void main () {
+    mat4 model = instances[gl_InstanceIndex].Model;
+    WorldPos = vec3(model * vec4(VertexPosition, 1.0));
+    Color = VertexColor;
+    Normal = mat3(model) * VertexNormal;
+
+    gl_Position = ubo.Proj * ubo.View * vec4(WorldPos, 1.0);
+}
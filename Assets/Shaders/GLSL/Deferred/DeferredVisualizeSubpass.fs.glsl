@@ -0,0 +1,152 @@
+#version 450
+
+// G-Bufferのマテリアルのビット(GBuffer::kMaterialGeometry)
+const uint MATERIAL_GEOMETRY = 1u;
+
+layout (location = 0) in vec2 UV;
+
+// G-Bufferは同じレンダーパスの前のサブパスで書き込まれ、自身のピクセルだけを読みます。
+// input_attachment_indexはGBuffer::kNormal, kAlbedo, kDepthと一致させます。
+layout (input_attachment_index = 2, binding = 1) uniform subpassInput DepthTex;
+layout (input_attachment_index = 0, binding = 2) uniform subpassInput NormTex;
+layout (input_attachment_index = 1, binding = 3) uniform subpassInput AlbedoTex;
+
+layout (location = 0) out vec4 FragColor;
+
+struct Light {
+    vec4 Position;
+    vec3 Color;
+    float Radius;
+};
+
+struct ClusterParams {
+    mat4 View;
+    uvec4 GridSize;
+    vec4 ZParams;
+    uint LightCount;
+    uint GlobalLightCount;
+};
+
+layout (binding = 4) uniform UniformBufferObject {
+    vec4 ViewPos;
+    mat4 InvViewProj;
+    ClusterParams Clusters;
+    int DisplayRenderTarget;
+} ubo;
+
+// 先頭のGlobalLightCount個は全体ライトで、残りはクラスタに振り分けられています。
+layout (std430, binding = 6) readonly buffer Lights {
+    Light lights[];
+};
+layout (std430, binding = 7) readonly buffer ClusterCounts {
+    uint clusterCounts[];
+};
+layout (std430, binding = 8) readonly buffer ClusterIndices {
+    uint clusterIndices[];
+};
+
+vec3 BlinnPhongModel(vec3 pos, vec3 norm, vec4 albedo, uint lightIdx) {
+    Light light = lights[lightIdx];
+
+    // ライトのベクトルを計算します。
+    vec3 L = light.Position.xyz - pos;
+    float dist = length(L);
+    L = normalize(L);
+
+    // 視線のベクトルを計算します。
+    vec3 V = normalize(ubo.ViewPos.xyz - pos);
+
+    // 減衰します。
+    // クラスタに振り分けるライトは、影響範囲(Radius)の端で0になるよう窓関数を掛けます。
+    float window = clamp(1.0 - pow(dist / light.Radius, 4.0), 0.0, 1.0);
+    float atten = light.Position.w == 0.0
+        ? 1.0 
+        : window * window / (pow(dist, 2.0) + 1.0);
+
+    // ディフューズを計算します。
+    vec3 N = normalize(norm);
+    float NoL = clamp((dot(N, L)), 0.0, 1.0);
+    vec3 diff = light.Color * albedo.rgb * NoL;
+
+    // スペキュラを計算します。
+    vec3 H = normalize(V + L);
+    float NoH = clamp((dot(N, H)), 0.0, 1.0);
+    vec3 spec = light.Color * pow(NoH, 16.0f);
+
+    return (diff + spec) * atten;
+}
+
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// テクスチャ座標と深度からワールド空間の位置を復元します。
+vec3 WorldPosition(vec2 uv) {
+    float depth = subpassLoad(DepthTex).r;
+    vec4 p = ubo.InvViewProj * vec4(uv * 2.0 - 1.0, depth, 1.0);
+    return p.xyz / p.w;
+}
+
+// 画面上の位置とワールド空間の位置からクラスタの番号を求めます。
+uint ClusterIndex(vec2 uv, vec3 pos) {
+    uvec3 grid = ubo.Clusters.GridSize.xyz;
+    float depth = -(ubo.Clusters.View * vec4(pos, 1.0)).z;
+    float slice = log(max(depth, ubo.Clusters.ZParams.x)) * ubo.Clusters.ZParams.z
+        + ubo.Clusters.ZParams.w;
+    uvec3 cluster = min(uvec3(uvec2(uv * vec2(grid.xy)), uint(max(slice, 0.0))),
+                        grid - 1);
+    return cluster.x + grid.x * (cluster.y + grid.y * cluster.z);
+}
+
+void main() {
+    // G-Bufferから値を取得します。
+    vec4 albedo = subpassLoad(AlbedoTex);
+    uint material = uint(albedo.a * 255.0 + 0.5);
+    // ジオメトリのないピクセルは背景として扱います。
+    if ((material & MATERIAL_GEOMETRY) == 0u) {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    vec3 pos = WorldPosition(UV);
+    vec3 norm = DecodeNormal(subpassLoad(NormTex).rg);
+
+    uint cluster = ClusterIndex(UV, pos);
+    uint count = clusterCounts[cluster];
+
+    // デバッグなどに使用します。
+    vec3 fragColor = vec3(0.0);
+    if (ubo.DisplayRenderTarget > 0) {
+        switch (ubo.DisplayRenderTarget) {
+            case 1: 
+                fragColor = pos;
+                break;
+            case 2:
+                fragColor = norm;
+                break;
+            case 3:
+                fragColor = albedo.rgb;
+                break;
+            case 4:
+                // クラスタのライト数を最大数に対する割合で表示します。
+                fragColor = mix(vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0),
+                                float(count) / float(ubo.Clusters.GridSize.w));
+                fragColor *= count > 0 ? 1.0 : 0.0;
+                break;
+        }
+        FragColor = vec4(fragColor, 1.0);
+        return;
+    }
+    
+    for (uint i = 0; i < ubo.Clusters.GlobalLightCount; i++) {
+        fragColor += BlinnPhongModel(pos, norm, albedo, i);
+    }
+    uint base = cluster * ubo.Clusters.GridSize.w;
+    for (uint j = 0; j < count; j++) {
+        fragColor += BlinnPhongModel(pos, norm, albedo, clusterIndices[base + j]);
+    }
+    FragColor = vec4(fragColor, 1.0);
+}
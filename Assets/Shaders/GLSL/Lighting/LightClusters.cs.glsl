@@ -0,0 +1,106 @@
+#version 450
+
+// 1つのワークグループが1つのクラスタを担当し、ライトを分担して判定します。
+layout (local_size_x = 64) in;
+
+struct Light {
+    vec4 Position;
+    vec3 Color;
+    float Radius;
+};
+
+struct ClusterParams {
+    mat4 View;
+    uvec4 GridSize;
+    vec4 ZParams;
+    uint LightCount;
+    uint GlobalLightCount;
+};
+
+layout (binding = 0) uniform UniformBufferObject {
+    mat4 InvProj;
+    ClusterParams Clusters;
+} ubo;
+
+layout (std430, binding = 1) readonly buffer Lights {
+    Light lights[];
+};
+layout (std430, binding = 2) writeonly buffer ClusterCounts {
+    uint clusterCounts[];
+};
+layout (std430, binding = 3) writeonly buffer ClusterIndices {
+    uint clusterIndices[];
+};
+
+shared uint count;
+shared vec3 aabbMin;
+shared vec3 aabbMax;
+
+// NDCのxyを通る視線上で、ビュー空間の深度がdepthの点を返します。
+vec3 Unproject(vec2 ndc, float depth) {
+    vec4 p = ubo.InvProj * vec4(ndc, 0.0, 1.0);
+    vec3 ray = p.xyz / p.w;
+    return ray * (depth / -ray.z);
+}
+
+bool SphereIntersectsAABB(vec3 center, float radius) {
+    vec3 d = max(aabbMin - center, 0.0) + max(center - aabbMax, 0.0);
+    return dot(d, d) <= radius * radius;
+}
+
+void main() {
+    uvec3 grid = ubo.Clusters.GridSize.xyz;
+    uint maxLights = ubo.Clusters.GridSize.w;
+    uvec3 cluster = gl_WorkGroupID;
+    uint clusterIndex = cluster.x + grid.x * (cluster.y + grid.y * cluster.z);
+
+    // クラスタのビュー空間のAABBを求めます。
+    if (gl_LocalInvocationIndex == 0) {
+        count = 0;
+
+        vec2 ndcMin = vec2(cluster.xy) / vec2(grid.xy) * 2.0 - 1.0;
+        vec2 ndcMax = vec2(cluster.xy + 1) / vec2(grid.xy) * 2.0 - 1.0;
+        float zNear = ubo.Clusters.ZParams.x;
+        float ratio = ubo.Clusters.ZParams.y / zNear;
+        float depthMin = zNear * pow(ratio, float(cluster.z) / float(grid.z));
+        float depthMax = zNear * pow(ratio, float(cluster.z + 1) / float(grid.z));
+
+        vec3 corners[8] = vec3[](
+            Unproject(vec2(ndcMin.x, ndcMin.y), depthMin),
+            Unproject(vec2(ndcMax.x, ndcMin.y), depthMin),
+            Unproject(vec2(ndcMin.x, ndcMax.y), depthMin),
+            Unproject(vec2(ndcMax.x, ndcMax.y), depthMin),
+            Unproject(vec2(ndcMin.x, ndcMin.y), depthMax),
+            Unproject(vec2(ndcMax.x, ndcMin.y), depthMax),
+            Unproject(vec2(ndcMin.x, ndcMax.y), depthMax),
+            Unproject(vec2(ndcMax.x, ndcMax.y), depthMax)
+        );
+        vec3 lo = corners[0];
+        vec3 hi = corners[0];
+        for (int i = 1; i < 8; i++) {
+            lo = min(lo, corners[i]);
+            hi = max(hi, corners[i]);
+        }
+        aabbMin = lo;
+        aabbMax = hi;
+    }
+    barrier();
+
+    // 全体ライトはクラスタに含めず、シェーダで常に評価します。
+    for (uint i = ubo.Clusters.GlobalLightCount + gl_LocalInvocationIndex;
+         i < ubo.Clusters.LightCount; i += gl_WorkGroupSize.x) {
+        vec3 center = (ubo.Clusters.View * vec4(lights[i].Position.xyz, 1.0)).xyz;
+        if (!SphereIntersectsAABB(center, lights[i].Radius)) {
+            continue;
+        }
+        uint slot = atomicAdd(count, 1);
+        if (slot < maxLights) {
+            clusterIndices[clusterIndex * maxLights + slot] = i;
+        }
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0) {
+        clusterCounts[clusterIndex] = min(count, maxLights);
+    }
+}
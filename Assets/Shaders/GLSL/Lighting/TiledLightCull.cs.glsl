@@ -0,0 +1,151 @@
+#version 450
+
+// 1つのワークグループが16x16ピクセルの1つのタイルを担当します。
+// 各スレッドが1ピクセルの深度を読み、タイルの最小・最大深度を求めてからライトを分担して判定します。
+layout (local_size_x = 16, local_size_y = 16) in;
+
+struct Light {
+    vec4 Position;
+    vec3 Color;
+    float Radius;
+};
+
+struct TileParams {
+    uvec4 Tiles;
+    uint LightCount;
+    uint GlobalLightCount;
+};
+
+layout (binding = 0) uniform UniformBufferObject {
+    mat4 View;
+    mat4 InvProj;
+    vec2 ScreenSize;
+    uint MaxLightIndices;
+    TileParams Params;
+} ubo;
+
+layout (binding = 1) uniform sampler2D Depth;
+
+layout (std430, binding = 2) readonly buffer Lights {
+    Light lights[];
+};
+layout (std430, binding = 3) writeonly buffer TileLights {
+    uvec2 tileLights[];
+};
+layout (std430, binding = 4) writeonly buffer LightIndices {
+    uint lightIndices[];
+};
+layout (std430, binding = 5) buffer IndexCounter {
+    uint indexCount;
+};
+
+shared uint minDepthBits;
+shared uint maxDepthBits;
+shared uint tileCount;
+shared uint tileOffset;
+shared uint cursor;
+shared vec3 aabbMin;
+shared vec3 aabbMax;
+
+// NDCの点をビュー空間へ戻します。
+vec3 Unproject(vec2 ndc, float depth) {
+    vec4 p = ubo.InvProj * vec4(ndc, depth, 1.0);
+    return p.xyz / p.w;
+}
+
+bool IsLightVisible(uint i) {
+    vec3 center = (ubo.View * vec4(lights[i].Position.xyz, 1.0)).xyz;
+    float radius = lights[i].Radius;
+    vec3 d = max(aabbMin - center, 0.0) + max(center - aabbMax, 0.0);
+    return dot(d, d) <= radius * radius;
+}
+
+void main() {
+    uvec2 tile = gl_WorkGroupID.xy;
+    uint tileIndex = tile.x + ubo.Params.Tiles.y * tile.y;
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(ubo.ScreenSize);
+
+    if (gl_LocalInvocationIndex == 0) {
+        minDepthBits = floatBitsToUint(1.0);
+        maxDepthBits = 0;
+        tileCount = 0;
+        cursor = 0;
+    }
+    barrier();
+
+    // 深度は正の値のため、ビット列のまま大小を比較できます。
+    if (all(lessThan(pixel, size))) {
+        uint depthBits = floatBitsToUint(texelFetch(Depth, pixel, 0).r);
+        atomicMin(minDepthBits, depthBits);
+        atomicMax(maxDepthBits, depthBits);
+    }
+    barrier();
+
+    // タイルの最小・最大深度で区切った部分視錐台を、ビュー空間のAABBで近似します。
+    float minDepth = uintBitsToFloat(minDepthBits);
+    float maxDepth = uintBitsToFloat(maxDepthBits);
+    if (gl_LocalInvocationIndex == 0) {
+        vec2 tileSize = vec2(gl_WorkGroupSize.xy);
+        vec2 ndcMin = vec2(tile) * tileSize / ubo.ScreenSize * 2.0 - 1.0;
+        vec2 ndcMax = min(vec2(tile + 1) * tileSize / ubo.ScreenSize, 1.0) * 2.0 - 1.0;
+        vec3 corners[8] = vec3[](
+            Unproject(vec2(ndcMin.x, ndcMin.y), minDepth),
+            Unproject(vec2(ndcMax.x, ndcMin.y), minDepth),
+            Unproject(vec2(ndcMin.x, ndcMax.y), minDepth),
+            Unproject(vec2(ndcMax.x, ndcMax.y), minDepth),
+            Unproject(vec2(ndcMin.x, ndcMin.y), maxDepth),
+            Unproject(vec2(ndcMax.x, ndcMin.y), maxDepth),
+            Unproject(vec2(ndcMin.x, ndcMax.y), maxDepth),
+            Unproject(vec2(ndcMax.x, ndcMax.y), maxDepth)
+        );
+        vec3 lo = corners[0];
+        vec3 hi = corners[0];
+        for (int i = 1; i < 8; i++) {
+            lo = min(lo, corners[i]);
+            hi = max(hi, corners[i]);
+        }
+        aabbMin = lo;
+        aabbMax = hi;
+    }
+    barrier();
+
+    // 何も描画されていないタイルはライティングされません。
+    bool empty = minDepth >= 1.0;
+    uint threadCount = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+    // 1回目で数を数えて共有バッファに領域を確保し、2回目で書き込みます。
+    // 全体ライトはリストに含めず、シェーダで常に評価します。
+    if (!empty) {
+        for (uint i = ubo.Params.GlobalLightCount + gl_LocalInvocationIndex;
+             i < ubo.Params.LightCount; i += threadCount) {
+            if (IsLightVisible(i)) {
+                atomicAdd(tileCount, 1);
+            }
+        }
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0) {
+        uint offset = tileCount > 0 ? atomicAdd(indexCount, tileCount) : 0;
+        // 共有バッファがあふれた場合は、収まる分だけを書き込みます。
+        uint count = offset < ubo.MaxLightIndices
+            ? min(tileCount, ubo.MaxLightIndices - offset) : 0;
+        tileOffset = offset;
+        tileCount = count;
+        tileLights[tileIndex] = uvec2(offset, count);
+    }
+    barrier();
+
+    if (!empty && tileCount > 0) {
+        for (uint i = ubo.Params.GlobalLightCount + gl_LocalInvocationIndex;
+             i < ubo.Params.LightCount; i += threadCount) {
+            if (IsLightVisible(i)) {
+                uint slot = atomicAdd(cursor, 1);
+                if (slot < tileCount) {
+                    lightIndices[tileOffset + slot] = i;
+                }
+            }
+        }
+    }
+}
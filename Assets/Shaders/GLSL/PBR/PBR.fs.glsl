@@ -2,32 +2,45 @@
 
 const float PI = 3.14159265358979323846264;
 const float GAMMA = 2.2;
-const int LIGHTS_MAX = 8;
 
 layout (location=0) in vec3 Position;
 layout (location=1) in vec3 Normal;
+layout (location=2) flat in vec3 BaseColor;
+// x: ラフネス, y: 金属度, z: 反射率
+layout (location=3) flat in vec3 MaterialParams;
 
 layout (location=0) out vec4 FragColor;
 
-struct LightInfo {
+// Colorは強度を掛けた放射輝度、Radiusは影響範囲です。
+struct Light {
     vec4 Position;
-    float Intensity;
+    vec3 Color;
+    float Radius;
+};
+
+struct TileParams {
+    uvec4 Tiles;
+    uint LightCount;
+    uint GlobalLightCount;
 };
 
 layout (binding=1) uniform UniformBufferObjectShared {
     vec3 CamPos;
-    LightInfo Lights[LIGHTS_MAX];
-    int LightsNum;
+    // 0以外ならタイルのライトのリストを使用します。(Forward+)
+    int Tiled;
+    TileParams Params;
 } UBOParams;
 
-layout (push_constant) uniform PushConstants {
-    layout (offset=64) float Roughness;
-    layout (offset=68) float Metallic;
-    layout (offset=72) float Reflectance;
-    layout (offset=76) float R;
-    layout (offset=80) float G;
-    layout (offset=84) float B;
-} Material;
+// 先頭のGlobalLightCount個は平行光源で、残りはタイルに振り分けられています。
+layout (std430, binding=4) readonly buffer Lights {
+    Light lights[];
+};
+layout (std430, binding=5) readonly buffer TileLights {
+    uvec2 tileLights[];
+};
+layout (std430, binding=6) readonly buffer LightIndices {
+    uint lightIndices[];
+};
 
 /**
  * @brief The GGX distribution (GGX分布関数)
@@ -59,23 +72,29 @@ vec3 GammaCorrection(vec3 color) {
     return pow(color, vec3(1.0 / GAMMA));
 }
 
-vec3 MicroFacetModel(int lightIdx, vec3 pos, vec3 n) {
+vec3 MicroFacetModel(uint lightIdx, vec3 pos, vec3 n) {
+    float metallic = MaterialParams.y;
+    float reflectance = MaterialParams.z;
+
     // 誘電体(非金属)ならDiffuse色(Albedo)取得
-    vec3 diff = (1.0 - Material.Metallic) * vec3(Material.R, Material.G, Material.B);
+    vec3 diff = (1.0 - metallic) * BaseColor;
 
     // 金属(導体)ならSpecular色取得
-    vec3 f0 = 0.16 * Material.Reflectance * Material.Reflectance * (1.0 - Material.Metallic) + vec3(Material.R, Material.G, Material.B) * Material.Metallic;
+    vec3 f0 = 0.16 * reflectance * reflectance * (1.0 - metallic) + BaseColor * metallic;
 
     // ライトに関して。
+    Light light = lights[lightIdx];
     vec3 l = vec3(0.0);
-    float lightIntensity = UBOParams.Lights[lightIdx].Intensity;
-    if (UBOParams.Lights[lightIdx].Position.w == 0.0) {    // Directional Lightの場合
-        l = normalize(UBOParams.Lights[lightIdx].Position.xyz);
+    vec3 lightIntensity = light.Color;
+    if (light.Position.w == 0.0) {    // Directional Lightの場合
+        l = normalize(light.Position.xyz);
     } else {                                    // Positional Lightの場合 
-        l = UBOParams.Lights[lightIdx].Position.xyz - pos;
+        l = light.Position.xyz - pos;
         float dist = length(l);
         l = normalize(l);
-        lightIntensity /= (dist * dist);
+        // 影響範囲の端で0になるよう窓関数を掛けます。
+        float window = clamp(1.0 - pow(dist / light.Radius, 4.0), 0.0, 1.0);
+        lightIntensity *= window * window / (dist * dist);
     }
 
     vec3 v = normalize(UBOParams.CamPos - pos);   // 視線ベクトル
@@ -86,7 +105,7 @@ vec3 MicroFacetModel(int lightIdx, vec3 pos, vec3 n) {
     float LoH = clamp(dot(l, h), 0.0, 1.0);
 
     // ラフネスをパラメタ化します。
-    float roughness = Material.Roughness * Material.Roughness;
+    float roughness = MaterialParams.x * MaterialParams.x;
 
     // Specular BRDF
     float D = D_GGX(NoH, roughness);
@@ -101,8 +120,21 @@ void main() {
     vec3 color = vec3(0.0);
     vec3 n = normalize(Normal);
 
-    for (int i = 0; i < UBOParams.LightsNum; i++) {
-        color += MicroFacetModel(i, Position, n);
+    if (UBOParams.Tiled == 0) {
+        for (uint i = 0; i < UBOParams.Params.LightCount; i++) {
+            color += MicroFacetModel(i, Position, n);
+        }
+    } else {
+        for (uint i = 0; i < UBOParams.Params.GlobalLightCount; i++) {
+            color += MicroFacetModel(i, Position, n);
+        }
+        // フレームバッファの上から数えたタイルのリストを参照します。
+        uvec3 tiles = UBOParams.Params.Tiles.xyz;
+        uvec2 tile = min(uvec2(gl_FragCoord.xy) / tiles.x, tiles.yz - 1);
+        uvec2 range = tileLights[tile.x + tiles.y * tile.y];
+        for (uint i = 0; i < range.y; i++) {
+            color += MicroFacetModel(lightIndices[range.x + i], Position, n);
+        }
     }
 
     FragColor = vec4(GammaCorrection(color), 1.0);
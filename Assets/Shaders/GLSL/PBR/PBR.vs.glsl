@@ -5,6 +5,9 @@ layout (location=1) in vec3 VertexNormal;
 
 layout (location=0) out vec3 Position;
 layout (location=1) out vec3 Normal;
+layout (location=2) flat out vec3 BaseColor;
+// x: ラフネス, y: 金属度, z: 反射率
+layout (location=3) flat out vec3 MaterialParams;
 
 layout (binding=0) uniform UniformBufferObject {
     mat4 ViewProj;
@@ -12,14 +15,23 @@ layout (binding=0) uniform UniformBufferObject {
 
 layout (push_constant) uniform PushConstants {
     mat4 Model;
+    float Roughness;
+    float Metallic;
+    float Reflectance;
+    float R;
+    float G;
+    float B;
 } pushConsts;
 
+// 深度のプリパスと深度を等号比較するため、シェーダ間で同じ深度になるよう保証します。
 out gl_PerVertex {
-    vec4 gl_Position;
+    invariant vec4 gl_Position;
 };
 
 void main() {
     Position = vec3(pushConsts.Model * vec4(VertexPosition, 1.0));
     Normal = mat3(pushConsts.Model) * VertexNormal;
+    BaseColor = vec3(pushConsts.R, pushConsts.G, pushConsts.B);
+    MaterialParams = vec3(pushConsts.Roughness, pushConsts.Metallic, pushConsts.Reflectance);
     gl_Position = ubo.ViewProj * vec4(Position, 1.0);
 }
@@ -0,0 +1,24 @@
+#version 450
+
+// 深度だけを描画する頂点シェーダです。
+// 位置だけを詰めた頂点ストリームを読み、PBR.vs.glslと同じ式で位置を求めます。
+
+layout (location=0) in vec3 VertexPosition;
+
+layout (binding=0) uniform UniformBufferObject {
+    mat4 ViewProj;
+} ubo;
+
+layout (push_constant) uniform PushConstants {
+    mat4 Model;
+} pushConsts;
+
+// カラーパスで深度を等号比較するため、シェーダ間で同じ深度になるよう保証します。
+out gl_PerVertex {
+    invariant vec4 gl_Position;
+};
+
+void main() {
+    vec3 Position = vec3(pushConsts.Model * vec4(VertexPosition, 1.0));
+    gl_Position = ubo.ViewProj * vec4(Position, 1.0);
+}
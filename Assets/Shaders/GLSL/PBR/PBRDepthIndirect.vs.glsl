@@ -0,0 +1,35 @@
+#version 450
+
+// インスタンス描画と間接描画で深度だけを描画する頂点シェーダです。
+// 位置だけを詰めた頂点ストリームを読み、PBRIndirect.vs.glslと同じ式で位置を求めます。
+
+layout (location=0) in vec3 VertexPosition;
+
+struct Instance {
+    mat4 Model;
+    vec4 Sphere;
+    uint MeshOffset;
+    uint MeshCount;
+    uint Material;
+    uint Padding;
+};
+
+layout (binding=0) uniform UniformBufferObject {
+    mat4 ViewProj;
+} ubo;
+
+layout (std430, binding=2) readonly buffer Instances {
+    Instance instances[];
+};
+
+// カラーパスで深度を等号比較するため、シェーダ間で同じ深度になるよう保証します。
+out gl_PerVertex {
+    invariant vec4 gl_Position;
+};
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+
+    vec3 Position = vec3(instance.Model * vec4(VertexPosition, 1.0));
+    gl_Position = ubo.ViewProj * vec4(Position, 1.0);
+}
@@ -0,0 +1,55 @@
+#version 450
+
+// インスタンス描画と間接描画で共用する頂点シェーダです。
+// 描画ごとのワールド行列とマテリアルは、gl_InstanceIndex(firstInstanceから始まるインスタンス番号)で参照します。
+
+layout (location=0) in vec3 VertexPosition;
+layout (location=1) in vec3 VertexNormal;
+
+layout (location=0) out vec3 Position;
+layout (location=1) out vec3 Normal;
+layout (location=2) flat out vec3 BaseColor;
+// x: ラフネス, y: 金属度, z: 反射率
+layout (location=3) flat out vec3 MaterialParams;
+
+struct Instance {
+    mat4 Model;
+    vec4 Sphere;
+    uint MeshOffset;
+    uint MeshCount;
+    uint Material;
+    uint Padding;
+};
+
+struct Material {
+    vec4 Params;
+    vec4 Color;
+};
+
+layout (binding=0) uniform UniformBufferObject {
+    mat4 ViewProj;
+} ubo;
+
+layout (std430, binding=2) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout (std430, binding=3) readonly buffer Materials {
+    Material materials[];
+};
+
+// 深度のプリパスと深度を等号比較するため、シェーダ間で同じ深度になるよう保証します。
+out gl_PerVertex {
+    invariant vec4 gl_Position;
+};
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+    Material material = materials[instance.Material];
+
+    Position = vec3(instance.Model * vec4(VertexPosition, 1.0));
+    Normal = mat3(instance.Model) * VertexNormal;
+    BaseColor = material.Color.rgb;
+    MaterialParams = material.Params.xyz;
+    gl_Position = ubo.ViewProj * vec4(Position, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+// DeinterleavedSSAO::kWorkGroupSize
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// レイヤーに分けるブロックの1辺(DeinterleavedSSAO::kLayerDim)
+const int LAYER_DIM = 4;
+
+layout (binding = 0) uniform sampler2D DepthTex;
+layout (binding = 1) uniform sampler2D NormalTex;
+layout (binding = 2, r32f) uniform writeonly image2DArray DepthLayers;
+// rg32fやrg16fはStorageImageExtendedFormatsが必要なため、コアのrgba16fを使います。
+layout (binding = 3, rgba16f) uniform writeonly image2DArray NormalLayers;
+
+layout (push_constant) uniform PushConstants {
+    ivec2 Size;
+} pushConsts;
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 layerSize = imageSize(DepthLayers).xy;
+    if (any(greaterThanEqual(pixel, layerSize * LAYER_DIM))) {
+        return;
+    }
+
+    // ブロック内の位置(x, y)のピクセルをレイヤー x + LAYER_DIM * y へ集めます。
+    // 端数のテクセルは端のピクセルで埋めます。
+    ivec2 src = min(pixel, pushConsts.Size - 1);
+    ivec2 offset = pixel % LAYER_DIM;
+    ivec3 dst = ivec3(pixel / LAYER_DIM, offset.x + LAYER_DIM * offset.y);
+    imageStore(DepthLayers, dst, vec4(texelFetch(DepthTex, src, 0).r));
+    imageStore(NormalLayers, dst, vec4(texelFetch(NormalTex, src, 0).rg, 0.0, 0.0));
+}
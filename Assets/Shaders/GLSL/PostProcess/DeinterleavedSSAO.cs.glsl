@@ -0,0 +1,98 @@
+#version 450
+
+// DeinterleavedSSAO::kWorkGroupSize
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (constant_id = 0) const int KERNEL_SIZE = 64;
+// レイヤーに分けるブロックの1辺(DeinterleavedSSAO::kLayerDim)
+const int LAYER_DIM = 4;
+
+layout (binding = 0) uniform sampler2DArray DepthLayers;
+layout (binding = 1) uniform sampler2DArray NormalLayers;
+layout (binding = 2) uniform sampler2D RandRotTex;
+
+layout (binding = 3) uniform UniformBufferObject {
+    vec4 Samples[KERNEL_SIZE];
+    mat4 Proj;
+    mat4 InvProj;
+    float Radius;
+    float Bias;
+    // 評価するカーネルの部分集合 Samples[SampleOffset + i * SampleStride]
+    int SampleOffset;
+    int SampleStride;
+    int SampleCount;
+    float NoiseRotation;
+} ubo;
+
+layout (binding = 4, r32f) uniform writeonly image2DArray AOLayers;
+
+layout (push_constant) uniform PushConstants {
+    ivec2 Size;
+} pushConsts;
+
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// テクスチャ座標と深度からビュー空間の位置を復元します。
+vec3 ViewPosition(vec2 uv, float depth) {
+    vec4 p = ubo.InvProj * vec4(uv * 2.0 - 1.0, depth, 1.0);
+    return p.xyz / p.w;
+}
+
+// 元の並びのテクスチャ座標に最も近い、同じレイヤーのテクセルの深度を読みます。
+float LayerDepth(vec2 uv, ivec2 offset, int layer) {
+    ivec2 layerSize = textureSize(DepthLayers, 0).xy;
+    ivec2 coord = ivec2(floor((uv * vec2(pushConsts.Size) - vec2(offset)) / float(LAYER_DIM)));
+    coord = clamp(coord, ivec2(0), layerSize - 1);
+    return texelFetch(DepthLayers, ivec3(coord, layer), 0).r;
+}
+
+void main() {
+    ivec3 id = ivec3(gl_GlobalInvocationID);
+    if (any(greaterThanEqual(id.xy, imageSize(AOLayers).xy))) {
+        return;
+    }
+    int layer = id.z;
+    ivec2 offset = ivec2(layer % LAYER_DIM, layer / LAYER_DIM);
+    vec2 uv = (vec2(id.xy * LAYER_DIM + offset) + 0.5) / vec2(pushConsts.Size);
+
+    vec3 pos = ViewPosition(uv, texelFetch(DepthLayers, id, 0).r);
+    vec3 norm = DecodeNormal(texelFetch(NormalLayers, id, 0).rg);
+
+    // レイヤー内のピクセルはすべてノイズの同じテクセルに当たるため、回転ベクトルはレイヤーごとの定数です。
+    ivec2 noiseDim = textureSize(RandRotTex, 0);
+    vec3 randDir = normalize(texelFetch(RandRotTex, offset % noiseDim, 0).xyz);
+    // フレームごとに回転ベクトルを回し、時間方向に異なる向きを使います。
+    float c = cos(ubo.NoiseRotation);
+    float s = sin(ubo.NoiseRotation);
+    randDir.xy = mat2(c, s, -s, c) * randDir.xy;
+
+    // 接座標空間->カメラ座標空間変換行列を生成します。
+    vec3 tang = normalize(randDir - norm * dot(randDir, norm));
+    vec3 bitang = cross(norm, tang);
+    mat3 TBN = mat3(tang, bitang, norm);
+
+    // サンプル点は同じレイヤーから読み、隣り合う呼び出しが近いテクセルを参照するようにします。
+    float occ = 0.0;
+    for (int i = 0; i < ubo.SampleCount; i++) {
+        int idx = ubo.SampleOffset + i * ubo.SampleStride;
+        vec3 samplePos = pos + ubo.Radius * (TBN * ubo.Samples[idx].xyz);
+
+        // カメラ座標->クリップ座標->正規化デバイス座標->テクスチャ座標
+        vec4 p = ubo.Proj * vec4(samplePos, 1.0);
+        p *= 1.0 / p.w;
+        p.xyz = p.xyz * 0.5 + 0.5;
+
+        // サンプル点と比較し、遮蔽されるようであれば環境遮蔽係数に加算します。
+        float surfZ = ViewPosition(p.xy, LayerDepth(p.xy, offset, layer)).z;
+        float range = smoothstep(0.0, 1.0, ubo.Radius / abs(pos.z - surfZ));
+        occ += (surfZ >= samplePos.z + ubo.Bias ? 1.0 : 0.0) * range;
+    }
+    occ = 1.0 - (occ / float(ubo.SampleCount));
+    imageStore(AOLayers, id, vec4(occ));
+}
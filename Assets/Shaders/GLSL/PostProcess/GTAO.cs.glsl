@@ -0,0 +1,159 @@
+#version 450
+
+// GTAO::kWorkGroupSize
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// trueの場合、gbaにビュー空間のベントノーマルを書き込みます。
+layout (constant_id = 0) const bool BENT_NORMALS = false;
+
+const float PI = 3.14159265359;
+const float HALF_PI = 1.57079632679;
+// 中心のテクセルを読まないよう、最初のステップが離れるピクセル数
+const float MIN_STEP_PIXELS = 1.3;
+// 1テクセルが覆う距離がこの倍率を超えるまでレベル0を読みます。
+const float MIP_OFFSET = 3.3;
+
+// ビュー空間の距離のミップチェーン
+layout (binding = 0) uniform sampler2D DepthMips;
+layout (binding = 1) uniform sampler2D NormalTex;
+layout (binding = 2, rgba16f) uniform writeonly image2D Dst;
+layout (binding = 3) uniform UniformBlock {
+    vec4 DepthParams;
+    vec2 NdcToView;
+    vec2 TexelSize;
+    float ProjScale;
+    float Radius;
+    float Falloff;
+    float Power;
+    int SliceCount;
+    int StepsPerSlice;
+    uint Frame;
+    float MaxLevel;
+} ubo;
+
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// テクスチャ座標と距離からビュー空間の位置を復元します。
+vec3 ViewPosition(vec2 uv, float dist) {
+    return vec3((uv * 2.0 - 1.0) * ubo.NdcToView, -1.0) * dist;
+}
+
+// フレームごとにずらしたインターリーブド・グラディエント・ノイズ
+float Noise(vec2 pixel, uint frame) {
+    pixel += 5.588238 * float(frame % 64u);
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+// fromをtoへ重ねる回転をvに適用します。
+vec3 RotateFromTo(vec3 from, vec3 to, vec3 v) {
+    float c = dot(from, to);
+    if (c > 0.9999) {
+        return v;
+    }
+    vec3 axis = cross(from, to);
+    return v * c + cross(axis, v) + axis * (dot(axis, v) / (1.0 + c));
+}
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pos, imageSize(Dst)))) {
+        return;
+    }
+
+    vec2 uv = (vec2(pos) + 0.5) * ubo.TexelSize;
+    vec3 P = ViewPosition(uv, texelFetch(DepthMips, pos, 0).r);
+    vec3 N = DecodeNormal(texelFetch(NormalTex, pos, 0).rg);
+    vec3 V = normalize(-P);
+
+    // 半径が1ピクセルに満たない場合は遮蔽を探しません。
+    float screenRadius = ubo.Radius * ubo.ProjScale / max(-P.z, 1e-4);
+    if (screenRadius < 1.0) {
+        imageStore(Dst, pos, vec4(1.0, N));
+        return;
+    }
+
+    // 半径の外側で遮蔽の寄与を0へ落とし、遠い物体による縁取りを防ぎます。
+    float falloffRange = ubo.Falloff * ubo.Radius;
+    float falloffMul = -1.0 / falloffRange;
+    float falloffAdd = (ubo.Radius - falloffRange) / falloffRange + 1.0;
+
+    float noiseSlice = Noise(vec2(pos), ubo.Frame);
+    float noiseStep = Noise(vec2(pos) + vec2(23.0, 41.0), ubo.Frame);
+    float minS = MIN_STEP_PIXELS / screenRadius;
+    // ビュー空間のxyの向きをテクスチャ座標の向きへ合わせます。
+    vec2 viewToUV = sign(ubo.NdcToView);
+
+    float visibility = 0.0;
+    vec3 bentNormal = vec3(0.0);
+    for (int slice = 0; slice < ubo.SliceCount; slice++) {
+        float phi = (float(slice) + noiseSlice) * PI / float(ubo.SliceCount);
+        vec3 dir = vec3(cos(phi), sin(phi), 0.0);
+        vec2 omega = dir.xy * viewToUV * screenRadius;
+
+        // スライスの平面へ法線を射影し、視線からの角度nを求めます。
+        vec3 orthoDir = dir - dot(dir, V) * V;
+        vec3 axis = normalize(cross(orthoDir, V));
+        vec3 projN = N - axis * dot(N, axis);
+        float projNLen = length(projN);
+        float cosN = clamp(dot(projN, V) / max(projNLen, 1e-4), 0.0, 1.0);
+        float n = sign(dot(orthoDir, projN)) * acos(cosN);
+
+        // 地平線は両側とも法線の接平面から探し始めます。
+        float lowCos0 = cos(n + HALF_PI);
+        float lowCos1 = cos(n - HALF_PI);
+        float horizonCos0 = lowCos0;
+        float horizonCos1 = lowCos1;
+        for (int i = 0; i < ubo.StepsPerSlice; i++) {
+            // 中心の近くを密に調べるよう、ステップを2乗で配置します。
+            float s = (float(i) + noiseStep) / float(ubo.StepsPerSlice);
+            s = clamp(s * s + minS, 0.0, 1.0);
+            vec2 offset = s * omega;
+            float level = clamp(log2(length(offset)) - MIP_OFFSET, 0.0, ubo.MaxLevel);
+            offset = round(offset) * ubo.TexelSize;
+
+            vec2 uv0 = uv + offset;
+            vec2 uv1 = uv - offset;
+            vec3 d0 = ViewPosition(uv0, textureLod(DepthMips, uv0, level).r) - P;
+            vec3 d1 = ViewPosition(uv1, textureLod(DepthMips, uv1, level).r) - P;
+            float len0 = length(d0);
+            float len1 = length(d1);
+            float weight0 = clamp(len0 * falloffMul + falloffAdd, 0.0, 1.0);
+            float weight1 = clamp(len1 * falloffMul + falloffAdd, 0.0, 1.0);
+            float cos0 = mix(lowCos0, dot(d0, V) / max(len0, 1e-4), weight0);
+            float cos1 = mix(lowCos1, dot(d1, V) / max(len1, 1e-4), weight1);
+            horizonCos0 = max(horizonCos0, cos0);
+            horizonCos1 = max(horizonCos1, cos1);
+        }
+
+        // 法線の半球に制限した地平線の間を、余弦重み付けで解析的に積分します。
+        float h0 = -acos(clamp(horizonCos1, -1.0, 1.0));
+        float h1 = acos(clamp(horizonCos0, -1.0, 1.0));
+        h0 = n + clamp(h0 - n, -HALF_PI, HALF_PI);
+        h1 = n + clamp(h1 - n, -HALF_PI, HALF_PI);
+        float sinN = sin(n);
+        float arc0 = (cosN + 2.0 * h0 * sinN - cos(2.0 * h0 - n)) * 0.25;
+        float arc1 = (cosN + 2.0 * h1 * sinN - cos(2.0 * h1 - n)) * 0.25;
+        visibility += projNLen * (arc0 + arc1);
+
+        if (BENT_NORMALS) {
+            // 可視領域の中心方向を、視線をzとするスライスの座標系で求めます。
+            float t0 = (6.0 * sin(h0 - n) - sin(3.0 * h0 - n) +
+                        6.0 * sin(h1 - n) - sin(3.0 * h1 - n) +
+                        16.0 * sinN - 3.0 * (sin(h0 + n) + sin(h1 + n))) / 12.0;
+            float t1 = (-cos(3.0 * h0 - n) - cos(3.0 * h1 - n) +
+                        8.0 * cos(n) - 3.0 * (cos(h0 + n) + cos(h1 + n))) / 12.0;
+            vec3 local = vec3(dir.xy * t0, t1);
+            bentNormal += RotateFromTo(vec3(0.0, 0.0, 1.0), V, local) * projNLen;
+        }
+    }
+
+    visibility = pow(clamp(visibility / float(ubo.SliceCount), 0.0, 1.0), ubo.Power);
+    vec3 outNormal = BENT_NORMALS ? normalize(bentNormal) : N;
+    imageStore(Dst, pos, vec4(visibility, outNormal));
+}
@@ -0,0 +1,55 @@
+#version 450
+
+// GTAO::kWorkGroupSize
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// レベル0は深度、以降は前のレベルの距離
+layout (binding = 0) uniform sampler2D Src;
+layout (binding = 1, r32f) uniform writeonly image2D Dst;
+layout (binding = 2) uniform UniformBlock {
+    vec4 DepthParams;
+    vec2 NdcToView;
+    vec2 TexelSize;
+    float ProjScale;
+    float Radius;
+    float Falloff;
+    float Power;
+    int SliceCount;
+    int StepsPerSlice;
+    uint Frame;
+    float MaxLevel;
+} ubo;
+
+layout (push_constant) uniform PushConstants {
+    ivec2 SrcSize;
+    ivec2 DstSize;
+    int Level;
+} pushConsts;
+
+// 深度をビュー空間の距離へ変換します。
+float LinearDepth(float depth) {
+    vec4 p = ubo.DepthParams;
+    return (p.x * depth + p.y) / (p.z * depth + p.w);
+}
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pos, pushConsts.DstSize))) {
+        return;
+    }
+
+    if (pushConsts.Level == 0) {
+        float depth = texelFetch(Src, pos, 0).r;
+        imageStore(Dst, pos, vec4(LinearDepth(depth)));
+        return;
+    }
+
+    // 遮蔽を見落とさないよう、2x2のうち最も手前の距離を残します。
+    ivec2 src = pos * 2;
+    ivec2 last = pushConsts.SrcSize - 1;
+    float d0 = texelFetch(Src, min(src, last), 0).r;
+    float d1 = texelFetch(Src, min(src + ivec2(1, 0), last), 0).r;
+    float d2 = texelFetch(Src, min(src + ivec2(0, 1), last), 0).r;
+    float d3 = texelFetch(Src, min(src + ivec2(1, 1), last), 0).r;
+    imageStore(Dst, pos, vec4(min(min(d0, d1), min(d2, d3))));
+}
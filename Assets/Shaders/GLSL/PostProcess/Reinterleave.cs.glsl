@@ -0,0 +1,26 @@
+#version 450
+
+// DeinterleavedSSAO::kWorkGroupSize
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// レイヤーに分けるブロックの1辺(DeinterleavedSSAO::kLayerDim)
+const int LAYER_DIM = 4;
+
+layout (binding = 0) uniform sampler2DArray AOLayers;
+layout (binding = 1, rgba16f) uniform writeonly image2D Dst;
+
+layout (push_constant) uniform PushConstants {
+    ivec2 Size;
+} pushConsts;
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, pushConsts.Size))) {
+        return;
+    }
+
+    // Deinterleaveと逆の対応で、ピクセルを元の位置へ戻します。
+    ivec2 offset = pixel % LAYER_DIM;
+    ivec3 src = ivec3(pixel / LAYER_DIM, offset.x + LAYER_DIM * offset.y);
+    imageStore(Dst, pixel, vec4(texelFetch(AOLayers, src, 0).r));
+}
@@ -0,0 +1,77 @@
+#version 450
+
+// ワークグループは1行(1列)のTILE_SIZEテクセルを担当します。(SeparableBlur::kTileSize)
+layout (local_size_x = 128) in;
+
+const int TILE_SIZE = 128;
+// 共有メモリに読み込む余白の最大値(SeparableBlur::kMaxRadius)
+const int MAX_RADIUS = 32;
+const int CACHE_SIZE = TILE_SIZE + 2 * MAX_RADIUS;
+
+// trueの場合、ガイドの深度が近いテクセルだけを混ぜます。
+layout (constant_id = 0) const bool BILATERAL = false;
+
+layout (binding = 0) uniform sampler2D Src;
+layout (binding = 1) uniform sampler2D Guide;
+// 単一チャンネルのr32fはコアのストレージ形式です。(SeparableBlur::kFormat)
+layout (binding = 2, r32f) uniform writeonly image2D Dst;
+
+layout (push_constant) uniform PushConstants {
+    vec4 DepthParams;
+    ivec2 Direction;
+    int Radius;
+    float Sigma;
+    float DepthSigma;
+} pushConsts;
+
+shared float values[CACHE_SIZE];
+shared float dists[CACHE_SIZE];
+
+// ガイドの深度をビュー空間の距離へ変換します。
+float LinearDepth(float depth) {
+    vec4 p = pushConsts.DepthParams;
+    return (p.x * depth + p.y) / (p.z * depth + p.w);
+}
+
+void main() {
+    ivec2 size = imageSize(Dst);
+    ivec2 dir = pushConsts.Direction;
+    int lineLength = dir.x != 0 ? size.x : size.y;
+    // 行(列)の先頭の座標と、ワークグループが担当する範囲の先頭です。
+    ivec2 lineOrigin = (ivec2(1) - dir) * int(gl_WorkGroupID.y);
+    int tileStart = int(gl_WorkGroupID.x) * TILE_SIZE;
+    int radius = pushConsts.Radius;
+
+    // 担当する範囲と前後の余白を一度だけ読み込みます。端は端のテクセルを繰り返します。
+    for (int i = int(gl_LocalInvocationID.x); i < TILE_SIZE + 2 * radius; i += TILE_SIZE) {
+        int t = clamp(tileStart + i - radius, 0, lineLength - 1);
+        ivec2 coord = lineOrigin + dir * t;
+        values[i] = texelFetch(Src, coord, 0).r;
+        if (BILATERAL) {
+            dists[i] = LinearDepth(texelFetch(Guide, coord, 0).r);
+        }
+    }
+    barrier();
+
+    int t = tileStart + int(gl_LocalInvocationID.x);
+    if (t >= lineLength) {
+        return;
+    }
+
+    int center = int(gl_LocalInvocationID.x) + radius;
+    float spatial = -0.5 / (pushConsts.Sigma * pushConsts.Sigma);
+    float centerDist = dists[center];
+    float depthScale = 1.0 / max(pushConsts.DepthSigma * centerDist, 1e-4);
+
+    float acc = 0.0;
+    float weightSum = 0.0;
+    for (int o = -radius; o <= radius; o++) {
+        float w = exp(float(o * o) * spatial);
+        if (BILATERAL) {
+            w *= exp(-abs(dists[center + o] - centerDist) * depthScale);
+        }
+        acc += values[center + o] * w;
+        weightSum += w;
+    }
+    imageStore(Dst, lineOrigin + dir * t, vec4(acc / weightSum));
+}
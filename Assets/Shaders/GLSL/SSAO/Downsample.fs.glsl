@@ -0,0 +1,36 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D DepthTex;
+layout (binding = 1) uniform sampler2D NormalTex;
+
+layout (binding = 2) uniform UniformBufferObject {
+    mat4 InvProj;
+    int Scale;
+    bool UseBlur;
+} ubo;
+
+layout (location = 0) in vec2 UV;
+
+layout (location = 0) out float FragDepth;
+layout (location = 1) out vec2 FragNormal;
+
+void main() {
+    // 平均すると輪郭で前景と背景の間に浮いた深度ができるため、
+    // ブロック内で最も手前の深度と、その位置の法線をそのまま選びます。
+    ivec2 base = ivec2(gl_FragCoord.xy) * ubo.Scale;
+    ivec2 maxCoord = textureSize(DepthTex, 0) - 1;
+    ivec2 closest = min(base, maxCoord);
+    float minDepth = 1.0;
+    for (int y = 0; y < ubo.Scale; y++) {
+        for (int x = 0; x < ubo.Scale; x++) {
+            ivec2 coord = min(base + ivec2(x, y), maxCoord);
+            float depth = texelFetch(DepthTex, coord, 0).r;
+            if (depth < minDepth) {
+                minDepth = depth;
+                closest = coord;
+            }
+        }
+    }
+    FragDepth = minDepth;
+    FragNormal = texelFetch(NormalTex, closest, 0).rg;
+}
@@ -1,36 +1,41 @@
 #version 450
 
 const float GAMMA = 2.2;
+// G-Bufferのマテリアルのビット(GBuffer::kMaterialGeometry)
+const uint MATERIAL_GEOMETRY = 1u;
 
-layout (location = 0) in vec3 Position;
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec3 Color;
 layout (location = 3) in vec2 UV;
+layout (location = 4) flat in int Tex;
 
-layout (location = 0) out vec4 PositionData;
-layout (location = 1) out vec4 NormalData;
-layout (location = 2) out vec4 AlbedoData;
+// 位置は深度から復元するため書き込みません。
+layout (location = 0) out vec2 NormalData;
+layout (location = 1) out vec4 AlbedoData;
 
 layout (binding = 1) uniform sampler2D Tex1;
 layout (binding = 2) uniform sampler2D Tex2;
 
-layout (push_constant) uniform PushConstants {
-    mat4 Dummy;
-    int Tex;
-} pushConsts;
+// 単位ベクトルを八面体へ写像し、[-1, 1]の2成分に符号化します。
+vec2 EncodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
 
 void main() {
-    PositionData = vec4(Position, 1.0);
-    NormalData = vec4(normalize(Normal), 1.0);
-    switch (pushConsts.Tex) {
+    NormalData = EncodeNormal(normalize(Normal));
+    vec3 albedo;
+    switch (Tex) {
         case 1:
-            AlbedoData = vec4(pow(texture(Tex1, UV).xyz, vec3(GAMMA)), 1.0);
+            albedo = pow(texture(Tex1, UV).xyz, vec3(GAMMA));
             break;
         case 2:
-            AlbedoData = vec4(pow(texture(Tex2, UV).xyz, vec3(GAMMA)), 1.0);
+            albedo = pow(texture(Tex2, UV).xyz, vec3(GAMMA));
             break;
         default:
-            AlbedoData = vec4(Color, 1.0);
+            albedo = Color;
             break;
-    } 
+    }
+    AlbedoData = vec4(albedo, float(MATERIAL_GEOMETRY) / 255.0);
 }
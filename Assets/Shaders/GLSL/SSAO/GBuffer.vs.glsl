@@ -5,6 +5,11 @@ layout (location = 1) in vec3 VertexNormal;
 layout (location = 2) in vec3 VertexColor;
 layout (location = 3) in vec2 VertexUV;
 
+// インスタンスごとの属性
+layout (location = 4) in mat4 InstanceModel;
+layout (location = 8) in vec2 InstanceUVScale;
+layout (location = 9) in int InstanceTex;
+
 layout (binding = 0) uniform UniformBufferObject {
     mat4 View;
     mat4 Proj;
@@ -14,19 +19,17 @@ layout (location = 0) out vec3 Position;
 layout (location = 1) out vec3 Normal;
 layout (location = 2) out vec3 Color;
 layout (location = 3) out vec2 UV;
-
-layout (push_constant) uniform PushConstants {
-    mat4 Model;
-} pushConsts;
+layout (location = 4) flat out int Tex;
 
 void main () {
-    Position = vec3(ubo.View * pushConsts.Model * vec4(VertexPosition, 1.0));
+    Position = vec3(ubo.View * InstanceModel * vec4(VertexPosition, 1.0));
 
-    mat3 normalMatrix = transpose(inverse(mat3(ubo.View * pushConsts.Model)));
+    mat3 normalMatrix = transpose(inverse(mat3(ubo.View * InstanceModel)));
     Normal = normalMatrix * VertexNormal;
 
     Color = VertexColor;
-    UV = VertexUV;
+    UV = VertexUV * InstanceUVScale;
+    Tex = InstanceTex;
 
     gl_Position = ubo.Proj * vec4(Position, 1.0);
 }
@@ -1,10 +1,12 @@
 #version 450
 
 const float GAMMA = 2.2;
+// G-Bufferのマテリアルのビット(GBuffer::kMaterialGeometry)
+const uint MATERIAL_GEOMETRY = 1u;
 
 layout (location = 0) in vec2 UV;
 
-layout (binding = 1) uniform sampler2D PosTex;
+layout (binding = 1) uniform sampler2D DepthTex;
 layout (binding = 2) uniform sampler2D NormTex;
 layout (binding = 3) uniform sampler2D AlbedoTex;
 layout (binding = 4) uniform sampler2D AOTex;
@@ -24,8 +26,24 @@ layout (binding = 0) uniform UniformBufferObject {
     int DisplayRenderTarget;
     bool UseBlur;
     float AO;
+    mat4 InvProj;
 } ubo;
 
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// テクスチャ座標と深度からビュー空間の位置を復元します。
+vec3 ViewPosition(vec2 uv) {
+    float depth = texture(DepthTex, uv).r;
+    vec4 p = ubo.InvProj * vec4(uv * 2.0 - 1.0, depth, 1.0);
+    return p.xyz / p.w;
+}
+
 vec3 AmbientDiffuseModel(vec3 pos, vec3 norm, vec3 albedo, float ao, int idx) {
     vec3 amb = ubo.Lights[idx].La * albedo * ao;
     vec3 L = normalize(vec3(ubo.Lights[idx].Position) - pos);
@@ -40,9 +58,16 @@ vec3 AmbientDiffuseModel(vec3 pos, vec3 norm, vec3 albedo, float ao, int idx) {
 }
 void main() {
     // G-Bufferから値を取得します。
-    vec3 pos = texture(PosTex, UV).xyz;
-    vec3 norm = texture(NormTex, UV).xyz;
-    vec3 albedo = texture(AlbedoTex, UV).rgb;
+    vec4 albedoData = texture(AlbedoTex, UV);
+    uint material = uint(albedoData.a * 255.0 + 0.5);
+    // ジオメトリのないピクセルは背景として扱います。
+    if ((material & MATERIAL_GEOMETRY) == 0u) {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    vec3 pos = ViewPosition(UV);
+    vec3 norm = DecodeNormal(texture(NormTex, UV).rg);
+    vec3 albedo = albedoData.rgb;
     float ao = ubo.UseBlur
         ? texture(AOBlurTex, UV).r 
         : texture(AOTex, UV).r;
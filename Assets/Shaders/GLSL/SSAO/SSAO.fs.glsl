@@ -2,29 +2,54 @@
 
 layout (constant_id = 0) const int KERNEL_SIZE = 64;
 
-layout (binding = 0) uniform sampler2D PositionDepthTex;
+layout (binding = 0) uniform sampler2D DepthTex;
 layout (binding = 1) uniform sampler2D NormalTex;
 layout (binding = 2) uniform sampler2D RandRotTex;
 
 layout (binding = 3) uniform UniformBufferObject {
     vec4 Samples[KERNEL_SIZE];
     mat4 Proj;
+    mat4 InvProj;
     float Radius;
     float Bias;
+    // 評価するカーネルの部分集合 Samples[SampleOffset + i * SampleStride]
+    int SampleOffset;
+    int SampleStride;
+    int SampleCount;
+    float NoiseRotation;
 } ubo;
 
 layout (location = 0) in vec2 UV;
 
 layout (location = 0) out float FragColor;
 
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// テクスチャ座標と深度からビュー空間の位置を復元します。
+vec3 ViewPosition(vec2 uv) {
+    float depth = texture(DepthTex, uv).r;
+    vec4 p = ubo.InvProj * vec4(uv * 2.0 - 1.0, depth, 1.0);
+    return p.xyz / p.w;
+}
+
 void main() {
-    vec3 pos = texture(PositionDepthTex, UV).rgb;
-    vec3 norm = normalize(texture(NormalTex, UV).rgb);
+    vec3 pos = ViewPosition(UV);
+    vec3 norm = DecodeNormal(texture(NormalTex, UV).rg);
 
-    ivec2 texDim = textureSize(PositionDepthTex, 0);
+    ivec2 texDim = textureSize(DepthTex, 0);
     ivec2 noiseDim = textureSize(RandRotTex, 0);
     vec2 noiseUV = vec2(float(texDim.x) / float(noiseDim.x), float(texDim.y) / float(noiseDim.y)) * UV;
     vec3 randDir = normalize(texture(RandRotTex, noiseUV).xyz);
+    // フレームごとに回転ベクトルを回し、時間方向に異なる向きを使います。
+    float c = cos(ubo.NoiseRotation);
+    float s = sin(ubo.NoiseRotation);
+    randDir.xy = mat2(c, s, -s, c) * randDir.xy;
 
     // 接座標空間->カメラ座標空間変換行列を生成します。
     vec3 tang = normalize(randDir - norm * dot(randDir, norm));
@@ -33,8 +58,9 @@ void main() {
 
     // サンプリングを行い、AO(環境遮蔽)の係数値を計算します。
     float occ = 0.0;
-    for (int i = 0; i < KERNEL_SIZE; i++) {
-        vec3 samplePos = pos + ubo.Radius * (TBN * ubo.Samples[i].xyz);
+    for (int i = 0; i < ubo.SampleCount; i++) {
+        int idx = ubo.SampleOffset + i * ubo.SampleStride;
+        vec3 samplePos = pos + ubo.Radius * (TBN * ubo.Samples[idx].xyz);
 
         // カメラ座標->クリップ座標->正規化デバイス座標->テクスチャ座標
         vec4 p = ubo.Proj * vec4(samplePos, 1.0);
@@ -42,10 +68,10 @@ void main() {
         p.xyz = p.xyz * 0.5 + 0.5;
 
         // サンプル点と比較し、遮蔽されるようであれば環境遮蔽係数に加算します。
-        float surfZ = texture(PositionDepthTex, p.xy).z;
+        float surfZ = ViewPosition(p.xy).z;
         float range = smoothstep(0.0, 1.0, ubo.Radius / abs(pos.z - surfZ));
         occ += (surfZ >= samplePos.z + ubo.Bias ? 1.0 : 0.0) * range;
     }
-    occ = 1.0 - (occ / float(KERNEL_SIZE));
+    occ = 1.0 - (occ / float(ubo.SampleCount));
     FragColor = occ;
 }
@@ -0,0 +1,71 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D AOTex;
+layout (binding = 1) uniform sampler2D DepthTex;
+layout (binding = 2) uniform sampler2D NormalTex;
+layout (binding = 3) uniform sampler2D HistoryTex;
+
+layout (binding = 4) uniform UniformBufferObject {
+    mat4 InvProj;
+    mat4 InvView;
+    mat4 PrevViewProj;
+    float Blend;
+    int Reset;
+} ubo;
+
+layout (location = 0) in vec2 UV;
+
+// r: AO, g: ビュー空間の距離, ba: ワールド空間の法線(八面体)
+layout (location = 0) out vec4 FragColor;
+
+// 距離の差を許容する割合
+const float DEPTH_TOLERANCE = 0.05;
+// 法線の差を許容するcos
+const float NORMAL_TOLERANCE = 0.9;
+
+vec2 EncodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    float ao = texture(AOTex, UV).r;
+    float depth = texture(DepthTex, UV).r;
+    if (depth >= 1.0) {
+        // 背景は遮蔽されず、履歴も持ちません。
+        FragColor = vec4(1.0, 0.0, 0.0, 0.0);
+        return;
+    }
+
+    // 深度からワールド空間の位置を復元し、前のフレームの画面へ投影します。
+    vec4 viewPos = ubo.InvProj * vec4(UV * 2.0 - 1.0, depth, 1.0);
+    viewPos /= viewPos.w;
+    vec4 worldPos = ubo.InvView * viewPos;
+    vec3 worldNorm = normalize(mat3(ubo.InvView) * DecodeNormal(texture(NormalTex, UV).rg));
+
+    vec4 prevClip = ubo.PrevViewProj * worldPos;
+    vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+    // 透視投影ではクリップ座標のwがビュー空間の距離になります。
+    float prevDist = prevClip.w;
+
+    if (ubo.Reset == 0 && all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)))) {
+        vec4 history = texture(HistoryTex, prevUV);
+        // 前のフレームで別の面が見えていた位置(ディスオクルージョン)では履歴を捨てます。
+        bool sameDepth = abs(history.g - prevDist) < DEPTH_TOLERANCE * prevDist;
+        bool sameNormal = dot(worldNorm, DecodeNormal(history.ba)) > NORMAL_TOLERANCE;
+        if (sameDepth && sameNormal) {
+            ao = mix(history.r, ao, ubo.Blend);
+        }
+    }
+
+    FragColor = vec4(ao, -viewPos.z, EncodeNormal(worldNorm));
+}
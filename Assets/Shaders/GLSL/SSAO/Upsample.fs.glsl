@@ -0,0 +1,88 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D AOTex;
+layout (binding = 1) uniform sampler2D LowDepthTex;
+layout (binding = 2) uniform sampler2D LowNormalTex;
+layout (binding = 3) uniform sampler2D DepthTex;
+layout (binding = 4) uniform sampler2D NormalTex;
+
+layout (binding = 5) uniform UniformBufferObject {
+    mat4 InvProj;
+    int Scale;
+    bool UseBlur;
+} ubo;
+
+layout (location = 0) in vec2 UV;
+
+layout (location = 0) out float FragColor;
+
+// 深度の差を許容する割合(ビュー空間の距離に対する比)
+const float DEPTH_SIGMA = 0.05;
+// 法線の一致度の鋭さ
+const float NORMAL_POWER = 8.0;
+
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// 深度からビュー空間の距離を求めます。
+float LinearDepth(float depth) {
+    vec4 p = ubo.InvProj * vec4(0.0, 0.0, depth, 1.0);
+    return -p.z / p.w;
+}
+
+void main() {
+    ivec2 fullCoord = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(DepthTex, fullCoord, 0).r;
+    if (depth >= 1.0) {
+        // 背景は遮蔽されません。
+        FragColor = 1.0;
+        return;
+    }
+    float z = LinearDepth(depth);
+    vec3 norm = DecodeNormal(texelFetch(NormalTex, fullCoord, 0).rg);
+
+    // 縮小したテクセルの中心を基準にした位置を求めます。
+    ivec2 lowSize = textureSize(AOTex, 0);
+    vec2 lowPos = gl_FragCoord.xy / float(ubo.Scale) - 0.5;
+    ivec2 origin = ivec2(floor(lowPos));
+    vec2 f = lowPos - vec2(origin);
+
+    // ぼかしを使う場合は4x4のテントフィルタ、使わない場合は2x2の双線形補間の重みに、
+    // 深度と法線の類似度を掛けて、輪郭をまたいだ値を混ぜないようにします。
+    int radius = ubo.UseBlur ? 2 : 1;
+    float acc = 0.0;
+    float weightSum = 0.0;
+    float closestDist = 1e30;
+    float closestAO = 1.0;
+    for (int y = 1 - radius; y <= radius; y++) {
+        for (int x = 1 - radius; x <= radius; x++) {
+            ivec2 coord = clamp(origin + ivec2(x, y), ivec2(0), lowSize - 1);
+            vec2 d = abs(vec2(x, y) - f);
+            vec2 tent = max(float(radius) - d, 0.0);
+            float spatial = tent.x * tent.y;
+
+            float sz = LinearDepth(texelFetch(LowDepthTex, coord, 0).r);
+            vec3 sn = DecodeNormal(texelFetch(LowNormalTex, coord, 0).rg);
+            float ao = texelFetch(AOTex, coord, 0).r;
+
+            float dz = abs(z - sz);
+            float w = spatial * exp(-dz / (DEPTH_SIGMA * z)) *
+                      pow(max(dot(norm, sn), 0.0), NORMAL_POWER);
+            acc += ao * w;
+            weightSum += w;
+
+            if (dz < closestDist) {
+                closestDist = dz;
+                closestAO = ao;
+            }
+        }
+    }
+
+    // すべての候補が別の面であれば、最も深度の近い値を使います。
+    FragColor = weightSum > 1e-4 ? acc / weightSum : closestAO;
+}
@@ -0,0 +1,45 @@
+#version 450
+
+// 1スレッドが縮小先の1テクセルを担当します。
+layout (local_size_x=8, local_size_y=8) in;
+
+layout (binding=0, rgba8) uniform readonly image2D SrcImage;
+layout (binding=1, rgba8) uniform writeonly image2D DstImage;
+
+layout (push_constant) uniform PushConstants {
+    // イメージがsRGBの場合、UNORMとして読み書きされるため手動で変換します。
+    int SRGB;
+} PC;
+
+vec3 ToLinear(vec3 c) {
+    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), greaterThan(c, vec3(0.04045)));
+}
+
+vec3 ToSRGB(vec3 c) {
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, greaterThan(c, vec3(0.0031308)));
+}
+
+void main() {
+    const ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(dst, imageSize(DstImage)))) {
+        return;
+    }
+
+    // 奇数サイズの端は同じテクセルを重ねて読みます。
+    const ivec2 srcMax = imageSize(SrcImage) - 1;
+    vec4 sum = vec4(0.0);
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            vec4 c = imageLoad(SrcImage, min(dst * 2 + ivec2(x, y), srcMax));
+            if (PC.SRGB != 0) {
+                c.rgb = ToLinear(c.rgb);
+            }
+            sum += c;
+        }
+    }
+    sum *= 0.25;
+    if (PC.SRGB != 0) {
+        sum.rgb = ToSRGB(sum.rgb);
+    }
+    imageStore(DstImage, dst, sum);
+}
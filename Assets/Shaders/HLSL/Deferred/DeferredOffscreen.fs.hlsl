@@ -1,21 +1,30 @@
+// G-Bufferのマテリアルのビット(GBuffer::kMaterialGeometry)
+static const uint MATERIAL_GEOMETRY = 1;
+
 struct VSOutput {
     [[vk::location(0)]] float3 WorldPos : POSITION0;
     [[vk::location(1)]] float3 Color : COLOR0;
     [[vk::location(2)]] float3 Normal : NORMAL0;
 };
 
+// 位置は深度から復元するため書き込みません。
 struct FSOutput {
-    float4 Position : SV_TARGET0;
-    float4 Normal : SV_TARGET1;
-    float4 Albedo : SV_TARGET2;
+    float2 Normal : SV_TARGET0;
+    float4 Albedo : SV_TARGET1;
 };
 
+// 単位ベクトルを八面体へ写像し、[-1, 1]の2成分に符号化します。
+float2 EncodeNormal(float3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    float2 signs = float2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
 FSOutput main(VSOutput input) {
     FSOutput output = (FSOutput)0;
-    
-    output.Position = float4(input.WorldPos, 1.0);
-    output.Normal = float4(input.Normal, 1.0);
-    output.Albedo = float4(input.Color, 1.0);
+
+    output.Normal = EncodeNormal(normalize(input.Normal));
+    output.Albedo = float4(input.Color, float(MATERIAL_GEOMETRY) / 255.0);
 
     return output;
 }
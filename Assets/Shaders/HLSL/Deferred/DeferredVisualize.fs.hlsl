@@ -1,6 +1,8 @@
+// G-Bufferのマテリアルのビット(GBuffer::kMaterialGeometry)
+static const uint MATERIAL_GEOMETRY = 1;
 
-Texture2D PosTex : register (t1);
-SamplerState PosSamp : register(s1);
+Texture2D DepthTex : register (t1);
+SamplerState DepthSamp : register(s1);
 Texture2D NormTex : register(t2);
 SamplerState NormSamp : register(s2);
 Texture2D AlbedoTex : register(t3);
@@ -12,10 +14,18 @@ struct Light {
     float Radius;
 };
 
+struct ClusterParams {
+    float4x4 View;
+    uint4 GridSize;
+    float4 ZParams;
+    uint LightCount;
+    uint GlobalLightCount;
+};
+
 struct UniformBufferObject {
-    Light Lights[8];
     float4 ViewPos;
-    int LightsNum;
+    float4x4 InvViewProj;
+    ClusterParams Clusters;
     int DisplayRenderTarget;
 };
 
@@ -23,9 +33,16 @@ cbuffer ubo : register(b4) {
     UniformBufferObject ubo;
 }
 
-float3 BlinnPhongModel(float3 pos, float3 norm, float4 albedo, int lightIdx) {
+// 先頭のGlobalLightCount個は全体ライトで、残りはクラスタに振り分けられています。
+StructuredBuffer<Light> Lights : register(t6);
+StructuredBuffer<uint> ClusterCounts : register(t7);
+StructuredBuffer<uint> ClusterIndices : register(t8);
+
+float3 BlinnPhongModel(float3 pos, float3 norm, float4 albedo, uint lightIdx) {
+    Light light = Lights[lightIdx];
+
     // ライトのベクトルを計算します。
-    float3 L = ubo.Lights[lightIdx].Position.xyz - pos;
+    float3 L = light.Position.xyz - pos;
     float dist = length(L);
     L = normalize(L);
 
@@ -33,28 +50,64 @@ float3 BlinnPhongModel(float3 pos, float3 norm, float4 albedo, int lightIdx) {
     float3 V = normalize(ubo.ViewPos.xyz - pos);
 
     // 減衰します。
-    float atten = ubo.Lights[lightIdx].Position.w == 0.0
+    // クラスタに振り分けるライトは、影響範囲(Radius)の端で0になるよう窓関数を掛けます。
+    float window = saturate(1.0 - pow(dist / light.Radius, 4.0));
+    float atten = light.Position.w == 0.0
         ? 1.0 
-        : ubo.Lights[lightIdx].Radius / (pow(dist, 2.0) + 1.0);
+        : window * window / (pow(dist, 2.0) + 1.0);
 
     // ディフューズを計算します。
     float3 N = normalize(norm);
     float NoL = saturate(dot(N, L));
-    float3 diff = ubo.Lights[lightIdx].Color * albedo.rgb * NoL;
+    float3 diff = light.Color * albedo.rgb * NoL;
 
     // スペキュラを計算します。
     float3 H = normalize(V + L);
     float NoH = saturate(dot(N, H));
-    float3 spec = ubo.Lights[lightIdx].Color * pow(NoH, 16.0f);
+    float3 spec = light.Color * pow(NoH, 16.0f);
 
     return (diff + spec) * atten;
 }
 
+// 八面体に符号化した法線を単位ベクトルへ戻します。
+float3 DecodeNormal(float2 e) {
+    float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += float2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// テクスチャ座標と深度からワールド空間の位置を復元します。
+float3 WorldPosition(float2 uv) {
+    float depth = DepthTex.Sample(DepthSamp, uv).r;
+    float4 p = mul(ubo.InvViewProj, float4(uv * 2.0 - 1.0, depth, 1.0));
+    return p.xyz / p.w;
+}
+
+// 画面上の位置とワールド空間の位置からクラスタの番号を求めます。
+uint ClusterIndex(float2 uv, float3 pos) {
+    uint3 grid = ubo.Clusters.GridSize.xyz;
+    float depth = -mul(ubo.Clusters.View, float4(pos, 1.0)).z;
+    float slice = log(max(depth, ubo.Clusters.ZParams.x)) * ubo.Clusters.ZParams.z
+        + ubo.Clusters.ZParams.w;
+    uint3 cluster = min(uint3(uint2(uv * float2(grid.xy)), uint(max(slice, 0.0))),
+                        grid - 1);
+    return cluster.x + grid.x * (cluster.y + grid.y * cluster.z);
+}
+
 float4 main([[vk::location(0)]] float2 uv : TEXCOORD0) : SV_TARGET {
     // G-Bufferから値を取得します。
-    float3 pos = PosTex.Sample(PosSamp, uv).rgb;
-    float3 norm = NormTex.Sample(NormSamp, uv).rgb;
     float4 albedo = AlbedoTex.Sample(AlbedoSamp, uv);
+    uint material = uint(albedo.a * 255.0 + 0.5);
+    // ジオメトリのないピクセルは背景として扱います。
+    if ((material & MATERIAL_GEOMETRY) == 0) {
+        return float4(0.0, 0.0, 0.0, 1.0);
+    }
+    float3 pos = WorldPosition(uv);
+    float3 norm = DecodeNormal(NormTex.Sample(NormSamp, uv).rg);
+
+    uint cluster = ClusterIndex(uv, pos);
+    uint count = ClusterCounts[cluster];
 
     // デバッグなどに使用します。
     float3 fragColor = float3(0.0);
@@ -69,12 +122,22 @@ float4 main([[vk::location(0)]] float2 uv : TEXCOORD0) : SV_TARGET {
             case 3:
                 fragColor = albedo.rgb;
                 break;
+            case 4:
+                // クラスタのライト数を最大数に対する割合で表示します。
+                fragColor = lerp(float3(0.0, 0.0, 1.0), float3(1.0, 0.0, 0.0),
+                                 float(count) / float(ubo.Clusters.GridSize.w));
+                fragColor *= count > 0 ? 1.0 : 0.0;
+                break;
         }
         return float4(fragColor, 1.0);
     }
 
-    for (int i = 0 ; i < ubo.LightsNum; i++) {
+    for (uint i = 0; i < ubo.Clusters.GlobalLightCount; i++) {
         fragColor += BlinnPhongModel(pos, norm, albedo, i);
     }
+    uint base = cluster * ubo.Clusters.GridSize.w;
+    for (uint j = 0; j < count; j++) {
+        fragColor += BlinnPhongModel(pos, norm, albedo, ClusterIndices[base + j]);
+    }
     return float4(fragColor, 1.0);
 }
@@ -7,6 +7,9 @@
 
 struct AABB {
   AABB() { Reset(); }
+  AABB(const glm::vec3 &mini, const glm::vec3 &maxi)
+      : mini(mini), maxi(maxi) {}
+
   void Reset() {
     mini = glm::vec3(std::numeric_limits<float>::max());
     maxi = glm::vec3(std::numeric_limits<float>::lowest());
@@ -25,6 +28,33 @@ struct AABB {
     maxi.z = std::fmax(maxi.z, z);
   }
 
+  void Merge(const AABB &aabb) {
+    mini = glm::min(mini, aabb.mini);
+    maxi = glm::max(maxi, aabb.maxi);
+  }
+
+  [[nodiscard]] glm::vec3 Center() const { return (mini + maxi) * 0.5f; }
+
+  [[nodiscard]] float SurfaceArea() const {
+    const glm::vec3 d = glm::max(maxi - mini, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+
+  /**
+   * @brief アフィン変換した箱を包むAABBを返します。(Arvoの方法)
+   */
+  [[nodiscard]] AABB Transform(const glm::mat4 &m) const {
+    const glm::vec3 t(m[3]);
+    AABB res(t, t);
+    for (int c = 0; c < 3; c++) {
+      const glm::vec3 a = glm::vec3(m[c]) * mini[c];
+      const glm::vec3 b = glm::vec3(m[c]) * maxi[c];
+      res.mini += glm::min(a, b);
+      res.maxi += glm::max(a, b);
+    }
+    return res;
+  }
+
   glm::vec3 mini;
   glm::vec3 maxi;
 };
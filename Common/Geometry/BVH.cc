@@ -0,0 +1,479 @@
+/**
+ * @brief オブジェクトのAABBに対する境界ボリューム階層(BVH)
+ */
+
+#include "Geometry/BVH.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Utils/ThreadPool.h"
+
+namespace {
+struct Bin {
+  AABB bounds{};
+  uint32_t count = 0;
+};
+
+/** @brief 葉のオブジェクト1つの判定に対する、ノード1つの走査コストの比 */
+constexpr float kTraversalCost = 1.0f;
+
+/** @brief 部分木を全て内側とみなすためのマスク(6平面すべてを判定済み) */
+constexpr uint32_t kAllPlanes = 0x3F;
+
+bool Overlaps(const AABB &aabb, const BSphere &sphere) {
+  const glm::vec3 d =
+      glm::clamp(sphere.center, aabb.mini, aabb.maxi) - sphere.center;
+  return glm::dot(d, d) <= sphere.radius * sphere.radius;
+}
+
+/**
+ * @brief スラブ法でレイとAABBの交差区間を求めます。
+ * @return 交差しない場合は負の値
+ */
+float IntersectRay(const AABB &aabb, const glm::vec3 &origin,
+                   const glm::vec3 &invDir, float maxDistance) {
+  const glm::vec3 t0 = (aabb.mini - origin) * invDir;
+  const glm::vec3 t1 = (aabb.maxi - origin) * invDir;
+  const glm::vec3 tmin = glm::min(t0, t1);
+  const glm::vec3 tmax = glm::max(t0, t1);
+  const float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+  const float exit =
+      std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, maxDistance));
+  return enter <= exit ? enter : -1.0f;
+}
+} // namespace
+
+//*-----------------------------------------------------------------------------
+// Build
+//*-----------------------------------------------------------------------------
+
+void BVH::Build(std::vector<AABB> objects) {
+  if (rebuild_.valid()) {
+    rebuild_.wait();
+    rebuild_ = {};
+  }
+  objects_ = std::move(objects);
+  tree_ = BuildTree(objects_);
+  dirtyLeaves_.clear();
+  refitCount_ = 0;
+}
+
+void BVH::Clear() {
+  if (rebuild_.valid()) {
+    rebuild_.wait();
+    rebuild_ = {};
+  }
+  objects_.clear();
+  tree_ = {};
+  dirtyLeaves_.clear();
+  refitCount_ = 0;
+}
+
+BVH::Tree BVH::BuildTree(const std::vector<AABB> &objects) {
+  Tree tree{};
+  const auto objectCount = static_cast<uint32_t>(objects.size());
+  if (objectCount == 0) {
+    return tree;
+  }
+
+  std::vector<glm::vec3> centers(objectCount);
+  tree.indices.resize(objectCount);
+  for (uint32_t i = 0; i < objectCount; i++) {
+    centers[i] = objects[i].Center();
+    tree.indices[i] = i;
+  }
+
+  tree.nodes.reserve(2 * static_cast<size_t>(objectCount) - 1);
+  tree.parents.reserve(2 * static_cast<size_t>(objectCount) - 1);
+  tree.nodes.emplace_back(Node{AABB{}, 0, 0, objectCount});
+  tree.parents.emplace_back(0);
+
+  std::vector<uint32_t> stack{0};
+  while (!stack.empty()) {
+    const uint32_t nodeIndex = stack.back();
+    stack.pop_back();
+
+    const uint32_t first = tree.nodes[nodeIndex].first;
+    const uint32_t count = tree.nodes[nodeIndex].count;
+    AABB bounds{};
+    AABB centerBounds{};
+    for (uint32_t i = first; i < first + count; i++) {
+      bounds.Merge(objects[tree.indices[i]]);
+      centerBounds.Merge(centers[tree.indices[i]]);
+    }
+    tree.nodes[nodeIndex].bounds = bounds;
+    if (count <= kMaxLeafSize) {
+      continue;
+    }
+
+    // 各軸をビンに分け、左右の表面積とオブジェクト数からSAHコストが最小の分割面を探します。
+    const glm::vec3 extent = centerBounds.maxi - centerBounds.mini;
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      if (extent[axis] <= 0.0f) {
+        continue;
+      }
+      const float scale = static_cast<float>(kBinCount) / extent[axis];
+      std::array<Bin, kBinCount> bins{};
+      for (uint32_t i = first; i < first + count; i++) {
+        const uint32_t object = tree.indices[i];
+        const auto b = std::min(
+            kBinCount - 1,
+            static_cast<uint32_t>((centers[object][axis] -
+                                   centerBounds.mini[axis]) *
+                                  scale));
+        bins[b].bounds.Merge(objects[object]);
+        bins[b].count++;
+      }
+
+      std::array<float, kBinCount - 1> rightCost{};
+      AABB right{};
+      uint32_t rightCount = 0;
+      for (uint32_t b = kBinCount - 1; b > 0; b--) {
+        right.Merge(bins[b].bounds);
+        rightCount += bins[b].count;
+        rightCost[b - 1] =
+            rightCount == 0 ? 0.0f : right.SurfaceArea() * rightCount;
+      }
+      AABB left{};
+      uint32_t leftCount = 0;
+      for (uint32_t b = 0; b < kBinCount - 1; b++) {
+        left.Merge(bins[b].bounds);
+        leftCount += bins[b].count;
+        if (leftCount == 0 || leftCount == count) {
+          continue;
+        }
+        const float cost = left.SurfaceArea() * leftCount + rightCost[b];
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = b + 1;
+        }
+      }
+    }
+
+    uint32_t mid = 0;
+    if (bestAxis < 0) {
+      // 中心がすべて重なっている場合は半分に分けます。
+      mid = first + count / 2;
+    } else {
+      const float area = bounds.SurfaceArea();
+      const float leafCost = static_cast<float>(count);
+      const float splitCost =
+          kTraversalCost + (area > 0.0f ? bestCost / area : leafCost);
+      if (splitCost >= leafCost && count <= 2 * kMaxLeafSize) {
+        continue;
+      }
+      const float scale = static_cast<float>(kBinCount) / extent[bestAxis];
+      const float minimum = centerBounds.mini[bestAxis];
+      const auto it = std::partition(
+          tree.indices.begin() + first, tree.indices.begin() + first + count,
+          [&](uint32_t object) {
+            const auto b = std::min(
+                kBinCount - 1,
+                static_cast<uint32_t>(
+                    (centers[object][bestAxis] - minimum) * scale));
+            return b < bestSplit;
+          });
+      mid = static_cast<uint32_t>(it - tree.indices.begin());
+    }
+
+    const auto left = static_cast<uint32_t>(tree.nodes.size());
+    tree.nodes[nodeIndex].left = left;
+    tree.nodes.emplace_back(Node{AABB{}, 0, first, mid - first});
+    tree.nodes.emplace_back(Node{AABB{}, 0, mid, first + count - mid});
+    tree.parents.emplace_back(nodeIndex);
+    tree.parents.emplace_back(nodeIndex);
+    stack.emplace_back(left + 1);
+    stack.emplace_back(left);
+  }
+
+  tree.leafOf.resize(objectCount);
+  for (uint32_t n = 0; n < tree.nodes.size(); n++) {
+    const Node &node = tree.nodes[n];
+    if (node.IsLeaf()) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        tree.leafOf[tree.indices[i]] = n;
+      }
+    }
+  }
+  return tree;
+}
+
+//*-----------------------------------------------------------------------------
+// Refit
+//*-----------------------------------------------------------------------------
+
+void BVH::SetBounds(uint32_t object, const AABB &bounds) {
+  objects_[object] = bounds;
+  if (!tree_.leafOf.empty()) {
+    dirtyLeaves_.emplace_back(tree_.leafOf[object]);
+  }
+}
+
+uint32_t BVH::Refit() {
+  if (dirtyLeaves_.empty()) {
+    return 0;
+  }
+  refitCount_++;
+
+  std::sort(dirtyLeaves_.begin(), dirtyLeaves_.end());
+  dirtyLeaves_.erase(std::unique(dirtyLeaves_.begin(), dirtyLeaves_.end()),
+                     dirtyLeaves_.end());
+  // 多くの葉が動いた場合は、経路ごとに遡るより全体を1度走査する方が速くなります。
+  if (dirtyLeaves_.size() * 4 > tree_.nodes.size()) {
+    dirtyLeaves_.clear();
+    RefitAll();
+    return static_cast<uint32_t>(tree_.nodes.size());
+  }
+
+  uint32_t updated = 0;
+  for (const uint32_t leaf : dirtyLeaves_) {
+    Node &node = tree_.nodes[leaf];
+    AABB bounds{};
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+      bounds.Merge(objects_[tree_.indices[i]]);
+    }
+    node.bounds = bounds;
+    updated++;
+
+    // 境界が変わらなくなった時点で、それより上の祖先は影響を受けません。
+    for (uint32_t n = leaf; n != 0;) {
+      n = tree_.parents[n];
+      Node &parent = tree_.nodes[n];
+      AABB merged = tree_.nodes[parent.left].bounds;
+      merged.Merge(tree_.nodes[parent.left + 1].bounds);
+      if (merged.mini == parent.bounds.mini &&
+          merged.maxi == parent.bounds.maxi) {
+        break;
+      }
+      parent.bounds = merged;
+      updated++;
+    }
+  }
+  dirtyLeaves_.clear();
+  return updated;
+}
+
+void BVH::RefitAll() {
+  // 子は常に親より後に追加されるため、末尾から走査すれば子から順に更新できます。
+  for (size_t n = tree_.nodes.size(); n-- > 0;) {
+    Node &node = tree_.nodes[n];
+    if (node.IsLeaf()) {
+      AABB bounds{};
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        bounds.Merge(objects_[tree_.indices[i]]);
+      }
+      node.bounds = bounds;
+    } else {
+      node.bounds = tree_.nodes[node.left].bounds;
+      node.bounds.Merge(tree_.nodes[node.left + 1].bounds);
+    }
+  }
+}
+
+void BVH::RebuildAsync(ThreadPool &threadPool) {
+  if (rebuild_.valid() || objects_.empty()) {
+    return;
+  }
+  rebuild_ = threadPool.Submit(
+      [objects = objects_]() { return BuildTree(objects); });
+}
+
+bool BVH::ApplyRebuild() {
+  if (!rebuild_.valid() || rebuild_.wait_for(std::chrono::seconds(0)) !=
+                               std::future_status::ready) {
+    return false;
+  }
+  tree_ = rebuild_.get();
+  // 投入後にSetBoundsされたオブジェクトは古い境界で構築されているため、全体を更新します。
+  dirtyLeaves_.clear();
+  RefitAll();
+  refitCount_ = 0;
+  return true;
+}
+
+float BVH::GetCost() const {
+  if (tree_.nodes.empty()) {
+    return 0.0f;
+  }
+  const float rootArea = tree_.nodes[0].bounds.SurfaceArea();
+  if (rootArea <= 0.0f) {
+    return 0.0f;
+  }
+  float cost = 0.0f;
+  for (const Node &node : tree_.nodes) {
+    cost += node.bounds.SurfaceArea() *
+            (node.IsLeaf() ? static_cast<float>(node.count) : kTraversalCost);
+  }
+  return cost / rootArea;
+}
+
+//*-----------------------------------------------------------------------------
+// Query
+//*-----------------------------------------------------------------------------
+
+void BVH::QueryFrustum(const Planes &planes,
+                       std::vector<uint32_t> &result) const {
+  if (tree_.nodes.empty()) {
+    return;
+  }
+
+  // 各ノードでは、祖先で完全に内側と判定された平面の判定を省きます。
+  struct Entry {
+    uint32_t node;
+    uint32_t insideMask;
+  };
+  std::vector<Entry> stack{{0, 0}};
+  while (!stack.empty()) {
+    const Entry entry = stack.back();
+    stack.pop_back();
+    const Node &node = tree_.nodes[entry.node];
+
+    uint32_t insideMask = entry.insideMask;
+    bool outside = false;
+    for (uint32_t p = 0; p < planes.size(); p++) {
+      if (insideMask & (1u << p)) {
+        continue;
+      }
+      const glm::vec4 &plane = planes[p];
+      const glm::vec3 n(plane);
+      // 法線方向に最も進んだ頂点(p-vertex)と最も遅れた頂点(n-vertex)
+      const glm::vec3 pv(n.x >= 0.0f ? node.bounds.maxi.x : node.bounds.mini.x,
+                         n.y >= 0.0f ? node.bounds.maxi.y : node.bounds.mini.y,
+                         n.z >= 0.0f ? node.bounds.maxi.z : node.bounds.mini.z);
+      const glm::vec3 nv(n.x >= 0.0f ? node.bounds.mini.x : node.bounds.maxi.x,
+                         n.y >= 0.0f ? node.bounds.mini.y : node.bounds.maxi.y,
+                         n.z >= 0.0f ? node.bounds.mini.z : node.bounds.maxi.z);
+      if (glm::dot(n, pv) + plane.w < 0.0f) {
+        outside = true;
+        break;
+      }
+      if (glm::dot(n, nv) + plane.w >= 0.0f) {
+        insideMask |= 1u << p;
+      }
+    }
+    if (outside) {
+      continue;
+    }
+
+    if (insideMask == kAllPlanes) {
+      result.insert(result.end(), tree_.indices.begin() + node.first,
+                    tree_.indices.begin() + node.first + node.count);
+    } else if (node.IsLeaf()) {
+      // 葉のオブジェクトは個別に判定します。
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        const uint32_t object = tree_.indices[i];
+        const AABB &aabb = objects_[object];
+        bool visible = true;
+        for (uint32_t p = 0; p < planes.size() && visible; p++) {
+          if (insideMask & (1u << p)) {
+            continue;
+          }
+          const glm::vec4 &plane = planes[p];
+          const glm::vec3 pv(plane.x >= 0.0f ? aabb.maxi.x : aabb.mini.x,
+                             plane.y >= 0.0f ? aabb.maxi.y : aabb.mini.y,
+                             plane.z >= 0.0f ? aabb.maxi.z : aabb.mini.z);
+          visible = glm::dot(glm::vec3(plane), pv) + plane.w >= 0.0f;
+        }
+        if (visible) {
+          result.emplace_back(object);
+        }
+      }
+    } else {
+      stack.emplace_back(Entry{node.left + 1, insideMask});
+      stack.emplace_back(Entry{node.left, insideMask});
+    }
+  }
+}
+
+std::optional<BVH::RayHit> BVH::Raycast(const glm::vec3 &origin,
+                                        const glm::vec3 &direction,
+                                        float maxDistance) const {
+  if (tree_.nodes.empty()) {
+    return std::nullopt;
+  }
+
+  const glm::vec3 invDir = 1.0f / direction;
+  std::optional<RayHit> hit = std::nullopt;
+  float best = maxDistance;
+
+  struct Entry {
+    uint32_t node;
+    float distance;
+  };
+  std::vector<Entry> stack{};
+  const float rootDistance =
+      IntersectRay(tree_.nodes[0].bounds, origin, invDir, best);
+  if (rootDistance >= 0.0f) {
+    stack.emplace_back(Entry{0, rootDistance});
+  }
+  while (!stack.empty()) {
+    const Entry entry = stack.back();
+    stack.pop_back();
+    // より近い交差が見つかった後は、それより遠いノードを飛ばします。
+    if (entry.distance > best) {
+      continue;
+    }
+    const Node &node = tree_.nodes[entry.node];
+    if (node.IsLeaf()) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        const uint32_t object = tree_.indices[i];
+        const float t = IntersectRay(objects_[object], origin, invDir, best);
+        if (t >= 0.0f && (!hit || t < best)) {
+          best = t;
+          hit = RayHit{object, t};
+        }
+      }
+      continue;
+    }
+
+    // 近い方の子を先に取り出せるよう、遠い方から積みます。
+    const float t0 =
+        IntersectRay(tree_.nodes[node.left].bounds, origin, invDir, best);
+    const float t1 =
+        IntersectRay(tree_.nodes[node.left + 1].bounds, origin, invDir, best);
+    Entry nearer{node.left, t0};
+    Entry farther{node.left + 1, t1};
+    if (t1 >= 0.0f && (t0 < 0.0f || t1 < t0)) {
+      std::swap(nearer, farther);
+    }
+    if (farther.distance >= 0.0f) {
+      stack.emplace_back(farther);
+    }
+    if (nearer.distance >= 0.0f) {
+      stack.emplace_back(nearer);
+    }
+  }
+  return hit;
+}
+
+void BVH::QuerySphere(const BSphere &sphere,
+                      std::vector<uint32_t> &result) const {
+  if (tree_.nodes.empty()) {
+    return;
+  }
+
+  std::vector<uint32_t> stack{0};
+  while (!stack.empty()) {
+    const Node &node = tree_.nodes[stack.back()];
+    stack.pop_back();
+    if (!Overlaps(node.bounds, sphere)) {
+      continue;
+    }
+    if (node.IsLeaf()) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        const uint32_t object = tree_.indices[i];
+        if (Overlaps(objects_[object], sphere)) {
+          result.emplace_back(object);
+        }
+      }
+    } else {
+      stack.emplace_back(node.left + 1);
+      stack.emplace_back(node.left);
+    }
+  }
+}
@@ -0,0 +1,129 @@
+/**
+ * @brief オブジェクトのAABBに対する境界ボリューム階層(BVH)
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "Geometry/AABB.h"
+#include "Geometry/BSphere.h"
+
+class ThreadPool;
+
+/**
+ * @brief
+ * ビン分割したSAH(表面積ヒューリスティック)で構築し、視錐台・レイ・球の問い合わせに答えます。
+ * @note
+ * 移動したオブジェクトはSetBoundsとRefitで木の形を保ったまま境界だけを更新します。<br>
+ * Refitを繰り返すと木の質が落ちるため、RebuildAsyncでワーカースレッド上に作り直し、
+ * 完了後のApplyRebuildで差し替えてください。
+ */
+class BVH {
+public:
+  struct Node {
+    AABB bounds{};
+    /** @brief 子ノードの先頭(右の子はleft + 1)。葉では0です。 */
+    uint32_t left = 0;
+    /** @brief 部分木に含まれるオブジェクトのindices_内の範囲 */
+    uint32_t first = 0;
+    uint32_t count = 0;
+
+    [[nodiscard]] bool IsLeaf() const { return left == 0; }
+  };
+
+  struct RayHit {
+    uint32_t object = 0;
+    /** @brief AABBへ入る位置までの距離(directionの長さ単位) */
+    float distance = 0.0f;
+  };
+
+  using Planes = std::array<glm::vec4, 6>;
+
+  /** @brief オブジェクト数がこれ以下のノードは分割せずに葉にします。 */
+  static constexpr uint32_t kMaxLeafSize = 4;
+  /** @brief SAHで評価する軸ごとのビン数 */
+  static constexpr uint32_t kBinCount = 16;
+
+  /**
+   * @brief objectsのインデックスをオブジェクトIDとして木を構築します。
+   */
+  void Build(std::vector<AABB> objects);
+  void Clear();
+
+  /** @brief オブジェクトの境界を更新します。木へ反映するにはRefitを呼び出してください。 */
+  void SetBounds(uint32_t object, const AABB &bounds);
+  /**
+   * @brief SetBoundsで変更されたオブジェクトを含む葉から根までの境界を更新します。
+   * @return 更新したノード数
+   */
+  uint32_t Refit();
+
+  /**
+   * @brief 現在の境界で木を作り直すジョブを投入します。
+   * @note 実行中に呼び出した場合は何もしません。
+   */
+  void RebuildAsync(ThreadPool &threadPool);
+  /**
+   * @brief 作り直しが完了していれば木を差し替え、投入後の移動をRefitで反映します。
+   * @return 差し替えた場合はtrue
+   */
+  bool ApplyRebuild();
+  [[nodiscard]] bool IsRebuilding() const { return rebuild_.valid(); }
+
+  /**
+   * @brief 視錐台と交差するオブジェクトを追加します。
+   * @note 完全に内側にある部分木は平面判定を省いてまとめて追加します。
+   */
+  void QueryFrustum(const Planes &planes, std::vector<uint32_t> &result) const;
+  /**
+   * @brief レイが最初に入るAABBのオブジェクトを求めます。
+   * @param direction 正規化されていなくても構いません。
+   */
+  [[nodiscard]] std::optional<RayHit>
+  Raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+          float maxDistance = std::numeric_limits<float>::max()) const;
+  /** @brief 球と交差するAABBのオブジェクトを追加します。 */
+  void QuerySphere(const BSphere &sphere, std::vector<uint32_t> &result) const;
+
+  [[nodiscard]] const std::vector<Node> &GetNodes() const {
+    return tree_.nodes;
+  }
+  [[nodiscard]] const AABB &GetBounds(uint32_t object) const {
+    return objects_[object];
+  }
+  [[nodiscard]] uint32_t GetObjectCount() const {
+    return static_cast<uint32_t>(objects_.size());
+  }
+  /** @brief 最後の構築からRefitで更新した回数 */
+  [[nodiscard]] uint32_t GetRefitCount() const { return refitCount_; }
+  /** @brief 木全体のSAHコスト(根の表面積で正規化) */
+  [[nodiscard]] float GetCost() const;
+
+private:
+  struct Tree {
+    std::vector<Node> nodes{};
+    /** @brief 葉の範囲が指すオブジェクトID */
+    std::vector<uint32_t> indices{};
+    std::vector<uint32_t> parents{};
+    /** @brief オブジェクトIDから所属する葉 */
+    std::vector<uint32_t> leafOf{};
+  };
+
+  static Tree BuildTree(const std::vector<AABB> &objects);
+  void RefitAll();
+
+  std::vector<AABB> objects_{};
+  Tree tree_{};
+  /** @brief SetBounds後にRefitしていない葉 */
+  std::vector<uint32_t> dirtyLeaves_{};
+  std::future<Tree> rebuild_{};
+  uint32_t refitCount_ = 0;
+};
@@ -0,0 +1,439 @@
+/**
+ * @brief 二次誤差計量(QEM)によるメッシュ簡略化
+ */
+
+#include "Geometry/MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+/** @brief 境界エッジを保持するための平面二次誤差に掛ける重み */
+constexpr double kBorderWeight = 10.0;
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) {
+  return (static_cast<uint64_t>(a) << 32) | static_cast<uint64_t>(b);
+}
+
+size_t HashFloats(const float *data, size_t count) {
+  size_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &data[i], sizeof(bits));
+    h = (h ^ bits) * 1099511628211ull;
+  }
+  return h;
+}
+} // namespace
+
+//*-----------------------------------------------------------------------------
+// Quadric
+//*-----------------------------------------------------------------------------
+
+void MeshSimplifier::Quadric::AddPlane(const glm::dvec3 &n, double d,
+                                       double weight) {
+  a00 += weight * n.x * n.x;
+  a01 += weight * n.x * n.y;
+  a02 += weight * n.x * n.z;
+  a11 += weight * n.y * n.y;
+  a12 += weight * n.y * n.z;
+  a22 += weight * n.z * n.z;
+  b0 += weight * n.x * d;
+  b1 += weight * n.y * d;
+  b2 += weight * n.z * d;
+  c += weight * d * d;
+  w += weight;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric &q) {
+  a00 += q.a00;
+  a01 += q.a01;
+  a02 += q.a02;
+  a11 += q.a11;
+  a12 += q.a12;
+  a22 += q.a22;
+  b0 += q.b0;
+  b1 += q.b1;
+  b2 += q.b2;
+  c += q.c;
+  w += q.w;
+}
+
+double MeshSimplifier::Quadric::Eval(const glm::dvec3 &p) const {
+  const double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+  const double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+  const double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+  const double e = rx * p.x + ry * p.y + rz * p.z +
+                   2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+  return std::fabs(e);
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+MeshSimplifier::MeshSimplifier(const float *vertices, size_t vertexCount,
+                               size_t stride, size_t positionOffset,
+                               const std::vector<uint32_t> &indices,
+                               MeshSimplifyOptions options)
+    : vertices_(vertices), vertexCount_(vertexCount), stride_(stride),
+      positionOffset_(positionOffset), options_(std::move(options)) {
+  positions_.resize(vertexCount_);
+  for (size_t i = 0; i < vertexCount_; i++) {
+    const float *p = vertices_ + i * stride_ + positionOffset_;
+    positions_[i] = glm::dvec3(p[0], p[1], p[2]);
+  }
+
+  WeldVertices();
+
+  indices_.reserve(indices.size());
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const uint32_t i0 = canonical_[indices[i + 0]];
+    const uint32_t i1 = canonical_[indices[i + 1]];
+    const uint32_t i2 = canonical_[indices[i + 2]];
+    if (i0 == i1 || i1 == i2 || i2 == i0) {
+      continue;
+    }
+    indices_.emplace_back(i0);
+    indices_.emplace_back(i1);
+    indices_.emplace_back(i2);
+  }
+
+  ClassifyVertices();
+  ComputeQuadrics();
+  BuildAdjacency();
+}
+
+/**
+ * @brief 全属性が一致する頂点を1つの代表頂点にまとめ、同一位置の代表頂点同士を連結します。
+ */
+void MeshSimplifier::WeldVertices() {
+  const auto hashVertex = [this](uint32_t v) {
+    return HashFloats(vertices_ + v * stride_, stride_);
+  };
+  const auto equalVertex = [this](uint32_t a, uint32_t b) {
+    return std::memcmp(vertices_ + a * stride_, vertices_ + b * stride_,
+                       stride_ * sizeof(float)) == 0;
+  };
+  const auto hashPosition = [this](uint32_t v) {
+    return HashFloats(vertices_ + v * stride_ + positionOffset_, 3);
+  };
+  const auto equalPosition = [this](uint32_t a, uint32_t b) {
+    return positions_[a] == positions_[b];
+  };
+
+  std::unordered_set<uint32_t, decltype(hashVertex), decltype(equalVertex)>
+      vertexSet(vertexCount_, hashVertex, equalVertex);
+  std::unordered_set<uint32_t, decltype(hashPosition), decltype(equalPosition)>
+      positionSet(vertexCount_, hashPosition, equalPosition);
+
+  canonical_.resize(vertexCount_);
+  wedge_.resize(vertexCount_);
+  for (uint32_t v = 0; v < vertexCount_; v++) {
+    wedge_[v] = v;
+
+    const auto [it, inserted] = vertexSet.insert(v);
+    canonical_[v] = *it;
+    if (!inserted) {
+      continue;
+    }
+
+    const auto [pit, pinserted] = positionSet.insert(v);
+    if (!pinserted) {
+      const uint32_t r = *pit;
+      wedge_[v] = wedge_[r];
+      wedge_[r] = v;
+    }
+  }
+}
+
+/**
+ * @brief 位置で溶接したトポロジーから境界や非多様体を検出し、頂点の種類を決定します。
+ */
+void MeshSimplifier::ClassifyVertices() {
+  // 同一位置グループの最小インデックスを位置IDとして用います。
+  std::vector<uint32_t> pid(vertexCount_);
+  for (uint32_t v = 0; v < vertexCount_; v++) {
+    uint32_t m = v;
+    for (uint32_t w = wedge_[v]; w != v; w = wedge_[w]) {
+      m = std::min(m, w);
+    }
+    pid[v] = m;
+  }
+
+  std::unordered_map<uint64_t, uint32_t> halfEdges;
+  halfEdges.reserve(indices_.size());
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    for (int e = 0; e < 3; e++) {
+      const uint32_t a = pid[indices_[i + e]];
+      const uint32_t b = pid[indices_[i + (e + 1) % 3]];
+      halfEdges[EdgeKey(a, b)]++;
+    }
+  }
+
+  kinds_.assign(vertexCount_, VertexKind::Manifold);
+  std::vector<uint32_t> borderCount(vertexCount_, 0);
+  borderEdges_.clear();
+  for (const auto &[key, count] : halfEdges) {
+    const auto a = static_cast<uint32_t>(key >> 32);
+    const auto b = static_cast<uint32_t>(key & 0xffffffffu);
+    if (count > 1) {
+      // 同じ向きの半辺を複数の三角形が共有する非多様体エッジです。
+      kinds_[a] = VertexKind::Locked;
+      kinds_[b] = VertexKind::Locked;
+      continue;
+    }
+    if (!halfEdges.contains(EdgeKey(b, a))) {
+      borderEdges_.emplace_back(key);
+      borderCount[a]++;
+      borderCount[b]++;
+    }
+  }
+  std::sort(borderEdges_.begin(), borderEdges_.end());
+
+  for (uint32_t v = 0; v < vertexCount_; v++) {
+    if (canonical_[v] != v) {
+      continue;
+    }
+    VertexKind &kind = kinds_[v];
+    if (wedge_[v] != v || kinds_[pid[v]] == VertexKind::Locked) {
+      // 属性の継ぎ目上の頂点は縮約するとひび割れが生じるため固定します。
+      kind = VertexKind::Locked;
+    } else if (borderCount[v] > 0) {
+      kind = (options_.lockBorder || borderCount[v] != 2) ? VertexKind::Locked
+                                                          : VertexKind::Border;
+    }
+  }
+}
+
+/**
+ * @brief 各三角形の平面を面積で重み付けして頂点の二次誤差に加算します。
+ */
+void MeshSimplifier::ComputeQuadrics() {
+  quadrics_.assign(vertexCount_, Quadric{});
+
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    const uint32_t v[3] = {indices_[i + 0], indices_[i + 1], indices_[i + 2]};
+    const glm::dvec3 &p0 = positions_[v[0]];
+    const glm::dvec3 &p1 = positions_[v[1]];
+    const glm::dvec3 &p2 = positions_[v[2]];
+
+    glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+    const double len = glm::length(n);
+    if (len == 0.0) {
+      continue;
+    }
+    n /= len;
+    const double area = 0.5 * len;
+    const double d = -glm::dot(n, p0);
+    for (uint32_t k : v) {
+      quadrics_[k].AddPlane(n, d, area);
+    }
+
+    // 境界エッジには、エッジを含み面に直交する平面を加えて輪郭を保持します。
+    for (int e = 0; e < 3; e++) {
+      const uint32_t a = v[e];
+      const uint32_t b = v[(e + 1) % 3];
+      if (!IsBorderEdge(a, b)) {
+        continue;
+      }
+      const glm::dvec3 edge = positions_[b] - positions_[a];
+      const double edgeLen2 = glm::dot(edge, edge);
+      glm::dvec3 m = glm::cross(edge, n);
+      const double mlen = glm::length(m);
+      if (mlen == 0.0) {
+        continue;
+      }
+      m /= mlen;
+      const double md = -glm::dot(m, positions_[a]);
+      quadrics_[a].AddPlane(m, md, edgeLen2 * kBorderWeight);
+      quadrics_[b].AddPlane(m, md, edgeLen2 * kBorderWeight);
+    }
+  }
+}
+
+/**
+ * @brief 頂点から隣接三角形を引くためのCSR形式の隣接リストを構築します。
+ */
+void MeshSimplifier::BuildAdjacency() {
+  adjOffsets_.assign(vertexCount_ + 1, 0);
+  for (uint32_t idx : indices_) {
+    adjOffsets_[idx + 1]++;
+  }
+  for (size_t v = 0; v < vertexCount_; v++) {
+    adjOffsets_[v + 1] += adjOffsets_[v];
+  }
+
+  adjTriangles_.resize(indices_.size());
+  std::vector<uint32_t> fill(adjOffsets_.begin(), adjOffsets_.end() - 1);
+  for (size_t i = 0; i < indices_.size(); i++) {
+    adjTriangles_[fill[indices_[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// Collapse
+//*-----------------------------------------------------------------------------
+
+bool MeshSimplifier::IsBorderEdge(uint32_t a, uint32_t b) const {
+  return std::binary_search(borderEdges_.begin(), borderEdges_.end(),
+                            EdgeKey(a, b)) ||
+         std::binary_search(borderEdges_.begin(), borderEdges_.end(),
+                            EdgeKey(b, a));
+}
+
+bool MeshSimplifier::CanCollapse(uint32_t from, uint32_t to) const {
+  switch (kinds_[from]) {
+  case VertexKind::Manifold:
+    return true;
+  case VertexKind::Border:
+    // 境界頂点は境界に沿ってのみ縮約し、輪郭を崩さないようにします。
+    return kinds_[to] != VertexKind::Manifold && IsBorderEdge(from, to);
+  case VertexKind::Locked:
+    return false;
+  }
+  return false;
+}
+
+/**
+ * @brief 縮約によって周囲の三角形の向きが反転するかどうかを判定します。
+ */
+bool MeshSimplifier::HasFlip(uint32_t from, uint32_t to) const {
+  for (uint32_t i = adjOffsets_[from]; i < adjOffsets_[from + 1]; i++) {
+    const uint32_t t = adjTriangles_[i];
+    const uint32_t v[3] = {indices_[t * 3 + 0], indices_[t * 3 + 1],
+                           indices_[t * 3 + 2]};
+    if (v[0] == to || v[1] == to || v[2] == to) {
+      continue;
+    }
+
+    glm::dvec3 p[3] = {positions_[v[0]], positions_[v[1]], positions_[v[2]]};
+    const glm::dvec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+    for (int k = 0; k < 3; k++) {
+      if (v[k] == from) {
+        p[k] = positions_[to];
+      }
+    }
+    const glm::dvec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+    if (glm::dot(n0, n1) <= 0.0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double MeshSimplifier::AttributeCost(uint32_t from, uint32_t to) const {
+  double cost = 0.0;
+  for (const auto &attr : options_.attributes) {
+    const float *a = vertices_ + from * stride_ + attr.offset;
+    const float *b = vertices_ + to * stride_ + attr.offset;
+    double sum = 0.0;
+    for (uint32_t k = 0; k < attr.count; k++) {
+      const double diff = static_cast<double>(a[k]) - b[k];
+      sum += diff * diff;
+    }
+    cost += attr.weight * sum;
+  }
+  return cost;
+}
+
+/**
+ * @brief 候補エッジをコスト順に並べ、互いに干渉しない縮約をまとめて適用します。
+ * @return 適用した縮約の数
+ */
+size_t MeshSimplifier::RunPass(size_t targetIndexCount, double targetError) {
+  std::vector<Collapse> candidates;
+  candidates.reserve(indices_.size() * 2);
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    for (int e = 0; e < 3; e++) {
+      const uint32_t a = indices_[i + e];
+      const uint32_t b = indices_[i + (e + 1) % 3];
+      for (const auto &[from, to] : {std::pair{a, b}, std::pair{b, a}}) {
+        if (!CanCollapse(from, to)) {
+          continue;
+        }
+        Quadric q = quadrics_[from];
+        q.Add(quadrics_[to]);
+        const double error = q.Eval(positions_[to]) / std::max(q.w, 1e-30);
+        candidates.push_back(
+            {from, to, error + AttributeCost(from, to), error});
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Collapse &lhs, const Collapse &rhs) {
+              return lhs.cost < rhs.cost;
+            });
+
+  // 内部エッジの縮約で三角形は2つ減るため、目標を超えないよう縮約数を制限します。
+  const size_t triangles = indices_.size() / 3;
+  const size_t targetTriangles = targetIndexCount / 3;
+  const size_t maxCollapses = std::max<size_t>(
+      (triangles - std::min(triangles, targetTriangles)) / 2, 1);
+  const double targetErrorSq = targetError * targetError;
+
+  std::vector<uint32_t> remap(vertexCount_);
+  for (uint32_t v = 0; v < vertexCount_; v++) {
+    remap[v] = v;
+  }
+  std::vector<uint8_t> locked(vertexCount_, 0);
+
+  size_t collapses = 0;
+  for (const auto &c : candidates) {
+    if (c.error > targetErrorSq) {
+      continue;
+    }
+    if (locked[c.from] || locked[c.to] || HasFlip(c.from, c.to)) {
+      continue;
+    }
+
+    remap[c.from] = c.to;
+    quadrics_[c.to].Add(quadrics_[c.from]);
+    error_ = std::max(error_, static_cast<float>(std::sqrt(c.error)));
+
+    // 同一パス内で隣接する縮約が起きると反転判定が無効になるため、1-ringを固定します。
+    for (uint32_t i = adjOffsets_[c.from]; i < adjOffsets_[c.from + 1]; i++) {
+      const uint32_t t = adjTriangles_[i];
+      locked[indices_[t * 3 + 0]] = 1;
+      locked[indices_[t * 3 + 1]] = 1;
+      locked[indices_[t * 3 + 2]] = 1;
+    }
+
+    if (++collapses >= maxCollapses) {
+      break;
+    }
+  }
+  if (collapses == 0) {
+    return 0;
+  }
+
+  size_t write = 0;
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    const uint32_t i0 = remap[indices_[i + 0]];
+    const uint32_t i1 = remap[indices_[i + 1]];
+    const uint32_t i2 = remap[indices_[i + 2]];
+    if (i0 == i1 || i1 == i2 || i2 == i0) {
+      continue;
+    }
+    indices_[write++] = i0;
+    indices_[write++] = i1;
+    indices_[write++] = i2;
+  }
+  indices_.resize(write);
+
+  BuildAdjacency();
+  return collapses;
+}
+
+float MeshSimplifier::Simplify(size_t targetIndexCount, float targetError) {
+  targetIndexCount -= targetIndexCount % 3;
+  while (indices_.size() > targetIndexCount) {
+    if (RunPass(targetIndexCount, targetError) == 0) {
+      break;
+    }
+  }
+  return error_;
+}
@@ -0,0 +1,121 @@
+/**
+ * @brief 二次誤差計量(QEM)によるメッシュ簡略化
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 簡略化時に考慮する頂点属性(法線やUVなど)を表します。
+ */
+struct MeshSimplifyAttribute {
+  /** @brief 頂点先頭からのオフセット(float単位) */
+  uint32_t offset = 0;
+  /** @brief 要素数(float単位) */
+  uint32_t count = 0;
+  /** @brief 誤差に加算する際の重み */
+  float weight = 1.0f;
+};
+
+struct MeshSimplifyOptions {
+  /** @brief 開いた境界上の頂点を固定します。 */
+  bool lockBorder = false;
+  std::vector<MeshSimplifyAttribute> attributes{};
+};
+
+/**
+ * @brief エッジ縮約による簡略化を行います。
+ * @note
+ * 頂点は既存の頂点へ縮約されるため、結果のインデックスは元の頂点バッファをそのまま参照できます。<br>
+ * Simplifyを目標値を下げながら繰り返し呼び出すことで、誤差を累積したままLODチェーンを生成できます。<br>
+ * 属性の継ぎ目(シーム)や非多様体エッジ上の頂点は固定されます。
+ */
+class MeshSimplifier {
+public:
+  /**
+   * @param vertices インターリーブされた頂点データ
+   * @param vertexCount 頂点数
+   * @param stride 頂点ごとのfloat数
+   * @param positionOffset 頂点先頭から位置までのオフセット(float単位)
+   * @param indices 三角形リストのインデックス(0 ~ vertexCount - 1)
+   */
+  MeshSimplifier(const float *vertices, size_t vertexCount, size_t stride,
+                 size_t positionOffset, const std::vector<uint32_t> &indices,
+                 MeshSimplifyOptions options = {});
+
+  /**
+   * @brief インデックス数がtargetIndexCount以下になるか、誤差がtargetErrorを超えるまで簡略化します。
+   * @return これまでに生じた最大の幾何誤差(頂点座標系における距離)
+   */
+  float Simplify(size_t targetIndexCount, float targetError);
+
+  [[nodiscard]] const std::vector<uint32_t> &GetIndices() const {
+    return indices_;
+  }
+  [[nodiscard]] float GetError() const { return error_; }
+
+private:
+  enum struct VertexKind : uint8_t {
+    Manifold,
+    Border,
+    Locked,
+  };
+
+  /** @brief 対称4x4行列の上三角成分と重みを保持する二次誤差 */
+  struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+    double w = 0.0;
+
+    void AddPlane(const glm::dvec3 &n, double d, double weight);
+    void Add(const Quadric &q);
+    [[nodiscard]] double Eval(const glm::dvec3 &p) const;
+  };
+
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+    double error;
+  };
+
+  void WeldVertices();
+  void ClassifyVertices();
+  void ComputeQuadrics();
+  void BuildAdjacency();
+
+  [[nodiscard]] bool CanCollapse(uint32_t from, uint32_t to) const;
+  [[nodiscard]] bool HasFlip(uint32_t from, uint32_t to) const;
+  [[nodiscard]] double AttributeCost(uint32_t from, uint32_t to) const;
+  [[nodiscard]] bool IsBorderEdge(uint32_t a, uint32_t b) const;
+
+  size_t RunPass(size_t targetIndexCount, double targetError);
+
+  const float *vertices_;
+  size_t vertexCount_;
+  size_t stride_;
+  size_t positionOffset_;
+  MeshSimplifyOptions options_;
+
+  std::vector<glm::dvec3> positions_{};
+  /** @brief 同一データの頂点を代表頂点へ写像します。 */
+  std::vector<uint32_t> canonical_{};
+  /** @brief 同一位置の代表頂点同士の循環リスト */
+  std::vector<uint32_t> wedge_{};
+  std::vector<VertexKind> kinds_{};
+  std::vector<Quadric> quadrics_{};
+
+  /** @brief 境界の半辺(from -> to)を64bitキーで保持します。 */
+  std::vector<uint64_t> borderEdges_{};
+
+  std::vector<uint32_t> adjOffsets_{};
+  std::vector<uint32_t> adjTriangles_{};
+
+  std::vector<uint32_t> indices_{};
+  float error_ = 0.0f;
+};
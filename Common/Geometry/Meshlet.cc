@@ -0,0 +1,219 @@
+/**
+ * @brief メッシュレット(小さな三角形クラスタ)の構築
+ */
+
+#include "Geometry/Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Geometry/AABB.h"
+
+namespace {
+glm::vec3 FetchVec3(const float *vertices, const MeshletBuildInfo &info,
+                    uint32_t v, size_t offset) {
+  const float *p = vertices + v * info.stride + offset;
+  return glm::vec3(p[0], p[1], p[2]);
+}
+
+/**
+ * @brief メッシュレットの境界球と法線コーンを計算します。
+ */
+void ComputeBounds(Meshlet &meshlet, const MeshletData &data,
+                   const float *vertices, const MeshletBuildInfo &info) {
+  AABB aabb;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    aabb.Merge(FetchVec3(vertices, info,
+                         data.vertices[meshlet.vertexOffset + i],
+                         info.positionOffset));
+  }
+  const glm::vec3 center = 0.5f * (aabb.mini + aabb.maxi);
+  float radius = 0.0f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    const glm::vec3 p = FetchVec3(
+        vertices, info, data.vertices[meshlet.vertexOffset + i],
+        info.positionOffset);
+    radius = std::max(radius, glm::length(p - center));
+  }
+  meshlet.bounds = {center, radius};
+
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.triangleCount);
+  glm::vec3 axis(0.0f);
+  for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+    const uint8_t *tri = &data.triangles[(meshlet.triangleOffset + t) * 3];
+    uint32_t v[3];
+    for (int k = 0; k < 3; k++) {
+      v[k] = data.vertices[meshlet.vertexOffset + tri[k]];
+    }
+    const glm::vec3 p0 = FetchVec3(vertices, info, v[0], info.positionOffset);
+    const glm::vec3 p1 = FetchVec3(vertices, info, v[1], info.positionOffset);
+    const glm::vec3 p2 = FetchVec3(vertices, info, v[2], info.positionOffset);
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    const float len = glm::length(n);
+    if (len == 0.0f) {
+      continue;
+    }
+    n /= len;
+
+    // 巻き順の規約に依存しないよう、頂点法線と同じ側を表とします。
+    if (info.normalOffset.has_value()) {
+      const glm::vec3 vn =
+          FetchVec3(vertices, info, v[0], *info.normalOffset) +
+          FetchVec3(vertices, info, v[1], *info.normalOffset) +
+          FetchVec3(vertices, info, v[2], *info.normalOffset);
+      if (glm::dot(n, vn) < 0.0f) {
+        n = -n;
+      }
+    }
+    normals.emplace_back(n);
+    axis += n;
+  }
+
+  const float axisLen = glm::length(axis);
+  if (normals.empty() || axisLen == 0.0f) {
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    return;
+  }
+  axis /= axisLen;
+
+  float minDot = 1.0f;
+  for (const auto &n : normals) {
+    minDot = std::min(minDot, glm::dot(axis, n));
+  }
+  meshlet.coneAxis = axis;
+  // 法線の広がりが半球を超える場合はカリングできません。
+  meshlet.coneCutoff =
+      minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
+} // namespace
+
+size_t BuildMeshlets(MeshletData &data, const std::vector<uint32_t> &indices,
+                     const float *vertices, const MeshletBuildInfo &info) {
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return 0;
+  }
+  const uint32_t vertexCount =
+      *std::max_element(indices.begin(), indices.end()) + 1;
+
+  // 頂点から三角形を引く隣接リストを構築します。
+  std::vector<uint32_t> adjOffsets(vertexCount + 1, 0);
+  for (uint32_t idx : indices) {
+    adjOffsets[idx + 1]++;
+  }
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    adjOffsets[v + 1] += adjOffsets[v];
+  }
+  std::vector<uint32_t> adjTriangles(indices.size());
+  {
+    std::vector<uint32_t> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+      adjTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<uint8_t> emitted(triangleCount, 0);
+  std::vector<int32_t> localIndex(vertexCount, -1);
+  const size_t firstMeshlet = data.meshlets.size();
+
+  Meshlet current{};
+  current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+  current.triangleOffset = static_cast<uint32_t>(data.triangles.size() / 3);
+  glm::vec3 centroid(0.0f);
+
+  const auto flush = [&]() {
+    if (current.triangleCount == 0) {
+      return;
+    }
+    ComputeBounds(current, data, vertices, info);
+    for (uint32_t i = 0; i < current.vertexCount; i++) {
+      localIndex[data.vertices[current.vertexOffset + i]] = -1;
+    }
+    data.meshlets.emplace_back(current);
+
+    current = Meshlet{};
+    current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+    current.triangleOffset = static_cast<uint32_t>(data.triangles.size() / 3);
+    centroid = glm::vec3(0.0f);
+  };
+
+  const auto newVertices = [&](size_t t) {
+    uint32_t count = 0;
+    for (int k = 0; k < 3; k++) {
+      count += localIndex[indices[t * 3 + k]] < 0 ? 1 : 0;
+    }
+    return count;
+  };
+
+  size_t seed = 0;
+  size_t remaining = triangleCount;
+  while (remaining > 0) {
+    // 現在のメッシュレットの頂点に隣接し、追加頂点が最も少なく重心に近い三角形を選びます。
+    size_t best = std::numeric_limits<size_t>::max();
+    float bestScore = std::numeric_limits<float>::max();
+    const glm::vec3 center =
+        current.vertexCount > 0
+            ? centroid / static_cast<float>(current.vertexCount)
+            : glm::vec3(0.0f);
+    for (uint32_t i = 0; i < current.vertexCount; i++) {
+      const uint32_t v = data.vertices[current.vertexOffset + i];
+      for (uint32_t a = adjOffsets[v]; a < adjOffsets[v + 1]; a++) {
+        const uint32_t t = adjTriangles[a];
+        if (emitted[t]) {
+          continue;
+        }
+        const uint32_t extra = newVertices(t);
+        if (current.vertexCount + extra > info.maxVertices) {
+          continue;
+        }
+        const glm::vec3 tc =
+            (FetchVec3(vertices, info, indices[t * 3 + 0], info.positionOffset) +
+             FetchVec3(vertices, info, indices[t * 3 + 1], info.positionOffset) +
+             FetchVec3(vertices, info, indices[t * 3 + 2], info.positionOffset)) /
+            3.0f;
+        const float score =
+            static_cast<float>(extra) * 1e6f + glm::length(tc - center);
+        if (score < bestScore) {
+          bestScore = score;
+          best = t;
+        }
+      }
+    }
+
+    if (best == std::numeric_limits<size_t>::max()) {
+      if (current.triangleCount > 0) {
+        // 隣接三角形が入らないため、新しいメッシュレットを始めます。
+        flush();
+        continue;
+      }
+      while (emitted[seed]) {
+        seed++;
+      }
+      best = seed;
+    }
+
+    for (int k = 0; k < 3; k++) {
+      const uint32_t v = indices[best * 3 + k];
+      if (localIndex[v] < 0) {
+        localIndex[v] = static_cast<int32_t>(current.vertexCount++);
+        data.vertices.emplace_back(v);
+        centroid += FetchVec3(vertices, info, v, info.positionOffset);
+      }
+      data.triangles.emplace_back(static_cast<uint8_t>(localIndex[v]));
+    }
+    current.triangleCount++;
+    emitted[best] = 1;
+    remaining--;
+
+    if (current.triangleCount >= info.maxTriangles ||
+        current.vertexCount >= info.maxVertices) {
+      flush();
+    }
+  }
+  flush();
+
+  return data.meshlets.size() - firstMeshlet;
+}
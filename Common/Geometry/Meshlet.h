@@ -0,0 +1,70 @@
+/**
+ * @brief メッシュレット(小さな三角形クラスタ)の構築
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Geometry/BSphere.h"
+
+/**
+ * @brief 頂点と三角形の範囲、および可視判定用の境界と法線コーンを保持します。
+ */
+struct Meshlet {
+  /** @brief MeshletData::verticesの先頭 */
+  uint32_t vertexOffset = 0;
+  /** @brief MeshletData::triangles内の三角形単位の先頭 */
+  uint32_t triangleOffset = 0;
+  uint32_t vertexCount = 0;
+  uint32_t triangleCount = 0;
+
+  /** @brief 境界球 */
+  BSphere bounds{};
+  /** @brief 法線コーンの軸 */
+  glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+  /**
+   * @brief 法線コーンのカットオフ
+   * @note
+   * dot(normalize(center - eye), coneAxis) >= coneCutoff
+   * を満たすとき全三角形が裏向きです。1以上なら裏面カリングできません。
+   */
+  float coneCutoff = 1.0f;
+};
+
+struct MeshletData {
+  std::vector<Meshlet> meshlets{};
+  /** @brief メッシュレットのローカル頂点から頂点バッファへのインデックス */
+  std::vector<uint32_t> vertices{};
+  /** @brief 三角形ごとに3つのローカル頂点インデックス */
+  std::vector<uint8_t> triangles{};
+};
+
+struct MeshletBuildInfo {
+  static constexpr uint32_t kMaxVertices = 64;
+  static constexpr uint32_t kMaxTriangles = 124;
+
+  uint32_t maxVertices = kMaxVertices;
+  uint32_t maxTriangles = kMaxTriangles;
+
+  /** @brief 頂点ごとのfloat数 */
+  size_t stride = 3;
+  /** @brief 頂点先頭から位置までのオフセット(float単位) */
+  size_t positionOffset = 0;
+  /** @brief 三角形の向きを揃えるための頂点法線のオフセット(float単位) */
+  std::optional<size_t> normalOffset = std::nullopt;
+};
+
+/**
+ * @brief 隣接する三角形を貪欲に集めてメッシュレットを構築し、dataへ追加します。
+ * @param indices 頂点バッファ全体を参照する三角形リスト
+ * @param vertices インターリーブされた頂点データ
+ * @return 追加したメッシュレット数
+ */
+size_t BuildMeshlets(MeshletData &data, const std::vector<uint32_t> &indices,
+                     const float *vertices, const MeshletBuildInfo &info);
@@ -0,0 +1,197 @@
+/**
+ * @brief アセットを1ファイルにまとめたアーカイブの読み書き
+ */
+
+#include "IO/Archive.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "IO/Lz4.h"
+
+namespace Archive {
+std::string NormalizeName(const std::string &name) {
+  return std::filesystem::path(name).lexically_normal().generic_string();
+}
+} // namespace Archive
+
+//*-----------------------------------------------------------------------------
+// Reader
+//*-----------------------------------------------------------------------------
+
+bool ArchiveReader::Open(const std::string &filepath) {
+  path_ = filepath;
+  entries_.clear();
+
+  std::ifstream ifs(filepath, std::ios::binary);
+  if (!ifs) {
+    std::cerr << "Failed to open " << filepath << std::endl;
+    return false;
+  }
+
+  Archive::Header header{};
+  ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!ifs || header.magic != Archive::kMagic ||
+      header.version != Archive::kVersion) {
+    std::cerr << filepath << " is not an asset archive." << std::endl;
+    return false;
+  }
+
+  std::vector<char> toc(header.tocSize);
+  ifs.seekg(static_cast<std::streamoff>(header.tocOffset));
+  ifs.read(toc.data(), static_cast<std::streamsize>(toc.size()));
+  if (!ifs) {
+    std::cerr << filepath << ": truncated table of contents." << std::endl;
+    return false;
+  }
+
+  // TOCは(offset, storedSize, size, compression, nameLength, name)の並びです。
+  size_t pos = 0;
+  const auto read = [&toc, &pos](void *dst, size_t size) {
+    if (pos + size > toc.size()) {
+      return false;
+    }
+    std::memcpy(dst, toc.data() + pos, size);
+    pos += size;
+    return true;
+  };
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    Archive::Entry entry{};
+    uint32_t nameLength = 0;
+    bool ok = read(&entry.offset, sizeof(uint64_t)) &&
+              read(&entry.storedSize, sizeof(uint64_t)) &&
+              read(&entry.size, sizeof(uint64_t)) &&
+              read(&entry.compression, sizeof(uint32_t)) &&
+              read(&nameLength, sizeof(uint32_t));
+    std::string name(nameLength, '\0');
+    ok = ok && read(name.data(), nameLength);
+    if (!ok) {
+      std::cerr << filepath << ": broken table of contents." << std::endl;
+      entries_.clear();
+      return false;
+    }
+    entries_.emplace(std::move(name), entry);
+  }
+  return true;
+}
+
+const Archive::Entry *ArchiveReader::Find(const std::string &name) const {
+  const auto it = entries_.find(Archive::NormalizeName(name));
+  return it != entries_.end() ? &it->second : nullptr;
+}
+
+std::optional<std::vector<std::byte>>
+ArchiveReader::Read(const std::string &name) const {
+  const Archive::Entry *entry = Find(name);
+  if (entry == nullptr) {
+    return std::nullopt;
+  }
+
+  std::vector<std::byte> stored(entry->storedSize);
+  std::ifstream ifs(path_, std::ios::binary);
+  ifs.seekg(static_cast<std::streamoff>(entry->offset));
+  ifs.read(reinterpret_cast<char *>(stored.data()),
+           static_cast<std::streamsize>(stored.size()));
+  if (!ifs) {
+    std::cerr << path_ << ": failed to read " << name << std::endl;
+    return std::nullopt;
+  }
+  if (entry->compression == Archive::Compression::None) {
+    return stored;
+  }
+
+  std::vector<std::byte> data(entry->size);
+  if (!Decode(*entry, stored.data(), data.data())) {
+    std::cerr << path_ << ": failed to decode " << name << std::endl;
+    return std::nullopt;
+  }
+  return data;
+}
+
+bool ArchiveReader::Decode(const Archive::Entry &entry,
+                           const std::byte *stored, std::byte *dst) {
+  switch (entry.compression) {
+  case Archive::Compression::None:
+    std::memcpy(dst, stored, entry.size);
+    return true;
+  case Archive::Compression::Lz4: {
+    const auto size = Lz4::Decompress(stored, entry.storedSize, dst, entry.size);
+    return size && *size == entry.size;
+  }
+  }
+  return false;
+}
+
+//*-----------------------------------------------------------------------------
+// Writer
+//*-----------------------------------------------------------------------------
+
+bool ArchiveWriter::Open(const std::string &filepath) {
+  ofs_.open(filepath, std::ios::binary | std::ios::trunc);
+  if (!ofs_) {
+    std::cerr << "Failed to open " << filepath << std::endl;
+    return false;
+  }
+  // ヘッダはCloseで書き直します。
+  const Archive::Header header{};
+  ofs_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  offset_ = sizeof(header);
+  entries_.clear();
+  return true;
+}
+
+bool ArchiveWriter::Add(const std::string &name,
+                        const std::vector<std::byte> &data, bool compress) {
+  Archive::Entry entry{};
+  entry.size = data.size();
+
+  std::vector<std::byte> compressed{};
+  const std::vector<std::byte> *stored = &data;
+  if (compress && !data.empty()) {
+    compressed = Lz4::Compress(data.data(), data.size());
+    if (compressed.size() < data.size()) {
+      entry.compression = Archive::Compression::Lz4;
+      stored = &compressed;
+    }
+  }
+  entry.storedSize = stored->size();
+
+  const uint64_t aligned = (offset_ + Archive::kBlobAlignment - 1) &
+                           ~(Archive::kBlobAlignment - 1);
+  const std::vector<char> padding(aligned - offset_, 0);
+  ofs_.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+  ofs_.write(reinterpret_cast<const char *>(stored->data()),
+             static_cast<std::streamsize>(stored->size()));
+  entry.offset = aligned;
+  offset_ = aligned + entry.storedSize;
+
+  entries_.emplace_back(Archive::NormalizeName(name), entry);
+  return static_cast<bool>(ofs_);
+}
+
+bool ArchiveWriter::Close() {
+  Archive::Header header{};
+  header.magic = Archive::kMagic;
+  header.version = Archive::kVersion;
+  header.entryCount = static_cast<uint32_t>(entries_.size());
+  header.tocOffset = offset_;
+
+  for (const auto &[name, entry] : entries_) {
+    const auto nameLength = static_cast<uint32_t>(name.size());
+    ofs_.write(reinterpret_cast<const char *>(&entry.offset), sizeof(uint64_t));
+    ofs_.write(reinterpret_cast<const char *>(&entry.storedSize),
+               sizeof(uint64_t));
+    ofs_.write(reinterpret_cast<const char *>(&entry.size), sizeof(uint64_t));
+    ofs_.write(reinterpret_cast<const char *>(&entry.compression),
+               sizeof(uint32_t));
+    ofs_.write(reinterpret_cast<const char *>(&nameLength), sizeof(uint32_t));
+    ofs_.write(name.data(), nameLength);
+    header.tocSize += 3 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + nameLength;
+  }
+
+  ofs_.seekp(0);
+  ofs_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  ofs_.close();
+  return !ofs_.fail();
+}
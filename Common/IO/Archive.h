@@ -0,0 +1,98 @@
+/**
+ * @brief アセットを1ファイルにまとめたアーカイブの読み書き
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief
+ * 先頭のヘッダ、kBlobAlignment境界に揃えたブロブ、末尾の目次(TOC)からなるアーカイブ形式です。
+ * @note ブロブはエントリごとにLZ4で圧縮できます。
+ */
+namespace Archive {
+inline constexpr uint32_t kMagic = 0x41504B56; // "VKPA"
+inline constexpr uint32_t kVersion = 1;
+/** @brief ブロブの配置境界(ページサイズに揃えて直接読み込みやすくします) */
+inline constexpr uint64_t kBlobAlignment = 4096;
+
+enum struct Compression : uint32_t {
+  None,
+  Lz4,
+};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+  uint64_t tocOffset;
+  uint64_t tocSize;
+};
+static_assert(sizeof(Header) == 32);
+
+struct Entry {
+  /** @brief ファイル先頭からのブロブの位置 */
+  uint64_t offset = 0;
+  /** @brief ファイル上のサイズ(圧縮後) */
+  uint64_t storedSize = 0;
+  /** @brief 展開後のサイズ */
+  uint64_t size = 0;
+  Compression compression = Compression::None;
+};
+
+/** @brief "./Assets/a.ktx"と"Assets/a.ktx"が同じ名前になるよう正規化します。 */
+[[nodiscard]] std::string NormalizeName(const std::string &name);
+} // namespace Archive
+
+class ArchiveReader {
+public:
+  bool Open(const std::string &filepath);
+
+  [[nodiscard]] const Archive::Entry *Find(const std::string &name) const;
+  [[nodiscard]] const std::string &GetPath() const { return path_; }
+  [[nodiscard]] size_t GetEntryCount() const { return entries_.size(); }
+
+  /**
+   * @brief エントリを同期的に読み込み、必要なら展開します。
+   */
+  [[nodiscard]] std::optional<std::vector<std::byte>>
+  Read(const std::string &name) const;
+
+  /**
+   * @brief 読み込んだブロブをdstへ展開します。
+   * @param dst 少なくともentry.sizeバイトの領域
+   */
+  static bool Decode(const Archive::Entry &entry, const std::byte *stored,
+                     std::byte *dst);
+
+private:
+  std::string path_{};
+  std::unordered_map<std::string, Archive::Entry> entries_{};
+};
+
+class ArchiveWriter {
+public:
+  bool Open(const std::string &filepath);
+
+  /**
+   * @param compress LZ4で圧縮します(縮まない場合はそのまま格納します)。
+   */
+  bool Add(const std::string &name, const std::vector<std::byte> &data,
+           bool compress);
+
+  /** @brief 目次を書き出してファイルを閉じます。 */
+  bool Close();
+
+private:
+  std::ofstream ofs_{};
+  std::vector<std::pair<std::string, Archive::Entry>> entries_{};
+  uint64_t offset_ = 0;
+};
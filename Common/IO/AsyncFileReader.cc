@@ -0,0 +1,371 @@
+/**
+ * @brief ファイルの非同期読み込み(Linuxではio_uring、それ以外はスレッドプール)
+ */
+
+#include "IO/AsyncFileReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "Utils/ThreadPool.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+//*-----------------------------------------------------------------------------
+// io_uring
+//*-----------------------------------------------------------------------------
+
+#if defined(__linux__)
+/**
+ * @brief liburingを使わずにシステムコールで直接扱うio_uringのリング
+ */
+struct AsyncFileReader::Ring {
+  struct Request {
+    uint64_t offset = 0;
+    size_t size = 0;
+    std::byte *dst = nullptr;
+  };
+
+  ~Ring() {
+    if (sqes != nullptr) {
+      munmap(sqes, sqesSize);
+    }
+    if (cqPtr != nullptr && cqPtr != sqPtr) {
+      munmap(cqPtr, cqSize);
+    }
+    if (sqPtr != nullptr) {
+      munmap(sqPtr, sqSize);
+    }
+    if (ringFd >= 0) {
+      close(ringFd);
+    }
+  }
+
+  bool Setup(uint32_t depth) {
+    io_uring_params params{};
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+    if (ringFd < 0) {
+      return false;
+    }
+
+    sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+      sqSize = cqSize = std::max(sqSize, cqSize);
+    }
+
+    sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqPtr == MAP_FAILED) {
+      sqPtr = nullptr;
+      return false;
+    }
+    if (singleMmap) {
+      cqPtr = sqPtr;
+    } else {
+      cqPtr = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+      if (cqPtr == MAP_FAILED) {
+        cqPtr = nullptr;
+        return false;
+      }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqesPtr = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqesPtr == MAP_FAILED) {
+      return false;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqesPtr);
+
+    auto *sq = static_cast<std::byte *>(sqPtr);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    auto *cq = static_cast<std::byte *>(cqPtr);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    entries = params.sq_entries;
+    requests.resize(entries);
+    iovecs.resize(entries);
+    freeSlots.reserve(entries);
+    for (uint32_t i = 0; i < entries; i++) {
+      freeSlots.emplace_back(entries - 1 - i);
+    }
+    return true;
+  }
+
+  /** @brief SQEを1つ積みます(まだカーネルには渡しません)。 */
+  void Push(int fd, uint64_t offset, size_t size, std::byte *dst) {
+    const uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    requests[slot] = {offset, size, dst};
+    iovecs[slot].iov_base = dst;
+    iovecs[slot].iov_len = size;
+
+    // カーネル5.1から使えるREADVを使います。
+    const unsigned tail = *sqTail;
+    const unsigned index = tail & sqMask;
+    io_uring_sqe &sqe = sqes[index];
+    sqe = io_uring_sqe{};
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<uint64_t>(&iovecs[slot]);
+    sqe.len = 1;
+    sqe.user_data = slot;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    unsubmitted++;
+  }
+
+  /**
+   * @brief 積んだSQEを提出し、少なくともminCompleteの完了を待ちます。
+   */
+  bool Enter(uint32_t minComplete) {
+    const unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+      const long submitted = syscall(__NR_io_uring_enter, ringFd, unsubmitted,
+                                     minComplete, flags, nullptr, 0);
+      if (submitted >= 0) {
+        unsubmitted -= static_cast<uint32_t>(submitted);
+        inflight += static_cast<uint32_t>(submitted);
+        return true;
+      }
+      if (errno != EINTR) {
+        return false;
+      }
+    }
+  }
+
+  /**
+   * @brief 完了したCQEを回収します。
+   * @param onComplete bool(const Request&, int32_t res)
+   */
+  template <class F> bool Reap(const F &onComplete) {
+    bool ok = true;
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      const io_uring_cqe &cqe = cqes[head & cqMask];
+      const auto slot = static_cast<uint32_t>(cqe.user_data);
+      ok = onComplete(requests[slot], cqe.res) && ok;
+      freeSlots.emplace_back(slot);
+      inflight--;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return ok;
+  }
+
+  [[nodiscard]] uint32_t GetPendingCount() const {
+    return inflight + unsubmitted;
+  }
+
+  int ringFd = -1;
+  void *sqPtr = nullptr;
+  size_t sqSize = 0;
+  void *cqPtr = nullptr;
+  size_t cqSize = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqesSize = 0;
+
+  unsigned *sqHead = nullptr;
+  unsigned *sqTail = nullptr;
+  unsigned sqMask = 0;
+  unsigned *sqArray = nullptr;
+  unsigned *cqHead = nullptr;
+  unsigned *cqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe *cqes = nullptr;
+
+  uint32_t entries = 0;
+  uint32_t unsubmitted = 0;
+  uint32_t inflight = 0;
+  std::vector<Request> requests{};
+  std::vector<iovec> iovecs{};
+  std::vector<uint32_t> freeSlots{};
+};
+#else
+struct AsyncFileReader::Ring {};
+#endif
+
+//*-----------------------------------------------------------------------------
+// AsyncFileReader
+//*-----------------------------------------------------------------------------
+
+AsyncFileReader::AsyncFileReader(uint32_t queueDepth)
+    : queueDepth_(std::max(queueDepth, 1u)) {}
+
+AsyncFileReader::~AsyncFileReader() { Close(); }
+
+bool AsyncFileReader::Open(const std::string &filepath) {
+  Close();
+  path_ = filepath;
+  failed_ = false;
+
+#if defined(__linux__)
+  fd_ = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    std::cerr << "Failed to open " << filepath << std::endl;
+    return false;
+  }
+  auto ring = std::make_unique<Ring>();
+  if (ring->Setup(queueDepth_)) {
+    ring_ = std::move(ring);
+    return true;
+  }
+#else
+  if (!std::ifstream(filepath, std::ios::binary)) {
+    std::cerr << "Failed to open " << filepath << std::endl;
+    return false;
+  }
+#endif
+
+  // io_uringが使えないため、ワーカースレッドで並列に読み込みます。
+  if (threadPool_ == nullptr) {
+    threadPool_ = std::make_unique<ThreadPool>(
+        std::min<size_t>(queueDepth_, std::thread::hardware_concurrency()));
+  }
+  return true;
+}
+
+void AsyncFileReader::Close() {
+  if (!path_.empty()) {
+    Wait();
+  }
+  ring_.reset();
+#if defined(__linux__)
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+#endif
+  fd_ = -1;
+  path_.clear();
+}
+
+void AsyncFileReader::Read(uint64_t offset, size_t size, std::byte *dst) {
+  if (size == 0) {
+    return;
+  }
+
+#if defined(__linux__)
+  if (ring_ != nullptr) {
+    // 満杯なら少なくとも1つの完了を待って空きを作ります。
+    if (ring_->GetPendingCount() == ring_->entries) {
+      if (!ring_->Enter(1) || !Reap()) {
+        failed_ = true;
+      }
+      // 空きが作れなければ、このリクエストはその場で同期的に読み込みます。
+      if (ring_->GetPendingCount() == ring_->entries) {
+        if (!ReadSync(offset, size, dst)) {
+          failed_ = true;
+        }
+        return;
+      }
+    }
+    ring_->Push(fd_, offset, size, dst);
+    // 深さの半分が溜まったら提出し、カーネル側の処理を先に進めます。
+    if (ring_->unsubmitted * 2 >= ring_->entries && !ring_->Enter(0)) {
+      failed_ = true;
+    }
+    return;
+  }
+#endif
+
+  pending_.emplace_back(threadPool_->Submit(
+      [this, offset, size, dst]() { return ReadSync(offset, size, dst); }));
+}
+
+bool AsyncFileReader::Wait() {
+#if defined(__linux__)
+  if (ring_ != nullptr) {
+    while (ring_->GetPendingCount() > 0) {
+      if (!ring_->Enter(1)) {
+        std::cerr << path_ << ": io_uring_enter failed." << std::endl;
+        failed_ = true;
+        break;
+      }
+      if (!Reap()) {
+        failed_ = true;
+      }
+    }
+    const bool ok = !failed_;
+    failed_ = false;
+    return ok;
+  }
+#endif
+
+  bool ok = !failed_;
+  for (auto &future : pending_) {
+    ok = future.get() && ok;
+  }
+  pending_.clear();
+  failed_ = false;
+  return ok;
+}
+
+bool AsyncFileReader::Reap() {
+#if defined(__linux__)
+  return ring_->Reap([this](const Ring::Request &request, int32_t res) {
+    if (res < 0) {
+      std::cerr << path_ << ": read failed (" << -res << ")" << std::endl;
+      return false;
+    }
+    const auto read = static_cast<size_t>(res);
+    if (read == request.size) {
+      return true;
+    }
+    // 短い読み込みは残りを同期的に読み込みます。
+    return read > 0 && ReadSync(request.offset + read, request.size - read,
+                                request.dst + read);
+  });
+#else
+  return true;
+#endif
+}
+
+bool AsyncFileReader::ReadSync(uint64_t offset, size_t size,
+                               std::byte *dst) const {
+#if defined(__linux__)
+  while (size > 0) {
+    const ssize_t read = pread(fd_, dst, size, static_cast<off_t>(offset));
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      std::cerr << path_ << ": failed to read " << size << " bytes at "
+                << offset << std::endl;
+      return false;
+    }
+    offset += static_cast<uint64_t>(read);
+    size -= static_cast<size_t>(read);
+    dst += read;
+  }
+  return true;
+#else
+  std::ifstream ifs(path_, std::ios::binary);
+  ifs.seekg(static_cast<std::streamoff>(offset));
+  ifs.read(reinterpret_cast<char *>(dst), static_cast<std::streamsize>(size));
+  if (!ifs) {
+    std::cerr << path_ << ": failed to read " << size << " bytes at " << offset
+              << std::endl;
+    return false;
+  }
+  return true;
+#endif
+}
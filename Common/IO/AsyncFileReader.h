@@ -0,0 +1,64 @@
+/**
+ * @brief ファイルの非同期読み込み(Linuxではio_uring、それ以外はスレッドプール)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief
+ * 1つのファイルから複数の範囲を、呼び出し側のメモリへ直接読み込みます。
+ * @note
+ * Readで要求を積み、Waitで全ての完了を待ちます。Waitまでdstを解放しないでください。<br>
+ * io_uringが使えない環境(Linux以外、カーネルが古い、seccompで禁止されている等)ではスレッドプールで読み込みます。
+ */
+class AsyncFileReader {
+public:
+  /**
+   * @param queueDepth 同時に発行する読み込み要求の最大数
+   */
+  explicit AsyncFileReader(uint32_t queueDepth = 64);
+  ~AsyncFileReader();
+
+  AsyncFileReader(const AsyncFileReader &) = delete;
+  AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+  bool Open(const std::string &filepath);
+  void Close();
+
+  /** @brief [offset, offset + size)をdstへ読み込む要求を積みます。 */
+  void Read(uint64_t offset, size_t size, std::byte *dst);
+
+  /**
+   * @brief 積んだ要求を全て完了させます。
+   * @return 全ての読み込みに成功したらtrue
+   */
+  bool Wait();
+
+  [[nodiscard]] bool IsUsingIoUring() const { return ring_ != nullptr; }
+
+private:
+  struct Ring;
+
+  /** @brief 完了した要求を回収します(io_uringのみ)。 */
+  bool Reap();
+  bool ReadSync(uint64_t offset, size_t size, std::byte *dst) const;
+
+  uint32_t queueDepth_ = 64;
+  std::string path_{};
+  int fd_ = -1;
+  bool failed_ = false;
+
+  std::unique_ptr<Ring> ring_{};
+
+  std::unique_ptr<ThreadPool> threadPool_{};
+  std::vector<std::future<bool>> pending_{};
+};
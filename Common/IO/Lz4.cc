@@ -0,0 +1,160 @@
+/**
+ * @brief LZ4ブロック形式の圧縮と展開
+ */
+
+#include "IO/Lz4.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+constexpr size_t kMinMatch = 4;
+/** @brief 末尾のこのバイト数はリテラルでなければなりません。 */
+constexpr size_t kLastLiterals = 5;
+/** @brief 一致の開始位置は末尾からこのバイト数より前でなければなりません。 */
+constexpr size_t kMatchSafeDistance = 12;
+constexpr size_t kMaxOffset = 65535;
+constexpr uint32_t kHashBits = 14;
+
+uint32_t Read32(const std::byte *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t Hash(uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+void WriteLength(std::vector<std::byte> &dst, size_t length) {
+  while (length >= 255) {
+    dst.push_back(std::byte{255});
+    length -= 255;
+  }
+  dst.push_back(static_cast<std::byte>(length));
+}
+
+void WriteSequence(std::vector<std::byte> &dst, const std::byte *literals,
+                   size_t literalLength, size_t offset, size_t matchLength,
+                   bool last) {
+  const size_t matchCode = last ? 0 : matchLength - kMinMatch;
+  const auto token = static_cast<uint8_t>(
+      (std::min<size_t>(literalLength, 15) << 4) |
+      std::min<size_t>(matchCode, 15));
+  dst.push_back(static_cast<std::byte>(token));
+  if (literalLength >= 15) {
+    WriteLength(dst, literalLength - 15);
+  }
+  dst.insert(dst.end(), literals, literals + literalLength);
+  if (last) {
+    return;
+  }
+  dst.push_back(static_cast<std::byte>(offset & 0xFF));
+  dst.push_back(static_cast<std::byte>(offset >> 8));
+  if (matchCode >= 15) {
+    WriteLength(dst, matchCode - 15);
+  }
+}
+} // namespace
+
+namespace Lz4 {
+size_t GetMaxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+std::vector<std::byte> Compress(const std::byte *src, size_t size) {
+  std::vector<std::byte> dst;
+  dst.reserve(GetMaxCompressedSize(size));
+
+  std::array<uint32_t, 1u << kHashBits> table{};
+  table.fill(UINT32_MAX);
+
+  size_t anchor = 0;
+  size_t pos = 0;
+  if (size > kMatchSafeDistance) {
+    const size_t matchLimit = size - kMatchSafeDistance;
+    while (pos < matchLimit) {
+      const uint32_t sequence = Read32(src + pos);
+      const uint32_t h = Hash(sequence);
+      const uint32_t candidate = table[h];
+      table[h] = static_cast<uint32_t>(pos);
+
+      if (candidate == UINT32_MAX || pos - candidate > kMaxOffset ||
+          Read32(src + candidate) != sequence) {
+        pos++;
+        continue;
+      }
+
+      // 末尾のリテラル領域に掛からない範囲で一致を延ばします。
+      size_t length = kMinMatch;
+      const size_t end = size - kLastLiterals;
+      while (pos + length < end && src[candidate + length] == src[pos + length]) {
+        length++;
+      }
+
+      WriteSequence(dst, src + anchor, pos - anchor, pos - candidate, length,
+                    false);
+      pos += length;
+      anchor = pos;
+    }
+  }
+  WriteSequence(dst, src + anchor, size - anchor, 0, 0, true);
+  return dst;
+}
+
+std::optional<size_t> Decompress(const std::byte *src, size_t srcSize,
+                                 std::byte *dst, size_t dstCapacity) {
+  size_t ip = 0;
+  size_t op = 0;
+  const auto readLength = [&](size_t length) -> std::optional<size_t> {
+    if (length != 15) {
+      return length;
+    }
+    uint8_t b = 0;
+    do {
+      if (ip >= srcSize) {
+        return std::nullopt;
+      }
+      b = static_cast<uint8_t>(src[ip++]);
+      length += b;
+    } while (b == 255);
+    return length;
+  };
+
+  while (ip < srcSize) {
+    const auto token = static_cast<uint8_t>(src[ip++]);
+
+    const auto literalLength = readLength(token >> 4);
+    if (!literalLength || ip + *literalLength > srcSize ||
+        op + *literalLength > dstCapacity) {
+      return std::nullopt;
+    }
+    std::memcpy(dst + op, src + ip, *literalLength);
+    ip += *literalLength;
+    op += *literalLength;
+
+    // 最後のシーケンスは一致を持ちません。
+    if (ip == srcSize) {
+      break;
+    }
+
+    if (ip + 2 > srcSize) {
+      return std::nullopt;
+    }
+    const size_t offset = static_cast<size_t>(src[ip]) |
+                          (static_cast<size_t>(src[ip + 1]) << 8);
+    ip += 2;
+    const auto matchLength = readLength(token & 15);
+    if (!matchLength || offset == 0 || offset > op) {
+      return std::nullopt;
+    }
+    const size_t length = *matchLength + kMinMatch;
+    if (op + length > dstCapacity) {
+      return std::nullopt;
+    }
+    // 一致は自身と重なり得るため1バイトずつコピーします。
+    for (size_t i = 0; i < length; i++, op++) {
+      dst[op] = dst[op - offset];
+    }
+  }
+  return op;
+}
+} // namespace Lz4
@@ -0,0 +1,28 @@
+/**
+ * @brief LZ4ブロック形式の圧縮と展開
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace Lz4 {
+/** @brief 圧縮後の最大サイズを返します。 */
+[[nodiscard]] size_t GetMaxCompressedSize(size_t size);
+
+/**
+ * @brief ハッシュによる貪欲法でLZ4ブロック形式へ圧縮します。
+ */
+[[nodiscard]] std::vector<std::byte> Compress(const std::byte *src,
+                                              size_t size);
+
+/**
+ * @brief LZ4ブロックをdstへ展開します。
+ * @return 展開したバイト数。入力が壊れている場合はstd::nullopt
+ */
+[[nodiscard]] std::optional<size_t> Decompress(const std::byte *src,
+                                               size_t srcSize, std::byte *dst,
+                                               size_t dstCapacity);
+} // namespace Lz4
@@ -0,0 +1,689 @@
+/**
+ * @brief BC1/BC3/BC4/BC5/BC7ブロック圧縮
+ */
+
+#include "Image/BlockCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BC_USE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BC_USE_NEON 1
+#endif
+
+#include "Utils/ThreadPool.h"
+
+namespace {
+/** @brief チャンネルごとに16ピクセルを並べたブロック(0〜255) */
+struct Block {
+  alignas(16) float c[4][16];
+};
+
+using Color = std::array<float, 4>;
+
+Block LoadBlock(const uint8_t *rgba) {
+  Block block{};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 4; c++) {
+      block.c[c][i] = static_cast<float>(rgba[i * 4 + c]);
+    }
+  }
+  return block;
+}
+
+/**
+ * @brief 各ピクセルに最も近いパレットのインデックスを選びます。
+ * @return 重み付き二乗誤差の合計
+ */
+float SelectIndices(const Block &block, const Color *palette, int count,
+                    const Color &weights, uint8_t *indices) {
+  float error = 0.0f;
+#if defined(BC_USE_SSE2)
+  const __m128 w0 = _mm_set1_ps(weights[0]);
+  const __m128 w1 = _mm_set1_ps(weights[1]);
+  const __m128 w2 = _mm_set1_ps(weights[2]);
+  const __m128 w3 = _mm_set1_ps(weights[3]);
+  for (int p = 0; p < 16; p += 4) {
+    const __m128 r = _mm_load_ps(&block.c[0][p]);
+    const __m128 g = _mm_load_ps(&block.c[1][p]);
+    const __m128 b = _mm_load_ps(&block.c[2][p]);
+    const __m128 a = _mm_load_ps(&block.c[3][p]);
+    __m128 best = _mm_set1_ps(FLT_MAX);
+    __m128i bestIndex = _mm_setzero_si128();
+    for (int k = 0; k < count; k++) {
+      const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+      const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+      const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+      const __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[k][3]));
+      __m128 e = _mm_mul_ps(w0, _mm_mul_ps(dr, dr));
+      e = _mm_add_ps(e, _mm_mul_ps(w1, _mm_mul_ps(dg, dg)));
+      e = _mm_add_ps(e, _mm_mul_ps(w2, _mm_mul_ps(db, db)));
+      e = _mm_add_ps(e, _mm_mul_ps(w3, _mm_mul_ps(da, da)));
+      const __m128i mask = _mm_castps_si128(_mm_cmplt_ps(e, best));
+      best = _mm_min_ps(e, best);
+      bestIndex = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(k)),
+                               _mm_andnot_si128(mask, bestIndex));
+    }
+    alignas(16) float e[4];
+    alignas(16) int32_t idx[4];
+    _mm_store_ps(e, best);
+    _mm_store_si128(reinterpret_cast<__m128i *>(idx), bestIndex);
+    for (int i = 0; i < 4; i++) {
+      error += e[i];
+      indices[p + i] = static_cast<uint8_t>(idx[i]);
+    }
+  }
+#elif defined(BC_USE_NEON)
+  for (int p = 0; p < 16; p += 4) {
+    const float32x4_t r = vld1q_f32(&block.c[0][p]);
+    const float32x4_t g = vld1q_f32(&block.c[1][p]);
+    const float32x4_t b = vld1q_f32(&block.c[2][p]);
+    const float32x4_t a = vld1q_f32(&block.c[3][p]);
+    float32x4_t best = vdupq_n_f32(FLT_MAX);
+    uint32x4_t bestIndex = vdupq_n_u32(0);
+    for (int k = 0; k < count; k++) {
+      const float32x4_t dr = vsubq_f32(r, vdupq_n_f32(palette[k][0]));
+      const float32x4_t dg = vsubq_f32(g, vdupq_n_f32(palette[k][1]));
+      const float32x4_t db = vsubq_f32(b, vdupq_n_f32(palette[k][2]));
+      const float32x4_t da = vsubq_f32(a, vdupq_n_f32(palette[k][3]));
+      float32x4_t e = vmulq_n_f32(vmulq_f32(dr, dr), weights[0]);
+      e = vmlaq_n_f32(e, vmulq_f32(dg, dg), weights[1]);
+      e = vmlaq_n_f32(e, vmulq_f32(db, db), weights[2]);
+      e = vmlaq_n_f32(e, vmulq_f32(da, da), weights[3]);
+      const uint32x4_t mask = vcltq_f32(e, best);
+      best = vminq_f32(e, best);
+      bestIndex = vbslq_u32(mask, vdupq_n_u32(static_cast<uint32_t>(k)),
+                            bestIndex);
+    }
+    float e[4];
+    uint32_t idx[4];
+    vst1q_f32(e, best);
+    vst1q_u32(idx, bestIndex);
+    for (int i = 0; i < 4; i++) {
+      error += e[i];
+      indices[p + i] = static_cast<uint8_t>(idx[i]);
+    }
+  }
+#else
+  for (int p = 0; p < 16; p++) {
+    float best = FLT_MAX;
+    for (int k = 0; k < count; k++) {
+      float e = 0.0f;
+      for (int c = 0; c < 4; c++) {
+        const float d = block.c[c][p] - palette[k][c];
+        e += weights[c] * d * d;
+      }
+      if (e < best) {
+        best = e;
+        indices[p] = static_cast<uint8_t>(k);
+      }
+    }
+    error += best;
+  }
+#endif
+  return error;
+}
+
+/**
+ * @brief 重み付きの主成分軸上で最も離れた2点を端点とします。
+ */
+void ComputePrincipalEndpoints(const Block &block, const Color &weights,
+                               Color &e0, Color &e1) {
+  Color mean{};
+  for (int c = 0; c < 4; c++) {
+    for (int i = 0; i < 16; i++) {
+      mean[c] += block.c[c][i];
+    }
+    mean[c] /= 16.0f;
+  }
+
+  float cov[4][4]{};
+  for (int i = 0; i < 16; i++) {
+    Color d{};
+    for (int c = 0; c < 4; c++) {
+      d[c] = (block.c[c][i] - mean[c]) * weights[c];
+    }
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        cov[r][c] += d[r] * d[c];
+      }
+    }
+  }
+
+  // べき乗法で最大固有値の固有ベクトルを求めます。
+  Color axis = {1.0f, 1.0f, 1.0f, 1.0f};
+  for (int c = 0; c < 4; c++) {
+    axis[c] *= weights[c] > 0.0f ? 1.0f : 0.0f;
+  }
+  for (int iter = 0; iter < 8; iter++) {
+    Color next{};
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        next[r] += cov[r][c] * axis[c];
+      }
+    }
+    const float len = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+                                next[2] * next[2] + next[3] * next[3]);
+    if (len < 1e-6f) {
+      break;
+    }
+    for (int c = 0; c < 4; c++) {
+      axis[c] = next[c] / len;
+    }
+  }
+
+  float tMin = FLT_MAX;
+  float tMax = -FLT_MAX;
+  for (int i = 0; i < 16; i++) {
+    float t = 0.0f;
+    for (int c = 0; c < 4; c++) {
+      t += (block.c[c][i] - mean[c]) * axis[c];
+    }
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  for (int c = 0; c < 4; c++) {
+    e0[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+    e1[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+  }
+}
+
+/**
+ * @brief インデックスを固定して、e0からe1への補間で誤差が最小となる端点を最小二乗法で求めます。
+ * @param t 各インデックスに対応するe1の重み(0〜1)
+ */
+bool RefineEndpoints(const Block &block, const uint8_t *indices,
+                     const float *t, Color &e0, Color &e1) {
+  float aa = 0.0f;
+  float bb = 0.0f;
+  float ab = 0.0f;
+  Color ax{};
+  Color bx{};
+  for (int i = 0; i < 16; i++) {
+    const float beta = t[indices[i]];
+    const float alpha = 1.0f - beta;
+    aa += alpha * alpha;
+    bb += beta * beta;
+    ab += alpha * beta;
+    for (int c = 0; c < 4; c++) {
+      ax[c] += alpha * block.c[c][i];
+      bx[c] += beta * block.c[c][i];
+    }
+  }
+  const float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f) {
+    return false;
+  }
+  for (int c = 0; c < 4; c++) {
+    e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+    e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+//*-----------------------------------------------------------------------------
+// BC1 (Color)
+//*-----------------------------------------------------------------------------
+
+constexpr Color kColorWeights = {1.0f, 1.0f, 1.0f, 0.0f};
+/** @brief 4色モードのインデックスに対応するc1の重み */
+constexpr float kBC1Weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+uint16_t QuantizeRGB565(const Color &c) {
+  const auto r = static_cast<uint16_t>(std::lround(c[0] * 31.0f / 255.0f));
+  const auto g = static_cast<uint16_t>(std::lround(c[1] * 63.0f / 255.0f));
+  const auto b = static_cast<uint16_t>(std::lround(c[2] * 31.0f / 255.0f));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+Color DequantizeRGB565(uint16_t c) {
+  const uint32_t r = (c >> 11) & 31;
+  const uint32_t g = (c >> 5) & 63;
+  const uint32_t b = c & 31;
+  return {static_cast<float>((r << 3) | (r >> 2)),
+          static_cast<float>((g << 2) | (g >> 4)),
+          static_cast<float>((b << 3) | (b >> 2)), 0.0f};
+}
+
+struct ColorBlock {
+  uint16_t c0 = 0;
+  uint16_t c1 = 0;
+  uint8_t indices[16]{};
+  float error = FLT_MAX;
+};
+
+/** @brief 量子化済みの端点で4色モードのパレットを作りインデックスを選びます。 */
+ColorBlock EvaluateColorBlock(const Block &block, uint16_t c0, uint16_t c1) {
+  // 4色モードはc0 > c1である必要があります。
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+  ColorBlock result{};
+  result.c0 = c0;
+  result.c1 = c1;
+
+  const Color p0 = DequantizeRGB565(c0);
+  const Color p1 = DequantizeRGB565(c1);
+  if (c0 == c1) {
+    // 3色モードになるため、全ピクセルでc0を使用します。
+    const Color palette[1] = {p0};
+    result.error =
+        SelectIndices(block, palette, 1, kColorWeights, result.indices);
+    return result;
+  }
+  Color palette[4];
+  for (int k = 0; k < 4; k++) {
+    for (int c = 0; c < 4; c++) {
+      palette[k][c] = p0[c] + (p1[c] - p0[c]) * kBC1Weights[k];
+    }
+  }
+  result.error =
+      SelectIndices(block, palette, 4, kColorWeights, result.indices);
+  return result;
+}
+
+ColorBlock EncodeColor(const Block &block, BCQuality quality) {
+  Color e0{};
+  Color e1{};
+  ComputePrincipalEndpoints(block, kColorWeights, e0, e1);
+  ColorBlock best =
+      EvaluateColorBlock(block, QuantizeRGB565(e0), QuantizeRGB565(e1));
+  if (quality == BCQuality::Fast) {
+    return best;
+  }
+
+  // 選ばれたインデックスに対して端点を最小二乗法で再推定します。
+  for (int iter = 0; iter < 4 && best.c0 != best.c1; iter++) {
+    if (!RefineEndpoints(block, best.indices, kBC1Weights, e0, e1)) {
+      break;
+    }
+    const ColorBlock refined =
+        EvaluateColorBlock(block, QuantizeRGB565(e0), QuantizeRGB565(e1));
+    if (refined.error >= best.error) {
+      break;
+    }
+    best = refined;
+  }
+
+  // 量子化後の各成分を±1して改善が無くなるまで探索します。
+  constexpr uint16_t kShifts[3] = {11, 5, 0};
+  constexpr uint16_t kMasks[3] = {31, 63, 31};
+  bool improved = true;
+  for (int iter = 0; iter < 8 && improved; iter++) {
+    improved = false;
+    for (int endpoint = 0; endpoint < 2; endpoint++) {
+      for (int c = 0; c < 3; c++) {
+        for (int delta : {-1, 1}) {
+          uint16_t ends[2] = {best.c0, best.c1};
+          const int v = ((ends[endpoint] >> kShifts[c]) & kMasks[c]) + delta;
+          if (v < 0 || v > kMasks[c]) {
+            continue;
+          }
+          ends[endpoint] = static_cast<uint16_t>(
+              (ends[endpoint] & ~(kMasks[c] << kShifts[c])) |
+              (v << kShifts[c]));
+          const ColorBlock candidate =
+              EvaluateColorBlock(block, ends[0], ends[1]);
+          if (candidate.error < best.error) {
+            best = candidate;
+            improved = true;
+          }
+        }
+      }
+    }
+  }
+  return best;
+}
+
+void WriteColorBlock(const ColorBlock &color, uint8_t *dst) {
+  uint32_t bits = 0;
+  for (int i = 0; i < 16; i++) {
+    bits |= static_cast<uint32_t>(color.indices[i]) << (i * 2);
+  }
+  std::memcpy(dst, &color.c0, 2);
+  std::memcpy(dst + 2, &color.c1, 2);
+  std::memcpy(dst + 4, &bits, 4);
+}
+
+//*-----------------------------------------------------------------------------
+// BC4 (Scalar)
+//*-----------------------------------------------------------------------------
+
+struct ScalarBlock {
+  uint8_t a0 = 0;
+  uint8_t a1 = 0;
+  uint8_t indices[16]{};
+  float error = FLT_MAX;
+};
+
+/** @brief a0 > a1なら8値モード、そうでなければ0と255を含む6値モードで評価します。 */
+ScalarBlock EvaluateScalarBlock(const Block &block, int channel, uint8_t a0,
+                                uint8_t a1) {
+  ScalarBlock result{};
+  result.a0 = a0;
+  result.a1 = a1;
+
+  Color palette[8]{};
+  const auto f0 = static_cast<float>(a0);
+  const auto f1 = static_cast<float>(a1);
+  palette[0][channel] = f0;
+  palette[1][channel] = f1;
+  if (a0 > a1) {
+    for (int k = 2; k < 8; k++) {
+      palette[k][channel] =
+          (static_cast<float>(8 - k) * f0 + static_cast<float>(k - 1) * f1) /
+          7.0f;
+    }
+  } else {
+    for (int k = 2; k < 6; k++) {
+      palette[k][channel] =
+          (static_cast<float>(6 - k) * f0 + static_cast<float>(k - 1) * f1) /
+          5.0f;
+    }
+    palette[6][channel] = 0.0f;
+    palette[7][channel] = 255.0f;
+  }
+
+  Color weights{};
+  weights[channel] = 1.0f;
+  result.error = SelectIndices(block, palette, 8, weights, result.indices);
+  return result;
+}
+
+ScalarBlock EncodeScalar(const Block &block, int channel, BCQuality quality) {
+  float lo = 255.0f;
+  float hi = 0.0f;
+  // 6値モード用に0と255を除いた範囲も求めます。
+  float innerLo = 255.0f;
+  float innerHi = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    const float v = block.c[channel][i];
+    lo = std::min(lo, v);
+    hi = std::max(hi, v);
+    if (v > 0.0f && v < 255.0f) {
+      innerLo = std::min(innerLo, v);
+      innerHi = std::max(innerHi, v);
+    }
+  }
+  const auto a0 = static_cast<uint8_t>(hi);
+  const auto a1 = static_cast<uint8_t>(lo);
+  ScalarBlock best = EvaluateScalarBlock(block, channel, a0, a1);
+  if (quality == BCQuality::Fast || best.error == 0.0f) {
+    return best;
+  }
+
+  if (innerLo <= innerHi) {
+    const ScalarBlock six =
+        EvaluateScalarBlock(block, channel, static_cast<uint8_t>(innerLo),
+                            static_cast<uint8_t>(innerHi));
+    if (six.error < best.error) {
+      best = six;
+    }
+  }
+
+  // 端点を内側へ寄せた近傍を探索します(8値モードは量子化誤差が端に偏るため)。
+  for (int d0 = -2; d0 <= 2; d0++) {
+    for (int d1 = -2; d1 <= 2; d1++) {
+      const int v0 = static_cast<int>(a0) + d0;
+      const int v1 = static_cast<int>(a1) + d1;
+      if (v0 < 0 || v0 > 255 || v1 < 0 || v1 > 255 || v0 <= v1) {
+        continue;
+      }
+      const ScalarBlock candidate =
+          EvaluateScalarBlock(block, channel, static_cast<uint8_t>(v0),
+                              static_cast<uint8_t>(v1));
+      if (candidate.error < best.error) {
+        best = candidate;
+      }
+    }
+  }
+  return best;
+}
+
+void WriteScalarBlock(const ScalarBlock &scalar, uint8_t *dst) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; i++) {
+    bits |= static_cast<uint64_t>(scalar.indices[i]) << (i * 3);
+  }
+  dst[0] = scalar.a0;
+  dst[1] = scalar.a1;
+  for (int i = 0; i < 6; i++) {
+    dst[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// BC7 (Mode 6)
+//*-----------------------------------------------------------------------------
+
+constexpr Color kBC7Weights = {1.0f, 1.0f, 1.0f, 1.0f};
+constexpr uint32_t kBC7IndexWeights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                           34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BC7Endpoint {
+  /** @brief 7bitに量子化された各成分 */
+  uint8_t q[4]{};
+  uint8_t pbit = 0;
+
+  [[nodiscard]] uint32_t Value(int c) const {
+    return (static_cast<uint32_t>(q[c]) << 1) | pbit;
+  }
+};
+
+BC7Endpoint QuantizeBC7(const Color &e, uint8_t pbit) {
+  BC7Endpoint endpoint{};
+  endpoint.pbit = pbit;
+  for (int c = 0; c < 4; c++) {
+    endpoint.q[c] = static_cast<uint8_t>(
+        std::clamp(std::lround((e[c] - pbit) * 0.5f), 0l, 127l));
+  }
+  return endpoint;
+}
+
+/** @brief 量子化誤差が小さくなる方のpビットを選びます。 */
+BC7Endpoint QuantizeBC7(const Color &e) {
+  BC7Endpoint best{};
+  float bestError = FLT_MAX;
+  for (uint8_t pbit = 0; pbit < 2; pbit++) {
+    const BC7Endpoint endpoint = QuantizeBC7(e, pbit);
+    float error = 0.0f;
+    for (int c = 0; c < 4; c++) {
+      const float d = static_cast<float>(endpoint.Value(c)) - e[c];
+      error += d * d;
+    }
+    if (error < bestError) {
+      bestError = error;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+struct BC7Block {
+  BC7Endpoint e0{};
+  BC7Endpoint e1{};
+  uint8_t indices[16]{};
+  float error = FLT_MAX;
+};
+
+BC7Block EvaluateBC7Block(const Block &block, const BC7Endpoint &e0,
+                          const BC7Endpoint &e1) {
+  BC7Block result{};
+  result.e0 = e0;
+  result.e1 = e1;
+  Color palette[16];
+  for (int k = 0; k < 16; k++) {
+    for (int c = 0; c < 4; c++) {
+      palette[k][c] = static_cast<float>(
+          ((64 - kBC7IndexWeights[k]) * e0.Value(c) +
+           kBC7IndexWeights[k] * e1.Value(c) + 32) >>
+          6);
+    }
+  }
+  result.error =
+      SelectIndices(block, palette, 16, kBC7Weights, result.indices);
+  return result;
+}
+
+BC7Block EncodeBC7(const Block &block, BCQuality quality) {
+  Color e0{};
+  Color e1{};
+  ComputePrincipalEndpoints(block, kBC7Weights, e0, e1);
+  if (quality == BCQuality::Fast) {
+    return EvaluateBC7Block(block, QuantizeBC7(e0), QuantizeBC7(e1));
+  }
+
+  // pビットの全組み合わせを評価します。
+  const auto evaluateAll = [&block](const Color &f0, const Color &f1) {
+    BC7Block best{};
+    for (uint8_t p0 = 0; p0 < 2; p0++) {
+      for (uint8_t p1 = 0; p1 < 2; p1++) {
+        const BC7Block candidate = EvaluateBC7Block(
+            block, QuantizeBC7(f0, p0), QuantizeBC7(f1, p1));
+        if (candidate.error < best.error) {
+          best = candidate;
+        }
+      }
+    }
+    return best;
+  };
+
+  BC7Block best = evaluateAll(e0, e1);
+  float t[16];
+  for (int k = 0; k < 16; k++) {
+    t[k] = static_cast<float>(kBC7IndexWeights[k]) / 64.0f;
+  }
+  for (int iter = 0; iter < 4 && best.error > 0.0f; iter++) {
+    if (!RefineEndpoints(block, best.indices, t, e0, e1)) {
+      break;
+    }
+    const BC7Block refined = evaluateAll(e0, e1);
+    if (refined.error >= best.error) {
+      break;
+    }
+    best = refined;
+  }
+  return best;
+}
+
+/** @brief 下位ビットから順に詰めていくビットライター */
+struct BitWriter {
+  void Write(uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+      if ((value >> i) & 1u) {
+        dst[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+      }
+      position++;
+    }
+  }
+  uint8_t *dst = nullptr;
+  uint32_t position = 0;
+};
+
+void WriteBC7Block(BC7Block bc7, uint8_t *dst) {
+  // 先頭インデックスの最上位ビットは0でなければならないため、必要なら端点を入れ替えます。
+  if (bc7.indices[0] & 8) {
+    std::swap(bc7.e0, bc7.e1);
+    for (auto &index : bc7.indices) {
+      index = static_cast<uint8_t>(15 - index);
+    }
+  }
+
+  std::memset(dst, 0, 16);
+  BitWriter writer{dst, 0};
+  writer.Write(1u << 6, 7);
+  for (int c = 0; c < 4; c++) {
+    writer.Write(bc7.e0.q[c], 7);
+    writer.Write(bc7.e1.q[c], 7);
+  }
+  writer.Write(bc7.e0.pbit, 1);
+  writer.Write(bc7.e1.pbit, 1);
+  writer.Write(bc7.indices[0], 3);
+  for (int i = 1; i < 16; i++) {
+    writer.Write(bc7.indices[i], 4);
+  }
+}
+} // namespace
+
+size_t GetBCBlockSize(BCFormat format) {
+  switch (format) {
+  case BCFormat::BC1:
+  case BCFormat::BC4:
+    return 8;
+  case BCFormat::BC3:
+  case BCFormat::BC5:
+  case BCFormat::BC7:
+    return 16;
+  }
+  return 16;
+}
+
+void EncodeBCBlock(BCFormat format, BCQuality quality, const uint8_t *rgba,
+                   uint8_t *dst) {
+  const Block block = LoadBlock(rgba);
+  switch (format) {
+  case BCFormat::BC1:
+    WriteColorBlock(EncodeColor(block, quality), dst);
+    break;
+  case BCFormat::BC3:
+    WriteScalarBlock(EncodeScalar(block, 3, quality), dst);
+    WriteColorBlock(EncodeColor(block, quality), dst + 8);
+    break;
+  case BCFormat::BC4:
+    WriteScalarBlock(EncodeScalar(block, 0, quality), dst);
+    break;
+  case BCFormat::BC5:
+    WriteScalarBlock(EncodeScalar(block, 0, quality), dst);
+    WriteScalarBlock(EncodeScalar(block, 1, quality), dst + 8);
+    break;
+  case BCFormat::BC7:
+    WriteBC7Block(EncodeBC7(block, quality), dst);
+    break;
+  }
+}
+
+std::vector<std::byte> CompressImage(BCFormat format, BCQuality quality,
+                                     const Image &image,
+                                     ThreadPool *threadPool) {
+  const uint32_t blocksX = (image.width + 3) / 4;
+  const uint32_t blocksY = (image.height + 3) / 4;
+  const size_t blockSize = GetBCBlockSize(format);
+  std::vector<std::byte> dst(static_cast<size_t>(blocksX) * blocksY *
+                             blockSize);
+
+  const auto compressRows = [&](size_t begin, size_t end) {
+    uint8_t rgba[64];
+    for (size_t by = begin; by < end; by++) {
+      for (uint32_t bx = 0; bx < blocksX; bx++) {
+        for (uint32_t y = 0; y < 4; y++) {
+          for (uint32_t x = 0; x < 4; x++) {
+            const uint32_t sx = std::min(bx * 4 + x, image.width - 1);
+            const uint32_t sy =
+                std::min(static_cast<uint32_t>(by) * 4 + y, image.height - 1);
+            std::memcpy(
+                &rgba[(y * 4 + x) * 4],
+                &image.pixels[(static_cast<size_t>(sy) * image.width + sx) * 4],
+                4);
+          }
+        }
+        EncodeBCBlock(format, quality, rgba,
+                      reinterpret_cast<uint8_t *>(
+                          &dst[(by * blocksX + bx) * blockSize]));
+      }
+    }
+  };
+
+  if (threadPool != nullptr) {
+    threadPool->ParallelFor(blocksY, 4, compressRows);
+  } else {
+    compressRows(0, blocksY);
+  }
+  return dst;
+}
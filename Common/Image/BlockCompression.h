@@ -0,0 +1,53 @@
+/**
+ * @brief BC1/BC3/BC4/BC5/BC7ブロック圧縮
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Image/MipChain.h"
+
+class ThreadPool;
+
+enum struct BCFormat : uint32_t {
+  /** @brief RGB 4bpp (アルファなし) */
+  BC1,
+  /** @brief RGBA 8bpp (アルファはBC4と同じ形式) */
+  BC3,
+  /** @brief R 4bpp */
+  BC4,
+  /** @brief RG 8bpp (法線マップ向け) */
+  BC5,
+  /** @brief RGBA 8bpp (単一サブセットのモード6のみを使用) */
+  BC7,
+};
+
+enum struct BCQuality : uint32_t {
+  /** @brief 主成分軸の端点を量子化するのみ */
+  Fast,
+  /** @brief 最小二乗法による端点の再推定と量子化後の近傍探索を行います。 */
+  High,
+};
+
+/** @brief 4x4ブロック1つあたりのバイト数を返します。 */
+[[nodiscard]] size_t GetBCBlockSize(BCFormat format);
+
+/**
+ * @brief 4x4ピクセルのブロックを1つ圧縮します。
+ * @param rgba 行優先で並んだ16ピクセル分のRGBA8
+ * @param dst GetBCBlockSizeバイトの出力先
+ */
+void EncodeBCBlock(BCFormat format, BCQuality quality, const uint8_t *rgba,
+                   uint8_t *dst);
+
+/**
+ * @brief 画像全体を圧縮します。4の倍数でない端は端のピクセルを複製して埋めます。
+ * @param threadPool nullptrでなければブロック行単位で並列に圧縮します。
+ */
+[[nodiscard]] std::vector<std::byte> CompressImage(BCFormat format,
+                                                   BCQuality quality,
+                                                   const Image &image,
+                                                   ThreadPool *threadPool);
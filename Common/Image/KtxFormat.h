@@ -0,0 +1,50 @@
+/**
+ * @brief KTX(1.0)ファイルの識別子とヘッダ、使用するGLフォーマット定数
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Ktx {
+inline constexpr std::array<uint8_t, 12> kIdentifier = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A,
+};
+inline constexpr uint32_t kEndianness = 0x04030201;
+
+struct Header {
+  uint32_t endianness;
+  uint32_t glType;
+  uint32_t glTypeSize;
+  uint32_t glFormat;
+  uint32_t glInternalFormat;
+  uint32_t glBaseInternalFormat;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t numberOfArrayElements;
+  uint32_t numberOfFaces;
+  uint32_t numberOfMipmapLevels;
+  uint32_t bytesOfKeyValueData;
+};
+static_assert(sizeof(Header) == 13 * sizeof(uint32_t));
+
+/** @brief glBaseInternalFormat (GL_RED, GL_RG, GL_RGB, GL_RGBA) */
+inline constexpr uint32_t kRed = 0x1903;
+inline constexpr uint32_t kRG = 0x8227;
+inline constexpr uint32_t kRGB = 0x1907;
+inline constexpr uint32_t kRGBA = 0x1908;
+
+/** @brief 圧縮フォーマットのglInternalFormat (S3TC, RGTC, BPTC) */
+inline constexpr uint32_t kCompressedRGB_BC1 = 0x83F0;
+inline constexpr uint32_t kCompressedRGBA_BC1 = 0x83F1;
+inline constexpr uint32_t kCompressedRGBA_BC3 = 0x83F3;
+inline constexpr uint32_t kCompressedSRGB_BC1 = 0x8C4C;
+inline constexpr uint32_t kCompressedSRGBA_BC1 = 0x8C4D;
+inline constexpr uint32_t kCompressedSRGBA_BC3 = 0x8C4F;
+inline constexpr uint32_t kCompressedR_BC4 = 0x8DBB;
+inline constexpr uint32_t kCompressedRG_BC5 = 0x8DBD;
+inline constexpr uint32_t kCompressedRGBA_BC7 = 0x8E8C;
+inline constexpr uint32_t kCompressedSRGBA_BC7 = 0x8E8D;
+} // namespace Ktx
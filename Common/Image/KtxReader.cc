@@ -0,0 +1,144 @@
+/**
+ * @brief KTX(1.0)ファイルのヘッダとミップレベルの読み込み
+ */
+
+#include "Image/KtxReader.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Image/KtxFormat.h"
+
+using Ktx::Header;
+using Ktx::kEndianness;
+using Ktx::kIdentifier;
+
+bool KtxReader::Open(const std::string &filepath) {
+  path_ = filepath;
+  levels_.clear();
+
+  std::ifstream ifs(filepath, std::ios::binary);
+  if (!ifs) {
+    std::cerr << "Failed to open " << filepath << std::endl;
+    return false;
+  }
+
+  std::array<uint8_t, 12> identifier{};
+  Header header{};
+  ifs.read(reinterpret_cast<char *>(identifier.data()), identifier.size());
+  ifs.read(reinterpret_cast<char *>(&header), sizeof(Header));
+  if (!ifs || identifier != kIdentifier) {
+    std::cerr << filepath << " is not a KTX file." << std::endl;
+    return false;
+  }
+  // 異なるエンディアンで書き出されたファイルには対応しません。
+  if (header.endianness != kEndianness) {
+    std::cerr << filepath << ": unsupported endianness." << std::endl;
+    return false;
+  }
+  if (header.numberOfFaces > 1 || header.numberOfArrayElements > 1 ||
+      header.pixelDepth > 1) {
+    std::cerr << filepath << ": only 2D textures are supported." << std::endl;
+    return false;
+  }
+
+  width_ = header.pixelWidth;
+  height_ = std::max(header.pixelHeight, 1u);
+  glInternalFormat_ = header.glInternalFormat;
+  glType_ = header.glType;
+
+  uint64_t offset =
+      identifier.size() + sizeof(Header) + header.bytesOfKeyValueData;
+  const uint32_t levelCount = std::max(header.numberOfMipmapLevels, 1u);
+  for (uint32_t i = 0; i < levelCount; i++) {
+    uint32_t imageSize = 0;
+    ifs.seekg(static_cast<std::streamoff>(offset));
+    ifs.read(reinterpret_cast<char *>(&imageSize), sizeof(uint32_t));
+    if (!ifs) {
+      std::cerr << filepath << ": truncated at level " << i << std::endl;
+      return false;
+    }
+
+    Level level{};
+    level.offset = offset + sizeof(uint32_t);
+    level.size = imageSize;
+    level.width = std::max(width_ >> i, 1u);
+    level.height = std::max(height_ >> i, 1u);
+    levels_.emplace_back(level);
+
+    // mipPaddingで4バイト境界に揃えられています。
+    offset = level.offset + ((imageSize + 3u) & ~3u);
+  }
+  return true;
+}
+
+bool KtxReader::Parse(const std::byte *data, size_t size) {
+  path_.clear();
+  levels_.clear();
+
+  std::array<uint8_t, 12> identifier{};
+  Header header{};
+  if (size < identifier.size() + sizeof(Header)) {
+    std::cerr << "Not a KTX file." << std::endl;
+    return false;
+  }
+  std::memcpy(identifier.data(), data, identifier.size());
+  std::memcpy(&header, data + identifier.size(), sizeof(Header));
+  if (identifier != kIdentifier || header.endianness != kEndianness) {
+    std::cerr << "Not a KTX file or unsupported endianness." << std::endl;
+    return false;
+  }
+  if (header.numberOfFaces > 1 || header.numberOfArrayElements > 1 ||
+      header.pixelDepth > 1) {
+    std::cerr << "Only 2D KTX textures are supported." << std::endl;
+    return false;
+  }
+
+  width_ = header.pixelWidth;
+  height_ = std::max(header.pixelHeight, 1u);
+  glInternalFormat_ = header.glInternalFormat;
+  glType_ = header.glType;
+
+  uint64_t offset =
+      identifier.size() + sizeof(Header) + header.bytesOfKeyValueData;
+  const uint32_t levelCount = std::max(header.numberOfMipmapLevels, 1u);
+  for (uint32_t i = 0; i < levelCount; i++) {
+    uint32_t imageSize = 0;
+    if (offset + sizeof(uint32_t) > size) {
+      std::cerr << "KTX truncated at level " << i << std::endl;
+      return false;
+    }
+    std::memcpy(&imageSize, data + offset, sizeof(uint32_t));
+
+    Level level{};
+    level.offset = offset + sizeof(uint32_t);
+    level.size = imageSize;
+    level.width = std::max(width_ >> i, 1u);
+    level.height = std::max(height_ >> i, 1u);
+    if (level.offset + level.size > size) {
+      std::cerr << "KTX truncated at level " << i << std::endl;
+      return false;
+    }
+    levels_.emplace_back(level);
+
+    offset = level.offset + ((imageSize + 3u) & ~3u);
+  }
+  return true;
+}
+
+std::vector<std::byte> KtxReader::ReadLevel(uint32_t level) const {
+  const Level &l = levels_.at(level);
+  std::vector<std::byte> data(l.size);
+
+  std::ifstream ifs(path_, std::ios::binary);
+  ifs.seekg(static_cast<std::streamoff>(l.offset));
+  ifs.read(reinterpret_cast<char *>(data.data()), l.size);
+  if (!ifs) {
+    std::cerr << path_ << ": failed to read level " << level << std::endl;
+    data.clear();
+  }
+  return data;
+}
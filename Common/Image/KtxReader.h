@@ -0,0 +1,58 @@
+/**
+ * @brief KTX(1.0)ファイルのヘッダとミップレベルの読み込み
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief
+ * ファイル全体を読み込まずに、ミップレベル単位でデータを取り出します。
+ * @note ReadLevelは呼び出しごとにファイルを開くため、複数スレッドから同時に呼び出せます。
+ */
+class KtxReader {
+public:
+  struct Level {
+    /** @brief ファイル先頭からのオフセット(imageSizeの直後) */
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+  };
+
+  bool Open(const std::string &filepath);
+  /**
+   * @brief メモリ上のKTXを解析します。Levelのoffsetはdataの先頭からの位置になります。
+   * @note ReadLevelは使えません。
+   */
+  bool Parse(const std::byte *data, size_t size);
+
+  [[nodiscard]] std::vector<std::byte> ReadLevel(uint32_t level) const;
+
+  [[nodiscard]] const std::string &GetPath() const { return path_; }
+  [[nodiscard]] uint32_t GetWidth() const { return width_; }
+  [[nodiscard]] uint32_t GetHeight() const { return height_; }
+  [[nodiscard]] uint32_t GetLevelCount() const {
+    return static_cast<uint32_t>(levels_.size());
+  }
+  [[nodiscard]] const Level &GetLevel(uint32_t level) const {
+    return levels_.at(level);
+  }
+  [[nodiscard]] uint32_t GetGLInternalFormat() const {
+    return glInternalFormat_;
+  }
+  /** @brief 圧縮フォーマットではglTypeが0になります。 */
+  [[nodiscard]] bool IsCompressed() const { return glType_ == 0; }
+
+private:
+  std::string path_{};
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t glInternalFormat_ = 0;
+  uint32_t glType_ = 0;
+  std::vector<Level> levels_{};
+};
@@ -0,0 +1,64 @@
+/**
+ * @brief KTX(1.0)ファイルの書き出し
+ */
+
+#include "Image/KtxWriter.h"
+
+#include <fstream>
+#include <iostream>
+
+#include "Image/KtxFormat.h"
+
+KtxWriter::KtxWriter(uint32_t glInternalFormat, uint32_t glBaseInternalFormat,
+                     uint32_t width, uint32_t height)
+    : glInternalFormat_(glInternalFormat),
+      glBaseInternalFormat_(glBaseInternalFormat), width_(width),
+      height_(height) {}
+
+void KtxWriter::AddLevel(std::vector<std::byte> data) {
+  levels_.emplace_back(std::move(data));
+}
+
+bool KtxWriter::Write(const std::string &filepath) const {
+  std::ofstream ofs(filepath, std::ios::binary);
+  if (!ofs) {
+    std::cerr << "Failed to open " << filepath << std::endl;
+    return false;
+  }
+
+  // 圧縮フォーマットではglType, glFormatは0、glTypeSizeは1とします。
+  Ktx::Header header{};
+  header.endianness = Ktx::kEndianness;
+  header.glType = 0;
+  header.glTypeSize = 1;
+  header.glFormat = 0;
+  header.glInternalFormat = glInternalFormat_;
+  header.glBaseInternalFormat = glBaseInternalFormat_;
+  header.pixelWidth = width_;
+  header.pixelHeight = height_;
+  header.pixelDepth = 0;
+  header.numberOfArrayElements = 0;
+  header.numberOfFaces = 1;
+  header.numberOfMipmapLevels = static_cast<uint32_t>(levels_.size());
+  header.bytesOfKeyValueData = 0;
+
+  ofs.write(reinterpret_cast<const char *>(Ktx::kIdentifier.data()),
+            Ktx::kIdentifier.size());
+  ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  constexpr char padding[4] = {};
+  for (const auto &level : levels_) {
+    const auto imageSize = static_cast<uint32_t>(level.size());
+    ofs.write(reinterpret_cast<const char *>(&imageSize), sizeof(imageSize));
+    ofs.write(reinterpret_cast<const char *>(level.data()),
+              static_cast<std::streamsize>(level.size()));
+    // mipPaddingで4バイト境界に揃えます。
+    ofs.write(padding, (4 - imageSize % 4) % 4);
+  }
+
+  if (!ofs) {
+    std::cerr << "Failed to write " << filepath << std::endl;
+    return false;
+  }
+  return true;
+}
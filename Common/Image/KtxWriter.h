@@ -0,0 +1,31 @@
+/**
+ * @brief KTX(1.0)ファイルの書き出し
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 圧縮済みの2Dテクスチャをミップレベルごとに追加してKTXファイルへ書き出します。
+ */
+class KtxWriter {
+public:
+  KtxWriter(uint32_t glInternalFormat, uint32_t glBaseInternalFormat,
+            uint32_t width, uint32_t height);
+
+  /** @brief 次のミップレベルのデータを追加します(最も細かいレベルから順に)。 */
+  void AddLevel(std::vector<std::byte> data);
+
+  bool Write(const std::string &filepath) const;
+
+private:
+  uint32_t glInternalFormat_ = 0;
+  uint32_t glBaseInternalFormat_ = 0;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<std::vector<std::byte>> levels_{};
+};
@@ -0,0 +1,102 @@
+/**
+ * @brief 線形空間でのミップマップ生成
+ */
+
+#include "Image/MipChain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+float SRGBToLinear(float c) {
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSRGB(float c) {
+  return c <= 0.0031308f ? c * 12.92f
+                         : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+uint8_t ToUNorm8(float c) {
+  return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+/** @brief 8bit値から線形値への変換表 */
+struct Decoder {
+  explicit Decoder(bool srgb) {
+    for (int i = 0; i < 256; i++) {
+      const float c = static_cast<float>(i) / 255.0f;
+      color[i] = srgb ? SRGBToLinear(c) : c;
+    }
+  }
+  std::array<float, 256> color{};
+};
+
+Image Downsample(const Image &src, const Decoder &decoder,
+                 const MipChainCreateInfo &createInfo) {
+  Image dst{};
+  dst.width = std::max(src.width / 2, 1u);
+  dst.height = std::max(src.height / 2, 1u);
+  dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+  for (uint32_t y = 0; y < dst.height; y++) {
+    for (uint32_t x = 0; x < dst.width; x++) {
+      // 奇数サイズの端は同じピクセルを重ねて読みます。
+      std::array<float, 4> sum{};
+      for (uint32_t dy = 0; dy < 2; dy++) {
+        for (uint32_t dx = 0; dx < 2; dx++) {
+          const uint32_t sx = std::min(x * 2 + dx, src.width - 1);
+          const uint32_t sy = std::min(y * 2 + dy, src.height - 1);
+          const uint8_t *p =
+              &src.pixels[(static_cast<size_t>(sy) * src.width + sx) * 4];
+          if (createInfo.normalMap) {
+            for (int c = 0; c < 3; c++) {
+              sum[c] += static_cast<float>(p[c]) / 255.0f * 2.0f - 1.0f;
+            }
+          } else {
+            for (int c = 0; c < 3; c++) {
+              sum[c] += decoder.color[p[c]];
+            }
+          }
+          sum[3] += static_cast<float>(p[3]) / 255.0f;
+        }
+      }
+
+      uint8_t *q = &dst.pixels[(static_cast<size_t>(y) * dst.width + x) * 4];
+      if (createInfo.normalMap) {
+        // 平均した法線は短くなるため正規化し直します。
+        const float len = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] +
+                                    sum[2] * sum[2]);
+        for (int c = 0; c < 3; c++) {
+          const float n = len > 0.0f ? sum[c] / len : (c == 2 ? 1.0f : 0.0f);
+          q[c] = ToUNorm8(n * 0.5f + 0.5f);
+        }
+      } else {
+        for (int c = 0; c < 3; c++) {
+          const float v = sum[c] * 0.25f;
+          q[c] = ToUNorm8(createInfo.srgb ? LinearToSRGB(v) : v);
+        }
+      }
+      q[3] = ToUNorm8(sum[3] * 0.25f);
+    }
+  }
+  return dst;
+}
+} // namespace
+
+std::vector<Image> GenerateMipChain(const Image &base,
+                                    const MipChainCreateInfo &createInfo) {
+  const Decoder decoder(createInfo.srgb && !createInfo.normalMap);
+
+  std::vector<Image> levels{base};
+  while (true) {
+    const Image &src = levels.back();
+    if ((src.width == 1 && src.height == 1) ||
+        std::max(src.width, src.height) <= createInfo.minSize) {
+      break;
+    }
+    levels.emplace_back(Downsample(src, decoder, createInfo));
+  }
+  return levels;
+}
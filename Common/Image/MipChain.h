@@ -0,0 +1,31 @@
+/**
+ * @brief 線形空間でのミップマップ生成
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/** @brief RGBA8のピクセルデータ */
+struct Image {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels{};
+};
+
+struct MipChainCreateInfo {
+  /** @brief RGBをsRGBとして扱い、線形空間に戻してから平均します。 */
+  bool srgb = true;
+  /** @brief RGBを接空間法線として扱い、縮小後に正規化し直します。 */
+  bool normalMap = false;
+  /** @brief 最大辺がこの長さ以下になったら生成を打ち切ります(ピクセル)。 */
+  uint32_t minSize = 1;
+};
+
+/**
+ * @brief 2x2のボックスフィルタで縮小を繰り返し、ミップチェーンを生成します。
+ * @return 先頭に元の画像を含むミップレベルの配列
+ */
+std::vector<Image> GenerateMipChain(const Image &base,
+                                    const MipChainCreateInfo &createInfo);
@@ -0,0 +1,217 @@
+/**
+ * @brief SoAで変換を保持する階層シーングラフ
+ */
+
+#include "Scene/SceneGraph.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCENE_USE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCENE_USE_NEON 1
+#endif
+
+#include "Utils/ThreadPool.h"
+
+namespace {
+/** @brief 並列に計算する場合の1ジョブあたりのノード数 */
+constexpr size_t kChunkSize = 512;
+
+/** @brief 拡大縮小、回転、平行移動の順に適用するローカル行列を求めます。 */
+glm::mat4 ComposeTRS(const glm::vec3 &t, const glm::quat &r,
+                     const glm::vec3 &s) {
+  const glm::mat3 rotation = glm::mat3_cast(r);
+  return {glm::vec4(rotation[0] * s.x, 0.0f), glm::vec4(rotation[1] * s.y, 0.0f),
+          glm::vec4(rotation[2] * s.z, 0.0f), glm::vec4(t, 1.0f)};
+}
+
+/**
+ * @brief out = a * bを計算します。
+ * @note glmの行列は列優先で連続しているため、aの列をbの要素で重み付けして足し合わせます。
+ */
+void Multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#if defined(SCENE_USE_SSE2)
+  const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+  const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+  const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+  const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+  for (int j = 0; j < 4; j++) {
+    const __m128 bj = _mm_loadu_ps(&b[j][0]);
+    __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(bj, bj, _MM_SHUFFLE(0, 0, 0, 0)));
+    r = _mm_add_ps(r,
+                   _mm_mul_ps(a1, _mm_shuffle_ps(bj, bj, _MM_SHUFFLE(1, 1, 1, 1))));
+    r = _mm_add_ps(r,
+                   _mm_mul_ps(a2, _mm_shuffle_ps(bj, bj, _MM_SHUFFLE(2, 2, 2, 2))));
+    r = _mm_add_ps(r,
+                   _mm_mul_ps(a3, _mm_shuffle_ps(bj, bj, _MM_SHUFFLE(3, 3, 3, 3))));
+    _mm_storeu_ps(&out[j][0], r);
+  }
+#elif defined(SCENE_USE_NEON)
+  const float32x4_t a0 = vld1q_f32(&a[0][0]);
+  const float32x4_t a1 = vld1q_f32(&a[1][0]);
+  const float32x4_t a2 = vld1q_f32(&a[2][0]);
+  const float32x4_t a3 = vld1q_f32(&a[3][0]);
+  for (int j = 0; j < 4; j++) {
+    float32x4_t r = vmulq_n_f32(a0, b[j][0]);
+    r = vmlaq_n_f32(r, a1, b[j][1]);
+    r = vmlaq_n_f32(r, a2, b[j][2]);
+    r = vmlaq_n_f32(r, a3, b[j][3]);
+    vst1q_f32(&out[j][0], r);
+  }
+#else
+  out = a * b;
+#endif
+}
+
+glm::vec3 ReadVec3(const nlohmann::json &value) {
+  return {value[0].get<float>(), value[1].get<float>(), value[2].get<float>()};
+}
+} // namespace
+
+//*-----------------------------------------------------------------------------
+// Nodes
+//*-----------------------------------------------------------------------------
+
+NodeId SceneGraph::CreateNode(NodeId parent, const std::string &name) {
+  const auto node = static_cast<NodeId>(parents_.size());
+  translations_.emplace_back(0.0f);
+  rotations_.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+  scales_.emplace_back(1.0f);
+  parents_.emplace_back(parent);
+  children_.emplace_back();
+  if (parent != kInvalidNode) {
+    children_[parent].emplace_back(node);
+    depths_.emplace_back(depths_[parent] + 1);
+    worldMatrices_.emplace_back(worldMatrices_[parent]);
+  } else {
+    depths_.emplace_back(0);
+    worldMatrices_.emplace_back(1.0f);
+  }
+  dirty_.emplace_back(0);
+  if (!name.empty()) {
+    names_[name] = node;
+  }
+  MarkDirty(node);
+  return node;
+}
+
+NodeId SceneGraph::Load(const nlohmann::json &block, const std::string &name,
+                        NodeId parent) {
+  const NodeId node = CreateNode(parent, name);
+  if (block.contains("Position")) {
+    SetTranslation(node, ReadVec3(block["Position"]));
+  }
+  if (block.contains("Rotate")) {
+    const auto &rotate = block["Rotate"];
+    SetRotation(node, glm::angleAxis(
+                          glm::radians(rotate["Degrees"].get<float>()),
+                          glm::normalize(ReadVec3(rotate["Axis"]))));
+  }
+  if (block.contains("Scale")) {
+    const auto &scale = block["Scale"];
+    SetScale(node, scale.is_array() ? ReadVec3(scale)
+                                    : glm::vec3(scale.get<float>()));
+  }
+  if (block.contains("Positions")) {
+    const auto &positions = block["Positions"];
+    for (size_t i = 0; i < positions.size(); i++) {
+      const NodeId child =
+          CreateNode(node, name + "[" + std::to_string(i) + "]");
+      SetTranslation(child, ReadVec3(positions[i]));
+    }
+  }
+  if (block.contains("Children")) {
+    for (const auto &[childName, child] : block["Children"].items()) {
+      Load(child, childName, node);
+    }
+  }
+  return node;
+}
+
+std::optional<NodeId> SceneGraph::Find(const std::string &name) const {
+  const auto it = names_.find(name);
+  return it != names_.end() ? std::make_optional(it->second) : std::nullopt;
+}
+
+//*-----------------------------------------------------------------------------
+// Transforms
+//*-----------------------------------------------------------------------------
+
+void SceneGraph::SetTranslation(NodeId node, const glm::vec3 &translation) {
+  translations_[node] = translation;
+  MarkDirty(node);
+}
+
+void SceneGraph::SetRotation(NodeId node, const glm::quat &rotation) {
+  rotations_[node] = rotation;
+  MarkDirty(node);
+}
+
+void SceneGraph::SetScale(NodeId node, const glm::vec3 &scale) {
+  scales_[node] = scale;
+  MarkDirty(node);
+}
+
+void SceneGraph::MarkDirty(NodeId node) {
+  if (dirty_[node] == 0) {
+    dirty_[node] = 1;
+    dirtyRoots_.emplace_back(node);
+  }
+}
+
+uint32_t SceneGraph::UpdateWorldMatrices(ThreadPool *threadPool) {
+  if (dirtyRoots_.empty()) {
+    return 0;
+  }
+
+  // 親は子より前に並ぶため、最初に変更されたノードから順に走査すれば
+  // 親の変更フラグを1回の走査で子孫へ伝播できます。
+  const NodeId first =
+      *std::min_element(dirtyRoots_.begin(), dirtyRoots_.end());
+  dirtyRoots_.clear();
+  uint32_t count = 0;
+  for (NodeId node = first; node < GetNodeCount(); node++) {
+    const NodeId parent = parents_[node];
+    if (dirty_[node] == 0 && (parent == kInvalidNode || dirty_[parent] == 0)) {
+      continue;
+    }
+    dirty_[node] = 1;
+    if (dirtyByDepth_.size() <= depths_[node]) {
+      dirtyByDepth_.resize(depths_[node] + 1);
+    }
+    dirtyByDepth_[depths_[node]].emplace_back(node);
+    count++;
+  }
+
+  // 親のワールド行列が確定してから子を計算するため、浅い順に処理します。
+  for (auto &nodes : dirtyByDepth_) {
+    const auto update = [this, &nodes](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const NodeId node = nodes[i];
+        const glm::mat4 local =
+            ComposeTRS(translations_[node], rotations_[node], scales_[node]);
+        const NodeId parent = parents_[node];
+        if (parent == kInvalidNode) {
+          worldMatrices_[node] = local;
+        } else {
+          Multiply(worldMatrices_[parent], local, worldMatrices_[node]);
+        }
+      }
+    };
+    if (threadPool != nullptr) {
+      threadPool->ParallelFor(nodes.size(), kChunkSize, update);
+    } else {
+      update(0, nodes.size());
+    }
+  }
+  for (auto &nodes : dirtyByDepth_) {
+    for (const NodeId node : nodes) {
+      dirty_[node] = 0;
+    }
+    nodes.clear();
+  }
+  return count;
+}
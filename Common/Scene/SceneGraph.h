@@ -0,0 +1,97 @@
+/**
+ * @brief SoAで変換を保持する階層シーングラフ
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+using NodeId = uint32_t;
+inline constexpr NodeId kInvalidNode = ~0u;
+
+/**
+ * @brief
+ * ノードの平行移動・回転・拡大縮小とワールド行列を構造体の配列(SoA)で保持します。
+ * @note
+ * 親は子より先に生成されるため、配列の順序は常に親が子より前になります。<br>
+ * 変換を変更したノードとその子孫だけが、UpdateWorldMatricesで深さごとにまとめて再計算されます。
+ */
+class SceneGraph {
+public:
+  NodeId CreateNode(NodeId parent = kInvalidNode, const std::string &name = {});
+
+  /**
+   * @brief シーン設定のブロックからノードを生成します。
+   * @note
+   * "Position", "Scale"(数値または配列), "Rotate"({"Degrees", "Axis"})を読み込みます。<br>
+   * "Positions"があれば要素ごとに子ノード("名前[i]")を、"Children"があれば子ブロックを再帰的に生成します。
+   */
+  NodeId Load(const nlohmann::json &block, const std::string &name,
+              NodeId parent = kInvalidNode);
+
+  void SetTranslation(NodeId node, const glm::vec3 &translation);
+  void SetRotation(NodeId node, const glm::quat &rotation);
+  void SetScale(NodeId node, const glm::vec3 &scale);
+
+  [[nodiscard]] const glm::vec3 &GetTranslation(NodeId node) const {
+    return translations_[node];
+  }
+  [[nodiscard]] const glm::quat &GetRotation(NodeId node) const {
+    return rotations_[node];
+  }
+  [[nodiscard]] const glm::vec3 &GetScale(NodeId node) const {
+    return scales_[node];
+  }
+  [[nodiscard]] NodeId GetParent(NodeId node) const { return parents_[node]; }
+  [[nodiscard]] const std::vector<NodeId> &GetChildren(NodeId node) const {
+    return children_[node];
+  }
+
+  /** @brief 最後のUpdateWorldMatrices時点のワールド行列を返します。 */
+  [[nodiscard]] const glm::mat4 &GetWorldMatrix(NodeId node) const {
+    return worldMatrices_[node];
+  }
+  [[nodiscard]] const std::vector<glm::mat4> &GetWorldMatrices() const {
+    return worldMatrices_;
+  }
+
+  [[nodiscard]] std::optional<NodeId> Find(const std::string &name) const;
+  [[nodiscard]] uint32_t GetNodeCount() const {
+    return static_cast<uint32_t>(parents_.size());
+  }
+
+  /**
+   * @brief 変更されたノードの部分木のワールド行列を更新します。
+   * @param threadPool 指定すると同じ深さのノードを並列に計算します。
+   * @return 更新したノード数
+   */
+  uint32_t UpdateWorldMatrices(ThreadPool *threadPool = nullptr);
+
+private:
+  void MarkDirty(NodeId node);
+
+  std::vector<glm::vec3> translations_{};
+  std::vector<glm::quat> rotations_{};
+  std::vector<glm::vec3> scales_{};
+  std::vector<glm::mat4> worldMatrices_{};
+  std::vector<NodeId> parents_{};
+  std::vector<uint32_t> depths_{};
+  std::vector<uint8_t> dirty_{};
+  std::vector<std::vector<NodeId>> children_{};
+
+  /** @brief 前回の更新以降に変換を変更したノード */
+  std::vector<NodeId> dirtyRoots_{};
+  /** @brief 深さごとの更新対象(再確保を避けるため保持します) */
+  std::vector<std::vector<NodeId>> dirtyByDepth_{};
+  std::unordered_map<std::string, NodeId> names_{};
+};
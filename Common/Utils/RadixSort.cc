@@ -0,0 +1,62 @@
+/**
+ * @brief 64bitキーのLSD基数ソート
+ */
+
+#include "Utils/RadixSort.h"
+
+#include <array>
+#include <boost/assert.hpp>
+#include <cstddef>
+#include <utility>
+
+namespace {
+constexpr uint32_t kRadixBits = 8;
+constexpr uint32_t kBucketCount = 1u << kRadixBits;
+constexpr uint32_t kDigitCount = 64 / kRadixBits;
+
+uint32_t Digit(uint64_t key, uint32_t digit) {
+  return static_cast<uint32_t>(key >> (digit * kRadixBits)) &
+         (kBucketCount - 1);
+}
+} // namespace
+
+void RadixSort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values) {
+  BOOST_ASSERT_MSG(keys.size() == values.size(),
+                   "Keys and values must have the same length!");
+  const size_t n = keys.size();
+  if (n < 2) {
+    return;
+  }
+
+  // すべての桁のヒストグラムを1回の走査で求めます。
+  std::array<std::array<size_t, kBucketCount>, kDigitCount> histograms{};
+  for (const uint64_t key : keys) {
+    for (uint32_t d = 0; d < kDigitCount; d++) {
+      histograms[d][Digit(key, d)]++;
+    }
+  }
+
+  std::vector<uint64_t> tmpKeys(n);
+  std::vector<uint32_t> tmpValues(n);
+  for (uint32_t d = 0; d < kDigitCount; d++) {
+    auto &histogram = histograms[d];
+    // 全キーが同じバケットに入る桁は並びが変わりません。
+    if (histogram[Digit(keys[0], d)] == n) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (auto &count : histogram) {
+      const size_t c = count;
+      count = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; i++) {
+      const size_t dst = histogram[Digit(keys[i], d)]++;
+      tmpKeys[dst] = keys[i];
+      tmpValues[dst] = values[i];
+    }
+    std::swap(keys, tmpKeys);
+    std::swap(values, tmpValues);
+  }
+}
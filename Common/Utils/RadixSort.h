@@ -0,0 +1,18 @@
+/**
+ * @brief 64bitキーのLSD基数ソート
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief キーと値の組をキーの昇順に安定ソートします。
+ * @note
+ * 8bitずつ下位の桁から並べ替えます。全キーで同じ値になる桁は読み飛ばすため、
+ * 上位に疎なビットしかないキー(描画のソートキーなど)では走査回数が減ります。
+ * @param keys ソートするキー
+ * @param values キーと同じ長さの値(キーと同じ順に並べ替えられます)
+ */
+void RadixSort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values);
@@ -0,0 +1,46 @@
+/**
+ * @brief 固定数のワーカースレッドでジョブを実行するスレッドプール
+ */
+
+#include "Utils/ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  if (threadCount == 0) {
+    const size_t hw = std::thread::hardware_concurrency();
+    threadCount = std::max<size_t>(hw, 2) - 1;
+  }
+  workers_.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+      // 停止時も残りのジョブを処理してから終了します。
+      if (stop_ && jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop();
+    }
+    job();
+  }
+}
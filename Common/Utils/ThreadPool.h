@@ -0,0 +1,83 @@
+/**
+ * @brief 固定数のワーカースレッドでジョブを実行するスレッドプール
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+public:
+  /**
+   * @param threadCount ワーカースレッド数(0ならハードウェアスレッド数 - 1)
+   */
+  explicit ThreadPool(size_t threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief ジョブを投入し、結果を受け取るfutureを返します。
+   */
+  template <class F> auto Submit(F &&f) -> std::future<std::invoke_result_t<F>> {
+    using R = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.emplace([task]() { (*task)(); });
+    }
+    cond_.notify_one();
+    return result;
+  }
+
+  /**
+   * @brief [0, count)をchunkSizeごとに分割してワーカーと呼び出しスレッドで並列に処理し、完了を待ちます。
+   * @param f void(size_t begin, size_t end)
+   */
+  template <class F>
+  void ParallelFor(size_t count, size_t chunkSize, const F &f) {
+    if (count == 0) {
+      return;
+    }
+    chunkSize = chunkSize == 0 ? 1 : chunkSize;
+    const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    if (chunkCount == 1 || workers_.empty()) {
+      f(size_t{0}, count);
+      return;
+    }
+    std::vector<std::future<void>> futures;
+    futures.reserve(chunkCount - 1);
+    for (size_t c = 1; c < chunkCount; c++) {
+      const size_t begin = c * chunkSize;
+      const size_t end = std::min(begin + chunkSize, count);
+      futures.emplace_back(Submit([&f, begin, end]() { f(begin, end); }));
+    }
+    f(size_t{0}, std::min(chunkSize, count));
+    for (auto &future : futures) {
+      future.get();
+    }
+  }
+
+  [[nodiscard]] size_t GetThreadCount() const { return workers_.size(); }
+
+private:
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_{};
+  std::queue<std::function<void()>> jobs_{};
+  std::mutex mutex_{};
+  std::condition_variable cond_{};
+  bool stop_ = false;
+};
@@ -74,3 +74,17 @@ glm::mat4 Frustum::GetProjectionMatrix() const {
   proj[1][1] *= -1.0f;
   return proj;
 }
+
+std::array<glm::vec4, 6> Frustum::ExtractPlanes(const glm::mat4 &viewProj) {
+  const glm::mat4 m = glm::transpose(viewProj);
+  std::array<glm::vec4, 6> planes = {
+      m[3] + m[0], m[3] - m[0], m[3] + m[1],
+      m[3] - m[1],
+      // 深度範囲が[-1, 1]と[0, 1]のどちらでも内側に収まるよう、保守的な近平面を使用します。
+      m[3] + m[2], m[3] - m[2],
+  };
+  for (auto &plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return planes;
+}
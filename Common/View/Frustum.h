@@ -32,6 +32,12 @@ public:
   glm::vec3 GetCorner(std::size_t idx) const { return corners_.at(idx); }
   BSphere ComputeBSphere() const;
 
+  /**
+   * @brief ビュー射影行列から正規化された6平面(左, 右, 下, 上, 近, 遠)を抽出します。
+   * @note 平面は内側を正とするax + by + cz + dの係数です。
+   */
+  static std::array<glm::vec4, 6> ExtractPlanes(const glm::mat4 &viewProj);
+
 private:
   ProjectionType type_;
 
@@ -0,0 +1,259 @@
+/**
+ * @brief SoAの境界配列に対するSIMD視錐台カリング
+ */
+
+#include "View/FrustumCuller.h"
+
+#include <bit>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_USE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CULL_USE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CULL_USE_NEON 1
+#endif
+
+#include "Utils/ThreadPool.h"
+
+namespace {
+/** @brief 並列に判定する場合の1ジョブあたりの要素数(SIMD幅の倍数) */
+constexpr size_t kChunkSize = 4096;
+
+/**
+ * @brief
+ * 平面ごとに、符号付き距離n・p + w (+ r)を求めるための成分配列です。
+ * @note AABBでは法線の向きに応じて最も内側に寄った頂点(p-vertex)の配列を選びます。
+ */
+struct PlaneInput {
+  float nx, ny, nz, w;
+  const float *px;
+  const float *py;
+  const float *pz;
+  /** @brief 境界球の半径(AABBではnullptr) */
+  const float *pr;
+};
+using PlaneInputs = std::array<PlaneInput, 6>;
+
+inline float Distance(const PlaneInput &p, size_t i) {
+  float d = p.nx * p.px[i] + p.ny * p.py[i] + p.nz * p.pz[i] + p.w;
+  if (p.pr != nullptr) {
+    d += p.pr[i];
+  }
+  return d;
+}
+
+void CullRange(const PlaneInputs &planes, size_t begin, size_t end,
+               std::vector<uint32_t> &visible) {
+  size_t i = begin;
+#if defined(CULL_USE_AVX)
+  for (; i + 8 <= end; i += 8) {
+    int mask = 0xFF;
+    for (const auto &p : planes) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_set1_ps(p.nx), _mm256_loadu_ps(p.px + i)),
+              _mm256_mul_ps(_mm256_set1_ps(p.ny), _mm256_loadu_ps(p.py + i))),
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_set1_ps(p.nz), _mm256_loadu_ps(p.pz + i)),
+              _mm256_set1_ps(p.w)));
+      if (p.pr != nullptr) {
+        d = _mm256_add_ps(d, _mm256_loadu_ps(p.pr + i));
+      }
+      mask &= _mm256_movemask_ps(
+          _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+      if (mask == 0) {
+        break;
+      }
+    }
+    for (auto bits = static_cast<unsigned>(mask); bits != 0; bits &= bits - 1) {
+      visible.emplace_back(static_cast<uint32_t>(i) + std::countr_zero(bits));
+    }
+  }
+#elif defined(CULL_USE_SSE2)
+  for (; i + 4 <= end; i += 4) {
+    int mask = 0xF;
+    for (const auto &p : planes) {
+      __m128 d = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nx), _mm_loadu_ps(p.px + i)),
+                     _mm_mul_ps(_mm_set1_ps(p.ny), _mm_loadu_ps(p.py + i))),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nz), _mm_loadu_ps(p.pz + i)),
+                     _mm_set1_ps(p.w)));
+      if (p.pr != nullptr) {
+        d = _mm_add_ps(d, _mm_loadu_ps(p.pr + i));
+      }
+      mask &= _mm_movemask_ps(_mm_cmpge_ps(d, _mm_setzero_ps()));
+      if (mask == 0) {
+        break;
+      }
+    }
+    for (auto bits = static_cast<unsigned>(mask); bits != 0; bits &= bits - 1) {
+      visible.emplace_back(static_cast<uint32_t>(i) + std::countr_zero(bits));
+    }
+  }
+#elif defined(CULL_USE_NEON)
+  const uint32x4_t laneBits = {1, 2, 4, 8};
+  for (; i + 4 <= end; i += 4) {
+    uint32_t mask = 0xF;
+    for (const auto &p : planes) {
+      float32x4_t d = vdupq_n_f32(p.w);
+      d = vmlaq_n_f32(d, vld1q_f32(p.px + i), p.nx);
+      d = vmlaq_n_f32(d, vld1q_f32(p.py + i), p.ny);
+      d = vmlaq_n_f32(d, vld1q_f32(p.pz + i), p.nz);
+      if (p.pr != nullptr) {
+        d = vaddq_f32(d, vld1q_f32(p.pr + i));
+      }
+      mask &= vaddvq_u32(vandq_u32(vcgeq_f32(d, vdupq_n_f32(0.0f)), laneBits));
+      if (mask == 0) {
+        break;
+      }
+    }
+    for (auto bits = mask; bits != 0; bits &= bits - 1) {
+      visible.emplace_back(static_cast<uint32_t>(i) + std::countr_zero(bits));
+    }
+  }
+#endif
+  // SIMD幅に満たない残りはスカラーで判定します。
+  for (; i < end; i++) {
+    bool inside = true;
+    for (const auto &p : planes) {
+      if (Distance(p, i) < 0.0f) {
+        inside = false;
+        break;
+      }
+    }
+    if (inside) {
+      visible.emplace_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+void Cull(const PlaneInputs &planes, size_t count,
+          std::vector<uint32_t> &visible, ThreadPool *threadPool) {
+  visible.clear();
+  if (threadPool == nullptr || threadPool->GetThreadCount() == 0 ||
+      count <= kChunkSize) {
+    CullRange(planes, 0, count, visible);
+    return;
+  }
+
+  // チャンクごとに結果を集め、順番に連結して昇順を保ちます。
+  std::vector<std::vector<uint32_t>> chunks((count + kChunkSize - 1) /
+                                            kChunkSize);
+  threadPool->ParallelFor(count, kChunkSize,
+                          [&planes, &chunks](size_t begin, size_t end) {
+                            CullRange(planes, begin, end,
+                                      chunks[begin / kChunkSize]);
+                          });
+  for (const auto &chunk : chunks) {
+    visible.insert(visible.end(), chunk.begin(), chunk.end());
+  }
+}
+} // namespace
+
+//*-----------------------------------------------------------------------------
+// Arrays
+//*-----------------------------------------------------------------------------
+
+void AABBArray::Clear() {
+  for (auto *v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) {
+    v->clear();
+  }
+}
+
+void AABBArray::Add(const AABB &aabb) {
+  minX.emplace_back(aabb.mini.x);
+  minY.emplace_back(aabb.mini.y);
+  minZ.emplace_back(aabb.mini.z);
+  maxX.emplace_back(aabb.maxi.x);
+  maxY.emplace_back(aabb.maxi.y);
+  maxZ.emplace_back(aabb.maxi.z);
+}
+
+void AABBArray::Set(uint32_t index, const AABB &aabb) {
+  minX[index] = aabb.mini.x;
+  minY[index] = aabb.mini.y;
+  minZ[index] = aabb.mini.z;
+  maxX[index] = aabb.maxi.x;
+  maxY[index] = aabb.maxi.y;
+  maxZ[index] = aabb.maxi.z;
+}
+
+void BSphereArray::Clear() {
+  for (auto *v : {&x, &y, &z, &radius}) {
+    v->clear();
+  }
+}
+
+void BSphereArray::Add(const BSphere &sphere) {
+  x.emplace_back(sphere.center.x);
+  y.emplace_back(sphere.center.y);
+  z.emplace_back(sphere.center.z);
+  radius.emplace_back(sphere.radius);
+}
+
+void BSphereArray::Set(uint32_t index, const BSphere &sphere) {
+  x[index] = sphere.center.x;
+  y[index] = sphere.center.y;
+  z[index] = sphere.center.z;
+  radius[index] = sphere.radius;
+}
+
+//*-----------------------------------------------------------------------------
+// Culling
+//*-----------------------------------------------------------------------------
+
+void FrustumCuller::Cull(const Planes &planes, const AABBArray &bounds,
+                         std::vector<uint32_t> &visible,
+                         ThreadPool *threadPool) {
+  PlaneInputs inputs{};
+  for (size_t i = 0; i < planes.size(); i++) {
+    const glm::vec4 &p = planes[i];
+    inputs[i] = {p.x,
+                 p.y,
+                 p.z,
+                 p.w,
+                 p.x >= 0.0f ? bounds.maxX.data() : bounds.minX.data(),
+                 p.y >= 0.0f ? bounds.maxY.data() : bounds.minY.data(),
+                 p.z >= 0.0f ? bounds.maxZ.data() : bounds.minZ.data(),
+                 nullptr};
+  }
+  ::Cull(inputs, bounds.Size(), visible, threadPool);
+}
+
+void FrustumCuller::Cull(const Planes &planes, const BSphereArray &bounds,
+                         std::vector<uint32_t> &visible,
+                         ThreadPool *threadPool) {
+  PlaneInputs inputs{};
+  for (size_t i = 0; i < planes.size(); i++) {
+    const glm::vec4 &p = planes[i];
+    inputs[i] = {p.x,           p.y,           p.z,
+                 p.w,           bounds.x.data(), bounds.y.data(),
+                 bounds.z.data(), bounds.radius.data()};
+  }
+  ::Cull(inputs, bounds.Size(), visible, threadPool);
+}
+
+bool FrustumCuller::IsVisible(const Planes &planes, const AABB &aabb) {
+  for (const auto &p : planes) {
+    const glm::vec3 v(p.x >= 0.0f ? aabb.maxi.x : aabb.mini.x,
+                      p.y >= 0.0f ? aabb.maxi.y : aabb.mini.y,
+                      p.z >= 0.0f ? aabb.maxi.z : aabb.mini.z);
+    if (glm::dot(glm::vec3(p), v) + p.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FrustumCuller::IsVisible(const Planes &planes, const BSphere &sphere) {
+  for (const auto &p : planes) {
+    if (glm::dot(glm::vec3(p), sphere.center) + p.w < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
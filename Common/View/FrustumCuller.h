@@ -0,0 +1,69 @@
+/**
+ * @brief SoAの境界配列に対するSIMD視錐台カリング
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Geometry/AABB.h"
+#include "Geometry/BSphere.h"
+
+class ThreadPool;
+
+/**
+ * @brief 軸平行境界ボックスを成分ごとの配列で保持します。
+ */
+struct AABBArray {
+  void Clear();
+  void Add(const AABB &aabb);
+  void Set(uint32_t index, const AABB &aabb);
+  [[nodiscard]] uint32_t Size() const {
+    return static_cast<uint32_t>(minX.size());
+  }
+
+  std::vector<float> minX{}, minY{}, minZ{};
+  std::vector<float> maxX{}, maxY{}, maxZ{};
+};
+
+/**
+ * @brief 境界球を成分ごとの配列で保持します。
+ */
+struct BSphereArray {
+  void Clear();
+  void Add(const BSphere &sphere);
+  void Set(uint32_t index, const BSphere &sphere);
+  [[nodiscard]] uint32_t Size() const {
+    return static_cast<uint32_t>(x.size());
+  }
+
+  std::vector<float> x{}, y{}, z{}, radius{};
+};
+
+/**
+ * @brief
+ * Frustum::ExtractPlanesで得た6平面に対して、境界をSIMD(AVX/SSE2/NEON、なければスカラー)でまとめて判定します。
+ * @note
+ * 結果は可視なインデックスを昇順に詰めたリストです。
+ * ThreadPoolを指定すると固定長のチャンクに分割して並列に判定します。
+ */
+class FrustumCuller {
+public:
+  using Planes = std::array<glm::vec4, 6>;
+
+  static void Cull(const Planes &planes, const AABBArray &bounds,
+                   std::vector<uint32_t> &visible,
+                   ThreadPool *threadPool = nullptr);
+  static void Cull(const Planes &planes, const BSphereArray &bounds,
+                   std::vector<uint32_t> &visible,
+                   ThreadPool *threadPool = nullptr);
+
+  /** @brief 1つのAABBを判定します。(境界と交差する場合も可視とします) */
+  [[nodiscard]] static bool IsVisible(const Planes &planes, const AABB &aabb);
+  [[nodiscard]] static bool IsVisible(const Planes &planes,
+                                      const BSphere &sphere);
+};
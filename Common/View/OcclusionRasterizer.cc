@@ -0,0 +1,465 @@
+/**
+ * @brief CPUによるマスク付きソフトウェア遮蔽カリング
+ */
+
+#include "View/OcclusionRasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define OCCLUSION_USE_NEON 1
+#endif
+
+#include "Utils/ThreadPool.h"
+
+namespace {
+/** @brief 並列に描画する場合の1ジョブあたりのタイル行数 */
+constexpr size_t kTileRowsPerJob = 2;
+
+constexpr uint32_t kFullMask = ~0u;
+
+/** @brief 行内の[begin, end)ビットを立てたマスクを返します。 */
+inline uint32_t SpanMask(int32_t begin, int32_t end) {
+  begin = std::clamp(begin, 0, 32);
+  end = std::clamp(end, 0, 32);
+  if (begin >= end) {
+    return 0;
+  }
+  const uint32_t upper = end == 32 ? kFullMask : (1u << end) - 1;
+  const uint32_t lower = begin == 32 ? kFullMask : (1u << begin) - 1;
+  return upper & ~lower;
+}
+
+/**
+ * @brief ニアクリップ面(z = 0)で三角形を切り取り、残った多角形の頂点を返します。
+ * @return 頂点数(0、3、または4)
+ */
+uint32_t ClipNear(const std::array<glm::vec4, 3> &in,
+                  std::array<glm::vec4, 4> &out) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < 3; i++) {
+    const glm::vec4 &a = in[i];
+    const glm::vec4 &b = in[(i + 1) % 3];
+    if (a.z >= 0.0f) {
+      out[count++] = a;
+    }
+    if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+      const float t = a.z / (a.z - b.z);
+      out[count++] = a + (b - a) * t;
+    }
+  }
+  return count;
+}
+} // namespace
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void OcclusionRasterizer::Resize(uint32_t width, uint32_t height) {
+  this->width = std::max(width, 1u);
+  this->height = std::max(height, 1u);
+  tilesX = (this->width + kTileWidth - 1) / kTileWidth;
+  tilesY = (this->height + kTileHeight - 1) / kTileHeight;
+
+  const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+  zMax0.assign(tileCount, 1.0f);
+  zMax1.assign(tileCount, 0.0f);
+  masks.assign(tileCount * kTileHeight, 0);
+  validMasks.resize(tileCount * kTileHeight);
+  for (uint32_t ty = 0; ty < tilesY; ty++) {
+    for (uint32_t tx = 0; tx < tilesX; tx++) {
+      const auto columns = static_cast<int32_t>(
+          std::min(this->width - tx * kTileWidth, kTileWidth));
+      uint32_t *valid =
+          &validMasks[(static_cast<size_t>(ty) * tilesX + tx) * kTileHeight];
+      for (uint32_t r = 0; r < kTileHeight; r++) {
+        valid[r] = ty * kTileHeight + r < this->height ? SpanMask(0, columns)
+                                                       : 0;
+      }
+    }
+  }
+}
+
+void OcclusionRasterizer::Begin(const glm::mat4 &viewProj) {
+  this->viewProj = viewProj;
+  occluders.clear();
+  std::fill(zMax0.begin(), zMax0.end(), 1.0f);
+  std::fill(zMax1.begin(), zMax1.end(), 0.0f);
+  std::fill(masks.begin(), masks.end(), 0u);
+}
+
+void OcclusionRasterizer::AddOccluder(const OccluderMesh &mesh,
+                                      const glm::mat4 &world) {
+  occluders.push_back({&mesh, viewProj * world});
+}
+
+void OcclusionRasterizer::SetupTriangles(
+    const Occluder &occluder, std::vector<Triangle> &triangles) const {
+  triangles.clear();
+  const auto &positions = occluder.mesh->positions;
+  const auto &indices = occluder.mesh->indices;
+
+  std::vector<glm::vec4> clip(positions.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    clip[i] = occluder.transform * glm::vec4(positions[i], 1.0f);
+  }
+
+  const auto w = static_cast<float>(width);
+  const auto h = static_cast<float>(height);
+  const auto emit = [&](const glm::vec4 &c0, const glm::vec4 &c1,
+                        const glm::vec4 &c2) {
+    std::array<glm::vec3, 3> v{};
+    for (int i = 0; i < 3; i++) {
+      const glm::vec4 &c = i == 0 ? c0 : (i == 1 ? c1 : c2);
+      const glm::vec3 ndc = glm::vec3(c) / c.w;
+      v[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * w, (ndc.y * 0.5f + 0.5f) * h,
+                       ndc.z);
+    }
+    std::sort(v.begin(), v.end(), [](const glm::vec3 &a, const glm::vec3 &b) {
+      return a.y < b.y;
+    });
+
+    Triangle t{};
+    t.minX = std::min({v[0].x, v[1].x, v[2].x});
+    t.maxX = std::max({v[0].x, v[1].x, v[2].x});
+    if (t.maxX <= 0.0f || t.minX >= w || v[2].y <= 0.0f || v[0].y >= h) {
+      return;
+    }
+    // 面積が0の三角形はピクセルを覆いません。
+    const glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+    if (std::abs(n.z) < 1e-8f) {
+      return;
+    }
+    for (int i = 0; i < 3; i++) {
+      t.x[i] = v[i].x;
+      t.y[i] = v[i].y;
+    }
+    const auto slope = [](const glm::vec3 &a, const glm::vec3 &b) {
+      return b.y > a.y ? (b.x - a.x) / (b.y - a.y) : 0.0f;
+    };
+    t.slope[0] = slope(v[0], v[1]);
+    t.slope[1] = slope(v[1], v[2]);
+    t.slope[2] = slope(v[0], v[2]);
+    t.dzdx = -n.x / n.z;
+    t.dzdy = -n.y / n.z;
+    t.z0 = v[0].z - t.dzdx * v[0].x - t.dzdy * v[0].y;
+    t.zMax = std::max({v[0].z, v[1].z, v[2].z});
+    triangles.push_back(t);
+  };
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const std::array<glm::vec4, 3> in = {
+        clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]};
+    if (in[0].z >= 0.0f && in[1].z >= 0.0f && in[2].z >= 0.0f) {
+      emit(in[0], in[1], in[2]);
+      continue;
+    }
+    std::array<glm::vec4, 4> polygon{};
+    const uint32_t count = ClipNear(in, polygon);
+    for (uint32_t j = 2; j < count; j++) {
+      emit(polygon[0], polygon[j - 1], polygon[j]);
+    }
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// Rasterize
+//*-----------------------------------------------------------------------------
+
+void OcclusionRasterizer::Rasterize(ThreadPool *threadPool) {
+  triangles.resize(occluders.size());
+  const auto setup = [this](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      SetupTriangles(occluders[i], triangles[i]);
+    }
+  };
+  // タイル行の範囲ごとに全三角形を描画するため、ジョブ間で書き込みが重なりません。
+  const auto rasterize = [this](size_t begin, size_t end) {
+    for (size_t i = 0; i < occluders.size(); i++) {
+      for (const auto &triangle : triangles[i]) {
+        RasterizeTriangle(triangle, static_cast<uint32_t>(begin),
+                          static_cast<uint32_t>(end));
+      }
+    }
+  };
+  if (threadPool != nullptr) {
+    threadPool->ParallelFor(occluders.size(), 1, setup);
+    threadPool->ParallelFor(tilesY, kTileRowsPerJob, rasterize);
+  } else {
+    setup(0, occluders.size());
+    rasterize(0, tilesY);
+  }
+
+  triangleCount = 0;
+  for (size_t i = 0; i < occluders.size(); i++) {
+    triangleCount += static_cast<uint32_t>(triangles[i].size());
+  }
+}
+
+void OcclusionRasterizer::RasterizeTriangle(const Triangle &t,
+                                            uint32_t tileRowBegin,
+                                            uint32_t tileRowEnd) {
+  const auto firstRow = static_cast<uint32_t>(std::max(t.y[0], 0.0f)) /
+                        kTileHeight;
+  const auto lastRow =
+      static_cast<uint32_t>(std::clamp(t.y[2], 0.0f,
+                                       static_cast<float>(height))) /
+      kTileHeight;
+  const uint32_t rowBegin = std::max(firstRow, tileRowBegin);
+  const uint32_t rowEnd = std::min(lastRow + 1, tileRowEnd);
+
+  const auto w = static_cast<float>(width);
+  alignas(16) int32_t spanBegin[kTileHeight];
+  alignas(16) int32_t spanEnd[kTileHeight];
+  for (uint32_t ty = rowBegin; ty < rowEnd; ty++) {
+    // タイル行の各行について、ピクセル中心が[左端, 右端)に入る区間を求めます。
+    const auto y = static_cast<float>(ty * kTileHeight) + 0.5f;
+#if defined(OCCLUSION_USE_SSE2)
+    for (uint32_t r = 0; r < kTileHeight; r += 4) {
+      const __m128 py = _mm_add_ps(_mm_set1_ps(y + static_cast<float>(r)),
+                                   _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+      const __m128 dy0 = _mm_sub_ps(py, _mm_set1_ps(t.y[0]));
+      const __m128 dy1 = _mm_sub_ps(py, _mm_set1_ps(t.y[1]));
+      const __m128 xl = _mm_add_ps(_mm_set1_ps(t.x[0]),
+                                   _mm_mul_ps(dy0, _mm_set1_ps(t.slope[2])));
+      const __m128 upper = _mm_cmplt_ps(py, _mm_set1_ps(t.y[1]));
+      const __m128 xr = _mm_or_ps(
+          _mm_and_ps(upper,
+                     _mm_add_ps(_mm_set1_ps(t.x[0]),
+                                _mm_mul_ps(dy0, _mm_set1_ps(t.slope[0])))),
+          _mm_andnot_ps(upper,
+                        _mm_add_ps(_mm_set1_ps(t.x[1]),
+                                   _mm_mul_ps(dy1, _mm_set1_ps(t.slope[1])))));
+      const __m128 inside =
+          _mm_and_ps(_mm_cmpge_ps(py, _mm_set1_ps(t.y[0])),
+                     _mm_cmplt_ps(py, _mm_set1_ps(t.y[2])));
+      const __m128 half = _mm_set1_ps(0.5f);
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 right = _mm_set1_ps(w);
+      __m128 l = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_min_ps(xl, xr), half),
+                                       zero),
+                            right);
+      __m128 e = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_max_ps(xl, xr), half),
+                                       zero),
+                            right);
+      l = _mm_and_ps(inside, l);
+      e = _mm_and_ps(inside, e);
+      // 非負の値の切り上げ(切り捨てた値が元より小さければ1を足します)
+      __m128i li = _mm_cvttps_epi32(l);
+      __m128i ei = _mm_cvttps_epi32(e);
+      li = _mm_sub_epi32(li, _mm_castps_si128(
+                                 _mm_cmplt_ps(_mm_cvtepi32_ps(li), l)));
+      ei = _mm_sub_epi32(ei, _mm_castps_si128(
+                                 _mm_cmplt_ps(_mm_cvtepi32_ps(ei), e)));
+      _mm_store_si128(reinterpret_cast<__m128i *>(spanBegin + r), li);
+      _mm_store_si128(reinterpret_cast<__m128i *>(spanEnd + r), ei);
+    }
+#elif defined(OCCLUSION_USE_NEON)
+    const float32x4_t offsets = {0.0f, 1.0f, 2.0f, 3.0f};
+    for (uint32_t r = 0; r < kTileHeight; r += 4) {
+      const float32x4_t py =
+          vaddq_f32(vdupq_n_f32(y + static_cast<float>(r)), offsets);
+      const float32x4_t dy0 = vsubq_f32(py, vdupq_n_f32(t.y[0]));
+      const float32x4_t dy1 = vsubq_f32(py, vdupq_n_f32(t.y[1]));
+      const float32x4_t xl = vmlaq_n_f32(vdupq_n_f32(t.x[0]), dy0, t.slope[2]);
+      const uint32x4_t upper = vcltq_f32(py, vdupq_n_f32(t.y[1]));
+      const float32x4_t xr =
+          vbslq_f32(upper, vmlaq_n_f32(vdupq_n_f32(t.x[0]), dy0, t.slope[0]),
+                    vmlaq_n_f32(vdupq_n_f32(t.x[1]), dy1, t.slope[1]));
+      const uint32x4_t inside = vandq_u32(vcgeq_f32(py, vdupq_n_f32(t.y[0])),
+                                          vcltq_f32(py, vdupq_n_f32(t.y[2])));
+      const float32x4_t zero = vdupq_n_f32(0.0f);
+      const float32x4_t right = vdupq_n_f32(w);
+      float32x4_t l = vminq_f32(
+          vmaxq_f32(vsubq_f32(vminq_f32(xl, xr), vdupq_n_f32(0.5f)), zero),
+          right);
+      float32x4_t e = vminq_f32(
+          vmaxq_f32(vsubq_f32(vmaxq_f32(xl, xr), vdupq_n_f32(0.5f)), zero),
+          right);
+      l = vbslq_f32(inside, l, zero);
+      e = vbslq_f32(inside, e, zero);
+      vst1q_s32(spanBegin + r, vcvtq_s32_f32(vrndpq_f32(l)));
+      vst1q_s32(spanEnd + r, vcvtq_s32_f32(vrndpq_f32(e)));
+    }
+#else
+    for (uint32_t r = 0; r < kTileHeight; r++) {
+      const float py = y + static_cast<float>(r);
+      if (py < t.y[0] || py >= t.y[2]) {
+        spanBegin[r] = spanEnd[r] = 0;
+        continue;
+      }
+      const float xl = t.x[0] + (py - t.y[0]) * t.slope[2];
+      const float xr = py < t.y[1] ? t.x[0] + (py - t.y[0]) * t.slope[0]
+                                   : t.x[1] + (py - t.y[1]) * t.slope[1];
+      spanBegin[r] = static_cast<int32_t>(
+          std::ceil(std::clamp(std::min(xl, xr) - 0.5f, 0.0f, w)));
+      spanEnd[r] = static_cast<int32_t>(
+          std::ceil(std::clamp(std::max(xl, xr) - 0.5f, 0.0f, w)));
+    }
+#endif
+
+    int32_t minBegin = static_cast<int32_t>(width);
+    int32_t maxEnd = 0;
+    for (uint32_t r = 0; r < kTileHeight; r++) {
+      if (spanBegin[r] < spanEnd[r]) {
+        minBegin = std::min(minBegin, spanBegin[r]);
+        maxEnd = std::max(maxEnd, spanEnd[r]);
+      }
+    }
+    if (minBegin >= maxEnd) {
+      continue;
+    }
+
+    // 三角形とタイル行の重なりで深度の平面が最も遠くなる点を使います。
+    const float top = std::max(static_cast<float>(ty * kTileHeight), t.y[0]);
+    const float bottom =
+        std::min(static_cast<float>((ty + 1) * kTileHeight), t.y[2]);
+    const float planeY = t.dzdy > 0.0f ? bottom : top;
+
+    const auto txBegin = static_cast<uint32_t>(minBegin) / kTileWidth;
+    const auto txEnd = static_cast<uint32_t>(maxEnd - 1) / kTileWidth + 1;
+    for (uint32_t tx = txBegin; tx < txEnd; tx++) {
+      const auto tileX = static_cast<int32_t>(tx * kTileWidth);
+      uint32_t triangleMask[kTileHeight];
+      uint32_t any = 0;
+      for (uint32_t r = 0; r < kTileHeight; r++) {
+        triangleMask[r] =
+            SpanMask(spanBegin[r] - tileX, spanEnd[r] - tileX);
+        any |= triangleMask[r];
+      }
+      if (any == 0) {
+        continue;
+      }
+
+      const float left = std::max(static_cast<float>(tileX), t.minX);
+      const float right =
+          std::min(static_cast<float>(tileX + kTileWidth), t.maxX);
+      const float planeX = t.dzdx > 0.0f ? right : left;
+      const float z =
+          std::min(t.zMax, t.z0 + t.dzdx * planeX + t.dzdy * planeY);
+      MergeTile(ty * tilesX + tx, triangleMask, z);
+    }
+  }
+}
+
+/**
+ * @note
+ * 三角形が作業レイヤーより基準レイヤーに近い場合は、作業レイヤーを捨てて三角形から始め直します。
+ * 遠い三角形を重ねて作業レイヤーの深度が後退するのを防ぐためです。
+ */
+void OcclusionRasterizer::MergeTile(uint32_t tile, const uint32_t *triangleMask,
+                                    float z) {
+  float &z0 = zMax0[tile];
+  float &z1 = zMax1[tile];
+  // 基準レイヤーより遠い三角形では判定が改善しません。
+  if (z >= z0) {
+    return;
+  }
+  uint32_t *mask = &masks[static_cast<size_t>(tile) * kTileHeight];
+  if (z - z1 > z0 - z) {
+    std::fill_n(mask, kTileHeight, 0u);
+    z1 = 0.0f;
+  }
+
+  const uint32_t *valid = &validMasks[static_cast<size_t>(tile) * kTileHeight];
+  bool full = true;
+  for (uint32_t r = 0; r < kTileHeight; r++) {
+    mask[r] |= triangleMask[r];
+    full = full && (mask[r] | ~valid[r]) == kFullMask;
+  }
+  z1 = std::max(z1, z);
+  if (full) {
+    z0 = z1;
+    z1 = 0.0f;
+    std::fill_n(mask, kTileHeight, 0u);
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// Query
+//*-----------------------------------------------------------------------------
+
+bool OcclusionRasterizer::IsVisible(const AABB &aabb) const {
+  float minX = std::numeric_limits<float>::max();
+  float minY = std::numeric_limits<float>::max();
+  float maxX = std::numeric_limits<float>::lowest();
+  float maxY = std::numeric_limits<float>::lowest();
+  float minZ = 1.0f;
+  for (int i = 0; i < 8; i++) {
+    const glm::vec3 corner((i & 1) != 0 ? aabb.maxi.x : aabb.mini.x,
+                           (i & 2) != 0 ? aabb.maxi.y : aabb.mini.y,
+                           (i & 4) != 0 ? aabb.maxi.z : aabb.mini.z);
+    const glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+    // ニアクリップ面をまたぐ場合は可視とみなします。
+    if (clip.z < 0.0f || clip.w <= 0.0f) {
+      return true;
+    }
+    const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    minX = std::min(minX, ndc.x);
+    minY = std::min(minY, ndc.y);
+    maxX = std::max(maxX, ndc.x);
+    maxY = std::max(maxY, ndc.y);
+    minZ = std::min(minZ, ndc.z);
+  }
+  const auto w = static_cast<float>(width);
+  const auto h = static_cast<float>(height);
+  return IsVisible((minX * 0.5f + 0.5f) * w, (minY * 0.5f + 0.5f) * h,
+                   (maxX * 0.5f + 0.5f) * w, (maxY * 0.5f + 0.5f) * h, minZ);
+}
+
+bool OcclusionRasterizer::IsVisible(float minX, float minY, float maxX,
+                                    float maxY, float minZ) const {
+  const auto w = static_cast<float>(width);
+  const auto h = static_cast<float>(height);
+  if (maxX < 0.0f || maxY < 0.0f || minX >= w || minY >= h) {
+    return false;
+  }
+  const auto tx0 = static_cast<uint32_t>(std::max(minX, 0.0f)) / kTileWidth;
+  const auto ty0 = static_cast<uint32_t>(std::max(minY, 0.0f)) / kTileHeight;
+  const uint32_t tx1 = std::min(
+      static_cast<uint32_t>(std::min(maxX, w - 1.0f)) / kTileWidth, tilesX - 1);
+  const uint32_t ty1 =
+      std::min(static_cast<uint32_t>(std::min(maxY, h - 1.0f)) / kTileHeight,
+               tilesY - 1);
+
+  // 覆うタイルのどれかで基準レイヤーより手前にあれば可視です。
+  for (uint32_t ty = ty0; ty <= ty1; ty++) {
+    const float *row = zMax0.data() + static_cast<size_t>(ty) * tilesX;
+    uint32_t tx = tx0;
+#if defined(OCCLUSION_USE_SSE2)
+    const __m128 z = _mm_set1_ps(minZ);
+    for (; tx + 4 <= tx1 + 1; tx += 4) {
+      if (_mm_movemask_ps(_mm_cmple_ps(z, _mm_loadu_ps(row + tx))) != 0) {
+        return true;
+      }
+    }
+#elif defined(OCCLUSION_USE_NEON)
+    const float32x4_t z = vdupq_n_f32(minZ);
+    for (; tx + 4 <= tx1 + 1; tx += 4) {
+      if (vmaxvq_u32(vcleq_f32(z, vld1q_f32(row + tx))) != 0) {
+        return true;
+      }
+    }
+#endif
+    for (; tx <= tx1; tx++) {
+      if (minZ <= row[tx]) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void OcclusionRasterizer::Cull(const std::vector<AABB> &bounds,
+                               std::vector<uint32_t> &visible) const {
+  std::erase_if(visible,
+                [&](uint32_t index) { return !IsVisible(bounds[index]); });
+}
@@ -0,0 +1,123 @@
+/**
+ * @brief CPUによるマスク付きソフトウェア遮蔽カリング
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Geometry/AABB.h"
+
+class ThreadPool;
+
+/**
+ * @brief 遮蔽物として描画する三角形メッシュです。(位置のみ)
+ */
+struct OccluderMesh {
+  std::vector<glm::vec3> positions{};
+  std::vector<uint32_t> indices{};
+};
+
+/**
+ * @brief
+ * 大きな遮蔽物を低解像度の深度へラスタライズし、境界の遮蔽を判定します。
+ * Masked Occlusion Cullingと同じく、32x8ピクセルのタイルごとに被覆マスクと2層の最大深度を保持します。
+ * @note
+ * 基準レイヤー(zMax0)はタイル全体を覆う遮蔽物の最も遠い深度です。
+ * 作業レイヤーは三角形の被覆をマスクに重ね、マスクが埋まった時点で基準レイヤーへ反映します。<br>
+ * 行ごとの被覆区間の計算と判定はSIMD(SSE2/NEON、なければスカラー)で行います。<br>
+ * 深度はGLM_FORCE_DEPTH_ZERO_TO_ONEの射影(手前0、奥1)を想定します。
+ * 遮蔽物はピクセル中心の規則で内側だけを、判定は境界を含むタイル単位で行うため、結果は保守的です。
+ */
+class OcclusionRasterizer {
+public:
+  static constexpr uint32_t kTileWidth = 32;
+  static constexpr uint32_t kTileHeight = 8;
+
+  /** @brief 深度の解像度を設定します。 */
+  void Resize(uint32_t width, uint32_t height);
+
+  /**
+   * @brief 深度を遠方でクリアし、遮蔽物の登録を始めます。
+   */
+  void Begin(const glm::mat4 &viewProj);
+
+  /**
+   * @brief 遮蔽物を登録します。meshはRasterizeを呼び出すまで保持してください。
+   */
+  void AddOccluder(const OccluderMesh &mesh, const glm::mat4 &world);
+
+  /**
+   * @brief 登録した遮蔽物を描画します。
+   * @note
+   * ThreadPoolを指定すると、遮蔽物ごとの三角形の準備と、タイル行ごとの描画を並列に行います。
+   */
+  void Rasterize(ThreadPool *threadPool = nullptr);
+
+  /**
+   * @brief ワールド空間のAABBが遮蔽されていなければtrueを返します。
+   */
+  [[nodiscard]] bool IsVisible(const AABB &aabb) const;
+
+  /**
+   * @brief 画面上の矩形(ピクセル)とその最も手前の深度で判定します。
+   */
+  [[nodiscard]] bool IsVisible(float minX, float minY, float maxX, float maxY,
+                               float minZ) const;
+
+  /** @brief visibleのうち、遮蔽されていないものだけを順序を保って残します。 */
+  void Cull(const std::vector<AABB> &bounds,
+            std::vector<uint32_t> &visible) const;
+
+  [[nodiscard]] uint32_t GetWidth() const { return width; }
+  [[nodiscard]] uint32_t GetHeight() const { return height; }
+  /** @brief 最後のRasterizeで描画した三角形の数 */
+  [[nodiscard]] uint32_t GetTriangleCount() const { return triangleCount; }
+
+private:
+  /** @brief 画面空間(ピクセル)の三角形です。頂点はyの昇順に並べます。 */
+  struct Triangle {
+    float x[3];
+    float y[3];
+    /** @brief 辺ごとのdx/dy(0: 頂点0-1, 1: 頂点1-2, 2: 頂点0-2) */
+    float slope[3];
+    /** @brief 深度の平面 z = z0 + dzdx * x + dzdy * y */
+    float z0, dzdx, dzdy;
+    float zMax;
+    float minX, maxX;
+  };
+
+  struct Occluder {
+    const OccluderMesh *mesh;
+    glm::mat4 transform;
+  };
+
+  void SetupTriangles(const Occluder &occluder,
+                      std::vector<Triangle> &triangles) const;
+  void RasterizeTriangle(const Triangle &triangle, uint32_t tileRowBegin,
+                         uint32_t tileRowEnd);
+  void MergeTile(uint32_t tile, const uint32_t *triangleMask, float z);
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t tilesX = 0;
+  uint32_t tilesY = 0;
+  uint32_t triangleCount = 0;
+
+  glm::mat4 viewProj = glm::mat4(1.0f);
+  std::vector<Occluder> occluders{};
+  /** @brief 遮蔽物ごとの画面空間の三角形 */
+  std::vector<std::vector<Triangle>> triangles{};
+
+  /** @brief タイルごとの基準レイヤーの最大深度 */
+  std::vector<float> zMax0{};
+  /** @brief タイルごとの作業レイヤーの最大深度 */
+  std::vector<float> zMax1{};
+  /** @brief タイルごとにkTileHeight行ぶんの作業レイヤーの被覆マスク */
+  std::vector<uint32_t> masks{};
+  /** @brief 画面内にあるピクセルのマスク(画面外は埋まっているとみなします) */
+  std::vector<uint32_t> validMasks{};
+};
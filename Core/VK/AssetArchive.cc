@@ -0,0 +1,270 @@
+/**
+ * @brief アーカイブからステージングメモリへ直接読み込むアセットローダ
+ */
+
+#include "VK/AssetArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#include "Image/KtxReader.h"
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Texture.h"
+#include "VK/Utils.h"
+
+namespace {
+/** @brief ステージング上のレベルの配置境界(BCのブロックサイズとテクセルサイズの倍数) */
+constexpr VkDeviceSize kLevelAlignment = 16;
+/**
+ * @brief
+ * KTXのレベルは4バイト境界にしか揃っていないため、全レベルを揃え直すための余白を確保します(最大16レベル)。
+ */
+constexpr VkDeviceSize kRelocationSlack = 16 * kLevelAlignment;
+
+constexpr VkDeviceSize Align(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+struct AssetArchive::PendingTexture {
+  const AssetArchiveTextureRequest *request = nullptr;
+  const Archive::Entry *entry = nullptr;
+  VkDeviceSize stagingOffset = 0;
+  size_t scratchOffset = 0;
+
+  KtxReader ktx{};
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::vector<VkBufferImageCopy> regions{};
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+};
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+bool AssetArchive::Setup(const Device &device, const std::string &filepath,
+                         VkDeviceSize size) {
+  if (!reader.Open(filepath) || !fileReader.Open(filepath)) {
+    return false;
+  }
+  stagingSize = size;
+  VK_CHECK_RESULT(staging.Create(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 stagingSize));
+  VK_CHECK_RESULT(staging.Map(device));
+  spdlog::info("{}: {} entries{}", filepath, reader.GetEntryCount(),
+               fileReader.IsUsingIoUring() ? " (io_uring)" : "");
+  return true;
+}
+
+void AssetArchive::Destroy(const Device &device) {
+  fileReader.Close();
+  if (staging.buffer != VK_NULL_HANDLE) {
+    staging.Unmap(device);
+    staging.Destroy(device);
+    staging = Buffer{};
+  }
+  scratch.clear();
+  scratch.shrink_to_fit();
+}
+
+bool AssetArchive::Contains(const std::string &name) const {
+  return staging.mapped != nullptr && reader.Find(name) != nullptr;
+}
+
+//*-----------------------------------------------------------------------------
+// Textures
+//*-----------------------------------------------------------------------------
+
+bool AssetArchive::LoadTextures(
+    const Device &device, VkQueue copyQueue,
+    const std::vector<AssetArchiveTextureRequest> &requests) {
+  bool ok = true;
+  std::vector<PendingTexture> batch{};
+  VkDeviceSize used = 0;
+  size_t scratchUsed = 0;
+  for (const auto &request : requests) {
+    const Archive::Entry *entry = reader.Find(request.name);
+    if (entry == nullptr) {
+      spdlog::error("{} is not in {}", request.name, reader.GetPath());
+      ok = false;
+      continue;
+    }
+    const VkDeviceSize footprint =
+        Align(entry->size + kRelocationSlack, kLevelAlignment);
+    if (footprint > stagingSize) {
+      spdlog::error("{} does not fit in the staging buffer.", request.name);
+      ok = false;
+      continue;
+    }
+    // ステージングが満杯になったら、それまでの分を転送します。
+    if (used + footprint > stagingSize) {
+      ok = LoadBatch(device, copyQueue, batch) && ok;
+      batch.clear();
+      used = 0;
+      scratchUsed = 0;
+    }
+
+    PendingTexture &pending = batch.emplace_back();
+    pending.request = &request;
+    pending.entry = entry;
+    pending.stagingOffset = used;
+    pending.scratchOffset = scratchUsed;
+    used += footprint;
+    if (entry->compression != Archive::Compression::None) {
+      scratchUsed += entry->storedSize;
+    }
+  }
+  if (!batch.empty()) {
+    ok = LoadBatch(device, copyQueue, batch) && ok;
+  }
+  return ok;
+}
+
+bool AssetArchive::LoadBatch(const Device &device, VkQueue copyQueue,
+                             std::vector<PendingTexture> &batch) {
+  auto *mapped = static_cast<std::byte *>(staging.mapped);
+
+  // 非圧縮のブロブはステージングへ、圧縮されたブロブは作業領域へ読み込みます。
+  size_t scratchSize = 0;
+  for (const auto &pending : batch) {
+    if (pending.entry->compression != Archive::Compression::None) {
+      scratchSize = pending.scratchOffset + pending.entry->storedSize;
+    }
+  }
+  if (scratch.size() < scratchSize) {
+    scratch.resize(scratchSize);
+  }
+  for (const auto &pending : batch) {
+    const Archive::Entry &entry = *pending.entry;
+    if (entry.compression == Archive::Compression::None) {
+      fileReader.Read(entry.offset, entry.size,
+                      mapped + pending.stagingOffset);
+    } else {
+      fileReader.Read(entry.offset, entry.storedSize,
+                      scratch.data() + pending.scratchOffset);
+    }
+  }
+  if (!fileReader.Wait()) {
+    return false;
+  }
+
+  bool ok = true;
+  VkCommandBuffer copyCommand =
+      device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+  for (auto &pending : batch) {
+    const Archive::Entry &entry = *pending.entry;
+    const std::string &name = pending.request->name;
+    std::byte *data = mapped + pending.stagingOffset;
+    if (entry.compression != Archive::Compression::None &&
+        !ArchiveReader::Decode(entry, scratch.data() + pending.scratchOffset,
+                               data)) {
+      spdlog::error("{}: failed to decode.", name);
+      ok = false;
+      continue;
+    }
+
+    KtxReader &ktx = pending.ktx;
+    if (!ktx.Parse(data, entry.size) || ktx.GetLevelCount() > 16) {
+      spdlog::error("{}: failed to parse KTX.", name);
+      ok = false;
+      continue;
+    }
+    pending.format = pending.request->format;
+    if (ktx.IsCompressed()) {
+      const auto compressed =
+          FindCompressedFormat(device, ktx.GetGLInternalFormat());
+      if (!compressed) {
+        spdlog::error("{}: compressed format is not supported.", name);
+        ok = false;
+        continue;
+      }
+      pending.format = *compressed;
+    }
+
+    // レベルをブロック境界へ揃え直します。後ろへずらすだけなので、末尾のレベルから移動します。
+    std::vector<VkDeviceSize> offsets(ktx.GetLevelCount());
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < ktx.GetLevelCount(); i++) {
+      offset = Align(std::max<VkDeviceSize>(offset, ktx.GetLevel(i).offset),
+                     kLevelAlignment);
+      offsets[i] = offset;
+      offset += ktx.GetLevel(i).size;
+    }
+    for (uint32_t i = ktx.GetLevelCount(); i-- > 0;) {
+      if (offsets[i] != ktx.GetLevel(i).offset) {
+        std::memmove(data + offsets[i], data + ktx.GetLevel(i).offset,
+                     ktx.GetLevel(i).size);
+      }
+    }
+
+    for (uint32_t i = 0; i < ktx.GetLevelCount(); i++) {
+      VkBufferImageCopy region{};
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = i;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent = {ktx.GetLevel(i).width, ktx.GetLevel(i).height, 1};
+      region.bufferOffset = pending.stagingOffset + offsets[i];
+      pending.regions.emplace_back(region);
+    }
+
+    VK_CHECK_RESULT(CreateImage(
+        device, pending.image, pending.memory, pending.format, VK_IMAGE_TYPE_2D,
+        ktx.GetWidth(), ktx.GetHeight(), 1, ktx.GetLevelCount(), 1,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_IMAGE_TILING_OPTIMAL));
+    const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                        ktx.GetLevelCount(), 0, 1};
+    TransitionImageLayout(copyCommand, pending.image, range,
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdCopyBufferToImage(copyCommand, staging.buffer, pending.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(pending.regions.size()),
+                           pending.regions.data());
+    TransitionImageLayout(copyCommand, pending.image, range,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          pending.request->imageLayout);
+  }
+  // バッチ内の全テクスチャを1回で転送します。
+  device.FlushCommandBuffer(copyCommand, copyQueue);
+
+  for (auto &pending : batch) {
+    if (pending.image == VK_NULL_HANDLE) {
+      continue;
+    }
+    Texture2D &texture = *pending.request->texture;
+    texture.image = pending.image;
+    texture.memory = pending.memory;
+    texture.width = pending.ktx.GetWidth();
+    texture.height = pending.ktx.GetHeight();
+    texture.mipLevels = pending.ktx.GetLevelCount();
+    texture.layerCount = 1;
+
+    VK_CHECK_RESULT(CreateSampler(
+        device, texture.sampler, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_FALSE,
+        VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        VK_SAMPLER_MIPMAP_MODE_LINEAR, 0.0f,
+        static_cast<float>(texture.mipLevels), 0.0f,
+        device.enabledFeatures.samplerAnisotropy,
+        device.enabledFeatures.samplerAnisotropy
+            ? device.properties.limits.maxSamplerAnisotropy
+            : 1.0f,
+        VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE));
+    VK_CHECK_RESULT(CreateImageView(device, texture.view, texture.image,
+                                    VK_IMAGE_VIEW_TYPE_2D, pending.format,
+                                    VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                    texture.mipLevels));
+
+    texture.descriptor.sampler = texture.sampler;
+    texture.descriptor.imageView = texture.view;
+    texture.descriptor.imageLayout = pending.request->imageLayout;
+  }
+  return ok;
+}
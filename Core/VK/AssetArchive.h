@@ -0,0 +1,66 @@
+/**
+ * @brief アーカイブからステージングメモリへ直接読み込むアセットローダ
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "IO/Archive.h"
+#include "IO/AsyncFileReader.h"
+#include "VK/Buffer.h"
+
+struct Device;
+struct Texture2D;
+
+struct AssetArchiveTextureRequest {
+  std::string name{};
+  /** @brief 書き換え先のテクスチャ(解放は呼び出し側で行います) */
+  Texture2D *texture = nullptr;
+  /** @brief 非圧縮のKTXに使用するフォーマット(BC圧縮なら自動で選択します) */
+  VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+  VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+};
+
+/**
+ * @brief
+ * アーカイブのブロブを永続的にマップしたステージングバッファへ非同期に読み込み、そのままイメージへ転送します。
+ * @note
+ * 非圧縮のブロブは中間バッファを経由しません。LZ4圧縮されたブロブは作業領域に読み込んでからステージングへ展開します。<br>
+ * ステージングに収まる分ずつまとめて読み込み、1回のコマンドバッファで転送します。
+ */
+struct AssetArchive {
+  /**
+   * @param stagingSize ステージングバッファのサイズ(1回の読み込みの上限)
+   */
+  bool Setup(const Device &device, const std::string &filepath,
+             VkDeviceSize stagingSize = 64ull * 1024 * 1024);
+  void Destroy(const Device &device);
+
+  [[nodiscard]] bool Contains(const std::string &name) const;
+
+  /**
+   * @brief KTXテクスチャをまとめて読み込みます。
+   * @return 全てのテクスチャを読み込めたらtrue(失敗したテクスチャは書き換えません)
+   */
+  bool LoadTextures(const Device &device, VkQueue copyQueue,
+                    const std::vector<AssetArchiveTextureRequest> &requests);
+
+  ArchiveReader reader{};
+  AsyncFileReader fileReader{};
+  /** @brief 永続的にマップしたステージングバッファ */
+  Buffer staging{};
+  VkDeviceSize stagingSize = 0;
+  /** @brief LZ4圧縮されたブロブの読み込み先 */
+  std::vector<std::byte> scratch{};
+
+private:
+  struct PendingTexture;
+
+  bool LoadBatch(const Device &device, VkQueue copyQueue,
+                 std::vector<PendingTexture> &batch);
+};
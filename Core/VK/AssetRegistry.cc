@@ -0,0 +1,133 @@
+/**
+ * @brief パスとインポート設定で重複を除く、参照カウント付きアセットレジストリ
+ */
+
+#include "VK/AssetRegistry.h"
+
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include "VK/Device.h"
+
+namespace {
+std::string NormalizePath(const std::string &filepath) {
+  return std::filesystem::path(filepath).lexically_normal().generic_string();
+}
+
+/**
+ * @brief 頂点データに影響する全ての設定をキーへ含めます。
+ */
+std::string MakeModelKey(const std::string &filepath,
+                         const VertexLayout &vertexLayout,
+                         const ModelCreateInfo &createInfo) {
+  std::ostringstream key;
+  key << NormalizePath(filepath) << "|layout:";
+  for (const auto &component : vertexLayout.components) {
+    key << static_cast<int>(component) << ",";
+  }
+  key << "|center:" << createInfo.center.x << "," << createInfo.center.y << ","
+      << createInfo.center.z;
+  key << "|scale:" << createInfo.scale.x << "," << createInfo.scale.y << ","
+      << createInfo.scale.z;
+  key << "|uv:" << createInfo.uvscale.x << "," << createInfo.uvscale.y;
+  if (createInfo.color) {
+    key << "|color:" << createInfo.color->r << "," << createInfo.color->g << ","
+        << createInfo.color->b;
+  }
+  key << "|mem:" << createInfo.memoryPropertyFlags;
+  const auto &lod = createInfo.lod;
+  key << "|lod:" << lod.levels << "," << lod.reduction << "," << lod.maxError
+      << "," << lod.lockBorder << "," << lod.normalWeight << "," << lod.uvWeight
+      << "," << lod.colorWeight;
+  key << "|meshlets:" << createInfo.buildMeshlets;
+  key << "|occluder:" << createInfo.buildOccluder;
+  key << "|positions:" << createInfo.buildPositions;
+  return key.str();
+}
+
+std::string MakeTextureKey(const std::string &filepath, VkFormat format,
+                           VkImageUsageFlags imageUsageFlags,
+                           VkImageLayout imageLayout, bool generateMips) {
+  std::ostringstream key;
+  key << NormalizePath(filepath) << "|format:" << format
+      << "|usage:" << imageUsageFlags << "|layout:" << imageLayout
+      << "|mips:" << generateMips;
+  return key.str();
+}
+} // namespace
+
+ModelHandle AssetRegistry::LoadModel(const Device &device,
+                                     const std::string &filepath,
+                                     VkQueue copyQueue,
+                                     const VertexLayout &vertexLayout,
+                                     const ModelCreateInfo &modelCreateInfo) {
+  const std::string key = MakeModelKey(filepath, vertexLayout, modelCreateInfo);
+  if (const auto it = models.find(key); it != models.end()) {
+    return it->second;
+  }
+
+  auto model = std::make_shared<Model>();
+  if (!model->LoadFromFile(device, filepath, copyQueue, vertexLayout,
+                           modelCreateInfo)) {
+    return nullptr;
+  }
+  models.emplace(key, model);
+  return model;
+}
+
+TextureHandle AssetRegistry::LoadTexture(const Device &device,
+                                         const std::string &filepath,
+                                         VkQueue copyQueue, VkFormat format,
+                                         VkImageUsageFlags imageUsageFlags,
+                                         VkImageLayout imageLayout,
+                                         bool generateMips) {
+  const std::string key = MakeTextureKey(filepath, format, imageUsageFlags,
+                                         imageLayout, generateMips);
+  if (const auto it = textures.find(key); it != textures.end()) {
+    return it->second;
+  }
+
+  auto texture = std::make_shared<Texture2D>();
+  texture->Load(device, filepath, copyQueue, format, imageUsageFlags,
+                imageLayout, true, generateMips);
+  if (texture->image == VK_NULL_HANDLE) {
+    return nullptr;
+  }
+  textures.emplace(key, texture);
+  return texture;
+}
+
+size_t AssetRegistry::Collect(const Device &device) {
+  size_t count = 0;
+  for (auto it = models.begin(); it != models.end();) {
+    if (it->second.use_count() == 1) {
+      it->second->Destroy(device);
+      it = models.erase(it);
+      count++;
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = textures.begin(); it != textures.end();) {
+    if (it->second.use_count() == 1) {
+      it->second->Destroy(device);
+      it = textures.erase(it);
+      count++;
+    } else {
+      ++it;
+    }
+  }
+  return count;
+}
+
+void AssetRegistry::Destroy(const Device &device) {
+  for (auto &[key, model] : models) {
+    model->Destroy(device);
+  }
+  models.clear();
+  for (auto &[key, texture] : textures) {
+    texture->Destroy(device);
+  }
+  textures.clear();
+}
@@ -0,0 +1,56 @@
+/**
+ * @brief パスとインポート設定で重複を除く、参照カウント付きアセットレジストリ
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "VK/Model.h"
+#include "VK/Texture.h"
+
+struct Device;
+
+using ModelHandle = std::shared_ptr<const Model>;
+using TextureHandle = std::shared_ptr<const Texture2D>;
+
+/**
+ * @brief
+ * 同じファイルを同じ設定で読み込む要求に対して、GPU上の1つのコピーを共有するハンドルを返します。
+ * @note
+ * 拡大縮小や中心、UVの繰り返しは頂点に焼き込まず、インスタンスごとの変換として与えてください。<br>
+ * GPUリソースの解放にはDeviceが必要なため、ハンドルが破棄されても即座には解放しません。
+ * Collectで未使用のアセットを解放し、終了時にDestroyで全てを解放します。
+ */
+struct AssetRegistry {
+  ModelHandle LoadModel(const Device &device, const std::string &filepath,
+                        VkQueue copyQueue, const VertexLayout &vertexLayout,
+                        const ModelCreateInfo &modelCreateInfo = {});
+
+  TextureHandle
+  LoadTexture(const Device &device, const std::string &filepath,
+              VkQueue copyQueue, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM,
+              VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+              VkImageLayout imageLayout =
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              bool generateMips = false);
+
+  /**
+   * @brief レジストリ以外から参照されていないアセットを解放します。
+   * @note GPUがアセットを使用していない時に呼び出してください。
+   * @return 解放したアセットの数
+   */
+  size_t Collect(const Device &device);
+  void Destroy(const Device &device);
+
+  [[nodiscard]] size_t GetModelCount() const { return models.size(); }
+  [[nodiscard]] size_t GetTextureCount() const { return textures.size(); }
+
+  /** @brief 正規化したパスとインポート設定から作ったキー */
+  std::unordered_map<std::string, std::shared_ptr<Model>> models{};
+  std::unordered_map<std::string, std::shared_ptr<Texture2D>> textures{};
+};
@@ -0,0 +1,310 @@
+/**
+ * @brief 深度と法線をレイヤーに分けて計算するSSAO
+ */
+
+#include "VK/DeinterleavedSSAO.h"
+
+#include <vector>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define DEINTERLEAVE_COMPUTE_SHADER_PATH                                       \
+  "./Assets/Shaders/GLSL/SPIR-V/PostProcess/Deinterleave.cs.spv"
+#define DEINTERLEAVED_SSAO_COMPUTE_SHADER_PATH                                 \
+  "./Assets/Shaders/GLSL/SPIR-V/PostProcess/DeinterleavedSSAO.cs.spv"
+#define REINTERLEAVE_COMPUTE_SHADER_PATH                                       \
+  "./Assets/Shaders/GLSL/SPIR-V/PostProcess/Reinterleave.cs.spv"
+
+void DeinterleavedSSAO::Setup(const Device &device, uint32_t width,
+                              uint32_t height, uint32_t kernelSize,
+                              VkQueue copyQueue,
+                              VkPipelineCache pipelineCache) {
+  this->width = width;
+  this->height = height;
+  layerWidth = (width + kLayerDim - 1) / kLayerDim;
+  layerHeight = (height + kLayerDim - 1) / kLayerDim;
+
+  SetupImages(device, copyQueue);
+  SetupDescriptorSets(device);
+  SetupPipelines(device, kernelSize, pipelineCache);
+}
+
+void DeinterleavedSSAO::Destroy(const Device &device) const {
+  for (uint32_t pass = 0; pass < kPassCount; pass++) {
+    vkDestroyPipeline(device, pipelines[pass], nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayouts[pass], nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayouts[pass], nullptr);
+  }
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroySampler(device, layerSampler, nullptr);
+  for (const Layers *layers : {&aoLayers, &normalLayers, &depthLayers}) {
+    vkDestroyImageView(device, layers->view, nullptr);
+    vkDestroyImage(device, layers->image, nullptr);
+    vkFreeMemory(device, layers->memory, nullptr);
+  }
+  vkDestroySampler(device, sampler, nullptr);
+  vkDestroyImageView(device, view, nullptr);
+  vkDestroyImage(device, image, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void DeinterleavedSSAO::SetSource(const Device &device,
+                                  const VkDescriptorImageInfo &depth,
+                                  const VkDescriptorImageInfo &normal,
+                                  const VkDescriptorImageInfo &noise,
+                                  const VkDescriptorBufferInfo &params) {
+  constexpr VkDescriptorType sampled =
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  const std::array<VkWriteDescriptorSet, 4> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSets[kDeinterleave], sampled,
+                                      0, &depth),
+      Initializer::WriteDescriptorSet(descriptorSets[kDeinterleave], sampled,
+                                      1, &normal),
+      Initializer::WriteDescriptorSet(descriptorSets[kSSAO], sampled, 2,
+                                      &noise),
+      Initializer::WriteDescriptorSet(descriptorSets[kSSAO],
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3,
+                                      &params),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void DeinterleavedSSAO::Dispatch(VkCommandBuffer commandBuffer) const {
+  // 入力の書き込みと、前回の結果の読み込みが終わってから書き込みます。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  const PushConstants pushConstants{
+      {static_cast<int32_t>(width), static_cast<int32_t>(height)},
+  };
+  // 分割はレイヤーの端数を埋めるため、レイヤー全体を覆うように並べます。
+  const std::array<VkExtent3D, kPassCount> groups = {{
+      {(layerWidth * kLayerDim + kWorkGroupSize - 1) / kWorkGroupSize,
+       (layerHeight * kLayerDim + kWorkGroupSize - 1) / kWorkGroupSize, 1},
+      {(layerWidth + kWorkGroupSize - 1) / kWorkGroupSize,
+       (layerHeight + kWorkGroupSize - 1) / kWorkGroupSize, kLayerCount},
+      {(width + kWorkGroupSize - 1) / kWorkGroupSize,
+       (height + kWorkGroupSize - 1) / kWorkGroupSize, 1},
+  }};
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  for (uint32_t pass = 0; pass < kPassCount; pass++) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      pipelines[pass]);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayouts[pass], 0, 1, &descriptorSets[pass],
+                            0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayouts[pass],
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, groups[pass].width, groups[pass].height,
+                  groups[pass].depth);
+
+    // 次のパスと、結果を参照するフラグメントシェーダが読みます。
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void DeinterleavedSSAO::SetupImages(const Device &device, VkQueue copyQueue) {
+  VK_CHECK_RESULT(CreateImage(
+      device, image, memory, kFormat, VK_IMAGE_TYPE_2D, width, height, 1, 1, 1,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_IMAGE_TILING_OPTIMAL));
+  VK_CHECK_RESULT(CreateImageView(device, view, image, VK_IMAGE_VIEW_TYPE_2D,
+                                  kFormat, VK_IMAGE_ASPECT_COLOR_BIT));
+  VK_CHECK_RESULT(CreateSampler(
+      device, sampler, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST));
+  descriptor = Initializer::DescriptorImageInfo(sampler, view,
+                                                VK_IMAGE_LAYOUT_GENERAL);
+
+  depthLayers.format = VK_FORMAT_R32_SFLOAT;
+  normalLayers.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+  aoLayers.format = VK_FORMAT_R32_SFLOAT;
+  for (Layers *layers : {&depthLayers, &normalLayers, &aoLayers}) {
+    VK_CHECK_RESULT(CreateImage(
+        device, layers->image, layers->memory, layers->format,
+        VK_IMAGE_TYPE_2D, layerWidth, layerHeight, 1, 1, kLayerCount,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_TILING_OPTIMAL));
+    VK_CHECK_RESULT(CreateImageView(
+        device, layers->view, layers->image, VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        layers->format, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, kLayerCount));
+  }
+  VK_CHECK_RESULT(CreateSampler(
+      device, layerSampler, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST));
+
+  // 読み書きのどちらにも使うため、イメージはGENERALのまま使用します。
+  VkCommandBuffer commandBuffer =
+      device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+  TransitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+  for (const Layers *layers : {&depthLayers, &normalLayers, &aoLayers}) {
+    TransitionImageLayout(commandBuffer, layers->image,
+                          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, kLayerCount},
+                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+  }
+  device.FlushCommandBuffer(commandBuffer, copyQueue);
+}
+
+void DeinterleavedSSAO::SetupDescriptorSets(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      6),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, kPassCount);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  constexpr VkDescriptorType sampled =
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  constexpr VkDescriptorType storage = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  constexpr VkShaderStageFlags stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  const std::array<std::vector<VkDescriptorSetLayoutBinding>, kPassCount>
+      setLayoutBindings = {{
+          // 0: 深度, 1: 法線, 2: 深度のレイヤー, 3: 法線のレイヤー
+          {
+              Initializer::DescriptorSetLayoutBinding(sampled, stage, 0),
+              Initializer::DescriptorSetLayoutBinding(sampled, stage, 1),
+              Initializer::DescriptorSetLayoutBinding(storage, stage, 2),
+              Initializer::DescriptorSetLayoutBinding(storage, stage, 3),
+          },
+          // 0: 深度のレイヤー, 1: 法線のレイヤー, 2: 回転ノイズ,
+          // 3: カーネルのパラメータ, 4: AOのレイヤー
+          {
+              Initializer::DescriptorSetLayoutBinding(sampled, stage, 0),
+              Initializer::DescriptorSetLayoutBinding(sampled, stage, 1),
+              Initializer::DescriptorSetLayoutBinding(sampled, stage, 2),
+              Initializer::DescriptorSetLayoutBinding(
+                  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stage, 3),
+              Initializer::DescriptorSetLayoutBinding(storage, stage, 4),
+          },
+          // 0: AOのレイヤー, 1: 出力
+          {
+              Initializer::DescriptorSetLayoutBinding(sampled, stage, 0),
+              Initializer::DescriptorSetLayoutBinding(storage, stage, 1),
+          },
+      }};
+  for (uint32_t pass = 0; pass < kPassCount; pass++) {
+    const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+        Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings[pass]);
+    VK_CHECK_RESULT(
+        vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                    nullptr, &descriptorSetLayouts[pass]));
+  }
+
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                             descriptorSetLayouts.data(),
+                                             kPassCount);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           descriptorSets.data()));
+
+  // 入力はSetSourceで設定します。
+  const auto layerInfo = [this](const Layers &layers, VkSampler sampler) {
+    return Initializer::DescriptorImageInfo(sampler, layers.view,
+                                            VK_IMAGE_LAYOUT_GENERAL);
+  };
+  const VkDescriptorImageInfo depthStorage =
+      layerInfo(depthLayers, VK_NULL_HANDLE);
+  const VkDescriptorImageInfo normalStorage =
+      layerInfo(normalLayers, VK_NULL_HANDLE);
+  const VkDescriptorImageInfo aoStorage = layerInfo(aoLayers, VK_NULL_HANDLE);
+  const VkDescriptorImageInfo depthSampled =
+      layerInfo(depthLayers, layerSampler);
+  const VkDescriptorImageInfo normalSampled =
+      layerInfo(normalLayers, layerSampler);
+  const VkDescriptorImageInfo aoSampled = layerInfo(aoLayers, layerSampler);
+  const VkDescriptorImageInfo outputStorage = Initializer::DescriptorImageInfo(
+      VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+  const std::array<VkWriteDescriptorSet, 7> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSets[kDeinterleave], storage,
+                                      2, &depthStorage),
+      Initializer::WriteDescriptorSet(descriptorSets[kDeinterleave], storage,
+                                      3, &normalStorage),
+      Initializer::WriteDescriptorSet(descriptorSets[kSSAO], sampled, 0,
+                                      &depthSampled),
+      Initializer::WriteDescriptorSet(descriptorSets[kSSAO], sampled, 1,
+                                      &normalSampled),
+      Initializer::WriteDescriptorSet(descriptorSets[kSSAO], storage, 4,
+                                      &aoStorage),
+      Initializer::WriteDescriptorSet(descriptorSets[kReinterleave], sampled,
+                                      0, &aoSampled),
+      Initializer::WriteDescriptorSet(descriptorSets[kReinterleave], storage,
+                                      1, &outputStorage),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void DeinterleavedSSAO::SetupPipelines(const Device &device,
+                                       uint32_t kernelSize,
+                                       VkPipelineCache pipelineCache) {
+  const std::array<const char *, kPassCount> shaderPaths = {
+      DEINTERLEAVE_COMPUTE_SHADER_PATH,
+      DEINTERLEAVED_SSAO_COMPUTE_SHADER_PATH,
+      REINTERLEAVE_COMPUTE_SHADER_PATH,
+  };
+
+  // カーネルの要素数はSSAOのフラグメントシェーダと同じ特殊化定数で与えます。
+  const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+      Initializer::SpecializationMapEntry(0, 0, sizeof(uint32_t)),
+  };
+  VkSpecializationInfo specializationInfo = Initializer::SpecializationInfo(
+      specializationMapEntries, sizeof(uint32_t), &kernelSize);
+
+  const VkPushConstantRange pushConstantRange = Initializer::PushConstantRange(
+      VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+  for (uint32_t pass = 0; pass < kPassCount; pass++) {
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+        Initializer::PipelineLayoutCreateInfo(&descriptorSetLayouts[pass]);
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                           nullptr, &pipelineLayouts[pass]));
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo =
+        Initializer::ComputePipelineCreateInfo(pipelineLayouts[pass]);
+    computePipelineCreateInfo.stage =
+        CreateShader(device, shaderPaths[pass], VK_SHADER_STAGE_COMPUTE_BIT,
+                     pass == kSSAO ? &specializationInfo : nullptr);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                             &computePipelineCreateInfo,
+                                             nullptr, &pipelines[pass]));
+    vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                          nullptr);
+  }
+}
@@ -0,0 +1,103 @@
+/**
+ * @brief 深度と法線をレイヤーに分けて計算するSSAO
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+
+struct Device;
+
+/**
+ * @brief
+ * 深度と法線を4x4ピクセルごとに16枚の縮小したレイヤー(テクスチャ配列)へ分け、
+ * レイヤーごとにSSAOを計算してから元の並びに戻します。
+ * @note
+ * 1つのレイヤーの中だけでサンプリングするため、半径が大きくても近いピクセルが近いテクセルを読み、
+ * テクスチャキャッシュの効率が落ちにくくなります。<br>
+ * レイヤー内のピクセルはすべて回転ノイズ(4x4)の同じテクセルに当たるため、
+ * 回転ベクトルはレイヤーごとの定数になります。<br>
+ * カーネルのパラメータはSSAOのフラグメントシェーダと同じユニフォームを参照します。
+ * 出力はkFormatで、VK_IMAGE_LAYOUT_GENERALのままdescriptorを渡して読み込んでください。
+ */
+struct DeinterleavedSSAO {
+  /** @brief レイヤーに分けるブロックの1辺(ピクセル) */
+  static constexpr uint32_t kLayerDim = 4;
+  static constexpr uint32_t kLayerCount = kLayerDim * kLayerDim;
+  /** @brief シェーダのlocal_sizeと一致させます。 */
+  static constexpr uint32_t kWorkGroupSize = 8;
+  static constexpr VkFormat kFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+  /** @param kernelSize SSAOのユニフォームのカーネルの要素数 */
+  void Setup(const Device &device, uint32_t width, uint32_t height,
+             uint32_t kernelSize, VkQueue copyQueue,
+             VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief 入力を設定します。深度と法線は出力と同じ大きさにしてください。
+   * @param noise 回転ノイズ(kLayerDim x kLayerDim)
+   * @param params SSAOのカーネルのユニフォーム
+   */
+  void SetSource(const Device &device, const VkDescriptorImageInfo &depth,
+                 const VkDescriptorImageInfo &normal,
+                 const VkDescriptorImageInfo &noise,
+                 const VkDescriptorBufferInfo &params);
+
+  /**
+   * @brief 分割、レイヤーごとのSSAO、再結合を記録します。レンダーパスの外で呼び出してください。
+   * @note 結果はフラグメントシェーダとコンピュートシェーダから読めます。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer) const;
+
+  /** @brief 元の並びに戻したAO */
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkDescriptorImageInfo descriptor{};
+
+  /** @brief レイヤーに分けた深度(R32)、法線(RGBA16F、rgだけを使用)、AO(R32) */
+  struct Layers {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+  };
+  Layers depthLayers{};
+  Layers normalLayers{};
+  Layers aoLayers{};
+  /** @brief レイヤーはテクセルをそのまま読みます。 */
+  VkSampler layerSampler = VK_NULL_HANDLE;
+
+  enum Pass : uint32_t {
+    kDeinterleave,
+    kSSAO,
+    kReinterleave,
+    kPassCount,
+  };
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  std::array<VkDescriptorSetLayout, kPassCount> descriptorSetLayouts{};
+  std::array<VkDescriptorSet, kPassCount> descriptorSets{};
+  std::array<VkPipelineLayout, kPassCount> pipelineLayouts{};
+  std::array<VkPipeline, kPassCount> pipelines{};
+
+  struct PushConstants {
+    /** @brief 元の並びの大きさ */
+    alignas(8) int32_t size[2];
+  };
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  /** @brief 端数のピクセルも含むよう切り上げたレイヤーの大きさ */
+  uint32_t layerWidth = 0;
+  uint32_t layerHeight = 0;
+
+private:
+  void SetupImages(const Device &device, VkQueue copyQueue);
+  void SetupDescriptorSets(const Device &device);
+  void SetupPipelines(const Device &device, uint32_t kernelSize,
+                      VkPipelineCache pipelineCache);
+};
@@ -0,0 +1,248 @@
+/**
+ * @brief コンピュートシェーダによる階層深度(Hi-Z)ピラミッドの生成
+ */
+
+#include "VK/DepthPyramid.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Framebuffer.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define DEPTH_PYRAMID_COMPUTE_SHADER_PATH                                      \
+  "./Assets/Shaders/GLSL/SPIR-V/Culling/DepthPyramid.cs.spv"
+
+/** @brief シェーダのlocal_sizeと一致させます。 */
+static constexpr uint32_t kWorkGroupSize = 8;
+
+void DepthPyramid::Setup(const Device &device,
+                         const FramebufferAttachment &depth, uint32_t width,
+                         uint32_t height, VkQueue copyQueue,
+                         VkPipelineCache pipelineCache) {
+  BOOST_ASSERT_MSG(depth.HasDepth(), "Attachment has no depth component!");
+
+  this->width = width;
+  this->height = height;
+  levels = static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+
+  SetupImage(device, depth, copyQueue);
+  SetupDescriptorSets(device);
+  SetupPipeline(device, pipelineCache);
+}
+
+void DepthPyramid::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroyImageView(device, depthView, nullptr);
+  vkDestroySampler(device, sampler, nullptr);
+  for (const auto levelView : levelViews) {
+    vkDestroyImageView(device, levelView, nullptr);
+  }
+  vkDestroyImageView(device, view, nullptr);
+  vkDestroyImage(device, image, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void DepthPyramid::Build(VkCommandBuffer commandBuffer) const {
+  // 深度の書き込みが終わってからコンピュートシェーダで読み込みます。
+  VkImageMemoryBarrier depthBarrier = Initializer::ImageMemoryBarrier();
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.image = depthImage;
+  depthBarrier.subresourceRange = {depthAspectMask, 0, 1, 0, 1};
+  // 前回のピラミッドを読むカリングが終わってから上書きします。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 1, &depthBarrier);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  uint32_t srcWidth = width;
+  uint32_t srcHeight = height;
+  for (uint32_t level = 0; level < levels; level++) {
+    const uint32_t dstWidth = level == 0 ? width : std::max(srcWidth / 2, 1u);
+    const uint32_t dstHeight =
+        level == 0 ? height : std::max(srcHeight / 2, 1u);
+    const PushConstants pushConstants{
+        {static_cast<int32_t>(srcWidth), static_cast<int32_t>(srcHeight)},
+        {static_cast<int32_t>(dstWidth), static_cast<int32_t>(dstHeight)},
+    };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descriptorSets[level], 0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer,
+                  (dstWidth + kWorkGroupSize - 1) / kWorkGroupSize,
+                  (dstHeight + kWorkGroupSize - 1) / kWorkGroupSize, 1);
+
+    // 次のレベルと、ピラミッドを参照するカリングが書き込み結果を読みます。
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &memoryBarrier, 0, nullptr, 0, nullptr);
+    srcWidth = dstWidth;
+    srcHeight = dstHeight;
+  }
+
+  // 続くレンダーパスで再び深度アタッチメントとして使用します。
+  depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void DepthPyramid::SetupImage(const Device &device,
+                              const FramebufferAttachment &depth,
+                              VkQueue copyQueue) {
+  VK_CHECK_RESULT(CreateImage(
+      device, image, memory, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TYPE_2D, width,
+      height, 1, levels, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+          VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      VK_IMAGE_TILING_OPTIMAL));
+  VK_CHECK_RESULT(CreateImageView(device, view, image, VK_IMAGE_VIEW_TYPE_2D,
+                                  VK_FORMAT_R32_SFLOAT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, 0, levels));
+  levelViews.resize(levels);
+  for (uint32_t level = 0; level < levels; level++) {
+    VK_CHECK_RESULT(CreateImageView(
+        device, levelViews[level], image, VK_IMAGE_VIEW_TYPE_2D,
+        VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+  }
+  VK_CHECK_RESULT(CreateSampler(
+      device, sampler, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      0.0f, static_cast<float>(levels)));
+  descriptor = Initializer::DescriptorImageInfo(sampler, view,
+                                                VK_IMAGE_LAYOUT_GENERAL);
+
+  // サンプリング用のビューは深度アスペクトだけを含める必要があります。
+  depthImage = depth.image;
+  depthAspectMask = depth.subresourceRange.aspectMask;
+  VK_CHECK_RESULT(CreateImageView(device, depthView, depth.image,
+                                  VK_IMAGE_VIEW_TYPE_2D, depth.format,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT));
+
+  // 最初のフレームでは何も遮蔽しないよう、遠方の深度で埋めておきます。
+  const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels,
+                                         0, 1};
+  VkCommandBuffer commandBuffer =
+      device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+  TransitionImageLayout(commandBuffer, image, range, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_GENERAL);
+  const VkClearColorValue farDepth = {{1.0f, 1.0f, 1.0f, 1.0f}};
+  vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL,
+                       &farDepth, 1, &range);
+  device.FlushCommandBuffer(commandBuffer, copyQueue);
+}
+
+void DepthPyramid::SetupDescriptorSets(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      levels),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levels),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, levels);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+      // Binding 0: 入力(深度または前のレベル)
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      // Binding 1: 出力レベル
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                              VK_SHADER_STAGE_COMPUTE_BIT, 1),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const std::vector<VkDescriptorSetLayout> setLayouts(levels,
+                                                      descriptorSetLayout);
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool, setLayouts.data(),
+                                             levels);
+  descriptorSets.resize(levels);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           descriptorSets.data()));
+
+  for (uint32_t level = 0; level < levels; level++) {
+    VkDescriptorImageInfo srcInfo =
+        level == 0 ? Initializer::DescriptorImageInfo(
+                         sampler, depthView,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+                   : Initializer::DescriptorImageInfo(
+                         sampler, levelViews[level - 1],
+                         VK_IMAGE_LAYOUT_GENERAL);
+    VkDescriptorImageInfo dstInfo = Initializer::DescriptorImageInfo(
+        VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+    const std::array<VkWriteDescriptorSet, 2> writeDescriptorSets = {
+        Initializer::WriteDescriptorSet(
+            descriptorSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            0, &srcInfo),
+        Initializer::WriteDescriptorSet(descriptorSets[level],
+                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                        &dstInfo),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writeDescriptorSets.size()),
+                           writeDescriptorSets.data(), 0, nullptr);
+  }
+}
+
+void DepthPyramid::SetupPipeline(const Device &device,
+                                 VkPipelineCache pipelineCache) {
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  const VkPushConstantRange pushConstantRange = Initializer::PushConstantRange(
+      VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo =
+      Initializer::ComputePipelineCreateInfo(pipelineLayout);
+  computePipelineCreateInfo.stage =
+      CreateShader(device, DEPTH_PYRAMID_COMPUTE_SHADER_PATH,
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                           &computePipelineCreateInfo, nullptr,
+                                           &pipeline));
+  vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
@@ -0,0 +1,73 @@
+/**
+ * @brief コンピュートシェーダによる階層深度(Hi-Z)ピラミッドの生成
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+struct Device;
+struct FramebufferAttachment;
+
+/**
+ * @brief
+ * 深度アタッチメントから、各テクセルが覆う範囲の最大深度を格納したミップチェーンを生成します。
+ * @note
+ * レベル0は深度アタッチメントと同じ解像度で、以降は1/2ずつ(切り捨て)縮小します。
+ * 奇数幅のレベルでは端のテクセルも含めて縮小するため、判定は常に保守的です。<br>
+ * 深度アタッチメントはVK_IMAGE_USAGE_SAMPLED_BITで作成し、サンプリング可能な形式である必要があります。<br>
+ * ピラミッドはVK_IMAGE_LAYOUT_GENERALのまま、MeshletCuller::SetDepthPyramidや
+ * InstanceCuller::SetDepthPyramidへdescriptorを渡して使用します。
+ */
+struct DepthPyramid {
+  void Setup(const Device &device, const FramebufferAttachment &depth,
+             uint32_t width, uint32_t height, VkQueue copyQueue,
+             VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief
+   * 深度アタッチメントからピラミッドを生成します。レンダーパスの外で呼び出してください。
+   * @note
+   * 深度アタッチメントはVK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMALで渡し、同じレイアウトに戻します。
+   */
+  void Build(VkCommandBuffer commandBuffer) const;
+
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  /** @brief 全ミップレベルのビュー(サンプリング用) */
+  VkImageView view = VK_NULL_HANDLE;
+  /** @brief ミップレベルごとのビュー(書き込み用) */
+  std::vector<VkImageView> levelViews{};
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkDescriptorImageInfo descriptor{};
+
+  /** @brief 深度アタッチメントの深度アスペクトだけのビュー */
+  VkImageView depthView = VK_NULL_HANDLE;
+  VkImage depthImage = VK_NULL_HANDLE;
+  VkImageAspectFlags depthAspectMask = 0;
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  /** @brief レベルごとの記述子セット(前のレベルを読み、このレベルへ書きます) */
+  std::vector<VkDescriptorSet> descriptorSets{};
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  struct PushConstants {
+    alignas(8) int32_t srcSize[2];
+    alignas(8) int32_t dstSize[2];
+  };
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t levels = 0;
+
+private:
+  void SetupImage(const Device &device, const FramebufferAttachment &depth,
+                  VkQueue copyQueue);
+  void SetupDescriptorSets(const Device &device);
+  void SetupPipeline(const Device &device, VkPipelineCache pipelineCache);
+};
@@ -0,0 +1,176 @@
+/**
+ * @brief ソートキーで並べ替えてから記録する描画リスト
+ */
+
+#include "VK/DrawList.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "Utils/RadixSort.h"
+
+namespace {
+constexpr uint64_t Mask(uint32_t bits) { return (uint64_t{1} << bits) - 1; }
+
+/** @brief 登録した順にIDを振ります。登録済みなら既存のIDを返します。 */
+template <class K>
+uint32_t Register(std::map<K, uint32_t> &ids, const K &key) {
+  return ids.try_emplace(key, static_cast<uint32_t>(ids.size())).first->second;
+}
+
+/** @brief 登録したIDを返し、未登録かビット幅に収まらなければ最大値に丸めます。 */
+template <class K>
+uint64_t GetId(const std::map<K, uint32_t> &ids, const K &key, uint32_t bits) {
+  const auto it = ids.find(key);
+  if (it == ids.end()) {
+    return Mask(bits);
+  }
+  return std::min<uint64_t>(it->second, Mask(bits));
+}
+} // namespace
+
+void DrawList::Clear() {
+  items.clear();
+  keys.clear();
+  order.clear();
+  pushConstantRanges.clear();
+  pushConstantData.clear();
+}
+
+void DrawList::Reset() {
+  Clear();
+  pipelineIds.clear();
+  descriptorSetIds.clear();
+  meshIds.clear();
+}
+
+uint32_t DrawList::RegisterPipeline(VkPipeline pipeline) {
+  return Register(pipelineIds, pipeline);
+}
+
+uint32_t DrawList::RegisterDescriptorSet(VkDescriptorSet descriptorSet) {
+  return Register(descriptorSetIds, descriptorSet);
+}
+
+uint32_t DrawList::RegisterMesh(VkBuffer vertexBuffer, VkBuffer indexBuffer) {
+  return Register(meshIds, std::pair{vertexBuffer, indexBuffer});
+}
+
+void DrawList::SetDepthRange(float zNear, float zFar) {
+  BOOST_ASSERT_MSG(zNear < zFar, "Invalid depth range!");
+  this->zNear = zNear;
+  this->zFar = zFar;
+}
+
+void DrawList::Add(const DrawItem &item, const void *pushConstants,
+                   uint32_t pushConstantSize) {
+  BOOST_ASSERT_MSG(item.pass <= Mask(kPassBits), "Pass is out of range!");
+  BOOST_ASSERT_MSG(pushConstantSize == 0 || item.pushConstantStages != 0,
+                   "Push constant stages are not specified!");
+
+  const auto offset = static_cast<uint32_t>(pushConstantData.size());
+  if (pushConstantSize > 0) {
+    pushConstantData.resize(offset + pushConstantSize);
+    std::memcpy(pushConstantData.data() + offset, pushConstants,
+                pushConstantSize);
+  }
+  pushConstantRanges.emplace_back(offset, pushConstantSize);
+  keys.push_back(MakeKey(item));
+  items.push_back(item);
+}
+
+void DrawList::Sort() {
+  order.resize(items.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::vector<uint64_t> sortedKeys = keys;
+  RadixSort(sortedKeys, order);
+}
+
+DrawListStats DrawList::Record(VkCommandBuffer commandBuffer) const {
+  BOOST_ASSERT_MSG(order.size() == items.size(), "Call Sort before Record!");
+
+  DrawListStats stats{};
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  const VkDeviceSize offsets[] = {0};
+
+  for (const uint32_t index : order) {
+    const auto &item = items[index];
+    if (item.pipeline != pipeline) {
+      pipeline = item.pipeline;
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+      stats.pipelineBinds++;
+    }
+    // パイプラインレイアウトが変わると記述子セットの互換性が保証されません。
+    if (item.descriptorSet != descriptorSet ||
+        item.pipelineLayout != pipelineLayout) {
+      descriptorSet = item.descriptorSet;
+      pipelineLayout = item.pipelineLayout;
+      if (descriptorSet != VK_NULL_HANDLE) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                pipelineLayout, 0, 1, &descriptorSet, 0,
+                                nullptr);
+        stats.descriptorSetBinds++;
+      }
+    }
+    if (item.vertexBuffer != vertexBuffer) {
+      vertexBuffer = item.vertexBuffer;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+      stats.vertexBufferBinds++;
+    }
+    if (item.indexBuffer != indexBuffer) {
+      indexBuffer = item.indexBuffer;
+      vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0,
+                           VK_INDEX_TYPE_UINT32);
+      stats.indexBufferBinds++;
+    }
+
+    const auto [offset, size] = pushConstantRanges[index];
+    if (size > 0) {
+      vkCmdPushConstants(commandBuffer, item.pipelineLayout,
+                         item.pushConstantStages, 0, size,
+                         pushConstantData.data() + offset);
+    }
+    vkCmdDrawIndexed(commandBuffer, item.indexCount, item.instanceCount,
+                     item.firstIndex, item.vertexOffset, item.firstInstance);
+    stats.draws++;
+  }
+  return stats;
+}
+
+uint64_t DrawList::MakeKey(const DrawItem &item) const {
+  const uint64_t pass = item.pass & Mask(kPassBits);
+  const uint64_t pipeline = GetId(pipelineIds, item.pipeline, kPipelineBits);
+  const uint64_t descriptorSet =
+      GetId(descriptorSetIds, item.descriptorSet, kDescriptorSetBits);
+  const uint64_t mesh = GetId(
+      meshIds, std::pair{item.vertexBuffer, item.indexBuffer}, kMeshBits);
+
+  const float t =
+      std::clamp((item.depth - zNear) / (zFar - zNear), 0.0f, 1.0f);
+  uint64_t depth =
+      static_cast<uint64_t>(t * static_cast<float>(Mask(kDepthBits)));
+
+  uint64_t key = pass;
+  if (item.blended) {
+    // 奥から手前へ描くため、深度を反転して状態より上位に置きます。
+    depth = Mask(kDepthBits) - depth;
+    key = (key << kDepthBits) | depth;
+    key = (key << kPipelineBits) | pipeline;
+    key = (key << kDescriptorSetBits) | descriptorSet;
+    key = (key << kMeshBits) | mesh;
+  } else {
+    key = (key << kPipelineBits) | pipeline;
+    key = (key << kDescriptorSetBits) | descriptorSet;
+    key = (key << kMeshBits) | mesh;
+    key = (key << kDepthBits) | depth;
+  }
+  return key;
+}
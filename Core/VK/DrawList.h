@@ -0,0 +1,131 @@
+/**
+ * @brief ソートキーで並べ替えてから記録する描画リスト
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 描画リストに積む1回分の描画です。
+ * @note インデックスはVK_INDEX_TYPE_UINT32とします。
+ */
+struct DrawItem {
+  /** @brief パス番号(0から15、小さい順に記録します) */
+  uint32_t pass = 0;
+  /** @brief 半透明の描画は奥から手前へ並べます。 */
+  bool blended = false;
+  /** @brief カメラからの距離(ビュー空間の深度) */
+  float depth = 0.0f;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  /** @brief セット0にバインドする記述子セット(マテリアル) */
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+
+  uint32_t indexCount = 0;
+  uint32_t firstIndex = 0;
+  int32_t vertexOffset = 0;
+  uint32_t instanceCount = 1;
+  uint32_t firstInstance = 0;
+
+  /** @brief プッシュ定数を送るステージ(0なら送りません) */
+  VkShaderStageFlags pushConstantStages = 0;
+};
+
+/** @brief 記録時に発行したコマンドの数 */
+struct DrawListStats {
+  uint32_t pipelineBinds = 0;
+  uint32_t descriptorSetBinds = 0;
+  uint32_t vertexBufferBinds = 0;
+  uint32_t indexBufferBinds = 0;
+  uint32_t draws = 0;
+};
+
+/**
+ * @brief
+ * 描画ごとに64bitのソートキーを作り、基数ソートした順に記録します。
+ * 記録時は直前と同じパイプライン、記述子セット、頂点・インデックスバッファのバインドを省きます。
+ * @note
+ * 不透明: パス(4) | パイプライン(10) | 記述子セット(14) | メッシュ(14) | 深度(22)<br>
+ * 半透明: パス(4) | 反転した深度(22) | パイプライン(10) | 記述子セット(14) | メッシュ(14)<br>
+ * 不透明は状態ごとに手前から奥へ、半透明は状態より奥から手前の順を優先します。<br>
+ * パイプライン等のIDは登録した順に振り、Clearをまたいで保持するため、フレーム間でキューの順序が変わりません。
+ * 未登録の状態やビット幅を超えたIDは最大値に丸めるため、まとまりが悪くなるだけで描画結果は変わりません。
+ */
+struct DrawList {
+  static constexpr uint32_t kPassBits = 4;
+  static constexpr uint32_t kPipelineBits = 10;
+  static constexpr uint32_t kDescriptorSetBits = 14;
+  static constexpr uint32_t kMeshBits = 14;
+  static constexpr uint32_t kDepthBits = 22;
+  static_assert(kPassBits + kPipelineBits + kDescriptorSetBits + kMeshBits +
+                    kDepthBits ==
+                64);
+
+  /** @brief 描画を破棄します。登録したIDは保持します。 */
+  void Clear();
+  /** @brief 描画と登録したIDをすべて破棄します。 */
+  void Reset();
+
+  /**
+   * @brief パイプラインを登録し、ソートキーのIDを割り当てます。
+   * @return 割り当てたID(登録済みなら既存のID)
+   */
+  uint32_t RegisterPipeline(VkPipeline pipeline);
+  /** @brief 記述子セットを登録し、ソートキーのIDを割り当てます。 */
+  uint32_t RegisterDescriptorSet(VkDescriptorSet descriptorSet);
+  /** @brief 頂点・インデックスバッファの組を登録し、ソートキーのIDを割り当てます。 */
+  uint32_t RegisterMesh(VkBuffer vertexBuffer, VkBuffer indexBuffer);
+
+  /**
+   * @brief 深度を量子化する範囲を設定します。(通常はカメラのnearとfar)
+   */
+  void SetDepthRange(float zNear, float zFar);
+
+  /**
+   * @brief 描画を追加します。
+   * @param pushConstants オフセット0から送るプッシュ定数(コピーして保持します)
+   */
+  void Add(const DrawItem &item, const void *pushConstants = nullptr,
+           uint32_t pushConstantSize = 0);
+
+  /** @brief ソートキーの昇順に並べ替えます。 */
+  void Sort();
+
+  /**
+   * @brief 並べ替えた順に記録します。レンダーパスの中で呼び出してください。
+   */
+  DrawListStats Record(VkCommandBuffer commandBuffer) const;
+
+  [[nodiscard]] uint32_t Size() const {
+    return static_cast<uint32_t>(items.size());
+  }
+
+  std::vector<DrawItem> items{};
+  /** @brief itemsと同じ順のソートキー */
+  std::vector<uint64_t> keys{};
+  /** @brief 記録順に並んだitemsのインデックス */
+  std::vector<uint32_t> order{};
+
+private:
+  [[nodiscard]] uint64_t MakeKey(const DrawItem &item) const;
+
+  /** @brief itemsごとのプッシュ定数の範囲(pushConstantData内のオフセットとサイズ) */
+  std::vector<std::pair<uint32_t, uint32_t>> pushConstantRanges{};
+  std::vector<uint8_t> pushConstantData{};
+
+  std::map<VkPipeline, uint32_t> pipelineIds{};
+  std::map<VkDescriptorSet, uint32_t> descriptorSetIds{};
+  std::map<std::pair<VkBuffer, VkBuffer>, uint32_t> meshIds{};
+
+  float zNear = 0.0f;
+  float zFar = 1.0f;
+};
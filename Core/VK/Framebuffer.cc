@@ -15,6 +15,7 @@
 void Framebuffer::Destroy(const Device &device) const {
   vkDestroyFramebuffer(device, framebuffer, nullptr);
   vkDestroyRenderPass(device, renderPass, nullptr);
+  vkDestroyRenderPass(device, loadRenderPass, nullptr);
   vkDestroySampler(device, sampler, nullptr);
   for (const auto &attachment : attachments) {
     vkDestroyImageView(device, attachment.view, nullptr);
@@ -50,7 +51,7 @@ Framebuffer::AddAttachment(const Device &device,
       device, framebufferAttachment.image, framebufferAttachment.memory,
       attachmentCreateInfo.format, VK_IMAGE_TYPE_2D, attachmentCreateInfo.width,
       attachmentCreateInfo.height, 1, 1, attachmentCreateInfo.layerCount,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, attachmentCreateInfo.usage,
+      attachmentCreateInfo.memoryFlags, attachmentCreateInfo.usage,
       VK_IMAGE_TILING_OPTIMAL, attachmentCreateInfo.imageSampleCount));
 
   framebufferAttachment.subresourceRange = {};
@@ -103,9 +104,52 @@ VkResult Framebuffer::CreateSampler(const Device &device, VkFilter magFilter,
 }
 
 VkResult Framebuffer::CreateRenderPass(const Device &device) {
+  CreateRenderPass(device, false, renderPass);
+
+  std::vector<VkImageView> attachmentViews;
+  for (const auto &attachment : attachments) {
+    attachmentViews.emplace_back(attachment.view);
+  }
+
+  uint32_t maxLayers = 0;
+  for (const auto &attachment : attachments) {
+    if (attachment.subresourceRange.layerCount > maxLayers) {
+      maxLayers = attachment.subresourceRange.layerCount;
+    }
+  }
+
+  VkFramebufferCreateInfo framebufferCreateInfo =
+      Initializer::FramebufferCreateInfo();
+  framebufferCreateInfo.renderPass = renderPass;
+  framebufferCreateInfo.pAttachments = attachmentViews.data();
+  framebufferCreateInfo.attachmentCount =
+      static_cast<uint32_t>(attachmentViews.size());
+  framebufferCreateInfo.width = width;
+  framebufferCreateInfo.height = height;
+  framebufferCreateInfo.layers = maxLayers;
+  VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr,
+                                      &framebuffer));
+
+  return VK_SUCCESS;
+}
+
+VkResult Framebuffer::CreateLoadRenderPass(const Device &device) {
+  CreateRenderPass(device, true, loadRenderPass);
+  return VK_SUCCESS;
+}
+
+void Framebuffer::CreateRenderPass(const Device &device, bool load,
+                                   VkRenderPass &dst) const {
   std::vector<VkAttachmentDescription> attachmentDescriptions;
   for (const auto &attachment : attachments) {
     attachmentDescriptions.emplace_back(attachment.description);
+    // 前のレンダーパスの最終レイアウトのまま内容を引き継ぎます。
+    if (load) {
+      attachmentDescriptions.back().loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+      attachmentDescriptions.back().storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      attachmentDescriptions.back().initialLayout =
+          attachment.description.finalLayout;
+    }
   }
 
   std::vector<VkAttachmentReference> colorReferences;
@@ -152,6 +196,23 @@ VkResult Framebuffer::CreateRenderPass(const Device &device) {
   subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
                                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
   subpassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+  // 前のレンダーパスの書き込みが終わってから読み込み・書き込みを続けます。
+  if (load) {
+    subpassDependencies[0].srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpassDependencies[0].dstStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    subpassDependencies[0].srcAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[0].dstAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  }
 
   subpassDependencies[1].srcSubpass = 0;
   subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
@@ -175,31 +236,5 @@ VkResult Framebuffer::CreateRenderPass(const Device &device) {
       static_cast<uint32_t>(subpassDependencies.size());
   renderPassCreateInfo.pDependencies = subpassDependencies.data();
   VK_CHECK_RESULT(
-      vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass));
-
-  std::vector<VkImageView> attachmentViews;
-  for (const auto &attachment : attachments) {
-    attachmentViews.emplace_back(attachment.view);
-  }
-
-  uint32_t maxLayers = 0;
-  for (const auto &attachment : attachments) {
-    if (attachment.subresourceRange.layerCount > maxLayers) {
-      maxLayers = attachment.subresourceRange.layerCount;
-    }
-  }
-
-  VkFramebufferCreateInfo framebufferCreateInfo =
-      Initializer::FramebufferCreateInfo();
-  framebufferCreateInfo.renderPass = renderPass;
-  framebufferCreateInfo.pAttachments = attachmentViews.data();
-  framebufferCreateInfo.attachmentCount =
-      static_cast<uint32_t>(attachmentViews.size());
-  framebufferCreateInfo.width = width;
-  framebufferCreateInfo.height = height;
-  framebufferCreateInfo.layers = maxLayers;
-  VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr,
-                                      &framebuffer));
-
-  return VK_SUCCESS;
+      vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &dst));
 }
@@ -65,18 +65,32 @@ struct AttachmentCreateInfo {
   VkFormat format;
   VkImageUsageFlags usage;
   VkSampleCountFlagBits imageSampleCount = VK_SAMPLE_COUNT_1_BIT;
+  /** @brief レンダーパス内でしか使わないアタッチメントは遅延割り当てを指定できます。 */
+  VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 };
 
 struct Framebuffer {
   uint32_t AddAttachment(const Device& device, const AttachmentCreateInfo &attachmentCreateInfo);
   VkResult CreateSampler(const Device& device, VkFilter magFilter, VkFilter minFilter, VkSamplerAddressMode addressMode);
   VkResult CreateRenderPass(const Device& device);
+  /**
+   * @brief アタッチメントの内容を読み込んで描画を続けるレンダーパスを生成します。
+   * @note
+   * CreateRenderPassのレンダーパスで描画した後に使用します。フレームバッファとパイプラインはそのまま使えます。<br>
+   * 内容を残すため、深度アタッチメントもVK_IMAGE_USAGE_SAMPLED_BITで作成してください。
+   */
+  VkResult CreateLoadRenderPass(const Device &device);
   void Destroy(const Device &device) const;
 
   uint32_t width;
   uint32_t height;
   VkFramebuffer framebuffer = VK_NULL_HANDLE;
   VkRenderPass renderPass = VK_NULL_HANDLE;
+  VkRenderPass loadRenderPass = VK_NULL_HANDLE;
   VkSampler sampler = VK_NULL_HANDLE;
   std::vector<FramebufferAttachment> attachments{};
+
+private:
+  void CreateRenderPass(const Device &device, bool load,
+                        VkRenderPass &dst) const;
 };
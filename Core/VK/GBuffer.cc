@@ -0,0 +1,283 @@
+/**
+ * @brief 深度から位置を復元するコンパクトなG-Buffer
+ */
+
+#include "VK/GBuffer.h"
+
+#include <boost/assert.hpp>
+
+#include <array>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+/**
+ * @brief 法線に使うRG16のフォーマットを選択します。
+ * @note
+ * SNORMは[-1, 1]を均等に量子化できますが、カラーアタッチメントとしての対応は必須ではありません。
+ * 対応していない場合は、必須のSFLOATを使用します。
+ */
+static VkFormat FindNormalFormat(const Device &device) {
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(
+      device.physicalDevice, VK_FORMAT_R16G16_SNORM, &formatProperties);
+  constexpr VkFormatFeatureFlags features =
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  return (formatProperties.optimalTilingFeatures & features) == features
+             ? VK_FORMAT_R16G16_SNORM
+             : VK_FORMAT_R16G16_SFLOAT;
+}
+
+/**
+ * @brief 入力アタッチメントとして読む、ステンシルを持たない深度のフォーマットを選択します。
+ * @note D16_UNORMは深度アタッチメントとしての対応が必須です。
+ */
+static VkFormat FindInputDepthFormat(const Device &device) {
+  for (const VkFormat format :
+       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32}) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format,
+                                        &formatProperties);
+    if (formatProperties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return format;
+    }
+  }
+  return VK_FORMAT_D16_UNORM;
+}
+
+/**
+ * @brief 一時的なアタッチメントに使うメモリのプロパティを返します。
+ * @note
+ * タイルベースのGPUは遅延割り当てのメモリを持ち、実際のメモリを確保しません。
+ * 持たない場合は通常のデバイスメモリを使用します。
+ */
+static VkMemoryPropertyFlags FindTransientMemoryFlags(const Device &device) {
+  constexpr VkMemoryPropertyFlags lazy =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  for (uint32_t i = 0; i < device.memoryProperties.memoryTypeCount; i++) {
+    if ((device.memoryProperties.memoryTypes[i].propertyFlags & lazy) ==
+        lazy) {
+      return lazy;
+    }
+  }
+  return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+void GBuffer::Setup(const Device &device, uint32_t width, uint32_t height) {
+  // 位置を復元するため、深度もサンプリングできる形式にして内容を残します。
+  SetupAttachments(device, width, height, VK_IMAGE_USAGE_SAMPLED_BIT,
+                   device.FindSupportedDepthFormat(true),
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // 補間した法線や深度は意味を持たないため、最近傍でサンプリングします。
+  VK_CHECK_RESULT(framebuffer.CreateSampler(
+      device, VK_FILTER_NEAREST, VK_FILTER_NEAREST,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+
+  // フレームバッファ用のデフォルトのレンダーパスを生成します。
+  VK_CHECK_RESULT(framebuffer.CreateRenderPass(device));
+}
+
+void GBuffer::SetupTransient(const Device &device, uint32_t width,
+                             uint32_t height) {
+  SetupAttachments(device, width, height,
+                   VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                       VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                   FindInputDepthFormat(device),
+                   FindTransientMemoryFlags(device));
+}
+
+void GBuffer::SetupAttachments(const Device &device, uint32_t width,
+                               uint32_t height, VkImageUsageFlags readUsage,
+                               VkFormat depthFormat,
+                               VkMemoryPropertyFlags memoryFlags) {
+  framebuffer.width = width;
+  framebuffer.height = height;
+  normalFormat = FindNormalFormat(device);
+
+  AttachmentCreateInfo attachmentCreateInfo{};
+  attachmentCreateInfo.width = width;
+  attachmentCreateInfo.height = height;
+  attachmentCreateInfo.layerCount = 1;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | readUsage;
+  attachmentCreateInfo.memoryFlags = memoryFlags;
+
+  // NORMAL (Octahedral)
+  attachmentCreateInfo.format = normalFormat;
+  framebuffer.AddAttachment(device, attachmentCreateInfo);
+
+  // ALBEDO (Color + Material bits)
+  attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  framebuffer.AddAttachment(device, attachmentCreateInfo);
+
+  // Depth attachment
+  attachmentCreateInfo.usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | readUsage;
+  attachmentCreateInfo.format = depthFormat;
+  framebuffer.AddAttachment(device, attachmentCreateInfo);
+  BOOST_ASSERT(framebuffer.attachments.size() == kDepth + 1);
+
+  const FramebufferAttachment &depth = framebuffer.attachments[kDepth];
+  VK_CHECK_RESULT(CreateImageView(device, depthView, depth.image,
+                                  VK_IMAGE_VIEW_TYPE_2D, depth.format,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT));
+}
+
+void GBuffer::Destroy(const Device &device) const {
+  vkDestroyImageView(device, depthView, nullptr);
+  framebuffer.Destroy(device);
+}
+
+void GBuffer::TransitionDepthToRead(VkCommandBuffer commandBuffer) const {
+  const FramebufferAttachment &depth = framebuffer.attachments[kDepth];
+
+  // 深度の書き込みが終わってからシェーダで読み込みます。
+  VkImageMemoryBarrier depthBarrier = Initializer::ImageMemoryBarrier();
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.image = depth.image;
+  depthBarrier.subresourceRange = depth.subresourceRange;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+}
+
+VkDescriptorImageInfo GBuffer::GetDescriptor(uint32_t attachment) const {
+  BOOST_ASSERT_MSG(attachment < framebuffer.attachments.size(),
+                   "Invalid G-Buffer attachment!");
+  if (attachment == kDepth) {
+    return Initializer::DescriptorImageInfo(
+        framebuffer.sampler, depthView,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+  }
+  return Initializer::DescriptorImageInfo(
+      framebuffer.sampler, framebuffer.attachments[attachment].view,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+VkDescriptorImageInfo GBuffer::GetInputDescriptor(uint32_t attachment) const {
+  BOOST_ASSERT_MSG(attachment < framebuffer.attachments.size(),
+                   "Invalid G-Buffer attachment!");
+  if (attachment == kDepth) {
+    return Initializer::DescriptorImageInfo(
+        VK_NULL_HANDLE, depthView,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+  }
+  return Initializer::DescriptorImageInfo(
+      VK_NULL_HANDLE, framebuffer.attachments[attachment].view,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+VkResult GBuffer::CreateSubpassRenderPass(const Device &device,
+                                          const VkAttachmentDescription &output,
+                                          VkRenderPass &renderPass) const {
+  BOOST_ASSERT_MSG(framebuffer.attachments.size() == kDepth + 1,
+                   "G-Buffer is not set up!");
+
+  // G-Bufferはレンダーパスの中で使い切るため、内容を書き出しません。
+  std::array<VkAttachmentDescription, kOutput + 1> attachmentDescriptions{};
+  for (uint32_t i = 0; i <= kDepth; i++) {
+    attachmentDescriptions[i] = framebuffer.attachments[i].description;
+    attachmentDescriptions[i].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  }
+  // 最後のサブパスのレイアウトのまま終えて、余分な遷移を避けます。
+  attachmentDescriptions[kDepth].finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  attachmentDescriptions[kOutput] = output;
+
+  // Subpass 0: G-Bufferへの書き込み
+  const std::array<VkAttachmentReference, kColorAttachmentCount> colorRefs{{
+      {kNormal, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+      {kAlbedo, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+  }};
+  const VkAttachmentReference depthRef{
+      kDepth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  // Subpass 1: 入力アタッチメントからの合成
+  const VkAttachmentReference outputRef{
+      kOutput, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  const std::array<VkAttachmentReference, kDepth + 1> inputRefs{{
+      {kNormal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {kAlbedo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {kDepth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+  }};
+
+  std::array<VkSubpassDescription, 2> subpasses{};
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+  subpasses[0].pColorAttachments = colorRefs.data();
+  subpasses[0].pDepthStencilAttachment = &depthRef;
+
+  subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[1].colorAttachmentCount = 1;
+  subpasses[1].pColorAttachments = &outputRef;
+  subpasses[1].inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+  subpasses[1].pInputAttachments = inputRefs.data();
+
+  std::array<VkSubpassDependency, 4> dependencies{};
+
+  // 前のフレームの書き込みが終わってからG-Bufferへ書き込みます。
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  // 出力先はサブパス1で初めて使うため、その前に遷移させます。
+  dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].dstSubpass = 1;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].srcAccessMask = 0;
+  dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  // 各ピクセルは自身の位置のG-Bufferだけを読むため、領域ごとの依存関係で十分です。
+  // これにより、タイルベースのGPUはG-Bufferをタイルのメモリに置いたまま合成できます。
+  dependencies[2].srcSubpass = 0;
+  dependencies[2].dstSubpass = 1;
+  dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+  dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  dependencies[3].srcSubpass = 1;
+  dependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[3].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  dependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[3].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+  dependencies[3].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  VkRenderPassCreateInfo renderPassCreateInfo =
+      Initializer::RenderPassCreateInfo();
+  renderPassCreateInfo.attachmentCount =
+      static_cast<uint32_t>(attachmentDescriptions.size());
+  renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+  renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassCreateInfo.pSubpasses = subpasses.data();
+  renderPassCreateInfo.dependencyCount =
+      static_cast<uint32_t>(dependencies.size());
+  renderPassCreateInfo.pDependencies = dependencies.data();
+  return vkCreateRenderPass(device, &renderPassCreateInfo, nullptr,
+                            &renderPass);
+}
@@ -0,0 +1,83 @@
+/**
+ * @brief 深度から位置を復元するコンパクトなG-Buffer
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "VK/Framebuffer.h"
+
+struct Device;
+
+/**
+ * @brief
+ * 位置を持たず、深度とカメラの逆射影行列から位置を復元するG-Bufferです。
+ * @note
+ * アタッチメントは次の順で、フラグメントシェーダの出力の順と一致させます。<br>
+ * kNormal: 八面体写像で符号化した法線(RG16)<br>
+ * kAlbedo: RGBはアルベド、Aはマテリアルのビットをbits / 255で書き込みます(RGBA8)<br>
+ * kDepth: サンプリングできる深度<br>
+ * 位置はテクスチャ座標uvと深度dから、逆射影行列 * (uv * 2 - 1, d, 1) をwで割って求めます。<br>
+ * 1ピクセルあたりのカラーアタッチメントは8バイトです。<br>
+ * SetupTransientで生成した場合は、同じレンダーパスの後続のサブパスから入力アタッチメントとして読みます。
+ */
+struct GBuffer {
+  static constexpr uint32_t kNormal = 0;
+  static constexpr uint32_t kAlbedo = 1;
+  static constexpr uint32_t kDepth = 2;
+  static constexpr uint32_t kColorAttachmentCount = 2;
+  /** @brief CreateSubpassRenderPassで合成結果を書き込むアタッチメント */
+  static constexpr uint32_t kOutput = 3;
+
+  /** @brief ジオメトリを書き込んだことを表すマテリアルのビット */
+  static constexpr uint32_t kMaterialGeometry = 1u << 0;
+
+  void Setup(const Device &device, uint32_t width, uint32_t height);
+  /**
+   * @brief レンダーパスの外へ書き出さない、入力アタッチメント用のG-Bufferを生成します。
+   * @note
+   * 対応していれば遅延割り当てのメモリを使い、タイルのメモリだけで完結させます。<br>
+   * 深度は入力アタッチメントとして読めるよう、ステンシルを持たない形式を選択します。<br>
+   * サンプラとレンダーパスは生成しません。CreateSubpassRenderPassを使用してください。
+   */
+  void SetupTransient(const Device &device, uint32_t width, uint32_t height);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief
+   * サブパス0でG-Bufferを書き込み、サブパス1で入力アタッチメントとして読んでoutputへ描くレンダーパスを生成します。
+   * @note
+   * フレームバッファのアタッチメントはkNormal, kAlbedo, kDepth, kOutputの順です。<br>
+   * サブパス1の入力アタッチメントの番号(input_attachment_index)はkNormal, kAlbedo, kDepthと一致します。
+   * @param output 合成結果を書き込むアタッチメント
+   */
+  VkResult CreateSubpassRenderPass(const Device &device,
+                                   const VkAttachmentDescription &output,
+                                   VkRenderPass &renderPass) const;
+
+  /**
+   * @brief 深度をシェーダから読めるレイアウトへ移行します。
+   * @note
+   * G-Bufferのレンダーパスの後、レンダーパスの外で呼び出してください。<br>
+   * 次のG-Bufferのレンダーパスは深度を捨ててクリアするため、元に戻す必要はありません。
+   */
+  void TransitionDepthToRead(VkCommandBuffer commandBuffer) const;
+
+  /** @brief アタッチメントをサンプリングする記述子を返します。 */
+  [[nodiscard]] VkDescriptorImageInfo GetDescriptor(uint32_t attachment) const;
+  /** @brief アタッチメントを入力アタッチメントとして読む記述子を返します。 */
+  [[nodiscard]] VkDescriptorImageInfo
+  GetInputDescriptor(uint32_t attachment) const;
+
+  /** @brief アタッチメントはkNormal, kAlbedo, kDepthの順です。 */
+  Framebuffer framebuffer{};
+  /** @brief 深度アスペクトだけを含むサンプリング用のビュー */
+  VkImageView depthView = VK_NULL_HANDLE;
+  VkFormat normalFormat = VK_FORMAT_UNDEFINED;
+
+private:
+  void SetupAttachments(const Device &device, uint32_t width, uint32_t height,
+                        VkImageUsageFlags readUsage, VkFormat depthFormat,
+                        VkMemoryPropertyFlags memoryFlags);
+};
@@ -0,0 +1,387 @@
+/**
+ * @brief コンピュートシェーダによる地平線ベースの環境遮蔽(GTAO)
+ */
+
+#include "VK/GTAO.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define GTAO_DEPTH_COMPUTE_SHADER_PATH                                         \
+  "./Assets/Shaders/GLSL/SPIR-V/PostProcess/GTAODepth.cs.spv"
+#define GTAO_COMPUTE_SHADER_PATH                                               \
+  "./Assets/Shaders/GLSL/SPIR-V/PostProcess/GTAO.cs.spv"
+
+void GTAO::Setup(const Device &device, uint32_t width, uint32_t height,
+                 VkQueue copyQueue, VkPipelineCache pipelineCache,
+                 bool bentNormals) {
+  this->width = width;
+  this->height = height;
+  // 小さすぎるレベルは使わないため、縮小できる回数で打ち切ります。
+  const uint32_t maxLevels =
+      static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) +
+      1;
+  depthLevels = std::min(kDepthMipLevels, maxLevels);
+
+  uniformBlock.texelSize = glm::vec2(1.0f / static_cast<float>(width),
+                                     1.0f / static_cast<float>(height));
+  uniformBlock.maxLevel = static_cast<float>(depthLevels - 1);
+
+  SetupImages(device, copyQueue);
+  SetupDescriptorSets(device);
+  SetupPipelines(device, pipelineCache, bentNormals);
+}
+
+void GTAO::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipeline(device, depthPipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyPipelineLayout(device, depthPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, depthDescriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  uniformBuffer.Destroy(device);
+  vkDestroySampler(device, depthSampler, nullptr);
+  for (const auto levelView : depthLevelViews) {
+    vkDestroyImageView(device, levelView, nullptr);
+  }
+  vkDestroyImageView(device, depthView, nullptr);
+  vkDestroyImage(device, depthImage, nullptr);
+  vkFreeMemory(device, depthMemory, nullptr);
+  vkDestroySampler(device, sampler, nullptr);
+  vkDestroyImageView(device, view, nullptr);
+  vkDestroyImage(device, image, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void GTAO::SetSource(const Device &device, const VkDescriptorImageInfo &depth,
+                     const VkDescriptorImageInfo &normal) {
+  const VkDescriptorImageInfo depthInfo = Initializer::DescriptorImageInfo(
+      depthSampler, depthView, VK_IMAGE_LAYOUT_GENERAL);
+  const std::array<VkWriteDescriptorSet, 3> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(depthDescriptorSets[0],
+                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      0, &depth),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      0, &depthInfo),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      1, &normal),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void GTAO::Update(const glm::mat4 &proj, const Params &params) {
+  // ビュー空間のzは負の向きのため、符号を反転して距離にします。
+  const glm::mat4 invProj = glm::inverse(proj);
+  uniformBlock.depthParams = glm::vec4(-invProj[2][2], -invProj[3][2],
+                                       invProj[2][3], invProj[3][3]);
+  uniformBlock.ndcToView = glm::vec2(invProj[0][0], invProj[1][1]);
+  uniformBlock.projScale =
+      0.5f * static_cast<float>(height) * std::abs(proj[1][1]);
+
+  uniformBlock.radius = std::max(params.radius, 0.0f);
+  uniformBlock.falloff = std::clamp(params.falloff, 0.01f, 1.0f);
+  uniformBlock.power = params.power;
+  uniformBlock.sliceCount = std::max(params.sliceCount, 1);
+  uniformBlock.stepsPerSlice = std::max(params.stepsPerSlice, 1);
+  uniformBlock.frame = params.frame;
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void GTAO::Dispatch(VkCommandBuffer commandBuffer) const {
+  // 入力の書き込みと、前回の結果の読み込みが終わってから書き込みます。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  // レベル0で深度を距離へ変換し、以降は2x2の最も手前の距離で縮小します。
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    depthPipeline);
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  uint32_t srcWidth = width;
+  uint32_t srcHeight = height;
+  for (uint32_t level = 0; level < depthLevels; level++) {
+    const uint32_t dstWidth = level == 0 ? width : std::max(srcWidth / 2, 1u);
+    const uint32_t dstHeight =
+        level == 0 ? height : std::max(srcHeight / 2, 1u);
+    const DepthPushConstants pushConstants{
+        {static_cast<int32_t>(srcWidth), static_cast<int32_t>(srcHeight)},
+        {static_cast<int32_t>(dstWidth), static_cast<int32_t>(dstHeight)},
+        static_cast<int32_t>(level),
+    };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            depthPipelineLayout, 0, 1,
+                            &depthDescriptorSets[level], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, depthPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(DepthPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer,
+                  (dstWidth + kWorkGroupSize - 1) / kWorkGroupSize,
+                  (dstHeight + kWorkGroupSize - 1) / kWorkGroupSize, 1);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &memoryBarrier, 0, nullptr, 0, nullptr);
+    srcWidth = dstWidth;
+    srcHeight = dstHeight;
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdDispatch(commandBuffer, (width + kWorkGroupSize - 1) / kWorkGroupSize,
+                (height + kWorkGroupSize - 1) / kWorkGroupSize, 1);
+
+  // 続くコンピュートパスと、結果を参照するフラグメントシェーダが読みます。
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void GTAO::SetupImages(const Device &device, VkQueue copyQueue) {
+  VK_CHECK_RESULT(CreateImage(
+      device, image, memory, kFormat, VK_IMAGE_TYPE_2D, width, height, 1, 1, 1,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_IMAGE_TILING_OPTIMAL));
+  VK_CHECK_RESULT(CreateImageView(device, view, image, VK_IMAGE_VIEW_TYPE_2D,
+                                  kFormat, VK_IMAGE_ASPECT_COLOR_BIT));
+  VK_CHECK_RESULT(CreateSampler(
+      device, sampler, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST));
+  descriptor = Initializer::DescriptorImageInfo(sampler, view,
+                                                VK_IMAGE_LAYOUT_GENERAL);
+
+  VK_CHECK_RESULT(CreateImage(
+      device, depthImage, depthMemory, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TYPE_2D,
+      width, height, 1, depthLevels, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_IMAGE_TILING_OPTIMAL));
+  VK_CHECK_RESULT(CreateImageView(device, depthView, depthImage,
+                                  VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32_SFLOAT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, 0, depthLevels));
+  depthLevelViews.resize(depthLevels);
+  for (uint32_t level = 0; level < depthLevels; level++) {
+    VK_CHECK_RESULT(CreateImageView(
+        device, depthLevelViews[level], depthImage, VK_IMAGE_VIEW_TYPE_2D,
+        VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+  }
+  // 距離は補間せず、ステップごとに選んだレベルのテクセルをそのまま読みます。
+  VK_CHECK_RESULT(CreateSampler(
+      device, depthSampler, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      0.0f, static_cast<float>(depthLevels)));
+
+  VK_CHECK_RESULT(uniformBuffer.Create(device,
+                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       sizeof(UniformBlock)));
+  VK_CHECK_RESULT(uniformBuffer.Map(device));
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+
+  // 読み書きのどちらにも使うため、イメージはGENERALのまま使用します。
+  VkCommandBuffer commandBuffer =
+      device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+  TransitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+  TransitionImageLayout(commandBuffer, depthImage,
+                        {VK_IMAGE_ASPECT_COLOR_BIT, 0, depthLevels, 0, 1},
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+  device.FlushCommandBuffer(commandBuffer, copyQueue);
+}
+
+void GTAO::SetupDescriptorSets(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                      depthLevels + 1),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      depthLevels + 2),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                      depthLevels + 1),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, depthLevels + 1);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  // 深度のミップチェーン
+  {
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+        // Binding 0: 入力(深度または前のレベル)
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        // Binding 1: 出力レベル
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        // Binding 2: パラメータ
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+    };
+    const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+        Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+        device, &descriptorSetLayoutCreateInfo, nullptr,
+        &depthDescriptorSetLayout));
+
+    const std::vector<VkDescriptorSetLayout> setLayouts(
+        depthLevels, depthDescriptorSetLayout);
+    const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+        Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                               setLayouts.data(), depthLevels);
+    depthDescriptorSets.resize(depthLevels);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(
+        device, &descriptorSetAllocateInfo, depthDescriptorSets.data()));
+
+    // レベル0の入力はSetSourceで設定します。
+    for (uint32_t level = 0; level < depthLevels; level++) {
+      const VkDescriptorImageInfo srcInfo = Initializer::DescriptorImageInfo(
+          depthSampler, depthLevelViews[level == 0 ? 0 : level - 1],
+          VK_IMAGE_LAYOUT_GENERAL);
+      const VkDescriptorImageInfo dstInfo = Initializer::DescriptorImageInfo(
+          VK_NULL_HANDLE, depthLevelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+      std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+          Initializer::WriteDescriptorSet(depthDescriptorSets[level],
+                                          VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                          &dstInfo),
+          Initializer::WriteDescriptorSet(depthDescriptorSets[level],
+                                          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
+                                          &uniformBuffer.descriptor),
+      };
+      if (level > 0) {
+        writeDescriptorSets.emplace_back(Initializer::WriteDescriptorSet(
+            depthDescriptorSets[level],
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcInfo));
+      }
+      vkUpdateDescriptorSets(device,
+                             static_cast<uint32_t>(writeDescriptorSets.size()),
+                             writeDescriptorSets.data(), 0, nullptr);
+    }
+  }
+
+  // GTAO
+  {
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+        // Binding 0: 距離のミップチェーン
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        // Binding 1: 法線
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        // Binding 2: 出力
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+        // Binding 3: パラメータ
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+    };
+    const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+        Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+        device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+    const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+        Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                               &descriptorSetLayout, 1);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(
+        device, &descriptorSetAllocateInfo, &descriptorSet));
+
+    const VkDescriptorImageInfo dstInfo = Initializer::DescriptorImageInfo(
+        VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+    const std::array<VkWriteDescriptorSet, 2> writeDescriptorSets = {
+        Initializer::WriteDescriptorSet(descriptorSet,
+                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2,
+                                        &dstInfo),
+        Initializer::WriteDescriptorSet(descriptorSet,
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3,
+                                        &uniformBuffer.descriptor),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writeDescriptorSets.size()),
+                           writeDescriptorSets.data(), 0, nullptr);
+  }
+}
+
+void GTAO::SetupPipelines(const Device &device, VkPipelineCache pipelineCache,
+                          bool bentNormals) {
+  // 深度のミップチェーン
+  {
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+        Initializer::PipelineLayoutCreateInfo(&depthDescriptorSetLayout);
+    const VkPushConstantRange pushConstantRange =
+        Initializer::PushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT,
+                                       sizeof(DepthPushConstants), 0);
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                           nullptr, &depthPipelineLayout));
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo =
+        Initializer::ComputePipelineCreateInfo(depthPipelineLayout);
+    computePipelineCreateInfo.stage =
+        CreateShader(device, GTAO_DEPTH_COMPUTE_SHADER_PATH,
+                     VK_SHADER_STAGE_COMPUTE_BIT);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                             &computePipelineCreateInfo,
+                                             nullptr, &depthPipeline));
+    vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                          nullptr);
+  }
+
+  // GTAO
+  {
+    const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+        Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                           nullptr, &pipelineLayout));
+
+    // ベントノーマルを使わない場合は特殊化定数で計算ごと取り除きます。
+    const VkBool32 bentNormal = bentNormals ? VK_TRUE : VK_FALSE;
+    const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+        Initializer::SpecializationMapEntry(0, 0, sizeof(VkBool32)),
+    };
+    VkSpecializationInfo specializationInfo = Initializer::SpecializationInfo(
+        specializationMapEntries, sizeof(VkBool32), &bentNormal);
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo =
+        Initializer::ComputePipelineCreateInfo(pipelineLayout);
+    computePipelineCreateInfo.stage =
+        CreateShader(device, GTAO_COMPUTE_SHADER_PATH,
+                     VK_SHADER_STAGE_COMPUTE_BIT, &specializationInfo);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                             &computePipelineCreateInfo,
+                                             nullptr, &pipeline));
+    vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                          nullptr);
+  }
+}
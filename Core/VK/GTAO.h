@@ -0,0 +1,123 @@
+/**
+ * @brief コンピュートシェーダによる地平線ベースの環境遮蔽(GTAO)
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "VK/Buffer.h"
+
+struct Device;
+
+/**
+ * @brief
+ * 画面上の方向(スライス)ごとに深度をたどって両側の地平線を求め、
+ * その間の可視領域を法線で余弦重み付けして積分します。
+ * @note
+ * 深度は先にビュー空間の距離へ変換し、最も手前の値で縮小したミップチェーンを作ります。
+ * 遠くのステップほど粗いミップを読むため、半径を広げてもキャッシュの効率が落ちにくくなります。<br>
+ * 入力の深度はハードウェアの深度、法線はG-Bufferと同じ八面体に符号化したビュー空間の法線です。<br>
+ * 出力はkFormatでrに可視率、gbaにビュー空間のベントノーマル(有効な場合)を書き込みます。
+ * VK_IMAGE_LAYOUT_GENERALのままdescriptorを渡して読み込んでください。
+ */
+struct GTAO {
+  /** @brief シェーダのlocal_sizeと一致させます。 */
+  static constexpr uint32_t kWorkGroupSize = 8;
+  static constexpr uint32_t kDepthMipLevels = 5;
+  static constexpr VkFormat kFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+  struct Params {
+    /** @brief 遮蔽を探す半径(ビュー空間) */
+    float radius = 0.5f;
+    /** @brief 半径のうち、遮蔽の寄与を弱めていく外側の割合 */
+    float falloff = 0.6f;
+    /** @brief 可視率に掛けるべき乗 */
+    float power = 2.2f;
+    int32_t sliceCount = 2;
+    int32_t stepsPerSlice = 4;
+    /** @brief ノイズを時間方向にずらすフレーム番号 */
+    uint32_t frame = 0;
+  };
+
+  void Setup(const Device &device, uint32_t width, uint32_t height,
+             VkQueue copyQueue, VkPipelineCache pipelineCache,
+             bool bentNormals = false);
+  void Destroy(const Device &device) const;
+
+  /** @brief 入力の深度と法線を設定します。出力と同じ大きさにしてください。 */
+  void SetSource(const Device &device, const VkDescriptorImageInfo &depth,
+                 const VkDescriptorImageInfo &normal);
+
+  /** @brief 射影行列とパラメータを更新します。 */
+  void Update(const glm::mat4 &proj, const Params &params);
+
+  /**
+   * @brief 深度のミップチェーンとGTAOを記録します。レンダーパスの外で呼び出してください。
+   * @note 結果はフラグメントシェーダとコンピュートシェーダから読めます。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer) const;
+
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkDescriptorImageInfo descriptor{};
+
+  /** @brief ビュー空間の距離のミップチェーン(R32) */
+  VkImage depthImage = VK_NULL_HANDLE;
+  VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+  VkImageView depthView = VK_NULL_HANDLE;
+  std::vector<VkImageView> depthLevelViews{};
+  VkSampler depthSampler = VK_NULL_HANDLE;
+
+  Buffer uniformBuffer{};
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout depthDescriptorSetLayout = VK_NULL_HANDLE;
+  /** @brief レベルごとの記述子セット(前のレベルを読み、このレベルへ書きます) */
+  std::vector<VkDescriptorSet> depthDescriptorSets{};
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout depthPipelineLayout = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline depthPipeline = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  struct UniformBlock {
+    /** @brief 深度をビュー空間の距離へ変換する係数 */
+    alignas(16) glm::vec4 depthParams;
+    /** @brief 正規化デバイス座標から距離1の位置への倍率 */
+    alignas(8) glm::vec2 ndcToView;
+    alignas(8) glm::vec2 texelSize;
+    /** @brief 距離1で半径1が覆うピクセル数 */
+    alignas(4) float projScale;
+    alignas(4) float radius;
+    alignas(4) float falloff;
+    alignas(4) float power;
+    alignas(4) int32_t sliceCount;
+    alignas(4) int32_t stepsPerSlice;
+    alignas(4) uint32_t frame;
+    alignas(4) float maxLevel;
+  } uniformBlock{};
+
+  struct DepthPushConstants {
+    alignas(8) int32_t srcSize[2];
+    alignas(8) int32_t dstSize[2];
+    alignas(4) int32_t level;
+  };
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t depthLevels = 0;
+
+private:
+  void SetupImages(const Device &device, VkQueue copyQueue);
+  void SetupDescriptorSets(const Device &device);
+  void SetupPipelines(const Device &device, VkPipelineCache pipelineCache,
+                      bool bentNormals);
+};
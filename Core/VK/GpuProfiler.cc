@@ -0,0 +1,142 @@
+/**
+ * @brief タイムスタンプクエリによるパスごとのGPU時間の計測
+ */
+
+#include "VK/GpuProfiler.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Gui.h"
+#include "VK/Initializer.h"
+
+/** @brief 1つのパスが使うクエリの数(開始と終了) */
+static constexpr uint32_t kQueriesPerScope = 2;
+/** @brief 平均に新しい値を混ぜる割合 */
+static constexpr float kSmoothing = 0.1f;
+
+void GpuProfiler::Setup(const Device &device, uint32_t frameCount,
+                        VkQueue queue) {
+  this->frameCount = frameCount;
+
+  const uint32_t validBits =
+      device.queueFamilyProperties[device.queueFamilyIndices.graphics]
+          .timestampValidBits;
+  supported = device.properties.limits.timestampComputeAndGraphics &&
+              validBits > 0;
+  if (!supported) {
+    return;
+  }
+  timestampPeriod = device.properties.limits.timestampPeriod;
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo queryPoolCreateInfo{};
+  queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolCreateInfo.queryCount = frameCount * kMaxScopes * kQueriesPerScope;
+  VK_CHECK_RESULT(
+      vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+
+  // リセットしていないクエリは読めないため、最初の提出より前に全体をリセットします。
+  VkCommandBuffer commandBuffer =
+      device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+  vkCmdResetQueryPool(commandBuffer, queryPool, 0,
+                      queryPoolCreateInfo.queryCount);
+  device.FlushCommandBuffer(commandBuffer, queue);
+}
+
+void GpuProfiler::Destroy(const Device &device) const {
+  vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+void GpuProfiler::Reset(VkCommandBuffer commandBuffer, uint32_t frame) const {
+  if (!supported) {
+    return;
+  }
+  vkCmdResetQueryPool(commandBuffer, queryPool,
+                      frame * kMaxScopes * kQueriesPerScope,
+                      kMaxScopes * kQueriesPerScope);
+}
+
+uint32_t GpuProfiler::Begin(VkCommandBuffer commandBuffer, uint32_t frame,
+                            const std::string &name) {
+  auto it = std::find_if(scopes.begin(), scopes.end(),
+                         [&name](const Scope &scope) {
+                           return scope.name == name;
+                         });
+  if (it == scopes.end()) {
+    BOOST_ASSERT_MSG(scopes.size() < kMaxScopes, "Too many profiler scopes!");
+    scopes.emplace_back(Scope{name});
+    it = std::prev(scopes.end());
+  }
+  const auto scope = static_cast<uint32_t>(std::distance(scopes.begin(), it));
+
+  if (supported) {
+    // 開始はパイプラインの先頭、終了は末尾で書き込み、パスが重なる時間も含めます。
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        queryPool,
+                        (frame * kMaxScopes + scope) * kQueriesPerScope);
+  }
+  return scope;
+}
+
+void GpuProfiler::End(VkCommandBuffer commandBuffer, uint32_t frame,
+                      uint32_t scope) const {
+  if (!supported) {
+    return;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      queryPool,
+                      (frame * kMaxScopes + scope) * kQueriesPerScope + 1);
+}
+
+void GpuProfiler::Resolve(const Device &device, uint32_t frame) {
+  if (!supported || scopes.empty()) {
+    return;
+  }
+
+  // 値と利用可能かどうかの組を読みます。記録されなかったクエリは利用できません。
+  std::array<uint64_t, kMaxScopes * kQueriesPerScope * 2> results{};
+  const auto queryCount =
+      static_cast<uint32_t>(scopes.size()) * kQueriesPerScope;
+  const VkResult result = vkGetQueryPoolResults(
+      device, queryPool, frame * kMaxScopes * kQueriesPerScope, queryCount,
+      sizeof(results), results.data(), sizeof(uint64_t) * 2,
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_SUCCESS && result != VK_NOT_READY) {
+    VK_CHECK_RESULT(result);
+  }
+
+  for (size_t i = 0; i < scopes.size(); i++) {
+    const uint64_t *begin = &results[i * kQueriesPerScope * 2];
+    const uint64_t *end = begin + 2;
+    if (begin[1] == 0 || end[1] == 0) {
+      continue;
+    }
+    const uint64_t ticks = ((end[0] & timestampMask) -
+                            (begin[0] & timestampMask)) &
+                           timestampMask;
+    const float milliseconds =
+        static_cast<float>(ticks) * timestampPeriod * 1e-6f;
+    scopes[i].milliseconds =
+        scopes[i].milliseconds == 0.0f
+            ? milliseconds
+            : scopes[i].milliseconds +
+                  (milliseconds - scopes[i].milliseconds) * kSmoothing;
+  }
+}
+
+void GpuProfiler::Draw(const Gui &gui) const {
+  if (!supported) {
+    gui.Text("GPU timestamps are not supported.");
+    return;
+  }
+  for (const auto &scope : scopes) {
+    gui.Text("%-12s %6.3f ms", scope.name.c_str(), scope.milliseconds);
+  }
+}
@@ -0,0 +1,71 @@
+/**
+ * @brief タイムスタンプクエリによるパスごとのGPU時間の計測
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+struct Device;
+struct Gui;
+
+/**
+ * @brief
+ * コマンドバッファに記録したパスの前後でタイムスタンプを書き込み、パスごとのGPU時間を求めます。
+ * @note
+ * コマンドバッファ(スワップチェーンのイメージ)ごとにクエリの範囲を分け、
+ * 完了したコマンドバッファの結果だけをResolveで読みます。<br>
+ * パスは名前で区別し、最初にBeginした順に表示します。記録されなかったパスの値は更新しません。<br>
+ * グラフィックスキューがタイムスタンプに対応しない場合は何も記録しません。
+ */
+struct GpuProfiler {
+  /** @brief 1つのコマンドバッファで計測できるパスの最大数 */
+  static constexpr uint32_t kMaxScopes = 16;
+
+  /**
+   * @brief クエリプールを生成し、全体をリセットします。
+   * @note 一度も記録されていないフレームのクエリもResolveで読めるよう、ここでリセットしておきます。
+   */
+  void Setup(const Device &device, uint32_t frameCount, VkQueue queue);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief frameのクエリをリセットします。コマンドバッファの先頭(レンダーパスの外)で呼び出してください。
+   */
+  void Reset(VkCommandBuffer commandBuffer, uint32_t frame) const;
+
+  /**
+   * @brief パスの計測を開始します。
+   * @return Endへ渡すパスの番号
+   */
+  uint32_t Begin(VkCommandBuffer commandBuffer, uint32_t frame,
+                 const std::string &name);
+  void End(VkCommandBuffer commandBuffer, uint32_t frame,
+           uint32_t scope) const;
+
+  /**
+   * @brief frameのコマンドバッファが完了した後に結果を読み、平均を更新します。
+   */
+  void Resolve(const Device &device, uint32_t frame);
+
+  /** @brief パスごとの時間をUIに表示します。 */
+  void Draw(const Gui &gui) const;
+
+  struct Scope {
+    std::string name;
+    /** @brief 指数移動平均したGPU時間(ミリ秒) */
+    float milliseconds = 0.0f;
+  };
+  std::vector<Scope> scopes{};
+
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  /** @brief タイムスタンプの1単位のナノ秒 */
+  float timestampPeriod = 1.0f;
+  /** @brief タイムスタンプの有効なビットのマスク */
+  uint64_t timestampMask = ~0ull;
+  uint32_t frameCount = 0;
+  bool supported = false;
+};
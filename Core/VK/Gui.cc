@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <boost/assert.hpp>
+#include <cstdarg>
 
 #include "VK/Common.h"
 #include "VK/Device.h"
@@ -484,6 +485,22 @@ bool Gui::SliderFloat(const char *label, float *v, float vmin, float vmax) {
   return res;
 }
 
+bool Gui::SliderInt(const char *label, int32_t *v, int32_t vmin,
+                    int32_t vmax) {
+  const bool res = ImGui::SliderInt(label, v, vmin, vmax);
+  if (res) {
+    updated = true;
+  }
+  return res;
+}
+
+void Gui::Text(const char *format, ...) const {
+  va_list args;
+  va_start(args, format);
+  ImGui::TextV(format, args);
+  va_end(args);
+}
+
 bool Gui::ColorEdit3(const char *label, glm::vec3 *color) {
   const bool res = ImGui::ColorEdit3(label, reinterpret_cast<float *>(color));
   if (res) {
@@ -26,7 +26,9 @@ public:
   bool Combo(const char *label, int32_t *v,
                 const std::vector<std::string> &items);
   bool SliderFloat(const char *label, float *v, float vmin, float vmax);
+  bool SliderInt(const char *label, int32_t *v, int32_t vmin, int32_t vmax);
   bool ColorEdit3(const char *label, glm::vec3 *color);
+  void Text(const char *format, ...) const;
 
   uint32_t subpass = 0;
 
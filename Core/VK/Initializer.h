@@ -293,7 +293,8 @@ DescriptorImageInfo(VkSampler sampler, VkImageView imageView,
 
 [[maybe_unused]] inline VkWriteDescriptorSet
 WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType descriptorType,
-                   uint32_t dstBinding, VkDescriptorBufferInfo *pBufferInfo,
+                   uint32_t dstBinding,
+                   const VkDescriptorBufferInfo *pBufferInfo,
                    uint32_t descriptorCount = 1) {
   VkWriteDescriptorSet writeDescriptorSet{};
   writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -307,7 +308,8 @@ WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType descriptorType,
 
 [[maybe_unused]] inline VkWriteDescriptorSet
 WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType descriptorType,
-                   uint32_t dstBinding, VkDescriptorImageInfo *pImageInfo,
+                   uint32_t dstBinding,
+                   const VkDescriptorImageInfo *pImageInfo,
                    uint32_t descriptorCount = 1) {
   VkWriteDescriptorSet writeDescriptorSet{};
   writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -525,6 +527,17 @@ GraphicsPipelineCreateInfo() {
   return pipelineCreateInfo;
 }
 
+[[maybe_unused]] inline VkComputePipelineCreateInfo
+ComputePipelineCreateInfo(VkPipelineLayout layout,
+                          VkPipelineCreateFlags flags = 0) {
+  VkComputePipelineCreateInfo computePipelineCreateInfo{};
+  computePipelineCreateInfo.sType =
+      VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  computePipelineCreateInfo.layout = layout;
+  computePipelineCreateInfo.flags = flags;
+  return computePipelineCreateInfo;
+}
+
 [[maybe_unused]] inline VkPushConstantRange
 PushConstantRange(VkShaderStageFlags stageFlags, uint32_t size,
                   uint32_t offset) {
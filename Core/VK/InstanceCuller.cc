@@ -0,0 +1,376 @@
+/**
+ * @brief コンピュートシェーダによるインスタンス単位のGPUカリングと間接描画
+ */
+
+#include "VK/InstanceCuller.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "View/Camera.h"
+#include "View/Frustum.h"
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Model.h"
+#include "VK/Utils.h"
+
+#define INSTANCE_CULL_COMPUTE_SHADER_PATH                                      \
+  "./Assets/Shaders/GLSL/SPIR-V/Culling/InstanceCull.cs.spv"
+
+/** @brief シェーダのlocal_size_xと一致させます。 */
+static constexpr uint32_t kWorkGroupSize = 64;
+
+/** @brief GPUへ転送するLODです。(std430) */
+struct GpuLod {
+  uint32_t indexBase;
+  uint32_t indexCount;
+  float error;
+  uint32_t padding;
+};
+
+bool InstanceCuller::IsSupported(const Device &device) {
+  return device.enabledFeatures.drawIndirectFirstInstance == VK_TRUE;
+}
+
+void InstanceCuller::Setup(const Device &device, const Model &model,
+                           uint32_t maxInstances, VkQueue copyQueue,
+                           VkPipelineCache pipelineCache) {
+  BOOST_ASSERT_MSG(IsSupported(device),
+                   "drawIndirectFirstInstance is not enabled!");
+
+  this->maxInstances = maxInstances;
+  meshCount = static_cast<uint32_t>(model.meshes.size());
+  maxDraws = std::max(maxInstances * meshCount, 1u);
+  indexBuffer = model.indices.buffer;
+  multiDraw = device.enabledFeatures.multiDrawIndirect == VK_TRUE;
+  maxDrawIndirectCount =
+      multiDraw ? std::max(device.properties.limits.maxDrawIndirectCount, 1u)
+                : 1u;
+
+  const glm::vec3 center = 0.5f * (model.dim.min + model.dim.max);
+  modelSphere =
+      glm::vec4(center, 0.5f * glm::length(model.dim.max - model.dim.min));
+
+  // 遮蔽判定を行わない場合に使う、常に遠方を示す1x1の深度ピラミッドです。
+  float farDepth = 1.0f;
+  dummyPyramid.FromBuffer(device, &farDepth, sizeof(float),
+                          VK_FORMAT_R32_SFLOAT, 1, 1, copyQueue,
+                          VK_FILTER_NEAREST);
+  uniformBlock.pyramidSize = glm::vec2(1.0f);
+  uniformBlock.pyramidLevels = 1;
+
+  SetupBuffers(device, model);
+  SetupDescriptorSet(device);
+  SetupPipeline(device, pipelineCache);
+}
+
+void InstanceCuller::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  dummyPyramid.Destroy(device);
+  uniformBuffer.Destroy(device);
+  visibility.Destroy(device);
+  drawCount.Destroy(device);
+  drawCommands.Destroy(device);
+  lods.Destroy(device);
+  meshes.Destroy(device);
+  instances.Destroy(device);
+}
+
+void InstanceCuller::SetInstance(uint32_t index, const glm::mat4 &world,
+                                 uint32_t material) {
+  BOOST_ASSERT(index < maxInstances);
+
+  GpuInstance instance{};
+  instance.model = world;
+  instance.sphere = modelSphere;
+  instance.meshOffset = 0;
+  instance.meshCount = meshCount;
+  instance.material = material;
+  static_cast<GpuInstance *>(instances.mapped)[index] = instance;
+}
+
+void InstanceCuller::SetInstanceCount(uint32_t count) {
+  BOOST_ASSERT(count <= maxInstances);
+  instanceCount = count;
+}
+
+void InstanceCuller::SetDepthPyramid(const Device &device,
+                                     const VkDescriptorImageInfo &imageInfo,
+                                     uint32_t width, uint32_t height,
+                                     uint32_t levels) {
+  VkDescriptorImageInfo info = imageInfo;
+  const VkWriteDescriptorSet writeDescriptorSet =
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &info);
+  vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+  uniformBlock.pyramidSize =
+      glm::vec2(static_cast<float>(width), static_cast<float>(height));
+  uniformBlock.pyramidLevels = levels;
+}
+
+void InstanceCuller::Update(const glm::mat4 &viewProj, const Camera &camera,
+                            float viewportHeight, float pixelError,
+                            bool occlusion) {
+  const auto planes = Frustum::ExtractPlanes(viewProj);
+  uniformBlock.viewProj = viewProj;
+  for (size_t i = 0; i < planes.size(); i++) {
+    uniformBlock.planes[i] = planes[i];
+  }
+  uniformBlock.cameraPos = glm::vec4(camera.GetPosition(), 1.0f);
+  // Model::SelectLodと同じく、距離dでの1ピクセルの大きさは2d・tan(fovy/2)/高さです。
+  uniformBlock.lodFactor =
+      pixelError * 2.0f * std::tan(0.5f * camera.GetFOVY()) / viewportHeight;
+  uniformBlock.zNear = camera.GetNear();
+  uniformBlock.instanceCount = instanceCount;
+  uniformBlock.maxDraws = maxDraws;
+  uniformBlock.occlusion = occlusion ? 1 : 0;
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void InstanceCuller::Dispatch(VkCommandBuffer commandBuffer,
+                              Phase phase) const {
+  constexpr VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+  const auto index = static_cast<uint32_t>(phase);
+
+  // 前回の描画による読み込みが終わってから、この段階の描画コマンドを空にします。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0,
+                       nullptr, 0, nullptr);
+  vkCmdFillBuffer(commandBuffer, drawCommands.buffer, index * maxDraws * stride,
+                  maxDraws * stride, 0);
+  vkCmdFillBuffer(commandBuffer, drawCount.buffer, index * sizeof(uint32_t),
+                  sizeof(uint32_t), 0);
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  // インスタンス数が変わっても記録し直さずに済むよう、最大数ぶん起動します。
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                     0, sizeof(index), &index);
+  vkCmdDispatch(commandBuffer,
+                (std::max(maxInstances, 1u) + kWorkGroupSize - 1) /
+                    kWorkGroupSize,
+                1, 1);
+
+  // Lateの段階はEarlyが書き込んだ可視性を読みます。
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                VK_ACCESS_HOST_READ_BIT |
+                                VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_HOST_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void InstanceCuller::Draw(VkCommandBuffer commandBuffer, Phase phase) const {
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  const VkDeviceSize base =
+      static_cast<VkDeviceSize>(static_cast<uint32_t>(phase)) * maxDraws;
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  for (uint32_t first = 0; first < maxDraws; first += maxDrawIndirectCount) {
+    const uint32_t count = std::min(maxDrawIndirectCount, maxDraws - first);
+    vkCmdDrawIndexedIndirect(commandBuffer, drawCommands.buffer,
+                             (base + first) * stride, count, stride);
+  }
+}
+
+uint32_t InstanceCuller::GetDrawCount() const {
+  const auto *counts = static_cast<const uint32_t *>(drawCount.mapped);
+  return counts[0] + counts[1];
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void InstanceCuller::SetupBuffers(const Device &device, const Model &model) {
+  VK_CHECK_RESULT(instances.Create(
+      device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      std::max(maxInstances, 1u) * sizeof(GpuInstance)));
+  VK_CHECK_RESULT(instances.Map(device));
+
+  // メッシュとLODの表は変化しないため、最初に一度だけ書き込みます。
+  std::vector<glm::uvec2> meshTable{};
+  std::vector<GpuLod> lodTable{};
+  for (const auto &mesh : model.meshes) {
+    meshTable.emplace_back(static_cast<uint32_t>(lodTable.size()),
+                           static_cast<uint32_t>(mesh.lods.size()));
+    for (const auto &lod : mesh.lods) {
+      lodTable.emplace_back(
+          GpuLod{lod.indexBase, lod.indexCount, lod.error, 0});
+    }
+  }
+  if (meshTable.empty()) {
+    meshTable.emplace_back(0, 0);
+  }
+  if (lodTable.empty()) {
+    lodTable.emplace_back(GpuLod{});
+  }
+  VK_CHECK_RESULT(meshes.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                meshTable.size() * sizeof(glm::uvec2),
+                                meshTable.data()));
+  VK_CHECK_RESULT(lods.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              lodTable.size() * sizeof(GpuLod),
+                              lodTable.data()));
+
+  VK_CHECK_RESULT(drawCommands.Create(
+      device,
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      2 * maxDraws * sizeof(VkDrawIndexedIndirectCommand)));
+
+  // 描画数はホストから読み返せるようにします。
+  VK_CHECK_RESULT(drawCount.Create(
+      device,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      2 * sizeof(uint32_t)));
+  VK_CHECK_RESULT(drawCount.Map(device));
+  std::fill_n(static_cast<uint32_t *>(drawCount.mapped), 2, 0u);
+
+  VK_CHECK_RESULT(visibility.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    std::max(maxInstances, 1u) *
+                                        sizeof(uint32_t)));
+
+  VK_CHECK_RESULT(uniformBuffer.Create(device,
+                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       sizeof(UniformBlock)));
+  VK_CHECK_RESULT(uniformBuffer.Map(device));
+}
+
+void InstanceCuller::SetupDescriptorSet(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      1),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, 1);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+      // Binding 0: パラメータ
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      // Binding 1: インスタンス
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+      // Binding 2: メッシュごとのLOD範囲
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+      // Binding 3: LOD
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+      // Binding 4: 間接描画コマンド
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+      // Binding 5: 描画数
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+      // Binding 6: Earlyで描画したインスタンス
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+      // Binding 7: 深度ピラミッド
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT, 7),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                             &descriptorSetLayout, 1);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           &descriptorSet));
+
+  VkDescriptorImageInfo pyramidInfo = dummyPyramid.descriptor;
+  const std::array<VkWriteDescriptorSet, 8> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
+                                      &uniformBuffer.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                      &instances.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2,
+                                      &meshes.descriptor),
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &lods.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4,
+                                      &drawCommands.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5,
+                                      &drawCount.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6,
+                                      &visibility.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      7, &pyramidInfo),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void InstanceCuller::SetupPipeline(const Device &device,
+                                   VkPipelineCache pipelineCache) {
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  // 段階(Phase)をプッシュ定数で渡します。
+  const VkPushConstantRange pushConstantRange = Initializer::PushConstantRange(
+      VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo =
+      Initializer::ComputePipelineCreateInfo(pipelineLayout);
+  computePipelineCreateInfo.stage =
+      CreateShader(device, INSTANCE_CULL_COMPUTE_SHADER_PATH,
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                           &computePipelineCreateInfo, nullptr,
+                                           &pipeline));
+  vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
@@ -0,0 +1,152 @@
+/**
+ * @brief コンピュートシェーダによるインスタンス単位のGPUカリングと間接描画
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "VK/Buffer.h"
+#include "VK/Texture.h"
+
+struct Device;
+struct Model;
+class Camera;
+
+/**
+ * @brief GPUへ転送するインスタンスです。(std430)
+ * @note 頂点シェーダはgl_InstanceIndexでこの配列を参照します。
+ */
+struct GpuInstance {
+  glm::mat4 model;
+  /** @brief xyz: モデル空間の境界球の中心, w: 半径 */
+  glm::vec4 sphere;
+  /** @brief 描画するメッシュの範囲(Model::meshes内) */
+  uint32_t meshOffset;
+  uint32_t meshCount;
+  /** @brief 呼び出し側のマテリアル配列のインデックス */
+  uint32_t material;
+  uint32_t padding;
+};
+
+/**
+ * @brief
+ * 1つのModelのインスタンスを視錐台で判定し、画面空間誤差からLODを選んで
+ * VkDrawIndexedIndirectCommandを先頭から詰めて書き出します。
+ * @note
+ * 描画コマンドは最大数ぶん記録され、未使用の末尾はインデックス数0の空の描画になります。<br>
+ * そのため、インスタンスの追加・削除・移動でコマンドバッファを作り直す必要はありません。<br>
+ * 各描画のfirstInstanceにインスタンス番号を書き込むため、drawIndirectFirstInstanceが必要です。
+ * multiDrawIndirectが有効なら1回の呼び出しで、そうでなければ1描画ずつ間接描画します。<br>
+ * 深度ピラミッドを設定すると、2段階の遮蔽カリングを行えます。
+ * Earlyで描画した深度からピラミッドを作り直し、Lateで残りのインスタンスを再判定して描画します。
+ */
+struct InstanceCuller {
+  /** @brief 2段階の遮蔽カリングの段階です。 */
+  enum struct Phase : uint32_t {
+    /** @brief 前回作ったピラミッドで判定します。(遮蔽カリングなしではこの段階のみ) */
+    Early,
+    /** @brief Earlyで描画しなかったインスタンスを、現在の深度のピラミッドで再判定します。 */
+    Late,
+  };
+
+  [[nodiscard]] static bool IsSupported(const Device &device);
+
+  void Setup(const Device &device, const Model &model, uint32_t maxInstances,
+             VkQueue copyQueue, VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief インスタンスを設定します。境界球はモデル全体から求めます。
+   */
+  void SetInstance(uint32_t index, const glm::mat4 &world, uint32_t material);
+  void SetInstanceCount(uint32_t count);
+
+  /**
+   * @brief 遮蔽判定に使う深度ピラミッド(各ミップに最大深度を格納)を設定します。
+   */
+  void SetDepthPyramid(const Device &device,
+                       const VkDescriptorImageInfo &imageInfo, uint32_t width,
+                       uint32_t height, uint32_t levels);
+
+  /**
+   * @brief カメラとLODの許容誤差を更新します。
+   * @param pixelError LOD選択で許容する画面上の誤差(ピクセル)
+   * @param occlusion 深度ピラミッドによる遮蔽カリングを行います。
+   */
+  void Update(const glm::mat4 &viewProj, const Camera &camera,
+              float viewportHeight, float pixelError, bool occlusion = false);
+
+  /**
+   * @brief カリングを記録します。レンダーパスの外で呼び出してください。
+   * @note 遮蔽カリングを行わない場合、Lateは何も描画しません。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer,
+                Phase phase = Phase::Early) const;
+
+  /**
+   * @brief 可視インスタンスを描画します。頂点バッファは呼び出し側でバインドします。
+   */
+  void Draw(VkCommandBuffer commandBuffer, Phase phase = Phase::Early) const;
+
+  /**
+   * @brief 最後に完了したカリングが書き出した描画数(両段階の合計)を返します。
+   */
+  [[nodiscard]] uint32_t GetDrawCount() const;
+
+  Buffer instances{};
+  /** @brief メッシュごとのLOD範囲(uvec2: 先頭, 数) */
+  Buffer meshes{};
+  /** @brief 全メッシュのLOD(インデックス範囲と誤差) */
+  Buffer lods{};
+  /** @brief 段階ごとにmaxDrawsずつ並べた描画コマンド */
+  Buffer drawCommands{};
+  /** @brief 段階ごとの描画数 */
+  Buffer drawCount{};
+  /** @brief Earlyで描画したインスタンス(uint) */
+  Buffer visibility{};
+  Buffer uniformBuffer{};
+
+  Texture2D dummyPyramid{};
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  struct UniformBlock {
+    alignas(16) glm::mat4 viewProj;
+    alignas(16) glm::vec4 planes[6];
+    alignas(16) glm::vec4 cameraPos;
+    /** @brief 距離1あたりの許容誤差(pixelError * 1ピクセルの大きさ) */
+    alignas(4) float lodFactor;
+    alignas(4) float zNear;
+    alignas(4) uint32_t instanceCount;
+    alignas(4) uint32_t maxDraws;
+    alignas(4) uint32_t occlusion;
+    alignas(4) uint32_t pyramidLevels;
+    alignas(8) glm::vec2 pyramidSize;
+  } uniformBlock{};
+
+  /** @brief モデル全体の境界球 */
+  glm::vec4 modelSphere = glm::vec4(0.0f);
+  uint32_t meshCount = 0;
+  uint32_t maxInstances = 0;
+  uint32_t instanceCount = 0;
+  /** @brief 記録する描画数(maxInstances * meshCount) */
+  uint32_t maxDraws = 0;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  bool multiDraw = false;
+  /** @brief 1回の呼び出しで発行できる最大描画数 */
+  uint32_t maxDrawIndirectCount = 1;
+
+private:
+  void SetupBuffers(const Device &device, const Model &model);
+  void SetupDescriptorSet(const Device &device);
+  void SetupPipeline(const Device &device, VkPipelineCache pipelineCache);
+};
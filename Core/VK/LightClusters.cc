@@ -0,0 +1,206 @@
+/**
+ * @brief コンピュートシェーダによるクラスタ(フラスタムボクセル)単位のライトの振り分け
+ */
+
+#include "VK/LightClusters.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "View/Camera.h"
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define LIGHT_CLUSTERS_COMPUTE_SHADER_PATH                                     \
+  "./Assets/Shaders/GLSL/SPIR-V/Lighting/LightClusters.cs.spv"
+
+void LightClusters::Setup(const Device &device, uint32_t maxLights,
+                          VkPipelineCache pipelineCache) {
+  this->maxLights = std::max(maxLights, 1u);
+  uniformBlock.params.gridSize =
+      glm::uvec4(kGridX, kGridY, kGridZ, kMaxLightsPerCluster);
+
+  SetupBuffers(device);
+  SetupDescriptorSet(device);
+  SetupPipeline(device, pipelineCache);
+}
+
+void LightClusters::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  uniformBuffer.Destroy(device);
+  clusterIndices.Destroy(device);
+  clusterCounts.Destroy(device);
+  lights.Destroy(device);
+}
+
+void LightClusters::SetLights(const std::vector<GpuLight> &lights) {
+  BOOST_ASSERT_MSG(lights.size() <= maxLights, "Too many lights!");
+
+  // 全体ライトを先頭に集め、シェーダが範囲で区別できるようにします。
+  auto *dst = static_cast<GpuLight *>(this->lights.mapped);
+  uint32_t count = 0;
+  for (const auto &light : lights) {
+    if (light.position.w == 0.0f) {
+      dst[count++] = light;
+    }
+  }
+  uniformBlock.params.globalLightCount = count;
+  for (const auto &light : lights) {
+    if (light.position.w != 0.0f) {
+      dst[count++] = light;
+    }
+  }
+  uniformBlock.params.lightCount = count;
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void LightClusters::Update(const Camera &camera) {
+  const float zNear = camera.GetNear();
+  const float zFar = camera.GetFar();
+  // スライスk(0 <= k < kGridZ)の深度は near * (far / near)^(k / kGridZ) です。
+  // 深度zのスライスは log(z) * scale + bias で求まります。
+  const float logRatio = std::log(zFar / zNear);
+  const float scale = static_cast<float>(kGridZ) / logRatio;
+  const float bias = -static_cast<float>(kGridZ) * std::log(zNear) / logRatio;
+
+  uniformBlock.invProj = glm::inverse(camera.GetProjectionMatrix());
+  uniformBlock.params.view = camera.GetViewMatrix();
+  uniformBlock.params.zParams = glm::vec4(zNear, zFar, scale, bias);
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void LightClusters::Dispatch(VkCommandBuffer commandBuffer) const {
+  // 前回のライティングが読み終わってから書き込みます。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  // 1つのワークグループが1つのクラスタを担当します。
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdDispatch(commandBuffer, kGridX, kGridY, kGridZ);
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void LightClusters::SetupBuffers(const Device &device) {
+  VK_CHECK_RESULT(lights.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                maxLights * sizeof(GpuLight)));
+  VK_CHECK_RESULT(lights.Map(device));
+
+  VK_CHECK_RESULT(clusterCounts.Create(device,
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       kClusterCount * sizeof(uint32_t)));
+  VK_CHECK_RESULT(clusterIndices.Create(
+      device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      static_cast<VkDeviceSize>(kClusterCount) * kMaxLightsPerCluster *
+          sizeof(uint32_t)));
+
+  VK_CHECK_RESULT(uniformBuffer.Create(device,
+                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       sizeof(UniformBlock)));
+  VK_CHECK_RESULT(uniformBuffer.Map(device));
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void LightClusters::SetupDescriptorSet(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, 1);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+      // Binding 0: パラメータ
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      // Binding 1: ライト
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+      // Binding 2: クラスタごとのライト数
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+      // Binding 3: クラスタごとのライトのインデックス
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                             &descriptorSetLayout, 1);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           &descriptorSet));
+
+  const std::array<VkWriteDescriptorSet, 4> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
+                                      &uniformBuffer.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                      &lights.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2,
+                                      &clusterCounts.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3,
+                                      &clusterIndices.descriptor),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void LightClusters::SetupPipeline(const Device &device,
+                                  VkPipelineCache pipelineCache) {
+  const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo =
+      Initializer::ComputePipelineCreateInfo(pipelineLayout);
+  computePipelineCreateInfo.stage =
+      CreateShader(device, LIGHT_CLUSTERS_COMPUTE_SHADER_PATH,
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                           &computePipelineCreateInfo, nullptr,
+                                           &pipeline));
+  vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
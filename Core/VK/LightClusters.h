@@ -0,0 +1,107 @@
+/**
+ * @brief コンピュートシェーダによるクラスタ(フラスタムボクセル)単位のライトの振り分け
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "VK/Buffer.h"
+
+struct Device;
+class Camera;
+
+/**
+ * @brief GPUへ転送するライトです。(std430)
+ * @note
+ * position.wが0のライトは減衰しない全体ライトで、すべてのクラスタに含まれます。<br>
+ * それ以外のライトはradiusを影響範囲とし、範囲の端で0になるよう減衰させます。
+ */
+struct GpuLight {
+  glm::vec4 position;
+  glm::vec3 color;
+  float radius;
+};
+
+/**
+ * @brief
+ * 視錐台をスクリーンのタイルと指数的な深度のスライスで分割し、
+ * クラスタごとに影響するライトのインデックスを書き出します。
+ * @note
+ * ライティングを行うシェーダは、全体ライトに加えて自身のクラスタのライトだけを評価します。<br>
+ * シェーダはParamsと同じ並びのユニフォームと、lights, clusterCounts,
+ * clusterIndicesのストレージバッファを参照してください。<br>
+ * クラスタ(x, y, z)の番号は x + gridX * (y + gridY * z)
+ * で、yはフレームバッファの上から数えます。
+ */
+struct LightClusters {
+  static constexpr uint32_t kGridX = 16;
+  static constexpr uint32_t kGridY = 9;
+  static constexpr uint32_t kGridZ = 24;
+  static constexpr uint32_t kClusterCount = kGridX * kGridY * kGridZ;
+  /** @brief クラスタあたりの最大ライト数(超えた分は捨てられます) */
+  static constexpr uint32_t kMaxLightsPerCluster = 256;
+
+  /**
+   * @brief ライティングを行うシェーダへ渡すパラメータです。(std140)
+   * @note 呼び出し側のユニフォームバッファにそのまま埋め込んでください。
+   */
+  struct Params {
+    alignas(16) glm::mat4 view;
+    /** @brief xyz: グリッドの分割数, w: クラスタあたりの最大ライト数 */
+    alignas(16) glm::uvec4 gridSize;
+    /** @brief x: near, y: far, z: スライスの倍率, w: スライスのバイアス */
+    alignas(16) glm::vec4 zParams;
+    alignas(4) uint32_t lightCount;
+    alignas(4) uint32_t globalLightCount;
+  };
+
+  void Setup(const Device &device, uint32_t maxLights,
+             VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief ライトを設定します。全体ライトは先頭へ並べ替えます。
+   */
+  void SetLights(const std::vector<GpuLight> &lights);
+
+  /** @brief カメラからクラスタの境界とパラメータを更新します。 */
+  void Update(const Camera &camera);
+
+  /**
+   * @brief 振り分けを記録します。レンダーパスの外で呼び出してください。
+   * @note 結果はフラグメントシェーダとコンピュートシェーダから読めます。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer) const;
+
+  [[nodiscard]] const Params &GetParams() const { return uniformBlock.params; }
+
+  Buffer lights{};
+  /** @brief クラスタごとのライト数(uint) */
+  Buffer clusterCounts{};
+  /** @brief クラスタごとにkMaxLightsPerClusterずつ並べたライトのインデックス */
+  Buffer clusterIndices{};
+  Buffer uniformBuffer{};
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  struct UniformBlock {
+    alignas(16) glm::mat4 invProj;
+    alignas(16) Params params;
+  } uniformBlock{};
+
+  uint32_t maxLights = 0;
+
+private:
+  void SetupBuffers(const Device &device);
+  void SetupDescriptorSet(const Device &device);
+  void SetupPipeline(const Device &device, VkPipelineCache pipelineCache);
+};
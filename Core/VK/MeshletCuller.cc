@@ -0,0 +1,288 @@
+/**
+ * @brief コンピュートシェーダによるメッシュレット単位のGPUカリング
+ */
+
+#include "VK/MeshletCuller.h"
+
+#include <boost/assert.hpp>
+
+#include <array>
+
+#include "View/Frustum.h"
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Model.h"
+#include "VK/Utils.h"
+
+#define MESHLET_CULL_COMPUTE_SHADER_PATH                                       \
+  "./Assets/Shaders/GLSL/SPIR-V/Culling/MeshletCull.cs.spv"
+
+/** @brief シェーダのlocal_size_xと一致させます。 */
+static constexpr uint32_t kWorkGroupSize = 128;
+static_assert(MeshletBuildInfo::kMaxTriangles <= kWorkGroupSize);
+
+void MeshletCuller::Setup(const Device &device, const Model &model,
+                          uint32_t instanceCount, VkQueue copyQueue,
+                          VkPipelineCache pipelineCache) {
+  BOOST_ASSERT_MSG(model.meshletBuffers.meshlets.buffer != VK_NULL_HANDLE,
+                   "Model has no meshlets!");
+
+  this->instanceCount = instanceCount;
+  meshletCount = static_cast<uint32_t>(model.meshlets.meshlets.size());
+  maxIndices = 0;
+  for (const auto &meshlet : model.meshlets.meshlets) {
+    maxIndices += meshlet.triangleCount * 3;
+  }
+
+  // 遮蔽判定を行わない場合に使う、常に遠方を示す1x1の深度ピラミッドです。
+  float farDepth = 1.0f;
+  dummyPyramid.FromBuffer(device, &farDepth, sizeof(float),
+                          VK_FORMAT_R32_SFLOAT, 1, 1, copyQueue,
+                          VK_FILTER_NEAREST);
+
+  SetupBuffers(device);
+  SetupDescriptorSet(device, model);
+  SetupPipeline(device, pipelineCache);
+}
+
+void MeshletCuller::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  dummyPyramid.Destroy(device);
+  uniformBuffer.Destroy(device);
+  instances.Destroy(device);
+  drawCommands.Destroy(device);
+  indices.Destroy(device);
+}
+
+void MeshletCuller::SetDepthPyramid(const Device &device,
+                                    const VkDescriptorImageInfo &imageInfo,
+                                    uint32_t width, uint32_t height,
+                                    uint32_t levels) {
+  VkDescriptorImageInfo info = imageInfo;
+  const VkWriteDescriptorSet writeDescriptorSet =
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &info);
+  vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+  uniformBlock.pyramidSize =
+      glm::vec2(static_cast<float>(width), static_cast<float>(height));
+  uniformBlock.pyramidLevels = levels;
+}
+
+void MeshletCuller::Update(const glm::mat4 &viewProj,
+                           const glm::vec3 &cameraPos,
+                           const std::vector<glm::mat4> &instanceMatrices,
+                           bool occlusion) {
+  BOOST_ASSERT(instanceMatrices.size() == instanceCount);
+
+  const auto planes = Frustum::ExtractPlanes(viewProj);
+  uniformBlock.viewProj = viewProj;
+  for (size_t i = 0; i < planes.size(); i++) {
+    uniformBlock.planes[i] = planes[i];
+  }
+  uniformBlock.cameraPos = glm::vec4(cameraPos, 1.0f);
+  uniformBlock.meshletCount = meshletCount;
+  uniformBlock.maxIndices = maxIndices;
+  uniformBlock.occlusion = occlusion ? 1 : 0;
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+
+  instances.Copy(const_cast<glm::mat4 *>(instanceMatrices.data()),
+                 instanceMatrices.size() * sizeof(glm::mat4));
+}
+
+void MeshletCuller::Dispatch(VkCommandBuffer commandBuffer) const {
+  // 前回の描画による読み込みが終わってから描画コマンドを初期化します。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0,
+                       nullptr, 0, nullptr);
+
+  std::vector<VkDrawIndexedIndirectCommand> commands(instanceCount);
+  for (uint32_t i = 0; i < instanceCount; i++) {
+    commands[i].indexCount = 0;
+    commands[i].instanceCount = 1;
+    commands[i].firstIndex = i * maxIndices;
+    commands[i].vertexOffset = 0;
+    commands[i].firstInstance = 0;
+  }
+  vkCmdUpdateBuffer(commandBuffer, drawCommands.buffer, 0,
+                    commands.size() * sizeof(VkDrawIndexedIndirectCommand),
+                    commands.data());
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  // 1ワークグループが1つのメッシュレットの1インスタンスを担当します。
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdDispatch(commandBuffer, meshletCount, instanceCount, 1);
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                       0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshletCuller::Draw(VkCommandBuffer commandBuffer,
+                         uint32_t instance) const {
+  vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+  vkCmdDrawIndexedIndirect(commandBuffer, drawCommands.buffer,
+                           instance * sizeof(VkDrawIndexedIndirectCommand), 1,
+                           sizeof(VkDrawIndexedIndirectCommand));
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void MeshletCuller::SetupBuffers(const Device &device) {
+  VK_CHECK_RESULT(indices.Create(
+      device,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      static_cast<VkDeviceSize>(std::max(maxIndices, 3u)) * instanceCount *
+          sizeof(uint32_t)));
+  VK_CHECK_RESULT(drawCommands.Create(
+      device,
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      instanceCount * sizeof(VkDrawIndexedIndirectCommand)));
+
+  VK_CHECK_RESULT(instances.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   instanceCount * sizeof(glm::mat4)));
+  VK_CHECK_RESULT(instances.Map(device));
+
+  VK_CHECK_RESULT(uniformBuffer.Create(device,
+                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       sizeof(UniformBlock)));
+  VK_CHECK_RESULT(uniformBuffer.Map(device));
+
+  uniformBlock.pyramidSize = glm::vec2(1.0f);
+  uniformBlock.pyramidLevels = 1;
+}
+
+void MeshletCuller::SetupDescriptorSet(const Device &device,
+                                       const Model &model) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
+      Initializer::DescriptorPoolSize(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, 1);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+      // Binding 0: パラメータ
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      // Binding 1: メッシュレット
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+      // Binding 2: メッシュレットの頂点インデックス
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+      // Binding 3: メッシュレットの三角形
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+      // Binding 4: インスタンスのワールド行列
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+      // Binding 5: 間接描画コマンド
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+      // Binding 6: 出力インデックス
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+      // Binding 7: 深度ピラミッド
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT, 7),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                             &descriptorSetLayout, 1);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           &descriptorSet));
+
+  VkDescriptorBufferInfo meshletsInfo = model.meshletBuffers.meshlets.descriptor;
+  VkDescriptorBufferInfo verticesInfo = model.meshletBuffers.vertices.descriptor;
+  VkDescriptorBufferInfo trianglesInfo =
+      model.meshletBuffers.triangles.descriptor;
+  VkDescriptorImageInfo pyramidInfo = dummyPyramid.descriptor;
+  const std::array<VkWriteDescriptorSet, 8> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
+                                      &uniformBuffer.descriptor),
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &meshletsInfo),
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &verticesInfo),
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &trianglesInfo),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4,
+                                      &instances.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5,
+                                      &drawCommands.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6,
+                                      &indices.descriptor),
+      Initializer::WriteDescriptorSet(
+          descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7,
+          &pyramidInfo),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void MeshletCuller::SetupPipeline(const Device &device,
+                                  VkPipelineCache pipelineCache) {
+  const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo =
+      Initializer::ComputePipelineCreateInfo(pipelineLayout);
+  computePipelineCreateInfo.stage =
+      CreateShader(device, MESHLET_CULL_COMPUTE_SHADER_PATH,
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                           &computePipelineCreateInfo, nullptr,
+                                           &pipeline));
+  vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
@@ -0,0 +1,88 @@
+/**
+ * @brief コンピュートシェーダによるメッシュレット単位のGPUカリング
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "VK/Buffer.h"
+#include "VK/Texture.h"
+
+struct Device;
+struct Model;
+
+/**
+ * @brief
+ * メッシュレットを視錐台、法線コーン、(任意で)深度ピラミッドで判定し、
+ * 可視な三角形をインスタンスごとのインデックスバッファへ詰めて間接描画します。
+ * @note
+ * Vulkan 1.0のコア機能(コンピュートシェーダとvkCmdDrawIndexedIndirect)のみを使用します。<br>
+ * インスタンスiの描画はインデックスバッファ上のi * maxIndicesから始まる範囲を使います。
+ */
+struct MeshletCuller {
+  void Setup(const Device &device, const Model &model, uint32_t instanceCount,
+             VkQueue copyQueue, VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief 遮蔽判定に使う深度ピラミッド(各ミップに最大深度を格納)を設定します。
+   */
+  void SetDepthPyramid(const Device &device,
+                       const VkDescriptorImageInfo &imageInfo, uint32_t width,
+                       uint32_t height, uint32_t levels);
+
+  /**
+   * @brief カメラとインスタンスのワールド行列を更新します。
+   */
+  void Update(const glm::mat4 &viewProj, const glm::vec3 &cameraPos,
+              const std::vector<glm::mat4> &instanceMatrices, bool occlusion);
+
+  /**
+   * @brief カリングを記録します。レンダーパスの外で呼び出してください。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer) const;
+
+  /**
+   * @brief インスタンスの可視三角形を描画します。頂点バッファは呼び出し側でバインドします。
+   */
+  void Draw(VkCommandBuffer commandBuffer, uint32_t instance) const;
+
+  Buffer indices{};
+  Buffer drawCommands{};
+  Buffer instances{};
+  Buffer uniformBuffer{};
+
+  Texture2D dummyPyramid{};
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  struct UniformBlock {
+    alignas(16) glm::mat4 viewProj;
+    alignas(16) glm::vec4 planes[6];
+    alignas(16) glm::vec4 cameraPos;
+    alignas(4) uint32_t meshletCount;
+    alignas(4) uint32_t maxIndices;
+    alignas(4) uint32_t occlusion;
+    alignas(4) uint32_t pyramidLevels;
+    alignas(8) glm::vec2 pyramidSize;
+  } uniformBlock{};
+
+  uint32_t meshletCount = 0;
+  uint32_t instanceCount = 0;
+  /** @brief インスタンスあたりの最大インデックス数(LOD0の全三角形) */
+  uint32_t maxIndices = 0;
+
+private:
+  void SetupBuffers(const Device &device);
+  void SetupDescriptorSet(const Device &device, const Model &model);
+  void SetupPipeline(const Device &device, VkPipelineCache pipelineCache);
+};
@@ -0,0 +1,301 @@
+/**
+ * @brief GPUによるミップマップ生成
+ */
+
+#include "VK/MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define DOWNSAMPLE_COMPUTE_SHADER_PATH                                         \
+  "./Assets/Shaders/GLSL/SPIR-V/Texture/Downsample.cs.spv"
+
+/** @brief シェーダのlocal_sizeと一致させます。 */
+static constexpr uint32_t kWorkGroupSize = 8;
+
+static bool IsSRGB(VkFormat format) {
+  return format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+static bool IsComputeCompatible(VkFormat format) {
+  return format == VK_FORMAT_R8G8B8A8_UNORM ||
+         format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+//*-----------------------------------------------------------------------------
+// Query
+//*-----------------------------------------------------------------------------
+
+uint32_t MipGenerator::GetMipLevelCount(uint32_t width, uint32_t height) {
+  return static_cast<uint32_t>(
+             std::floor(std::log2(std::max(width, height)))) +
+         1;
+}
+
+MipGenerationMethod MipGenerator::SelectMethod(const Device &device,
+                                               VkFormat format) {
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format,
+                                      &formatProperties);
+  const VkFormatFeatureFlags features = formatProperties.optimalTilingFeatures;
+
+  // 線形フィルタでのブリットが可能ならそれを優先します(sRGBは線形空間でフィルタされます)。
+  constexpr VkFormatFeatureFlags blitFeatures =
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  if ((features & blitFeatures) == blitFeatures) {
+    return MipGenerationMethod::Blit;
+  }
+
+  // sRGBはUNORMのビューでストレージイメージとして書き込みます。
+  if (IsComputeCompatible(format)) {
+    vkGetPhysicalDeviceFormatProperties(
+        device.physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+    if (formatProperties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) {
+      return MipGenerationMethod::Compute;
+    }
+  }
+  return MipGenerationMethod::Unsupported;
+}
+
+VkImageUsageFlags MipGenerator::GetImageUsage(MipGenerationMethod method) {
+  switch (method) {
+  case MipGenerationMethod::Blit:
+    return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  case MipGenerationMethod::Compute:
+    return VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  default:
+    return 0;
+  }
+}
+
+VkImageCreateFlags
+MipGenerator::GetImageCreateFlags(MipGenerationMethod method,
+                                  VkFormat format) {
+  if (method == MipGenerationMethod::Compute && IsSRGB(format)) {
+    return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+  }
+  return 0;
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void MipGenerator::Setup(const Device &device, VkImage targetImage,
+                         VkFormat format, uint32_t targetWidth,
+                         uint32_t targetHeight, uint32_t levels) {
+  method = SelectMethod(device, format);
+  image = targetImage;
+  width = targetWidth;
+  height = targetHeight;
+  mipLevels = levels;
+  srgb = IsSRGB(format);
+
+  if (method == MipGenerationMethod::Compute && mipLevels > 1) {
+    SetupCompute(device);
+  }
+}
+
+void MipGenerator::SetupCompute(const Device &device) {
+  // 各レベルをUNORMのストレージイメージとして参照するビューを作ります。
+  views.resize(mipLevels);
+  for (uint32_t i = 0; i < mipLevels; i++) {
+    VK_CHECK_RESULT(CreateImageView(device, views[i], image,
+                                    VK_IMAGE_VIEW_TYPE_2D,
+                                    VK_FORMAT_R8G8B8A8_UNORM,
+                                    VK_IMAGE_ASPECT_COLOR_BIT, i, 1));
+  }
+
+  const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(bindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const uint32_t setCount = mipLevels - 1;
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                      setCount * 2),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, setCount);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  // レベルi+1を書き込むセットiはレベルiを読み込みます。
+  const std::vector<VkDescriptorSetLayout> setLayouts(setCount,
+                                                      descriptorSetLayout);
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool, setLayouts.data(),
+                                             setCount);
+  descriptorSets.resize(setCount);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           descriptorSets.data()));
+  for (uint32_t i = 0; i < setCount; i++) {
+    VkDescriptorImageInfo src = Initializer::DescriptorImageInfo(
+        VK_NULL_HANDLE, views[i], VK_IMAGE_LAYOUT_GENERAL);
+    VkDescriptorImageInfo dst = Initializer::DescriptorImageInfo(
+        VK_NULL_HANDLE, views[i + 1], VK_IMAGE_LAYOUT_GENERAL);
+    const std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+        Initializer::WriteDescriptorSet(descriptorSets[i],
+                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0,
+                                        &src),
+        Initializer::WriteDescriptorSet(descriptorSets[i],
+                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                        &dst),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writeDescriptorSets.size()),
+                           writeDescriptorSets.data(), 0, nullptr);
+  }
+
+  const VkPushConstantRange pushConstantRange = Initializer::PushConstantRange(
+      VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t), 0);
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo =
+      Initializer::ComputePipelineCreateInfo(pipelineLayout);
+  computePipelineCreateInfo.stage = CreateShader(
+      device, DOWNSAMPLE_COMPUTE_SHADER_PATH, VK_SHADER_STAGE_COMPUTE_BIT);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
+                                           &computePipelineCreateInfo, nullptr,
+                                           &pipeline));
+  vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
+
+void MipGenerator::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  for (const auto view : views) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// Record
+//*-----------------------------------------------------------------------------
+
+void MipGenerator::Record(VkCommandBuffer commandBuffer,
+                          VkImageLayout finalLayout) const {
+  if (method == MipGenerationMethod::Compute && mipLevels > 1) {
+    RecordCompute(commandBuffer, finalLayout);
+    return;
+  }
+  if (method == MipGenerationMethod::Blit && mipLevels > 1) {
+    RecordBlit(commandBuffer, finalLayout);
+    return;
+  }
+
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.baseMipLevel = 0;
+  range.levelCount = mipLevels;
+  range.layerCount = 1;
+  TransitionImageLayout(commandBuffer, image, range,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout);
+}
+
+void MipGenerator::RecordBlit(VkCommandBuffer commandBuffer,
+                              VkImageLayout finalLayout) const {
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+
+  for (uint32_t i = 1; i < mipLevels; i++) {
+    // 1つ前のレベルを転送元にします。
+    range.baseMipLevel = i - 1;
+    TransitionImageLayout(commandBuffer, image, range,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(std::max(width >> (i - 1), 1u)),
+                          static_cast<int32_t>(std::max(height >> (i - 1), 1u)),
+                          1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+    blit.dstOffsets[1] = {static_cast<int32_t>(std::max(width >> i, 1u)),
+                          static_cast<int32_t>(std::max(height >> i, 1u)), 1};
+    vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                   VK_FILTER_LINEAR);
+  }
+
+  // 転送元にしたレベルと最後のレベルをそれぞれ最終レイアウトへ遷移させます。
+  range.baseMipLevel = 0;
+  range.levelCount = mipLevels - 1;
+  TransitionImageLayout(commandBuffer, image, range,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, finalLayout);
+  range.baseMipLevel = mipLevels - 1;
+  range.levelCount = 1;
+  TransitionImageLayout(commandBuffer, image, range,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout);
+}
+
+void MipGenerator::RecordCompute(VkCommandBuffer commandBuffer,
+                                 VkImageLayout finalLayout) const {
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.baseMipLevel = 0;
+  range.levelCount = mipLevels;
+  range.layerCount = 1;
+  TransitionImageLayout(commandBuffer, image, range,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  const int32_t srgbFlag = srgb ? 1 : 0;
+  vkCmdPushConstants(commandBuffer, pipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(srgbFlag),
+                     &srgbFlag);
+
+  for (uint32_t i = 1; i < mipLevels; i++) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descriptorSets[i - 1], 0,
+                            nullptr);
+    const uint32_t w = std::max(width >> i, 1u);
+    const uint32_t h = std::max(height >> i, 1u);
+    vkCmdDispatch(commandBuffer, (w + kWorkGroupSize - 1) / kWorkGroupSize,
+                  (h + kWorkGroupSize - 1) / kWorkGroupSize, 1);
+
+    // 書き込んだレベルを次のディスパッチで読み込めるようにします。
+    VkImageMemoryBarrier barrier = Initializer::ImageMemoryBarrier();
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+  }
+
+  TransitionImageLayout(commandBuffer, image, range, VK_IMAGE_LAYOUT_GENERAL,
+                        finalLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+}
@@ -0,0 +1,69 @@
+/**
+ * @brief GPUによるミップマップ生成
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+struct Device;
+
+enum struct MipGenerationMethod {
+  /** @brief 線形フィルタ付きのvkCmdBlitImageで縮小します。 */
+  Blit,
+  /** @brief コンピュートシェーダで縮小します(RGBA8のUNORM/sRGBのみ)。 */
+  Compute,
+  /** @brief どちらにも対応しないためミップを生成できません。 */
+  Unsupported,
+};
+
+/**
+ * @brief
+ * レベル0のみが書き込まれたイメージから残りのミップレベルを生成します。
+ * @note
+ * Setupの前にGetImageUsageとGetImageCreateFlagsを加えてイメージを生成してください。<br>
+ * コンピュートの記述子は1回の記録分だけ確保するため、コマンドバッファの完了後にDestroyしてください。
+ */
+struct MipGenerator {
+  [[nodiscard]] static uint32_t GetMipLevelCount(uint32_t width,
+                                                 uint32_t height);
+  [[nodiscard]] static MipGenerationMethod SelectMethod(const Device &device,
+                                                        VkFormat format);
+  [[nodiscard]] static VkImageUsageFlags
+  GetImageUsage(MipGenerationMethod method);
+  [[nodiscard]] static VkImageCreateFlags
+  GetImageCreateFlags(MipGenerationMethod method, VkFormat format);
+
+  void Setup(const Device &device, VkImage image, VkFormat format,
+             uint32_t width, uint32_t height, uint32_t mipLevels);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief 全レベルがTRANSFER_DST_OPTIMALの状態から縮小を記録し、全レベルをfinalLayoutへ遷移させます。
+   */
+  void Record(VkCommandBuffer commandBuffer, VkImageLayout finalLayout) const;
+
+  MipGenerationMethod method = MipGenerationMethod::Unsupported;
+  VkImage image = VK_NULL_HANDLE;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipLevels = 1;
+  bool srgb = false;
+
+  /** @brief コンピュートで使用する、レベルごとのストレージ用イメージビュー */
+  std::vector<VkImageView> views{};
+  std::vector<VkDescriptorSet> descriptorSets{};
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+private:
+  void RecordBlit(VkCommandBuffer commandBuffer,
+                  VkImageLayout finalLayout) const;
+  void RecordCompute(VkCommandBuffer commandBuffer,
+                     VkImageLayout finalLayout) const;
+  void SetupCompute(const Device &device);
+};
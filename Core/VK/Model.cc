@@ -12,6 +12,8 @@
 #include <boost/assert.hpp>
 #include <iostream>
 
+#include "Geometry/AABB.h"
+#include "Geometry/MeshSimplifier.h"
 #include "VK/Common.h"
 #include "VK/Device.h"
 
@@ -20,6 +22,208 @@ static constexpr uint32_t defaultFlags =
     aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace |
     aiProcess_GenSmoothNormals;
 
+/**
+ * @brief 各メッシュのLODチェーンを生成し、全メッシュのLOD0の後ろへインデックスを追加します。
+ * @note
+ * LODは既存の頂点を参照するため、頂点バッファはすべてのLODで共有されます。
+ */
+static void GenerateLods(std::vector<Model::Mesh> &meshes,
+                         const std::vector<float> &vertexBuffer,
+                         std::vector<uint32_t> &indexBuffer,
+                         const VertexLayout &vertexLayout,
+                         const ModelLodCreateInfo &lodCreateInfo) {
+  for (auto &mesh : meshes) {
+    mesh.lods = {{mesh.indexBase, mesh.indexCount, 0.0f}};
+  }
+
+  const auto posOffset = vertexLayout.Offset(VertexLayoutComponent::Position);
+  if (lodCreateInfo.levels <= 1 || !posOffset.has_value()) {
+    return;
+  }
+
+  const uint32_t stride = vertexLayout.Stride() / sizeof(float);
+  MeshSimplifyOptions options{};
+  options.lockBorder = lodCreateInfo.lockBorder;
+  const std::pair<VertexLayoutComponent, float> weights[] = {
+      {VertexLayoutComponent::Normal, lodCreateInfo.normalWeight},
+      {VertexLayoutComponent::UV, lodCreateInfo.uvWeight},
+      {VertexLayoutComponent::Color, lodCreateInfo.colorWeight},
+  };
+  for (const auto &[component, weight] : weights) {
+    const auto offset = vertexLayout.Offset(component);
+    if (weight > 0.0f && offset.has_value()) {
+      options.attributes.push_back(
+          {static_cast<uint32_t>(*offset / sizeof(float)),
+           static_cast<uint32_t>(VertexLayout::ComponentSize(component) /
+                                 sizeof(float)),
+           weight});
+    }
+  }
+
+  for (auto &mesh : meshes) {
+    if (mesh.indexCount == 0) {
+      continue;
+    }
+    const float *meshVertices = vertexBuffer.data() + mesh.vertexBase * stride;
+
+    std::vector<uint32_t> localIndices(indexBuffer.begin() + mesh.indexBase,
+                                       indexBuffer.begin() + mesh.indexBase +
+                                           mesh.indexCount);
+    for (auto &idx : localIndices) {
+      idx -= mesh.vertexBase;
+    }
+
+    AABB bounds;
+    for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+      const float *p = meshVertices + i * stride + *posOffset / sizeof(float);
+      bounds.Merge(p[0], p[1], p[2]);
+    }
+    const float maxError =
+        lodCreateInfo.maxError * glm::length(bounds.maxi - bounds.mini);
+
+    MeshSimplifier simplifier(meshVertices, mesh.vertexCount, stride,
+                              *posOffset / sizeof(float), localIndices,
+                              options);
+    size_t target = mesh.indexCount;
+    for (uint32_t level = 1; level < lodCreateInfo.levels; level++) {
+      target = static_cast<size_t>(static_cast<float>(target) *
+                                   lodCreateInfo.reduction);
+      const float error = simplifier.Simplify(target, maxError);
+      const auto &result = simplifier.GetIndices();
+      if (result.empty() || result.size() >= mesh.lods.back().indexCount) {
+        // 許容誤差内でこれ以上簡略化できません。
+        break;
+      }
+
+      Model::Mesh::Lod lod{};
+      lod.indexBase = static_cast<uint32_t>(indexBuffer.size());
+      lod.indexCount = static_cast<uint32_t>(result.size());
+      lod.error = error;
+      for (uint32_t idx : result) {
+        indexBuffer.emplace_back(mesh.vertexBase + idx);
+      }
+      mesh.lods.emplace_back(lod);
+    }
+  }
+}
+
+/**
+ * @brief 各メッシュのLOD0からメッシュレットを構築します。
+ */
+static void GenerateMeshlets(std::vector<Model::Mesh> &meshes,
+                             MeshletData &meshlets,
+                             const std::vector<float> &vertexBuffer,
+                             const std::vector<uint32_t> &indexBuffer,
+                             const VertexLayout &vertexLayout) {
+  meshlets = {};
+  const auto posOffset = vertexLayout.Offset(VertexLayoutComponent::Position);
+  if (!posOffset.has_value()) {
+    return;
+  }
+
+  MeshletBuildInfo buildInfo{};
+  buildInfo.stride = vertexLayout.Stride() / sizeof(float);
+  buildInfo.positionOffset = *posOffset / sizeof(float);
+  if (const auto normalOffset =
+          vertexLayout.Offset(VertexLayoutComponent::Normal);
+      normalOffset.has_value()) {
+    buildInfo.normalOffset = *normalOffset / sizeof(float);
+  }
+
+  for (auto &mesh : meshes) {
+    const std::vector<uint32_t> meshIndices(
+        indexBuffer.begin() + mesh.indexBase,
+        indexBuffer.begin() + mesh.indexBase + mesh.indexCount);
+    mesh.meshletOffset = static_cast<uint32_t>(meshlets.meshlets.size());
+    mesh.meshletCount = static_cast<uint32_t>(
+        BuildMeshlets(meshlets, meshIndices, vertexBuffer.data(), buildInfo));
+  }
+}
+
+/**
+ * @brief 各メッシュのLOD0の位置とインデックスをCPUの遮蔽カリング用に保持します。
+ * @note LODは元の面より外へ膨らむことがあり、誤って遮蔽してしまうため使いません。
+ */
+static void GenerateOccluder(const std::vector<Model::Mesh> &meshes,
+                             OccluderMesh &occluder,
+                             const std::vector<float> &vertexBuffer,
+                             const std::vector<uint32_t> &indexBuffer,
+                             const VertexLayout &vertexLayout,
+                             uint32_t vertexCount) {
+  occluder = {};
+  const auto posOffset = vertexLayout.Offset(VertexLayoutComponent::Position);
+  if (!posOffset.has_value()) {
+    return;
+  }
+
+  const size_t stride = vertexLayout.Stride() / sizeof(float);
+  occluder.positions.reserve(vertexCount);
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    const float *p =
+        vertexBuffer.data() + i * stride + *posOffset / sizeof(float);
+    occluder.positions.emplace_back(p[0], p[1], p[2]);
+  }
+  for (const auto &mesh : meshes) {
+    occluder.indices.insert(occluder.indices.end(),
+                            indexBuffer.begin() + mesh.indexBase,
+                            indexBuffer.begin() + mesh.indexBase +
+                                mesh.indexCount);
+  }
+}
+
+/**
+ * @brief 頂点バッファから位置だけを取り出して詰めます。
+ */
+static std::vector<float>
+ExtractPositions(const std::vector<float> &vertexBuffer,
+                 const VertexLayout &vertexLayout, uint32_t vertexCount) {
+  const auto posOffset = vertexLayout.Offset(VertexLayoutComponent::Position);
+  if (!posOffset.has_value()) {
+    return {};
+  }
+
+  const size_t stride = vertexLayout.Stride() / sizeof(float);
+  std::vector<float> positions;
+  positions.reserve(static_cast<size_t>(vertexCount) * 3);
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    const float *p =
+        vertexBuffer.data() + i * stride + *posOffset / sizeof(float);
+    positions.insert(positions.end(), p, p + 3);
+  }
+  return positions;
+}
+
+/**
+ * @brief ステージングバッファを経由してデバイスローカルなバッファを生成します。
+ */
+static void CreateDeviceLocalBuffer(const Device &device, VkQueue copyQueue,
+                                    VkBufferUsageFlags usage, Buffer &buffer,
+                                    void *data, VkDeviceSize size) {
+  // 空のバッファは生成できないため、最低限のサイズを確保します。
+  const VkDeviceSize bufSize = std::max<VkDeviceSize>(size, 4);
+  Buffer staging;
+  VK_CHECK_RESULT(staging.Create(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 bufSize));
+  if (size > 0) {
+    VK_CHECK_RESULT(staging.Map(device));
+    staging.Copy(data, size);
+    staging.Unmap(device);
+  }
+  VK_CHECK_RESULT(buffer.Create(device,
+                                usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bufSize));
+
+  VkCommandBuffer copyCmd = device.CreateCommandBuffer();
+  VkBufferCopy copyRegion{};
+  copyRegion.size = bufSize;
+  vkCmdCopyBuffer(copyCmd, staging.buffer, buffer.buffer, 1, &copyRegion);
+  device.FlushCommandBuffer(copyCmd, copyQueue);
+
+  staging.Destroy(device);
+}
+
 bool Model::LoadFromFile(const Device &device, const std::string &filepath,
                          VkQueue copyQueue, const VertexLayout &vertexLayout,
                          const ModelCreateInfo &modelCreateInfo) {
@@ -114,17 +318,14 @@ bool Model::LoadFromFile(const Device &device, const std::string &filepath,
           break;
         }
       }
-      dim.min.x = std::min(pos.x, dim.min.x);
-      dim.min.y = std::min(pos.y, dim.min.y);
-      dim.min.z = std::min(pos.z, dim.min.z);
-
-      dim.max.x = std::max(pos.x, dim.max.x);
-      dim.max.y = std::max(pos.y, dim.max.y);
-      dim.max.z = std::max(pos.z, dim.max.z);
+      // 頂点バッファと同じ座標系で寸法を保持します。
+      const glm::vec3 p = glm::vec3(pos.x, pos.y, pos.z) * scale + center;
+      dim.min = glm::min(dim.min, p);
+      dim.max = glm::max(dim.max, p);
     }
     meshes[i].vertexCount = mesh->mNumVertices;
 
-    const auto indexBase = static_cast<uint32_t>(indexBuffer.size());
+    const uint32_t indexBase = meshes[i].vertexBase;
     for (uint32_t j = 0; j < mesh->mNumFaces; j++) {
       const aiFace &face = mesh->mFaces[j];
       if (face.mNumIndices != 3) {
@@ -138,6 +339,54 @@ bool Model::LoadFromFile(const Device &device, const std::string &filepath,
     }
   }
 
+  GenerateLods(meshes, vertexBuffer, indexBuffer, vertexLayout,
+               modelCreateInfo.lod);
+  if (modelCreateInfo.buildOccluder) {
+    GenerateOccluder(meshes, occluder, vertexBuffer, indexBuffer, vertexLayout,
+                     vertexCount);
+  }
+  if (modelCreateInfo.buildMeshlets) {
+    GenerateMeshlets(meshes, meshlets, vertexBuffer, indexBuffer,
+                     vertexLayout);
+
+    std::vector<GpuMeshlet> gpuMeshlets;
+    gpuMeshlets.reserve(meshlets.meshlets.size());
+    for (const auto &m : meshlets.meshlets) {
+      gpuMeshlets.push_back({glm::vec4(m.bounds.center, m.bounds.radius),
+                             glm::vec4(m.coneAxis, m.coneCutoff),
+                             m.vertexOffset, m.triangleOffset, m.vertexCount,
+                             m.triangleCount});
+    }
+    // シェーダで扱いやすいよう、三角形ごとに32bitへ詰めます。
+    std::vector<uint32_t> packedTriangles(meshlets.triangles.size() / 3);
+    for (size_t t = 0; t < packedTriangles.size(); t++) {
+      packedTriangles[t] = meshlets.triangles[t * 3 + 0] |
+                           (meshlets.triangles[t * 3 + 1] << 8) |
+                           (meshlets.triangles[t * 3 + 2] << 16);
+    }
+    CreateDeviceLocalBuffer(device, copyQueue,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            meshletBuffers.meshlets, gpuMeshlets.data(),
+                            gpuMeshlets.size() * sizeof(GpuMeshlet));
+    CreateDeviceLocalBuffer(device, copyQueue,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            meshletBuffers.vertices, meshlets.vertices.data(),
+                            meshlets.vertices.size() * sizeof(uint32_t));
+    CreateDeviceLocalBuffer(device, copyQueue,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            meshletBuffers.triangles, packedTriangles.data(),
+                            packedTriangles.size() * sizeof(uint32_t));
+  }
+  if (modelCreateInfo.buildPositions) {
+    // 深度だけの描画では法線などを読まないため、位置だけを詰めて帯域を減らします。
+    std::vector<float> positionBuffer =
+        ExtractPositions(vertexBuffer, vertexLayout, vertexCount);
+    CreateDeviceLocalBuffer(device, copyQueue,
+                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, positions,
+                            positionBuffer.data(),
+                            positionBuffer.size() * sizeof(float));
+  }
+
   const auto vtxBufSize =
       static_cast<uint32_t>(vertexBuffer.size()) * sizeof(float);
   const auto idxBufSize =
@@ -188,6 +437,48 @@ bool Model::LoadFromFile(const Device &device, const std::string &filepath,
 }
 
 void Model::Destroy(const Device &device) const {
+  positions.Destroy(device);
+  meshletBuffers.triangles.Destroy(device);
+  meshletBuffers.vertices.Destroy(device);
+  meshletBuffers.meshlets.Destroy(device);
   indices.Destroy(device);
   vertices.Destroy(device);
 }
+
+/**
+ * @brief 画面上の誤差がpixelError以下に収まる最も粗いLODレベルを選択します。
+ * @param world モデルのワールド行列
+ * @param viewportHeight ビューポートの高さ(ピクセル)
+ * @note 全メッシュで共通のレベルを返すため、描画時はMesh::GetLodで範囲を取得します。
+ */
+uint32_t Model::SelectLod(const glm::mat4 &world, const Camera &camera,
+                          float viewportHeight, float pixelError) const {
+  // モデルの境界球をワールド空間へ変換します。
+  const float scale = std::max({glm::length(glm::vec3(world[0])),
+                                glm::length(glm::vec3(world[1])),
+                                glm::length(glm::vec3(world[2]))});
+  const glm::vec3 center =
+      glm::vec3(world * glm::vec4(0.5f * (dim.min + dim.max), 1.0f));
+  const float radius = 0.5f * glm::length(dim.max - dim.min) * scale;
+
+  // 境界球の最近点における1ピクセルあたりのワールド空間の長さを求めます。
+  const float distance =
+      std::max(glm::length(center - camera.GetPosition()) - radius,
+               camera.GetNear());
+  const float pixelSize = 2.0f * distance *
+                          std::tan(0.5f * camera.GetFOVY()) / viewportHeight;
+  const float threshold = pixelError * pixelSize;
+
+  uint32_t level = std::numeric_limits<uint32_t>::max();
+  for (const auto &mesh : meshes) {
+    uint32_t meshLevel = 0;
+    for (uint32_t l = 1; l < mesh.lods.size(); l++) {
+      if (mesh.lods[l].error * scale > threshold) {
+        break;
+      }
+      meshLevel = l;
+    }
+    level = std::min(level, meshLevel);
+  }
+  return meshes.empty() ? 0 : level;
+}
@@ -12,13 +12,17 @@
 
 #include <assimp/postprocess.h>
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
 #include <optional>
 
+#include "Geometry/Meshlet.h"
 #include "VK/Buffer.h"
 #include "VK/Device.h"
+#include "View/Camera.h"
+#include "View/OcclusionRasterizer.h"
 
 enum struct VertexLayoutComponent {
   Position = 0x00,
@@ -39,32 +43,87 @@ struct VertexLayout {
       std::vector<VertexLayoutComponent> &&vertexLayoutComponents)
       : components(std::move(vertexLayoutComponents)) {}
 
-  [[nodiscard]] uint32_t Stride() const {
+  [[nodiscard]] static uint32_t ComponentSize(VertexLayoutComponent component) {
     static const std::map<VertexLayoutComponent, uint32_t> c2s = {
         {VertexLayoutComponent::UV, 2 * sizeof(float)},
         {VertexLayoutComponent::DummyFloat, sizeof(float)},
         {VertexLayoutComponent::DummyVec4, 4 * sizeof(float)},
     };
+    return c2s.contains(component) ? c2s.at(component) : 3 * sizeof(float);
+  }
 
+  [[nodiscard]] uint32_t Stride() const {
     uint32_t res = 0;
     for (const auto &component : components) {
-      if (c2s.contains(component)) {
-        res += c2s.at(component);
-      } else {
-        res += 3 * sizeof(float);
-      }
+      res += ComponentSize(component);
     }
     return res;
   }
+
+  /**
+   * @brief 頂点先頭からコンポーネントまでのオフセット(バイト単位)を返します。
+   */
+  [[nodiscard]] std::optional<uint32_t>
+  Offset(VertexLayoutComponent component) const {
+    uint32_t res = 0;
+    for (const auto &c : components) {
+      if (c == component) {
+        return res;
+      }
+      res += ComponentSize(c);
+    }
+    return std::nullopt;
+  }
   std::vector<VertexLayoutComponent> components;
 };
 
+/**
+ * @brief 二次誤差計量によるLODチェーンの生成パラメータです。
+ */
+struct ModelLodCreateInfo {
+  /** @brief LOD0を含むレベル数(1ならLODを生成しません) */
+  uint32_t levels = 1;
+  /** @brief 前のレベルに対するインデックス数の比率 */
+  float reduction = 0.5f;
+  /** @brief メッシュの対角線長に対する許容誤差の比率 */
+  float maxError = 0.05f;
+  /** @brief 開いた境界上の頂点を固定します。 */
+  bool lockBorder = false;
+  /** @brief 法線の差に対する重み(0なら位置のみで評価します) */
+  float normalWeight = 0.0f;
+  /** @brief UVの差に対する重み */
+  float uvWeight = 0.0f;
+  /** @brief 頂点カラーの差に対する重み */
+  float colorWeight = 0.0f;
+};
+
 struct ModelCreateInfo {
   glm::vec3 center = glm::vec3(0.0f);
   glm::vec3 scale = glm::vec3(1.0f);
   glm::vec2 uvscale = glm::vec2(1.0f);
   std::optional<glm::vec3> color = std::nullopt;
   VkMemoryPropertyFlags memoryPropertyFlags = 0;
+  ModelLodCreateInfo lod{};
+  /** @brief LOD0からGPUカリング用のメッシュレットを構築します。 */
+  bool buildMeshlets = false;
+  /** @brief LOD0の位置をCPUの遮蔽カリング用に保持します。 */
+  bool buildOccluder = false;
+  /** @brief 深度だけの描画用に、位置だけを詰めた頂点バッファを生成します。 */
+  bool buildPositions = false;
+};
+
+/**
+ * @brief GPUへ転送するメッシュレットです。(std430)
+ */
+struct GpuMeshlet {
+  /** @brief xyz: 境界球の中心, w: 半径 */
+  glm::vec4 sphere;
+  /** @brief xyz: 法線コーンの軸, w: カットオフ */
+  glm::vec4 cone;
+  uint32_t vertexOffset;
+  uint32_t triangleOffset;
+  uint32_t vertexCount;
+  uint32_t triangleCount;
 };
 
 struct Model {
@@ -73,8 +132,17 @@ struct Model {
                     const ModelCreateInfo &modelCreateInfo = {});
   void Destroy(const Device &device) const;
 
+  [[nodiscard]] uint32_t SelectLod(const glm::mat4 &world, const Camera &camera,
+                                   float viewportHeight,
+                                   float pixelError = 1.0f) const;
+
   Buffer vertices{};
   uint32_t vertexCount = 0;
+  /**
+   * @brief 位置(vec3)だけを詰めた頂点バッファ(ModelCreateInfo::buildPositionsが有効な場合のみ)
+   * @note 頂点の並びはverticesと同じため、インデックスバッファを共有できます。
+   */
+  Buffer positions{};
   Buffer indices{};
   uint32_t indexCount = 0;
   /**
@@ -85,9 +153,46 @@ struct Model {
     uint32_t vertexCount = 0;
     uint32_t indexBase = 0;
     uint32_t indexCount = 0;
+
+    /**
+     * @brief 共有頂点バッファを参照するLODごとのインデックス範囲です。
+     * @note lods[0]は元のメッシュ(indexBase, indexCount)と同じ範囲です。
+     */
+    struct Lod {
+      uint32_t indexBase = 0;
+      uint32_t indexCount = 0;
+      /** @brief 簡略化による幾何誤差(モデル空間の距離) */
+      float error = 0.0f;
+    };
+    std::vector<Lod> lods{};
+
+    /** @brief Model::meshlets内の範囲 */
+    uint32_t meshletOffset = 0;
+    uint32_t meshletCount = 0;
+
+    [[nodiscard]] const Lod &GetLod(uint32_t level) const {
+      return lods[std::min(level, static_cast<uint32_t>(lods.size()) - 1)];
+    }
   };
   std::vector<Mesh> meshes{};
 
+  /**
+   * @brief 全メッシュのメッシュレット(ModelCreateInfo::buildMeshletsが有効な場合のみ)
+   * @note 頂点インデックスは頂点バッファ全体を参照します。
+   */
+  MeshletData meshlets{};
+  /** @brief CPUの遮蔽物(ModelCreateInfo::buildOccluderが有効な場合のみ) */
+  OccluderMesh occluder{};
+  /** @brief メッシュレットを格納したストレージバッファ */
+  struct {
+    /** @brief GpuMeshletの配列 */
+    Buffer meshlets{};
+    /** @brief メッシュレットのローカル頂点から頂点バッファへのインデックス */
+    Buffer vertices{};
+    /** @brief 三角形ごとにローカル頂点インデックスを8bitずつ詰めたもの */
+    Buffer triangles{};
+  } meshletBuffers;
+
   struct Dimension {
     glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
     glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
@@ -0,0 +1,251 @@
+/**
+ * @brief コンピュートシェーダによる分離可能なガウシアン・バイラテラルぼかし
+ */
+
+#include "VK/SeparableBlur.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define SEPARABLE_BLUR_COMPUTE_SHADER_PATH                                     \
+  "./Assets/Shaders/GLSL/SPIR-V/PostProcess/SeparableBlur.cs.spv"
+
+glm::vec4 SeparableBlur::GetDepthParams(const glm::mat4 &invProj) {
+  // ビュー空間のzは負の向きのため、符号を反転して距離にします。
+  return glm::vec4(-invProj[2][2], -invProj[3][2], invProj[2][3],
+                   invProj[3][3]);
+}
+
+void SeparableBlur::Setup(const Device &device, uint32_t width,
+                          uint32_t height, VkQueue copyQueue,
+                          VkPipelineCache pipelineCache) {
+  this->width = width;
+  this->height = height;
+
+  SetupImages(device, copyQueue);
+  SetupDescriptorSets(device);
+  SetupPipelines(device, pipelineCache);
+}
+
+void SeparableBlur::Destroy(const Device &device) const {
+  for (const auto pipeline : pipelines) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+  }
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroySampler(device, sampler, nullptr);
+  vkDestroyImageView(device, intermediateView, nullptr);
+  vkDestroyImage(device, intermediateImage, nullptr);
+  vkFreeMemory(device, intermediateMemory, nullptr);
+  vkDestroyImageView(device, view, nullptr);
+  vkDestroyImage(device, image, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void SeparableBlur::SetSource(const Device &device,
+                              const VkDescriptorImageInfo &source,
+                              const VkDescriptorImageInfo *guide) {
+  const VkDescriptorImageInfo &guideInfo = guide ? *guide : source;
+  const VkDescriptorImageInfo intermediateInfo =
+      Initializer::DescriptorImageInfo(sampler, intermediateView,
+                                       VK_IMAGE_LAYOUT_GENERAL);
+  const VkDescriptorImageInfo intermediateStorage =
+      Initializer::DescriptorImageInfo(VK_NULL_HANDLE, intermediateView,
+                                       VK_IMAGE_LAYOUT_GENERAL);
+  const VkDescriptorImageInfo outputStorage = Initializer::DescriptorImageInfo(
+      VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+
+  constexpr VkDescriptorType sampled =
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  constexpr VkDescriptorType storage = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  const std::array<VkWriteDescriptorSet, 6> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSets[0], sampled, 0, &source),
+      Initializer::WriteDescriptorSet(descriptorSets[0], sampled, 1,
+                                      &guideInfo),
+      Initializer::WriteDescriptorSet(descriptorSets[0], storage, 2,
+                                      &intermediateStorage),
+      Initializer::WriteDescriptorSet(descriptorSets[1], sampled, 0,
+                                      &intermediateInfo),
+      Initializer::WriteDescriptorSet(descriptorSets[1], sampled, 1,
+                                      &guideInfo),
+      Initializer::WriteDescriptorSet(descriptorSets[1], storage, 2,
+                                      &outputStorage),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void SeparableBlur::Dispatch(VkCommandBuffer commandBuffer, BlurFilter filter,
+                             const Params &params) const {
+  // 入力の書き込みと、前回の結果の読み込みが終わってから書き込みます。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pipelines[static_cast<size_t>(filter)]);
+
+  PushConstants pushConstants{};
+  pushConstants.depthParams = params.depthParams;
+  pushConstants.radius = std::clamp(params.radius, 0, kMaxRadius);
+  pushConstants.sigma = params.sigma > 0.0f
+                            ? params.sigma
+                            : std::max(0.5f * pushConstants.radius, 0.5f);
+  pushConstants.depthSigma = params.depthSigma;
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    // 横方向は行ごと、縦方向は列ごとにワークグループを並べます。
+    const bool horizontal = pass == 0;
+    pushConstants.direction[0] = horizontal ? 1 : 0;
+    pushConstants.direction[1] = horizontal ? 0 : 1;
+    const uint32_t length = horizontal ? width : height;
+    const uint32_t lines = horizontal ? height : width;
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descriptorSets[pass], 0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, (length + kTileSize - 1) / kTileSize, lines,
+                  1);
+
+    // 縦方向のパスと、結果を参照するフラグメントシェーダが読みます。
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+  }
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void SeparableBlur::SetupImages(const Device &device, VkQueue copyQueue) {
+  const std::array<std::pair<VkImage *, VkDeviceMemory *>, 2> targets = {{
+      {&image, &memory},
+      {&intermediateImage, &intermediateMemory},
+  }};
+  for (const auto &[dstImage, dstMemory] : targets) {
+    VK_CHECK_RESULT(CreateImage(
+        device, *dstImage, *dstMemory, kFormat, VK_IMAGE_TYPE_2D, width,
+        height, 1, 1, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_TILING_OPTIMAL));
+  }
+  VK_CHECK_RESULT(CreateImageView(device, view, image, VK_IMAGE_VIEW_TYPE_2D,
+                                  kFormat, VK_IMAGE_ASPECT_COLOR_BIT));
+  VK_CHECK_RESULT(CreateImageView(device, intermediateView, intermediateImage,
+                                  VK_IMAGE_VIEW_TYPE_2D, kFormat,
+                                  VK_IMAGE_ASPECT_COLOR_BIT));
+  VK_CHECK_RESULT(CreateSampler(
+      device, sampler, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST));
+  descriptor = Initializer::DescriptorImageInfo(sampler, view,
+                                                VK_IMAGE_LAYOUT_GENERAL);
+
+  // 読み書きのどちらにも使うため、イメージはGENERALのまま使用します。
+  VkCommandBuffer commandBuffer =
+      device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+  TransitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+  TransitionImageLayout(commandBuffer, intermediateImage,
+                        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_GENERAL);
+  device.FlushCommandBuffer(commandBuffer, copyQueue);
+}
+
+void SeparableBlur::SetupDescriptorSets(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      4),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, 2);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+      // Binding 0: 入力
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      // Binding 1: バイラテラルぼかしのガイド(深度)
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT, 1),
+      // Binding 2: 出力
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                              VK_SHADER_STAGE_COMPUTE_BIT, 2),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const std::array<VkDescriptorSetLayout, 2> setLayouts = {
+      descriptorSetLayout, descriptorSetLayout};
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(
+          descriptorPool, setLayouts.data(),
+          static_cast<uint32_t>(setLayouts.size()));
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           descriptorSets.data()));
+}
+
+void SeparableBlur::SetupPipelines(const Device &device,
+                                   VkPipelineCache pipelineCache) {
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  const VkPushConstantRange pushConstantRange = Initializer::PushConstantRange(
+      VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  // フィルタの種類は特殊化定数で切り替え、シェーダ内の分岐をなくします。
+  for (size_t i = 0; i < pipelines.size(); i++) {
+    const VkBool32 bilateral =
+        static_cast<BlurFilter>(i) == BlurFilter::Bilateral ? VK_TRUE
+                                                            : VK_FALSE;
+    const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+        Initializer::SpecializationMapEntry(0, 0, sizeof(VkBool32)),
+    };
+    VkSpecializationInfo specializationInfo = Initializer::SpecializationInfo(
+        specializationMapEntries, sizeof(VkBool32), &bilateral);
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo =
+        Initializer::ComputePipelineCreateInfo(pipelineLayout);
+    computePipelineCreateInfo.stage =
+        CreateShader(device, SEPARABLE_BLUR_COMPUTE_SHADER_PATH,
+                     VK_SHADER_STAGE_COMPUTE_BIT, &specializationInfo);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                             &computePipelineCreateInfo,
+                                             nullptr, &pipelines[i]));
+    vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                          nullptr);
+  }
+}
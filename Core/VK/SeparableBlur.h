@@ -0,0 +1,108 @@
+/**
+ * @brief コンピュートシェーダによる分離可能なガウシアン・バイラテラルぼかし
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+struct Device;
+
+enum struct BlurFilter {
+  /** @brief 距離だけで重みを決めるガウシアンぼかし */
+  Gaussian,
+  /** @brief ガイドの深度が近いテクセルだけを混ぜるバイラテラルぼかし */
+  Bilateral,
+};
+
+/**
+ * @brief
+ * 横と縦の2回のコンピュートパスで入力をぼかし、ストレージイメージへ書き込みます。
+ * @note
+ * ワークグループは1行(1列)のkTileSizeテクセルを担当し、半径分の余白を含めて共有メモリへ一度だけ読み込みます。
+ * そのため、1テクセルあたりのコストは半径に比例します。<br>
+ * 入力のrだけをぼかし、出力はkFormatで、VK_IMAGE_LAYOUT_GENERALのままdescriptorを渡して読み込んでください。<br>
+ * バイラテラルぼかしのガイドは入力と同じ大きさで、rに深度を持つ必要があります。
+ */
+struct SeparableBlur {
+  /** @brief ワークグループの大きさ(テクセル)。シェーダのlocal_sizeと一致させます。 */
+  static constexpr uint32_t kTileSize = 128;
+  /** @brief 共有メモリに読み込む余白の最大値(テクセル) */
+  static constexpr int32_t kMaxRadius = 32;
+  /** @brief 出力と途中の結果の形式。r32fはStorageImageExtendedFormatsなしで書き込めます。 */
+  static constexpr VkFormat kFormat = VK_FORMAT_R32_SFLOAT;
+
+  struct Params {
+    /** @brief ぼかしの半径(テクセル)。kMaxRadiusまでに制限します。 */
+    int32_t radius = 4;
+    /** @brief ガウス関数の標準偏差。0以下の場合は半径の半分を使います。 */
+    float sigma = 0.0f;
+    /** @brief 深度の差を許容する割合(ビュー空間の距離に対する比) */
+    float depthSigma = 0.05f;
+    /** @brief ガイドの深度をビュー空間の距離へ変換する係数(GetDepthParams) */
+    glm::vec4 depthParams{1.0f, 0.0f, 0.0f, 1.0f};
+  };
+
+  /**
+   * @brief 射影行列の逆行列から、深度をビュー空間の距離へ変換する係数を求めます。
+   * @note 距離は (x * depth + y) / (z * depth + w) です。ガイドが距離の場合は既定値を使います。
+   */
+  [[nodiscard]] static glm::vec4 GetDepthParams(const glm::mat4 &invProj);
+
+  void Setup(const Device &device, uint32_t width, uint32_t height,
+             VkQueue copyQueue, VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief 入力とガイドを設定します。
+   * @param guide バイラテラルぼかしのガイド。nullptrの場合は入力を使います。
+   */
+  void SetSource(const Device &device, const VkDescriptorImageInfo &source,
+                 const VkDescriptorImageInfo *guide = nullptr);
+
+  /**
+   * @brief ぼかしを記録します。レンダーパスの外で呼び出してください。
+   * @note 入力はカラーアタッチメントとして書き込んだ後に渡し、結果はフラグメントシェーダから読めます。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer, BlurFilter filter,
+                const Params &params) const;
+
+  /** @brief ぼかした結果 */
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  /** @brief 横方向にぼかした途中の結果 */
+  VkImage intermediateImage = VK_NULL_HANDLE;
+  VkDeviceMemory intermediateMemory = VK_NULL_HANDLE;
+  VkImageView intermediateView = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkDescriptorImageInfo descriptor{};
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  /** @brief 0: 横方向(入力->途中), 1: 縦方向(途中->出力) */
+  std::array<VkDescriptorSet, 2> descriptorSets{};
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  /** @brief BlurFilterの順に並べたパイプライン */
+  std::array<VkPipeline, 2> pipelines{};
+
+  struct PushConstants {
+    alignas(16) glm::vec4 depthParams;
+    alignas(8) int32_t direction[2];
+    alignas(4) int32_t radius;
+    alignas(4) float sigma;
+    alignas(4) float depthSigma;
+  };
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+private:
+  void SetupImages(const Device &device, VkQueue copyQueue);
+  void SetupDescriptorSets(const Device &device);
+  void SetupPipelines(const Device &device, VkPipelineCache pipelineCache);
+};
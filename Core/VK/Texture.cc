@@ -11,9 +11,11 @@
 #include <gli/gli.hpp>
 #include <iostream>
 
+#include "Image/KtxFormat.h"
 #include "VK/Common.h"
 #include "VK/Device.h"
 #include "VK/Initializer.h"
+#include "VK/MipGenerator.h"
 #include "VK/Utils.h"
 
 void Texture::Destroy(const Device &device) const {
@@ -25,10 +27,62 @@ void Texture::Destroy(const Device &device) const {
   vkFreeMemory(device, memory, nullptr);
 }
 
+std::optional<VkFormat> FindCompressedFormat(const Device &device,
+                                             uint32_t glInternalFormat) {
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  switch (glInternalFormat) {
+  case Ktx::kCompressedRGB_BC1:
+    format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    break;
+  case Ktx::kCompressedSRGB_BC1:
+    format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    break;
+  case Ktx::kCompressedRGBA_BC1:
+    format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    break;
+  case Ktx::kCompressedSRGBA_BC1:
+    format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    break;
+  case Ktx::kCompressedRGBA_BC3:
+    format = VK_FORMAT_BC3_UNORM_BLOCK;
+    break;
+  case Ktx::kCompressedSRGBA_BC3:
+    format = VK_FORMAT_BC3_SRGB_BLOCK;
+    break;
+  case Ktx::kCompressedR_BC4:
+    format = VK_FORMAT_BC4_UNORM_BLOCK;
+    break;
+  case Ktx::kCompressedRG_BC5:
+    format = VK_FORMAT_BC5_UNORM_BLOCK;
+    break;
+  case Ktx::kCompressedRGBA_BC7:
+    format = VK_FORMAT_BC7_UNORM_BLOCK;
+    break;
+  case Ktx::kCompressedSRGBA_BC7:
+    format = VK_FORMAT_BC7_SRGB_BLOCK;
+    break;
+  default:
+    return std::nullopt;
+  }
+
+  if (!device.enabledFeatures.textureCompressionBC) {
+    return std::nullopt;
+  }
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format,
+                                      &formatProperties);
+  if ((formatProperties.optimalTilingFeatures &
+       VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+    return std::nullopt;
+  }
+  return format;
+}
+
 void Texture2D::Load(const Device &device, const std::string &filepath,
                      VkQueue copyQueue, VkFormat format,
                      VkImageUsageFlags imageUsageFlags,
-                     VkImageLayout imageLayout, bool useStaging) {
+                     VkImageLayout imageLayout, bool useStaging,
+                     bool generateMips) {
   std::error_code ec;
   if (!std::filesystem::exists(filepath, ec)) {
     std::cerr << "Failed to load texture from " << filepath << std::endl;
@@ -43,6 +97,38 @@ void Texture2D::Load(const Device &device, const std::string &filepath,
   height = static_cast<uint32_t>(tex2d[0].extent().y);
   mipLevels = static_cast<uint32_t>(tex2d.levels());
 
+  // 圧縮済みのファイルはそのままのフォーマットで転送します。
+  if (gli::is_compressed(tex2d.format())) {
+    const gli::gl gl(gli::gl::PROFILE_GL33);
+    const gli::gl::format glFormat =
+        gl.translate(tex2d.format(), tex2d.swizzles());
+    const auto compressed =
+        FindCompressedFormat(device, static_cast<uint32_t>(glFormat.Internal));
+    if (!compressed) {
+      std::cerr << filepath << ": compressed format is not supported."
+                << std::endl;
+      BOOST_ASSERT_MSG(compressed, "Unsupported compressed texture format!");
+      return;
+    }
+    BOOST_ASSERT_MSG(useStaging,
+                     "Compressed textures require a staging upload!");
+    format = *compressed;
+  }
+
+  // ファイルにミップが含まれない場合はGPUで生成します。
+  const uint32_t fileLevels = mipLevels;
+  MipGenerationMethod mipMethod = MipGenerationMethod::Unsupported;
+  if (generateMips && useStaging && fileLevels == 1 &&
+      !gli::is_compressed(tex2d.format())) {
+    mipMethod = MipGenerator::SelectMethod(device, format);
+    if (mipMethod != MipGenerationMethod::Unsupported) {
+      mipLevels = MipGenerator::GetMipLevelCount(width, height);
+    } else {
+      std::cerr << filepath << ": mipmap generation is not supported."
+                << std::endl;
+    }
+  }
+
   // 要求されたテクスチャ形式のデバイスプロパティを取得します。
   VkFormatProperties formatProperties;
   vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format,
@@ -66,7 +152,7 @@ void Texture2D::Load(const Device &device, const std::string &filepath,
     // バッファコピー領域を設定します。
     std::vector<VkBufferImageCopy> bufferImageCopyRegions{};
     uint32_t offset = 0;
-    for (uint32_t i = 0; i < mipLevels; i++) {
+    for (uint32_t i = 0; i < fileLevels; i++) {
       VkBufferImageCopy bufferImageCopyRegion{};
       bufferImageCopyRegion.imageSubresource.aspectMask =
           VK_IMAGE_ASPECT_COLOR_BIT;
@@ -98,6 +184,8 @@ void Texture2D::Load(const Device &device, const std::string &filepath,
     if ((imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0) {
       imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
+    imageCreateInfo.usage |= MipGenerator::GetImageUsage(mipMethod);
+    imageCreateInfo.flags |= MipGenerator::GetImageCreateFlags(mipMethod, format);
     VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &image));
 
     VkMemoryRequirements memoryRequirements{};
@@ -127,12 +215,19 @@ void Texture2D::Load(const Device &device, const std::string &filepath,
                            static_cast<uint32_t>(bufferImageCopyRegions.size()),
                            bufferImageCopyRegions.data());
 
-    // すべてコピーされた後、テクスチャのイメージレイアウトを変更します。
-    TransitionImageLayout(copyCommand, image, imageSubresourceRange,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+    // すべてコピーされた後、必要ならミップを生成してイメージレイアウトを変更します。
+    MipGenerator mipGenerator{};
+    if (mipLevels > fileLevels) {
+      mipGenerator.Setup(device, image, format, width, height, mipLevels);
+      mipGenerator.Record(copyCommand, imageLayout);
+    } else {
+      TransitionImageLayout(copyCommand, image, imageSubresourceRange,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+    }
     device.FlushCommandBuffer(copyCommand, copyQueue);
 
     // ステージングリソースを破棄します。
+    mipGenerator.Destroy(device);
     vkFreeMemory(device, stagingMemory, nullptr);
     vkDestroyBuffer(device, stagingBuffer, nullptr);
   } else {
@@ -256,13 +351,25 @@ void Texture2D::FromBuffer(const Device &device, void *buffer,
                            uint32_t texWidth, uint32_t texHeight,
                            VkQueue copyQueue, VkFilter filter,
                            VkImageUsageFlags imageUsageFlags,
-                           VkImageLayout imageLayout) {
+                           VkImageLayout imageLayout, bool generateMips) {
   BOOST_ASSERT(buffer);
 
   width = texWidth;
   height = texHeight;
   mipLevels = 1;
 
+  // バッファはレベル0のみを含むため、ミップはGPUで生成します。
+  MipGenerationMethod mipMethod = MipGenerationMethod::Unsupported;
+  if (generateMips) {
+    mipMethod = MipGenerator::SelectMethod(device, format);
+    if (mipMethod != MipGenerationMethod::Unsupported) {
+      mipLevels = MipGenerator::GetMipLevelCount(width, height);
+    } else {
+      std::cerr << "Mipmap generation is not supported for format " << format
+                << std::endl;
+    }
+  }
+
   VkCommandBuffer copyCmd = device.CreateCommandBuffer();
 
   // 生の画像データを含むホストに表示されるステージングバッファを生成します。
@@ -307,8 +414,10 @@ void Texture2D::FromBuffer(const Device &device, void *buffer,
   // 最適なタイルターゲット画像を生成します。
   CreateImage(device, image, memory, format, VK_IMAGE_TYPE_2D, width, height, 1,
               mipLevels, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-              imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-              VK_IMAGE_TILING_OPTIMAL);
+              imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                  MipGenerator::GetImageUsage(mipMethod),
+              VK_IMAGE_TILING_OPTIMAL, VK_SAMPLE_COUNT_1_BIT,
+              MipGenerator::GetImageCreateFlags(mipMethod, format));
 
   // イメージバリア
   VkImageSubresourceRange imageSubresourceRange{};
@@ -325,20 +434,31 @@ void Texture2D::FromBuffer(const Device &device, void *buffer,
                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
                          &bufferCopyRegion);
 
-  // すべてのミップレベルがコピーされた後、テクスチャのイメージレイアウトをシェーダー読み取りに変更します。
-  TransitionImageLayout(copyCmd, image, imageSubresourceRange,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+  // すべてのミップレベルが揃った後、テクスチャのイメージレイアウトをシェーダー読み取りに変更します。
+  MipGenerator mipGenerator{};
+  if (mipLevels > 1) {
+    mipGenerator.Setup(device, image, format, width, height, mipLevels);
+    mipGenerator.Record(copyCmd, imageLayout);
+  } else {
+    TransitionImageLayout(copyCmd, image, imageSubresourceRange,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+  }
   device.FlushCommandBuffer(copyCmd, copyQueue);
 
   // ステージングリソースを破棄します。
+  mipGenerator.Destroy(device);
   vkFreeMemory(device, stagingMemory, nullptr);
   vkDestroyBuffer(device, stagingBuffer, nullptr);
 
-  // サンプラーの生成を行います。
-  CreateSampler(device, sampler, filter, filter, VK_FALSE, VK_COMPARE_OP_NEVER);
+  // サンプラーの生成を行います。最大LODはミップレベル数と一致させます。
+  CreateSampler(device, sampler, filter, filter, VK_FALSE, VK_COMPARE_OP_NEVER,
+                VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_MIPMAP_MODE_LINEAR,
+                0.0f, static_cast<float>(mipLevels));
 
   // イメージビューの生成を行います。
-  CreateImageView(device, view, image, VK_IMAGE_VIEW_TYPE_2D, format);
+  CreateImageView(device, view, image, VK_IMAGE_VIEW_TYPE_2D, format,
+                  VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels);
 
   // 記述子セットの設定に使用する情報の更新を行います。
   descriptor.sampler = sampler;
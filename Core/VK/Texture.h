@@ -5,6 +5,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <optional>
 #include <string>
 
 struct Device;
@@ -25,18 +26,34 @@ struct Texture {
   uint32_t layerCount = 1;
 };
 
+/**
+ * @brief KTXのglInternalFormatに対応するBC圧縮フォーマットを返します。
+ * @return 非圧縮のフォーマット、またはデバイスが対応していない場合はstd::nullopt
+ */
+std::optional<VkFormat> FindCompressedFormat(const Device &device,
+                                             uint32_t glInternalFormat);
+
 struct Texture2D : public Texture {
+  /**
+   * @brief テクスチャを読み込みます。
+   * @note ファイルがBC圧縮されている場合、formatは無視して対応する圧縮フォーマットを使用します。
+   * @param generateMips ファイルにミップが含まれない場合、GPUで全ミップを生成します。
+   */
   void
   Load(const Device &device, const std::string &filepath, VkQueue copyQueue,
        VkFormat format = VK_FORMAT_R8G8B8A8_UNORM,
        VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
        VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-       bool useStaging = true);
+       bool useStaging = true, bool generateMips = false);
 
+  /**
+   * @param generateMips バッファをレベル0として、GPUで全ミップを生成します。
+   */
   void FromBuffer(
       const Device &device, void *buffer, VkDeviceSize bufferSize,
       VkFormat format, uint32_t texWidth, uint32_t texHeight, VkQueue copyQueue,
       VkFilter filter = VK_FILTER_LINEAR,
       VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-      VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      bool generateMips = false);
 };
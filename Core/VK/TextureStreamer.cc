@@ -0,0 +1,382 @@
+/**
+ * @brief ミップレベル単位のテクスチャストリーミング
+ */
+
+#include "VK/TextureStreamer.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+/** @brief ステージングバッファ上の各レベルの配置境界(圧縮フォーマットのブロックサイズを含みます) */
+static constexpr VkDeviceSize kLevelAlignment = 16;
+
+void TextureStreamer::Setup(VkQueue copyQueue,
+                            const TextureStreamerCreateInfo &createInfo) {
+  queue = copyQueue;
+  settings = createInfo;
+  threadPool = std::make_unique<ThreadPool>(createInfo.threadCount);
+}
+
+void TextureStreamer::Destroy(const Device &device) {
+  // 読み込み中のジョブが登録済みのリーダーを参照しなくなるまで待ちます。
+  for (auto &entry : entries) {
+    if (entry.loading) {
+      entry.pending.wait();
+      entry.loading = false;
+    }
+  }
+  threadPool.reset();
+  (void)device;
+  entries.clear();
+}
+
+std::optional<uint32_t> TextureStreamer::Register(const Device &device,
+                                                  const std::string &filepath,
+                                                  VkFormat format,
+                                                  Texture2D &texture) {
+  Entry entry{};
+  if (!entry.reader.Open(filepath)) {
+    return std::nullopt;
+  }
+  // BC圧縮されたKTXは対応する圧縮フォーマットのまま常駐させます。
+  if (entry.reader.IsCompressed()) {
+    const auto compressed =
+        FindCompressedFormat(device, entry.reader.GetGLInternalFormat());
+    if (!compressed) {
+      return std::nullopt;
+    }
+    format = *compressed;
+  }
+  entry.format = format;
+  entry.texture = &texture;
+
+  // 最大辺がtailSize以下になる最初のレベルからミップテイルとします。
+  const uint32_t levelCount = entry.reader.GetLevelCount();
+  entry.tailLevel = levelCount - 1;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    const auto &level = entry.reader.GetLevel(i);
+    if (std::max(level.width, level.height) <= settings.tailSize) {
+      entry.tailLevel = i;
+      break;
+    }
+  }
+  entry.residentLevel = levelCount;
+  entry.requestedLevel = entry.tailLevel;
+
+  std::vector<std::vector<std::byte>> levels;
+  for (uint32_t i = entry.tailLevel; i < levelCount; i++) {
+    levels.emplace_back(entry.reader.ReadLevel(i));
+  }
+  Rebuild(device, entry, entry.tailLevel, levels);
+
+  entries.emplace_back(std::move(entry));
+  return static_cast<uint32_t>(entries.size() - 1);
+}
+
+void TextureStreamer::Request(uint32_t handle, uint32_t level) {
+  Entry &entry = entries[handle];
+  entry.requestedLevel = std::min(entry.requestedLevel, level);
+  entry.lastUsedFrame = frame;
+}
+
+void TextureStreamer::RequestByDensity(uint32_t handle,
+                                       const Model::Dimension &dim,
+                                       const glm::mat4 &world,
+                                       const Camera &camera,
+                                       float viewportHeight, float uvScale) {
+  const Entry &entry = entries[handle];
+
+  // モデルの境界球をワールド空間へ変換します。
+  const float scale = std::max({glm::length(glm::vec3(world[0])),
+                                glm::length(glm::vec3(world[1])),
+                                glm::length(glm::vec3(world[2]))});
+  const glm::vec3 center =
+      glm::vec3(world * glm::vec4(0.5f * (dim.min + dim.max), 1.0f));
+  const float radius = 0.5f * glm::length(dim.max - dim.min) * scale;
+
+  // 境界球の最近点における1ピクセルあたりのワールド空間の長さです。
+  const float distance =
+      std::max(glm::length(center - camera.GetPosition()) - radius,
+               camera.GetNear());
+  const float pixelSize =
+      2.0f * distance * std::tan(0.5f * camera.GetFOVY()) / viewportHeight;
+
+  // テクスチャがuvScale回繰り返してモデルの直径を覆うとみなしたテクセルの長さです。
+  const float texels = static_cast<float>(std::max(
+                           entry.reader.GetWidth(), entry.reader.GetHeight())) *
+                       uvScale;
+  const float texelSize = 2.0f * radius / texels;
+
+  // 1ピクセルに収まるテクセル数の対数がミップレベルになります。
+  const float level = std::floor(std::log2(pixelSize / texelSize));
+  Request(handle, level <= 0.0f ? 0u : static_cast<uint32_t>(level));
+}
+
+bool TextureStreamer::Update(const Device &device) {
+  bool changed = false;
+
+  // 完了した読み込みを反映します。
+  uint32_t uploads = 0;
+  for (auto &entry : entries) {
+    if (!entry.loading || uploads >= settings.maxUploadsPerFrame) {
+      continue;
+    }
+    if (entry.pending.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      continue;
+    }
+    entry.loading = false;
+    const auto levels = entry.pending.get();
+    const bool valid =
+        std::none_of(levels.begin(), levels.end(),
+                     [](const auto &level) { return level.empty(); });
+    if (valid && entry.loadingLevel < entry.residentLevel) {
+      Rebuild(device, entry, entry.loadingLevel, levels);
+      uploads++;
+      changed = true;
+    }
+  }
+
+  // 予算を超えている間、使われていないテクスチャから細かいミップを破棄します。
+  while (GetResidentSize() > settings.budget) {
+    if (!EvictLeastRecentlyUsed(device, false) &&
+        !EvictLeastRecentlyUsed(device, true)) {
+      break;
+    }
+    changed = true;
+  }
+
+  // 要求されたレベルが常駐していなければ、予算に収まる範囲で読み込みを開始します。
+  for (auto &entry : entries) {
+    if (entry.loading || entry.requestedLevel >= entry.residentLevel) {
+      continue;
+    }
+    uint32_t target = entry.requestedLevel;
+    while (target < entry.residentLevel &&
+           GetResidentSize() +
+                   EstimateSize(entry, target, entry.residentLevel) >
+               settings.budget) {
+      if (EvictLeastRecentlyUsed(device, false)) {
+        changed = true;
+        continue;
+      }
+      target++;
+    }
+    if (target >= entry.residentLevel) {
+      continue;
+    }
+
+    entry.loading = true;
+    entry.loadingLevel = target;
+    entry.pending = threadPool->Submit(
+        [reader = entry.reader, first = target, last = entry.residentLevel]() {
+          std::vector<std::vector<std::byte>> levels;
+          for (uint32_t i = first; i < last; i++) {
+            levels.emplace_back(reader.ReadLevel(i));
+          }
+          return levels;
+        });
+  }
+
+  // 要求は毎フレーム出し直されます。
+  for (auto &entry : entries) {
+    entry.requestedLevel = entry.tailLevel;
+  }
+  frame++;
+
+  return changed;
+}
+
+VkDeviceSize TextureStreamer::GetResidentSize() const {
+  VkDeviceSize size = 0;
+  for (const auto &entry : entries) {
+    size += entry.memorySize;
+  }
+  return size;
+}
+
+/**
+ * @brief 最も長く使われていないテクスチャの最も細かいミップを1つ破棄します。
+ * @param allowUsedThisFrame このフレームで要求されたテクスチャも対象にします。
+ */
+bool TextureStreamer::EvictLeastRecentlyUsed(const Device &device,
+                                             bool allowUsedThisFrame) {
+  Entry *victim = nullptr;
+  for (auto &entry : entries) {
+    if (entry.loading || entry.residentLevel >= entry.tailLevel) {
+      continue;
+    }
+    if (!allowUsedThisFrame && entry.lastUsedFrame == frame) {
+      continue;
+    }
+    if (victim == nullptr || entry.lastUsedFrame < victim->lastUsedFrame) {
+      victim = &entry;
+    }
+  }
+  if (victim == nullptr) {
+    return false;
+  }
+  Rebuild(device, *victim, victim->residentLevel + 1, {});
+  return true;
+}
+
+VkDeviceSize TextureStreamer::EstimateSize(const Entry &entry,
+                                           uint32_t firstLevel,
+                                           uint32_t lastLevel) const {
+  VkDeviceSize size = 0;
+  for (uint32_t i = firstLevel; i < lastLevel; i++) {
+    size += entry.reader.GetLevel(i).size;
+  }
+  return size;
+}
+
+/**
+ * @brief newLevel以降のレベルを持つイメージを作り直します。
+ * @param levels newLevelから現在の常駐レベルの直前までの新たに読み込んだデータ
+ * @note 既に常駐しているレベルは古いイメージからGPU上でコピーします。
+ */
+void TextureStreamer::Rebuild(
+    const Device &device, Entry &entry, uint32_t newLevel,
+    const std::vector<std::vector<std::byte>> &levels) {
+  Texture2D &texture = *entry.texture;
+  const KtxReader &reader = entry.reader;
+  const uint32_t levelCount = reader.GetLevelCount() - newLevel;
+  const uint32_t oldLevel = entry.residentLevel;
+  const bool hasOld = texture.image != VK_NULL_HANDLE;
+
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(CreateImage(
+      device, image, memory, entry.format, VK_IMAGE_TYPE_2D,
+      reader.GetLevel(newLevel).width, reader.GetLevel(newLevel).height, 1,
+      levelCount, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+          VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      VK_IMAGE_TILING_OPTIMAL));
+  VkMemoryRequirements memoryRequirements{};
+  vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+  // 新たに読み込んだレベルをステージングバッファへ詰めます。
+  Buffer staging{};
+  std::vector<VkBufferImageCopy> uploadRegions{};
+  if (!levels.empty()) {
+    VkDeviceSize stagingSize = 0;
+    for (const auto &level : levels) {
+      stagingSize += (level.size() + kLevelAlignment - 1) & ~(kLevelAlignment - 1);
+    }
+    VK_CHECK_RESULT(staging.Create(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   stagingSize));
+    VK_CHECK_RESULT(staging.Map(device));
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < levels.size(); i++) {
+      std::memcpy(static_cast<std::byte *>(staging.mapped) + offset,
+                  levels[i].data(), levels[i].size());
+
+      const auto &level = reader.GetLevel(newLevel + i);
+      VkBufferImageCopy region{};
+      region.bufferOffset = offset;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = i;
+      region.imageSubresource.baseArrayLayer = 0;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent = {level.width, level.height, 1};
+      uploadRegions.emplace_back(region);
+
+      offset +=
+          (levels[i].size() + kLevelAlignment - 1) & ~(kLevelAlignment - 1);
+    }
+    staging.Unmap(device);
+  }
+
+  VkCommandBuffer copyCmd = device.CreateCommandBuffer();
+
+  VkImageSubresourceRange newRange{};
+  newRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  newRange.baseMipLevel = 0;
+  newRange.levelCount = levelCount;
+  newRange.layerCount = 1;
+  TransitionImageLayout(copyCmd, image, newRange, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  if (!uploadRegions.empty()) {
+    vkCmdCopyBufferToImage(copyCmd, staging.buffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(uploadRegions.size()),
+                           uploadRegions.data());
+  }
+
+  // 両方のイメージに存在するレベルを古いイメージからコピーします。
+  if (hasOld) {
+    VkImageSubresourceRange oldRange{};
+    oldRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    oldRange.baseMipLevel = 0;
+    oldRange.levelCount = texture.mipLevels;
+    oldRange.layerCount = 1;
+    TransitionImageLayout(copyCmd, texture.image, oldRange,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    std::vector<VkImageCopy> copyRegions{};
+    for (uint32_t l = std::max(newLevel, oldLevel); l < reader.GetLevelCount();
+         l++) {
+      const auto &level = reader.GetLevel(l);
+      VkImageCopy region{};
+      region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, l - oldLevel, 0, 1};
+      region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, l - newLevel, 0, 1};
+      region.extent = {level.width, level.height, 1};
+      copyRegions.emplace_back(region);
+    }
+    vkCmdCopyImage(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   static_cast<uint32_t>(copyRegions.size()),
+                   copyRegions.data());
+  }
+
+  TransitionImageLayout(copyCmd, image, newRange,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  device.FlushCommandBuffer(copyCmd, queue);
+  staging.Destroy(device);
+
+  // 古いイメージを破棄して差し替えます。サンプラーは使い回します。
+  if (hasOld) {
+    vkDestroyImageView(device, texture.view, nullptr);
+    vkDestroyImage(device, texture.image, nullptr);
+    vkFreeMemory(device, texture.memory, nullptr);
+  }
+  if (texture.sampler == VK_NULL_HANDLE) {
+    VK_CHECK_RESULT(CreateSampler(
+        device, texture.sampler, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_FALSE,
+        VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        VK_SAMPLER_MIPMAP_MODE_LINEAR, 0.0f,
+        static_cast<float>(reader.GetLevelCount())));
+  }
+
+  texture.image = image;
+  texture.memory = memory;
+  texture.width = reader.GetLevel(newLevel).width;
+  texture.height = reader.GetLevel(newLevel).height;
+  texture.mipLevels = levelCount;
+  VK_CHECK_RESULT(CreateImageView(device, texture.view, image,
+                                  VK_IMAGE_VIEW_TYPE_2D, entry.format,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount));
+  texture.descriptor.sampler = texture.sampler;
+  texture.descriptor.imageView = texture.view;
+  texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  entry.residentLevel = newLevel;
+  entry.memorySize = memoryRequirements.size;
+}
@@ -0,0 +1,116 @@
+/**
+ * @brief ミップレベル単位のテクスチャストリーミング
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Image/KtxReader.h"
+#include "Utils/ThreadPool.h"
+#include "VK/Model.h"
+#include "VK/Texture.h"
+#include "View/Camera.h"
+
+struct Device;
+
+struct TextureStreamerCreateInfo {
+  /** @brief ストリーミングテクスチャが使用するVRAMの上限(バイト) */
+  VkDeviceSize budget = 256ull * 1024 * 1024;
+  /** @brief 登録時に同期的に読み込むミップテイルの最大辺(ピクセル) */
+  uint32_t tailSize = 64;
+  /** @brief 1フレームで反映する読み込みの最大数 */
+  uint32_t maxUploadsPerFrame = 2;
+  /** @brief ファイル読み込みに使うワーカースレッド数 */
+  size_t threadCount = 1;
+};
+
+/**
+ * @brief
+ * KTXテクスチャを低解像度のミップテイルから常駐させ、要求に応じて細かいミップを非同期に読み込みます。
+ * @note
+ * 常駐するミップが変わるとイメージを作り直してTexture2Dを書き換えるため、
+ * Updateがtrueを返したら記述子セットとコマンドバッファを更新してください。<br>
+ * 予算を超えた場合は、最も長く使われていないテクスチャから細かいミップを破棄します。
+ */
+struct TextureStreamer {
+  void Setup(VkQueue copyQueue, const TextureStreamerCreateInfo &createInfo);
+  void Destroy(const Device &device);
+
+  /**
+   * @brief テクスチャを登録し、ミップテイルを読み込みます。
+   * @param format 非圧縮のKTXに使用するフォーマット(BC圧縮なら自動で選択します)
+   * @param texture 書き換え先のテクスチャ(解放は呼び出し側で行います)
+   * @return ハンドル。KTXとして読み込めない、または圧縮フォーマットに対応していない場合はstd::nullopt
+   */
+  std::optional<uint32_t> Register(const Device &device,
+                                   const std::string &filepath,
+                                   VkFormat format, Texture2D &texture);
+
+  /**
+   * @brief このフレームで必要な最も細かいミップレベルを要求します。
+   */
+  void Request(uint32_t handle, uint32_t level);
+
+  /**
+   * @brief モデルの寸法から求めた画面上のテクセル密度に応じてミップレベルを要求します。
+   * @param uvScale モデル全体に対するテクスチャの繰り返し回数
+   */
+  void RequestByDensity(uint32_t handle, const Model::Dimension &dim,
+                        const glm::mat4 &world, const Camera &camera,
+                        float viewportHeight, float uvScale = 1.0f);
+
+  /**
+   * @brief 読み込みの完了を反映し、予算に応じて破棄と新たな読み込みを行います。
+   * @note GPUがテクスチャを使用していない時に呼び出してください。
+   * @return いずれかのテクスチャのイメージが作り直された場合はtrue
+   */
+  bool Update(const Device &device);
+
+  [[nodiscard]] VkDeviceSize GetResidentSize() const;
+  [[nodiscard]] uint32_t GetResidentLevel(uint32_t handle) const {
+    return entries[handle].residentLevel;
+  }
+
+private:
+  struct Entry {
+    KtxReader reader{};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    Texture2D *texture = nullptr;
+    VkDeviceSize memorySize = 0;
+
+    /** @brief 常に常駐させる最も細かいレベル */
+    uint32_t tailLevel = 0;
+    /** @brief 常駐している最も細かいレベル */
+    uint32_t residentLevel = 0;
+    /** @brief このフレームで要求された最も細かいレベル */
+    uint32_t requestedLevel = 0;
+    uint64_t lastUsedFrame = 0;
+
+    bool loading = false;
+    uint32_t loadingLevel = 0;
+    std::future<std::vector<std::vector<std::byte>>> pending{};
+  };
+
+  void Rebuild(const Device &device, Entry &entry, uint32_t newLevel,
+               const std::vector<std::vector<std::byte>> &levels);
+  bool EvictLeastRecentlyUsed(const Device &device, bool allowUsedThisFrame);
+  [[nodiscard]] VkDeviceSize EstimateSize(const Entry &entry,
+                                          uint32_t firstLevel,
+                                          uint32_t lastLevel) const;
+
+  std::vector<Entry> entries{};
+  std::unique_ptr<ThreadPool> threadPool{};
+  TextureStreamerCreateInfo settings{};
+  VkQueue queue = VK_NULL_HANDLE;
+  uint64_t frame = 0;
+};
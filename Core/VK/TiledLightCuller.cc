@@ -0,0 +1,273 @@
+/**
+ * @brief 深度のプリパスを使ったタイル単位のライトカリング(Forward+)
+ */
+
+#include "VK/TiledLightCuller.h"
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <array>
+
+#include "View/Camera.h"
+#include "VK/Common.h"
+#include "VK/Device.h"
+#include "VK/Framebuffer.h"
+#include "VK/Initializer.h"
+#include "VK/Utils.h"
+
+#define TILED_LIGHT_CULL_COMPUTE_SHADER_PATH                                   \
+  "./Assets/Shaders/GLSL/SPIR-V/Lighting/TiledLightCull.cs.spv"
+
+void TiledLightCuller::Setup(const Device &device,
+                             const FramebufferAttachment &depth, uint32_t width,
+                             uint32_t height, uint32_t maxLights,
+                             uint32_t maxLightIndices,
+                             VkPipelineCache pipelineCache) {
+  BOOST_ASSERT_MSG(depth.HasDepth(), "Attachment has no depth component!");
+
+  this->width = width;
+  this->height = height;
+  this->maxLights = std::max(maxLights, 1u);
+  uniformBlock.screenSize =
+      glm::vec2(static_cast<float>(width), static_cast<float>(height));
+  uniformBlock.maxLightIndices = std::max(maxLightIndices, 1u);
+  uniformBlock.params.tiles =
+      glm::uvec4(kTileSize, (width + kTileSize - 1) / kTileSize,
+                 (height + kTileSize - 1) / kTileSize, 0);
+
+  // サンプリング用のビューは深度アスペクトだけを含める必要があります。
+  depthImage = depth.image;
+  depthAspectMask = depth.subresourceRange.aspectMask;
+  VK_CHECK_RESULT(CreateImageView(device, depthView, depth.image,
+                                  VK_IMAGE_VIEW_TYPE_2D, depth.format,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT));
+  VK_CHECK_RESULT(CreateSampler(
+      device, sampler, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_FALSE,
+      VK_COMPARE_OP_NEVER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      0.0f, 1.0f));
+
+  SetupBuffers(device);
+  SetupDescriptorSet(device);
+  SetupPipeline(device, pipelineCache);
+}
+
+void TiledLightCuller::Destroy(const Device &device) const {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroySampler(device, sampler, nullptr);
+  vkDestroyImageView(device, depthView, nullptr);
+  uniformBuffer.Destroy(device);
+  indexCounter.Destroy(device);
+  lightIndices.Destroy(device);
+  tileLights.Destroy(device);
+  lights.Destroy(device);
+}
+
+void TiledLightCuller::SetLights(const std::vector<GpuLight> &lights) {
+  BOOST_ASSERT_MSG(lights.size() <= maxLights, "Too many lights!");
+
+  // 全体ライトを先頭に集め、シェーダが範囲で区別できるようにします。
+  auto *dst = static_cast<GpuLight *>(this->lights.mapped);
+  uint32_t count = 0;
+  for (const auto &light : lights) {
+    if (light.position.w == 0.0f) {
+      dst[count++] = light;
+    }
+  }
+  uniformBlock.params.globalLightCount = count;
+  for (const auto &light : lights) {
+    if (light.position.w != 0.0f) {
+      dst[count++] = light;
+    }
+  }
+  uniformBlock.params.lightCount = count;
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void TiledLightCuller::Update(const Camera &camera) {
+  uniformBlock.view = camera.GetViewMatrix();
+  uniformBlock.invProj = glm::inverse(camera.GetProjectionMatrix());
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void TiledLightCuller::Dispatch(VkCommandBuffer commandBuffer) const {
+  // 前回のライティングが読み終わってから、インデックスの使用数を0に戻します。
+  VkMemoryBarrier memoryBarrier = Initializer::MemoryBarrier();
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0,
+                       nullptr, 0, nullptr);
+  vkCmdFillBuffer(commandBuffer, indexCounter.buffer, 0, sizeof(uint32_t), 0);
+
+  // プリパスの深度の書き込みが終わってからコンピュートシェーダで読み込みます。
+  VkImageMemoryBarrier depthBarrier = Initializer::ImageMemoryBarrier();
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.image = depthImage;
+  depthBarrier.subresourceRange = {depthAspectMask, 0, 1, 0, 1};
+  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 1, &depthBarrier);
+
+  // 1つのワークグループが1つのタイルを担当します。
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdDispatch(commandBuffer, uniformBlock.params.tiles.y,
+                uniformBlock.params.tiles.z, 1);
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  // 続くレンダーパスで再び深度アタッチメントとして使用します。
+  depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+}
+
+//*-----------------------------------------------------------------------------
+// Setup
+//*-----------------------------------------------------------------------------
+
+void TiledLightCuller::SetupBuffers(const Device &device) {
+  VK_CHECK_RESULT(lights.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                maxLights * sizeof(GpuLight)));
+  VK_CHECK_RESULT(lights.Map(device));
+
+  const uint32_t tileCount =
+      uniformBlock.params.tiles.y * uniformBlock.params.tiles.z;
+  VK_CHECK_RESULT(tileLights.Create(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    tileCount * sizeof(glm::uvec2)));
+  VK_CHECK_RESULT(lightIndices.Create(
+      device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      static_cast<VkDeviceSize>(uniformBlock.maxLightIndices) *
+          sizeof(uint32_t)));
+  VK_CHECK_RESULT(indexCounter.Create(
+      device,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sizeof(uint32_t)));
+
+  VK_CHECK_RESULT(uniformBuffer.Create(device,
+                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       sizeof(UniformBlock)));
+  VK_CHECK_RESULT(uniformBuffer.Map(device));
+  uniformBuffer.Copy(&uniformBlock, sizeof(UniformBlock));
+}
+
+void TiledLightCuller::SetupDescriptorSet(const Device &device) {
+  const std::vector<VkDescriptorPoolSize> poolSizes = {
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      1),
+  };
+  const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+      Initializer::DescriptorPoolCreateInfo(poolSizes, 1);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo,
+                                         nullptr, &descriptorPool));
+
+  const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+      // Binding 0: パラメータ
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+      // Binding 1: プリパスの深度
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT, 1),
+      // Binding 2: ライト
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+      // Binding 3: タイルごとのインデックスの範囲
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+      // Binding 4: ライトのインデックス
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+      // Binding 5: インデックスの使用数
+      Initializer::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+  };
+  const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+      Initializer::DescriptorSetLayoutCreateInfo(setLayoutBindings);
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                             &descriptorSetLayout, 1);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                           &descriptorSet));
+
+  VkDescriptorImageInfo depthInfo = Initializer::DescriptorImageInfo(
+      sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+  const std::array<VkWriteDescriptorSet, 6> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
+                                      &uniformBuffer.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                      1, &depthInfo),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2,
+                                      &lights.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3,
+                                      &tileLights.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4,
+                                      &lightIndices.descriptor),
+      Initializer::WriteDescriptorSet(descriptorSet,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5,
+                                      &indexCounter.descriptor),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
+void TiledLightCuller::SetupPipeline(const Device &device,
+                                     VkPipelineCache pipelineCache) {
+  const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+      Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                         nullptr, &pipelineLayout));
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo =
+      Initializer::ComputePipelineCreateInfo(pipelineLayout);
+  computePipelineCreateInfo.stage =
+      CreateShader(device, TILED_LIGHT_CULL_COMPUTE_SHADER_PATH,
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                           &computePipelineCreateInfo, nullptr,
+                                           &pipeline));
+  vkDestroyShaderModule(device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
@@ -0,0 +1,109 @@
+/**
+ * @brief 深度のプリパスを使ったタイル単位のライトカリング(Forward+)
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "VK/Buffer.h"
+#include "VK/LightClusters.h"
+
+struct Device;
+struct FramebufferAttachment;
+class Camera;
+
+/**
+ * @brief
+ * 深度のプリパスから画面のタイルごとの最小・最大深度を求め、
+ * タイルの部分視錐台と交差するライトのインデックスを書き出します。
+ * @note
+ * ライトはLightClustersと同じGpuLightで、全体ライト(position.w == 0)はリストに含めません。<br>
+ * インデックスはすべてのタイルで1つのバッファを共有し、タイルごとに(先頭, 数)を持ちます。
+ * そのため、1タイルのライト数はインデックスバッファの大きさだけで制限されます。<br>
+ * シェーダはParamsと同じ並びのユニフォームと、lights, tileLights,
+ * lightIndicesのストレージバッファを参照してください。
+ * タイル(x, y)の番号は x + tilesX * y で、yはフレームバッファの上から数えます。
+ */
+struct TiledLightCuller {
+  /** @brief タイルの大きさ(ピクセル)。シェーダのlocal_sizeと一致させます。 */
+  static constexpr uint32_t kTileSize = 16;
+
+  /**
+   * @brief ライティングを行うシェーダへ渡すパラメータです。(std140)
+   * @note 呼び出し側のユニフォームバッファにそのまま埋め込んでください。
+   */
+  struct Params {
+    /** @brief x: タイルの大きさ, y: 横のタイル数, z: 縦のタイル数 */
+    alignas(16) glm::uvec4 tiles;
+    alignas(4) uint32_t lightCount;
+    alignas(4) uint32_t globalLightCount;
+  };
+
+  /**
+   * @param depth プリパスの深度アタッチメント(VK_IMAGE_USAGE_SAMPLED_BITが必要)
+   * @param maxLightIndices 全タイルで共有するインデックスの最大数
+   */
+  void Setup(const Device &device, const FramebufferAttachment &depth,
+             uint32_t width, uint32_t height, uint32_t maxLights,
+             uint32_t maxLightIndices, VkPipelineCache pipelineCache);
+  void Destroy(const Device &device) const;
+
+  /**
+   * @brief ライトを設定します。全体ライトは先頭へ並べ替えます。
+   */
+  void SetLights(const std::vector<GpuLight> &lights);
+
+  /** @brief カメラの行列を更新します。 */
+  void Update(const Camera &camera);
+
+  /**
+   * @brief プリパスの深度からカリングを記録します。レンダーパスの外で呼び出してください。
+   * @note 深度は深度アタッチメントのレイアウトに戻し、結果はフラグメントシェーダから読めます。
+   */
+  void Dispatch(VkCommandBuffer commandBuffer) const;
+
+  [[nodiscard]] const Params &GetParams() const { return uniformBlock.params; }
+
+  Buffer lights{};
+  /** @brief タイルごとのインデックスの範囲(uvec2: 先頭, 数) */
+  Buffer tileLights{};
+  /** @brief 全タイルで共有するライトのインデックス */
+  Buffer lightIndices{};
+  /** @brief lightIndicesの使用数(uint) */
+  Buffer indexCounter{};
+  Buffer uniformBuffer{};
+
+  VkSampler sampler = VK_NULL_HANDLE;
+  /** @brief 深度アスペクトだけを含むサンプリング用のビュー */
+  VkImageView depthView = VK_NULL_HANDLE;
+  VkImage depthImage = VK_NULL_HANDLE;
+  VkImageAspectFlags depthAspectMask = 0;
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  struct UniformBlock {
+    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 invProj;
+    alignas(8) glm::vec2 screenSize;
+    alignas(4) uint32_t maxLightIndices;
+    alignas(16) Params params;
+  } uniformBlock{};
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t maxLights = 0;
+
+private:
+  void SetupBuffers(const Device &device);
+  void SetupDescriptorSet(const Device &device);
+  void SetupPipeline(const Device &device, VkPipelineCache pipelineCache);
+};
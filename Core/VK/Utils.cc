@@ -229,6 +229,11 @@ void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
     // 画像からのシェーダー読み取りが終了していることを確認します。
     imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
     break;
+  case VK_IMAGE_LAYOUT_GENERAL:
+    // 画像はストレージイメージです。
+    // シェーダーからの書き込みがすべて終了していることを確認します。
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    break;
   default:
     break;
   }
@@ -267,6 +272,11 @@ void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
     }
     imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     break;
+  case VK_IMAGE_LAYOUT_GENERAL:
+    // 画像はストレージイメージとして読み書きされます。
+    imageMemoryBarrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    break;
   default:
     break;
   }
@@ -233,14 +233,15 @@ void VkBase::ResizeWindow() {
     Gui::OnResize(width, height);
   }
 
+  // 新しいアスペクト比のカメラで記録するため、先にビューを更新します。
+  ViewChanged();
+
   // Frame buffersの再生成後にCommand buffersも再生成する必要があります。
   DestroyCommandBuffers();
   CreateCommandBuffers();
   BuildCommandBuffers();
 
   vkDeviceWaitIdle(device);
-
-  ViewChanged();
 }
 
 //*-----------------------------------------------------------------------------
@@ -569,6 +570,8 @@ void VkBase::ViewChanged() {}
 
 VkPhysicalDeviceFeatures VkBase::GetEnabledFeatures() const {
   VkPhysicalDeviceFeatures enabledFeatures{};
+  // BC圧縮テクスチャはサポートされていれば常に有効にします。
+  enabledFeatures.textureCompressionBC = device.features.textureCompressionBC;
   return enabledFeatures;
 }
 
@@ -3,38 +3,71 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <array>
 #include <boost/assert.hpp>
+#include <random>
 #include <vector>
 
 #include "VK/Common.h"
 #include "VK/Initializer.h"
 #include "VK/Utils.h"
+#include "View/Frustum.h"
 
 //*-----------------------------------------------------------------------------
 // Overrides functions
 //*-----------------------------------------------------------------------------
 
 void Deferred::OnPostInit() {
+  // レンダーパスの構成が変わるため、VkBaseがレンダーパスを作る前に決めます。
+  settings.subpasses =
+      config.contains("Subpasses") && config["Subpasses"].get<bool>();
+  if (settings.subpasses) {
+    uiOverlay.subpass = 1;
+  }
   VkBase::OnPostInit();
 
   LoadAssets();
   PrepareOffscreenFramebuffer();
+  PrepareOcclusionRasterizer();
+  PrepareLights();
   PrepareUniformBuffers();
 
   SetupDescriptorSetLayout();
   SetupPipelines();
   SetupDescriptorPool();
   SetupDescriptorSet();
+  SetupDrawList();
+  SetupOcclusionCulling();
+
+  // オフスクリーンレンダリングと同期を行うために使用するセマフォを生成します。
+  // サブパスでは1つのコマンドバッファで完結するため、必要ありません。
+  if (!settings.subpasses) {
+    VkSemaphoreCreateInfo semaphoreCreateInfo =
+        Initializer::SemaphoreCreateInfo();
+    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
+                                      &offscreenSemaphore));
+  }
 
   // UpdateUIOverlay();
   BuildCommandBuffers();
+  UpdateInstanceCullers();
+  UpdateVisibleObjects();
+  UpdateDrawList();
   BuildDeferredCommandBuffer();
 }
 
 void Deferred::OnPreDestroy() {
   vkDestroySemaphore(device, offscreenSemaphore, nullptr);
 
+  if (IsGpuCullingAvailable()) {
+    for (const auto &culler : instanceCullers) {
+      culler.Destroy(device);
+    }
+    depthPyramid.Destroy(device);
+    vkDestroyPipeline(device, pipelines.instanced, nullptr);
+  }
+  lightClusters.Destroy(device);
   vkDestroyPipeline(device, pipelines.composition, nullptr);
   vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 
@@ -42,14 +75,12 @@ void Deferred::OnPreDestroy() {
 
   vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-  offscreenFramebuffer.Destroy(device);
+  gBuffer.Destroy(device);
 
   uniformBuffers.composition.Destroy(device);
   uniformBuffers.offscreen.Destroy(device);
 
-  models.floor.Destroy(device);
-  models.torus.Destroy(device);
-  models.teapot.Destroy(device);
+  assetRegistry.Destroy(device);
 }
 
 void Deferred::OnUpdate(float t) {
@@ -60,9 +91,28 @@ void Deferred::OnUpdate(float t) {
       camAngle + config["Camera"]["RotationSpeed"].get<float>() * deltaT,
       glm::two_pi<float>());
   UpdateUniformBuffers();
+
+  // GPUカリングでは描画数をGPUが決めるため、コマンドバッファを記録し直す必要はありません。
+  if (settings.occlusionCulling) {
+    UpdateInstanceCullers();
+    return;
+  }
+
+  // 可視オブジェクトか描画順が変わったときだけオフスクリーンのコマンドバッファを記録し直します。
+  // SubmitFrameでキューの完了を待っているため、ここでは実行中ではありません。
+  const bool visibleChanged = UpdateVisibleObjects();
+  if (UpdateDrawList() || visibleChanged) {
+    BuildDeferredCommandBuffer();
+  }
 }
 
 void Deferred::OnRender() {
+  // G-Bufferと合成は同じコマンドバッファのサブパスに記録されています。
+  if (settings.subpasses) {
+    VkBase::RenderFrame();
+    return;
+  }
+
   VkBase::PrepareFrame();
 
   // シーンレンダリングコマンドバッファはオフスクリーンのレンダリングが終了まで待機する必要があります
@@ -98,21 +148,45 @@ void Deferred::OnRender() {
 
 void Deferred::ViewChanged() { UpdateUniformBuffers(); }
 
+bool Deferred::IsGpuCullingAvailable() const {
+  // 階層深度はG-Bufferのパスの間に作るため、1つのレンダーパスでは作れません。
+  return !settings.subpasses && InstanceCuller::IsSupported(device);
+}
+
+VkDescriptorType Deferred::GetGBufferDescriptorType() const {
+  return settings.subpasses ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+                            : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+}
+
+VkPhysicalDeviceFeatures Deferred::GetEnabledFeatures() const {
+  VkPhysicalDeviceFeatures enabledFeatures = VkBase::GetEnabledFeatures();
+  // GPUによる遮蔽カリングで使用します。
+  enabledFeatures.multiDrawIndirect = device.features.multiDrawIndirect;
+  enabledFeatures.drawIndirectFirstInstance =
+      device.features.drawIndirectFirstInstance;
+  return enabledFeatures;
+}
+
 //*-----------------------------------------------------------------------------
 // Assets
 //*-----------------------------------------------------------------------------
 
 void Deferred::LoadAssets() {
   ModelCreateInfo modelCreateInfo{};
+  // CPUの遮蔽カリングで遮蔽物として描くモデルは、位置を保持しておきます。
+  const auto isOccluder = [](const nlohmann::json &object) {
+    return object.contains("Occluder") && object["Occluder"].get<bool>();
+  };
   // Teapot
   {
     const auto &teapot = config["Teapot"];
     modelCreateInfo.color = glm::vec3(teapot["Color"][0].get<float>(),
                                       teapot["Color"][1].get<float>(),
                                       teapot["Color"][2].get<float>());
-    models.teapot.LoadFromFile(device,
-                               config["Teapot"]["Model"].get<std::string>(),
-                               queue, vertexLayout, modelCreateInfo);
+    modelCreateInfo.buildOccluder = isOccluder(teapot);
+    models.teapot = assetRegistry.LoadModel(
+        device, config["Teapot"]["Model"].get<std::string>(), queue,
+        vertexLayout, modelCreateInfo);
   }
   // Torus
   {
@@ -120,9 +194,10 @@ void Deferred::LoadAssets() {
     modelCreateInfo.color = glm::vec3(torus["Color"][0].get<float>(),
                                       torus["Color"][1].get<float>(),
                                       torus["Color"][2].get<float>());
-    models.torus.LoadFromFile(device,
-                              config["Torus"]["Model"].get<std::string>(),
-                              queue, vertexLayout, modelCreateInfo);
+    modelCreateInfo.buildOccluder = isOccluder(torus);
+    models.torus = assetRegistry.LoadModel(
+        device, config["Torus"]["Model"].get<std::string>(), queue,
+        vertexLayout, modelCreateInfo);
   }
   // Floor
   {
@@ -130,10 +205,37 @@ void Deferred::LoadAssets() {
     modelCreateInfo.color = glm::vec3(floor["Color"][0].get<float>(),
                                       floor["Color"][1].get<float>(),
                                       floor["Color"][2].get<float>());
-    models.floor.LoadFromFile(device,
-                              config["Floor"]["Model"].get<std::string>(),
-                              queue, vertexLayout, modelCreateInfo);
+    modelCreateInfo.buildOccluder = isOccluder(floor);
+    models.floor = assetRegistry.LoadModel(
+        device, config["Floor"]["Model"].get<std::string>(), queue,
+        vertexLayout, modelCreateInfo);
   }
+
+  // 配置はシーングラフで管理します。
+  nodes.teapot = sceneGraph.Load(config["Teapot"], "Teapot");
+  nodes.torus = sceneGraph.Load(config["Torus"], "Torus");
+  nodes.floor = sceneGraph.Load(config["Floor"], "Floor");
+  sceneGraph.UpdateWorldMatrices();
+  BuildSceneBVH();
+}
+
+/**
+ * @brief 各モデルの境界をワールド空間へ変換し、カリング用のBVHを構築します。
+ */
+void Deferred::BuildSceneBVH() {
+  sceneObjects = {
+      {models.teapot, nodes.teapot},
+      {models.torus, nodes.torus},
+      {models.floor, nodes.floor},
+  };
+  std::vector<AABB> bounds{};
+  bounds.reserve(sceneObjects.size());
+  for (const auto &object : sceneObjects) {
+    const AABB local(object.model->dim.min, object.model->dim.max);
+    bounds.emplace_back(
+        local.Transform(sceneGraph.GetWorldMatrix(object.node)));
+  }
+  bvh.Build(std::move(bounds));
 }
 
 //*-----------------------------------------------------------------------------
@@ -149,17 +251,25 @@ void Deferred::SetupDescriptorSetLayout() {
   std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings = {
       Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                                               VK_SHADER_STAGE_VERTEX_BIT, 0),
-      Initializer::DescriptorSetLayoutBinding(
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-          VK_SHADER_STAGE_FRAGMENT_BIT, 1),
-      Initializer::DescriptorSetLayoutBinding(
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-          VK_SHADER_STAGE_FRAGMENT_BIT, 2),
-      Initializer::DescriptorSetLayoutBinding(
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-          VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+      // G-Buffer
+      Initializer::DescriptorSetLayoutBinding(GetGBufferDescriptorType(),
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+      Initializer::DescriptorSetLayoutBinding(GetGBufferDescriptorType(),
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+      Initializer::DescriptorSetLayoutBinding(GetGBufferDescriptorType(),
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 3),
       Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                                               VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+      // 間接描画のインスタンス
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_VERTEX_BIT, 5),
+      // クラスタに振り分けたライト
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 7),
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 8),
   };
 
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
@@ -185,13 +295,18 @@ void Deferred::SetupDescriptorPool() {
   // APIに記述子の最大数を通知する必要があります。
   std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {
       Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                      9),
+      Initializer::DescriptorPoolSize(GetGBufferDescriptorType(), 9),
+      Initializer::DescriptorPoolSize(
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          3 + static_cast<uint32_t>(sceneObjects.size())),
   };
 
   // グローバル記述子プールを生成します。
+  // オフスクリーンと合成に加えて、GPUカリングするオブジェクトごとに1つ使います。
   VkDescriptorPoolCreateInfo descriptorPoolInfo =
-      Initializer::DescriptorPoolCreateInfo(descriptorPoolSizes, 2);
+      Initializer::DescriptorPoolCreateInfo(
+          descriptorPoolSizes,
+          2 + static_cast<uint32_t>(sceneObjects.size()));
 
   VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr,
                                          &descriptorPool));
@@ -203,33 +318,23 @@ void Deferred::SetupDescriptorSet() {
       Initializer::DescriptorSetAllocateInfo(descriptorPool,
                                              &descriptorSetLayout, 1);
 
-  // オフスクリーンカラーアタッチメントのイメージ記述子を設定します。　
-  VkDescriptorImageInfo texPosDesc = Initializer::DescriptorImageInfo(
-      offscreenFramebuffer.sampler, offscreenFramebuffer.attachments[0].view,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-  VkDescriptorImageInfo texNormDesc = Initializer::DescriptorImageInfo(
-      offscreenFramebuffer.sampler, offscreenFramebuffer.attachments[1].view,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-  VkDescriptorImageInfo texAlbedoDesc = Initializer::DescriptorImageInfo(
-      offscreenFramebuffer.sampler, offscreenFramebuffer.attachments[2].view,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
   // Deferred Composition
   VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
                                            &descriptorSets.composition));
+  UpdateGBufferDescriptors();
   std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
       Initializer::WriteDescriptorSet(descriptorSets.composition,
-                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                      1, &texPosDesc),
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4,
+                                      &uniformBuffers.composition.descriptor),
       Initializer::WriteDescriptorSet(descriptorSets.composition,
-                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                      2, &texNormDesc),
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6,
+                                      &lightClusters.lights.descriptor),
       Initializer::WriteDescriptorSet(descriptorSets.composition,
-                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                      3, &texAlbedoDesc),
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7,
+                                      &lightClusters.clusterCounts.descriptor),
       Initializer::WriteDescriptorSet(descriptorSets.composition,
-                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4,
-                                      &uniformBuffers.composition.descriptor),
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8,
+                                      &lightClusters.clusterIndices.descriptor),
   };
   vkUpdateDescriptorSets(device,
                          static_cast<uint32_t>(writeDescriptorSets.size()),
@@ -248,6 +353,33 @@ void Deferred::SetupDescriptorSet() {
                          writeDescriptorSets.data(), 0, nullptr);
 }
 
+/**
+ * @brief 合成の記述子セットにG-Bufferのイメージ記述子を設定します。
+ * @note 位置の代わりに深度を読みます。
+ */
+void Deferred::UpdateGBufferDescriptors() {
+  const auto descriptor = [this](uint32_t attachment) {
+    return settings.subpasses ? gBuffer.GetInputDescriptor(attachment)
+                              : gBuffer.GetDescriptor(attachment);
+  };
+  const VkDescriptorImageInfo texDepthDesc = descriptor(GBuffer::kDepth);
+  const VkDescriptorImageInfo texNormDesc = descriptor(GBuffer::kNormal);
+  const VkDescriptorImageInfo texAlbedoDesc = descriptor(GBuffer::kAlbedo);
+
+  const VkDescriptorType type = GetGBufferDescriptorType();
+  const std::array<VkWriteDescriptorSet, 3> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSets.composition, type, 1,
+                                      &texDepthDesc),
+      Initializer::WriteDescriptorSet(descriptorSets.composition, type, 2,
+                                      &texNormDesc),
+      Initializer::WriteDescriptorSet(descriptorSets.composition, type, 3,
+                                      &texAlbedoDesc),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
 /**
  * @note
  * Vulkanは、レンダリングパイプラインの概念を用いてFixedStatusをカプセル化し、OpenGLの複雑なステートマシンを置き換えます。<br>
@@ -310,16 +442,20 @@ void Deferred::SetupPipelines() {
 
   // パイプラインシェーダーステージ情報を設定します。
   const auto &pipelinesConfig = config["Pipelines"];
+  // サブパスでは、G-Bufferを入力アタッチメントから読むシェーダーを使います。
+  const auto &compositionConfig = pipelinesConfig["Composition"];
   std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{
-      CreateShader(
-          device,
-          pipelinesConfig["Composition"]["VertexShader"].get<std::string>(),
-          VK_SHADER_STAGE_VERTEX_BIT),
-      CreateShader(
-          device,
-          pipelinesConfig["Composition"]["FragmentShader"].get<std::string>(),
-          VK_SHADER_STAGE_FRAGMENT_BIT),
+      CreateShader(device,
+                   compositionConfig["VertexShader"].get<std::string>(),
+                   VK_SHADER_STAGE_VERTEX_BIT),
+      CreateShader(device,
+                   compositionConfig[settings.subpasses
+                                         ? "SubpassFragmentShader"
+                                         : "FragmentShader"]
+                       .get<std::string>(),
+                   VK_SHADER_STAGE_FRAGMENT_BIT),
   };
+  pipelineCreateInfo.subpass = settings.subpasses ? 1 : 0;
   pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
   pipelineCreateInfo.pStages = shaderStages.data();
 
@@ -361,15 +497,18 @@ void Deferred::SetupPipelines() {
       device, pipelinesConfig["Offscreen"]["FragmentShader"].get<std::string>(),
       VK_SHADER_STAGE_FRAGMENT_BIT);
 
-  // レンダーパスは別にします。
-  pipelineCreateInfo.renderPass = offscreenFramebuffer.renderPass;
+  // レンダーパスは別にします。サブパスでは同じレンダーパスの最初のサブパスです。
+  if (!settings.subpasses) {
+    pipelineCreateInfo.renderPass = gBuffer.framebuffer.renderPass;
+  }
+  pipelineCreateInfo.subpass = 0;
 
   // カラーアタッチメントに何も描画しないようにします。
-  std::array<VkPipelineColorBlendAttachmentState, 3>
+  std::array<VkPipelineColorBlendAttachmentState,
+             GBuffer::kColorAttachmentCount>
       colorBlendAttachmentStates = {
           Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
           Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
-          Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
       };
   colorBlendState.attachmentCount =
       static_cast<uint32_t>(colorBlendAttachmentStates.size());
@@ -379,9 +518,142 @@ void Deferred::SetupPipelines() {
                                             &pipelineCreateInfo, nullptr,
                                             &pipelines.offscreen));
   vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+  // GPUカリングの間接描画用に、ワールド行列をインスタンスバッファから読むパイプラインを生成します。
+  // loadRenderPassはrenderPassと互換性があるため、同じパイプラインを使えます。
+  if (IsGpuCullingAvailable()) {
+    shaderStages[0] = CreateShader(
+        device,
+        pipelinesConfig["Offscreen"]["InstancedVertexShader"].get<std::string>(),
+        VK_SHADER_STAGE_VERTEX_BIT);
+    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                              &pipelineCreateInfo, nullptr,
+                                              &pipelines.instanced));
+    vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+  }
   vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
 }
 
+/**
+ * @brief オブジェクトごとのGPUカリングと、G-Bufferの深度から作る深度ピラミッドを用意します。
+ */
+void Deferred::SetupOcclusionCulling() {
+  if (!IsGpuCullingAvailable()) {
+    return;
+  }
+  settings.occlusionCulling = config.contains("OcclusionCulling") &&
+                              config["OcclusionCulling"].get<bool>();
+
+  depthPyramid.Setup(device, gBuffer.framebuffer.attachments[GBuffer::kDepth],
+                     gBuffer.framebuffer.width, gBuffer.framebuffer.height,
+                     queue, pipelineCache);
+
+  const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+      Initializer::DescriptorSetAllocateInfo(descriptorPool,
+                                             &descriptorSetLayout, 1);
+  instanceCullers.resize(sceneObjects.size());
+  instancedDescriptorSets.resize(sceneObjects.size());
+  for (size_t i = 0; i < sceneObjects.size(); i++) {
+    const auto &object = sceneObjects[i];
+    auto &culler = instanceCullers[i];
+    culler.Setup(device, *object.model, 1, queue, pipelineCache);
+    culler.SetInstance(0, sceneGraph.GetWorldMatrix(object.node),
+                       static_cast<uint32_t>(i));
+    culler.SetInstanceCount(1);
+    culler.SetDepthPyramid(device, depthPyramid.descriptor, depthPyramid.width,
+                           depthPyramid.height, depthPyramid.levels);
+
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                             &instancedDescriptorSets[i]));
+    const std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+        Initializer::WriteDescriptorSet(instancedDescriptorSets[i],
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
+                                        &uniformBuffers.offscreen.descriptor),
+        Initializer::WriteDescriptorSet(instancedDescriptorSets[i],
+                                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5,
+                                        &culler.instances.descriptor),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writeDescriptorSets.size()),
+                           writeDescriptorSets.data(), 0, nullptr);
+  }
+}
+
+/**
+ * @brief
+ * Subpassesでは、G-Bufferを書き込むサブパスと合成するサブパスからなるレンダーパスを生成します。
+ * @note
+ * 合成は同じピクセルのG-Bufferだけを読むため、タイルベースのGPUではG-Bufferがタイルのメモリから出ません。
+ */
+void Deferred::SetupRenderPass() {
+  if (!settings.subpasses) {
+    VkBase::SetupRenderPass();
+    return;
+  }
+
+  // 合成は全画面を描き直すため、スワップチェーンの前の内容は読み込みません。
+  VkAttachmentDescription output{};
+  output.format = swapchain.format;
+  output.samples = VK_SAMPLE_COUNT_1_BIT;
+  output.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  output.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  output.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  output.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  output.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  output.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  VK_CHECK_RESULT(gBuffer.CreateSubpassRenderPass(device, output, renderPass));
+}
+
+/**
+ * @brief Subpassesでは、スワップチェーンの深度の代わりにG-Bufferを生成します。
+ * @note ウィンドウのサイズが変わったときは、スワップチェーンの大きさで作り直します。
+ */
+void Deferred::SetupDepthStencil() {
+  if (!settings.subpasses) {
+    VkBase::SetupDepthStencil();
+    return;
+  }
+  gBuffer.Destroy(device);
+  gBuffer = GBuffer{};
+  gBuffer.SetupTransient(device, swapchain.extent.width,
+                         swapchain.extent.height);
+}
+
+/**
+ * @brief Subpassesでは、G-Bufferとスワップチェーンのイメージからフレームバッファを生成します。
+ */
+void Deferred::SetupFramebuffers() {
+  if (!settings.subpasses) {
+    VkBase::SetupFramebuffers();
+    return;
+  }
+
+  std::array<VkImageView, GBuffer::kOutput + 1> attachments{};
+  for (uint32_t i = 0; i < GBuffer::kOutput; i++) {
+    attachments[i] = gBuffer.framebuffer.attachments[i].view;
+  }
+
+  VkFramebufferCreateInfo create = Initializer::FramebufferCreateInfo();
+  create.renderPass = renderPass;
+  create.attachmentCount = static_cast<uint32_t>(attachments.size());
+  create.pAttachments = attachments.data();
+  create.width = swapchain.extent.width;
+  create.height = swapchain.extent.height;
+  create.layers = 1;
+
+  framebuffers.resize(swapchain.views.size());
+  for (size_t i = 0; i < framebuffers.size(); i++) {
+    attachments[GBuffer::kOutput] = swapchain.views[i];
+    VK_CHECK_RESULT(
+        vkCreateFramebuffer(device, &create, nullptr, &framebuffers[i]));
+  }
+
+  // ウィンドウのサイズが変わったときは、作り直したG-Bufferを記述子に反映します。
+  if (descriptorSets.composition != VK_NULL_HANDLE) {
+    UpdateGBufferDescriptors();
+  }
+}
+
 //*-----------------------------------------------------------------------------
 // Prepare
 //*-----------------------------------------------------------------------------
@@ -390,39 +662,73 @@ void Deferred::SetupPipelines() {
  * @brief オフスクリーンレンダリング用に新しいフレームバッファを用意します。
  */
 void Deferred::PrepareOffscreenFramebuffer() {
-  offscreenFramebuffer.width = swapchain.extent.width;
-  offscreenFramebuffer.height = swapchain.extent.height;
-
-  AttachmentCreateInfo attachmentCreateInfo{};
-  attachmentCreateInfo.width = offscreenFramebuffer.width;
-  attachmentCreateInfo.height = offscreenFramebuffer.height;
-  attachmentCreateInfo.layerCount = 1;
-  attachmentCreateInfo.usage =
-      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-  attachmentCreateInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-
-  // POSITION (World Space)
-  offscreenFramebuffer.AddAttachment(device, attachmentCreateInfo);
-
-  // NORMAL (World Space)
-  offscreenFramebuffer.AddAttachment(device, attachmentCreateInfo);
+  // サブパスでは、スワップチェーンのフレームバッファと一緒に生成しています。
+  if (settings.subpasses) {
+    return;
+  }
+  // 位置は深度から復元するため、法線とアルベドだけを書き込みます。
+  // 深度は深度ピラミッドの作成にも使います。
+  gBuffer.Setup(device, swapchain.extent.width, swapchain.extent.height);
+  // 遮蔽カリングのLateで、Earlyの描画結果に続けて描画するレンダーパスです。
+  VK_CHECK_RESULT(gBuffer.framebuffer.CreateLoadRenderPass(device));
+}
 
-  // ALBEDO (Color)
-  attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-  offscreenFramebuffer.AddAttachment(device, attachmentCreateInfo);
+/**
+ * @brief 記録前に遮蔽されたオブジェクトを除くための、低解像度のCPU深度を用意します。
+ */
+void Deferred::PrepareOcclusionRasterizer() {
+  settings.softwareOcclusion = config.contains("SoftwareOcclusion") &&
+                               config["SoftwareOcclusion"].get<bool>();
+  threadPool = std::make_unique<ThreadPool>();
+
+  // アスペクト比を保ったまま、幅をkOcclusionWidthに縮小します。
+  const uint32_t height = std::max(
+      kOcclusionWidth * swapchain.extent.height / swapchain.extent.width, 1u);
+  occlusionRasterizer.Resize(kOcclusionWidth, height);
+}
 
-  // Depth attachment
-  attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-  attachmentCreateInfo.format = device.FindSupportedDepthFormat();
-  offscreenFramebuffer.AddAttachment(device, attachmentCreateInfo);
+/**
+ * @brief
+ * 設定ファイルのライトに、ClusteredLightsで指定した数の減衰するライトを加えて登録します。
+ * @note
+ * 減衰するライトは床の上の範囲に乱数で配置します。シード値を固定して、毎回同じ配置にします。
+ */
+void Deferred::PrepareLights() {
+  std::vector<GpuLight> lights{};
+  for (const auto &light : config["Lights"]) {
+    GpuLight &dst = lights.emplace_back();
+    for (int j = 0; j < 4; j++) {
+      dst.position[j] = light["Position"][j].get<float>();
+    }
+    for (int j = 0; j < 3; j++) {
+      dst.color[j] = light["Color"][j].get<float>();
+    }
+    dst.radius = light["Radius"].get<float>();
+  }
 
-  // カラーアタッチメントからサンプラーを生成します。
-  VK_CHECK_RESULT(offscreenFramebuffer.CreateSampler(
-      device, VK_FILTER_NEAREST, VK_FILTER_NEAREST,
-      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+  if (config.contains("ClusteredLights")) {
+    const auto &clustered = config["ClusteredLights"];
+    const auto count = clustered["Count"].get<uint32_t>();
+    const auto radius = clustered["Radius"].get<float>();
+    const auto extent = clustered["Extent"].get<float>();
+    const auto height = clustered["Height"].get<float>();
+    const auto intensity = clustered["Intensity"].get<float>();
+
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
+    std::uniform_real_distribution<float> distXZ(-extent, extent);
+    for (uint32_t i = 0; i < count; i++) {
+      GpuLight &dst = lights.emplace_back();
+      dst.position = glm::vec4(distXZ(gen), height * dist01(gen),
+                               distXZ(gen), 1.0f);
+      dst.color = intensity * glm::vec3(dist01(gen), dist01(gen), dist01(gen));
+      dst.radius = radius;
+    }
+  }
 
-  // フレームバッファ用のデフォルトのレンダーパスを生成します。
-  VK_CHECK_RESULT(offscreenFramebuffer.CreateRenderPass(device));
+  lightClusters.Setup(device, static_cast<uint32_t>(lights.size()),
+                      pipelineCache);
+  lightClusters.SetLights(lights);
 }
 
 /**
@@ -460,6 +766,11 @@ void Deferred::PrepareUniformBuffers() {
  * これにより、Vulkanの最大の利点の１つである、複数のスレッドから事前に作業を生成できます。
  */
 void Deferred::BuildCommandBuffers() {
+  if (settings.subpasses) {
+    BuildSubpassCommandBuffers();
+    return;
+  }
+
   VkCommandBufferBeginInfo commandBufferBeginInfo =
       Initializer::CommandBufferBeginInfo();
 
@@ -485,6 +796,10 @@ void Deferred::BuildCommandBuffers() {
     VK_CHECK_RESULT(
         vkBeginCommandBuffer(drawCmdBuffers[i], &commandBufferBeginInfo));
 
+    // 合成で評価するライトをクラスタに振り分けます。
+    // カメラはユニフォームバッファで渡すため、記録し直す必要はありません。
+    lightClusters.Dispatch(drawCmdBuffers[i]);
+
     // デフォルトのレンダーパス設定で指定された最初のサブパスを開始します。
     // これにより、色と奥行きのアタッチメントがクリアされます。
     vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo,
@@ -517,111 +832,162 @@ void Deferred::BuildCommandBuffers() {
   }
 }
 
+/**
+ * @brief G-Bufferと合成を1つのレンダーパスのサブパスとして記録します。
+ * @note
+ * オフスクリーンのコマンドバッファとセマフォを使わず、1回の送信で描画します。<br>
+ * 描画リストが変わったときは、すべてのコマンドバッファを記録し直します。
+ */
+void Deferred::BuildSubpassCommandBuffers() {
+  VkCommandBufferBeginInfo commandBufferBeginInfo =
+      Initializer::CommandBufferBeginInfo();
+
+  // 出力先は合成で全画面を描くため、G-Bufferだけをクリアします。
+  std::array<VkClearValue, GBuffer::kOutput + 1> clearValues{};
+  clearValues[GBuffer::kNormal].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+  clearValues[GBuffer::kAlbedo].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+  clearValues[GBuffer::kDepth].depthStencil = {1.0f, 0};
+
+  VkRenderPassBeginInfo renderPassBeginInfo =
+      Initializer::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = renderPass;
+  renderPassBeginInfo.renderArea.extent.width = swapchain.extent.width;
+  renderPassBeginInfo.renderArea.extent.height = swapchain.extent.height;
+  renderPassBeginInfo.clearValueCount =
+      static_cast<uint32_t>(clearValues.size());
+  renderPassBeginInfo.pClearValues = clearValues.data();
+
+  const VkViewport viewport = Initializer::Viewport(
+      static_cast<float>(swapchain.extent.width),
+      static_cast<float>(swapchain.extent.height), 0.0f, 1.0f);
+  const VkRect2D scissor =
+      Initializer::Rect2D(swapchain.extent.width, swapchain.extent.height, 0, 0);
+
+  for (size_t i = 0; i < drawCmdBuffers.size(); i++) {
+    renderPassBeginInfo.framebuffer = framebuffers[i];
+    VK_CHECK_RESULT(
+        vkBeginCommandBuffer(drawCmdBuffers[i], &commandBufferBeginInfo));
+
+    // 合成で評価するライトをクラスタに振り分けます。
+    lightClusters.Dispatch(drawCmdBuffers[i]);
+
+    vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+    vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+    // Subpass 0: G-Bufferを描画します。
+    drawList.Record(drawCmdBuffers[i]);
+
+    // Subpass 1: G-Bufferを入力アタッチメントから読んで合成します。
+    vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, &descriptorSets.composition,
+                            0, nullptr);
+    vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipelines.composition);
+    vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+    DrawUI(drawCmdBuffers[i]);
+
+    vkCmdEndRenderPass(drawCmdBuffers[i]);
+    VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+  }
+}
+
 void Deferred::BuildDeferredCommandBuffer() {
+  // サブパスでは、G-Bufferも描画コマンドバッファに記録します。
+  if (settings.subpasses) {
+    BuildCommandBuffers();
+    return;
+  }
+
   if (offscreenCmdBuffer == VK_NULL_HANDLE) {
     offscreenCmdBuffer =
         device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
   }
-  // オフスクリーンレンダリングと同期を行うために使用するセマフォを生成します。
-  VkSemaphoreCreateInfo semaphoreCreateInfo =
-      Initializer::SemaphoreCreateInfo();
-  VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
-                                    &offscreenSemaphore));
-
   VkCommandBufferBeginInfo commandBufferBeginInfo =
       Initializer::CommandBufferBeginInfo();
 
   // フラグメントシェーダーで使用するすべてのアタッチメントをこの値でクリアします。
-  std::array<VkClearValue, 4> clearValues{};
-  clearValues[0].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
-  clearValues[1].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
-  clearValues[2].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
-  clearValues[3].depthStencil = {1.0f, 0};
+  std::array<VkClearValue, 3> clearValues{};
+  clearValues[GBuffer::kNormal].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+  clearValues[GBuffer::kAlbedo].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+  clearValues[GBuffer::kDepth].depthStencil = {1.0f, 0};
 
+  const Framebuffer &framebuffer = gBuffer.framebuffer;
   VkRenderPassBeginInfo renderPassBeginInfo =
       Initializer::RenderPassBeginInfo();
-  renderPassBeginInfo.renderPass = offscreenFramebuffer.renderPass;
-  renderPassBeginInfo.framebuffer = offscreenFramebuffer.framebuffer;
-  renderPassBeginInfo.renderArea.extent.width = offscreenFramebuffer.width;
-  renderPassBeginInfo.renderArea.extent.height = offscreenFramebuffer.height;
+  renderPassBeginInfo.renderPass = framebuffer.renderPass;
+  renderPassBeginInfo.framebuffer = framebuffer.framebuffer;
+  renderPassBeginInfo.renderArea.extent.width = framebuffer.width;
+  renderPassBeginInfo.renderArea.extent.height = framebuffer.height;
   renderPassBeginInfo.clearValueCount =
       static_cast<uint32_t>(clearValues.size());
   renderPassBeginInfo.pClearValues = clearValues.data();
 
   VK_CHECK_RESULT(
       vkBeginCommandBuffer(offscreenCmdBuffer, &commandBufferBeginInfo));
-  vkCmdBeginRenderPass(offscreenCmdBuffer, &renderPassBeginInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
 
-  VkViewport viewport = Initializer::Viewport(
-      static_cast<float>(offscreenFramebuffer.width),
-      static_cast<float>(offscreenFramebuffer.height), 0.0f, 1.0f);
-  vkCmdSetViewport(offscreenCmdBuffer, 0, 1, &viewport);
-  VkRect2D scissor = Initializer::Rect2D(offscreenFramebuffer.width,
-                                         offscreenFramebuffer.height, 0, 0);
-  vkCmdSetScissor(offscreenCmdBuffer, 0, 1, &scissor);
-
-  vkCmdBindPipeline(offscreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    pipelines.offscreen);
-  vkCmdBindDescriptorSets(offscreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          pipelineLayout, 0, 1, &descriptorSets.offscreen, 0,
-                          nullptr);
-  VkDeviceSize offsets[] = {0};
+  const VkViewport viewport =
+      Initializer::Viewport(static_cast<float>(framebuffer.width),
+                            static_cast<float>(framebuffer.height), 0.0f, 1.0f);
+  const VkRect2D scissor =
+      Initializer::Rect2D(framebuffer.width, framebuffer.height, 0, 0);
 
-  // Teapot
-  {
-    vkCmdBindVertexBuffers(offscreenCmdBuffer, 0, 1,
-                           &models.teapot.vertices.buffer, offsets);
-    vkCmdBindIndexBuffer(offscreenCmdBuffer, models.teapot.indices.buffer, 0,
-                         VK_INDEX_TYPE_UINT32);
-    const auto &teapot = config["Teapot"];
-    const auto scale = glm::vec3(teapot["Scale"].get<float>());
-    const auto model = glm::scale(glm::mat4(1.0f), scale);
-    vkCmdPushConstants(offscreenCmdBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
-    vkCmdDrawIndexed(offscreenCmdBuffer, models.teapot.indexCount, 1, 0, 0, 0);
+  if (!settings.occlusionCulling) {
+    vkCmdBeginRenderPass(offscreenCmdBuffer, &renderPassBeginInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdSetViewport(offscreenCmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(offscreenCmdBuffer, 0, 1, &scissor);
+
+    // パイプライン等のバインドは描画リストが必要なときだけ記録します。
+    drawList.Record(offscreenCmdBuffer);
+    vkCmdEndRenderPass(offscreenCmdBuffer);
+    // 合成では深度から位置を復元します。
+    gBuffer.TransitionDepthToRead(offscreenCmdBuffer);
+    VK_CHECK_RESULT(vkEndCommandBuffer(offscreenCmdBuffer));
+    return;
   }
-  // Torus
-  {
-    vkCmdBindVertexBuffers(offscreenCmdBuffer, 0, 1,
-                           &models.torus.vertices.buffer, offsets);
-    vkCmdBindIndexBuffer(offscreenCmdBuffer, models.torus.indices.buffer, 0,
-                         VK_INDEX_TYPE_UINT32);
-    const auto &torus = config["Torus"];
-    const auto scale = glm::vec3(torus["Scale"].get<float>());
-    const auto rotAxis = glm::vec3(torus["Rotate"]["Axis"][0].get<float>(),
-                                   torus["Rotate"]["Axis"][1].get<float>(),
-                                   torus["Rotate"]["Axis"][2].get<float>());
-    const auto angle = glm::radians(torus["Rotate"]["Degrees"].get<float>());
-    const auto trans = glm::vec3(torus["Position"][0].get<float>(),
-                                 torus["Position"][1].get<float>(),
-                                 torus["Position"][2].get<float>());
-    auto model = glm::translate(glm::mat4(1.0f), trans);
-    model = glm::rotate(model, angle, rotAxis);
-    model = glm::scale(model, scale);
-    vkCmdPushConstants(offscreenCmdBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
-    vkCmdDrawIndexed(offscreenCmdBuffer, models.torus.indexCount, 1, 0, 0, 0);
+
+  // 2段階の遮蔽カリングでG-Bufferを描画します。
+  // Early: 前フレームの深度ピラミッドで判定したオブジェクトを描画します。
+  // Late: Earlyの深度でピラミッドを作り直し、Earlyで描画しなかったオブジェクトを再判定して描き足します。
+  const VkDeviceSize offsets[] = {0};
+  const auto drawPhase = [&](InstanceCuller::Phase phase) {
+    vkCmdSetViewport(offscreenCmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(offscreenCmdBuffer, 0, 1, &scissor);
+    vkCmdBindPipeline(offscreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipelines.instanced);
+    for (size_t i = 0; i < instanceCullers.size(); i++) {
+      vkCmdBindDescriptorSets(offscreenCmdBuffer,
+                              VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                              0, 1, &instancedDescriptorSets[i], 0, nullptr);
+      vkCmdBindVertexBuffers(offscreenCmdBuffer, 0, 1,
+                             &sceneObjects[i].model->vertices.buffer, offsets);
+      instanceCullers[i].Draw(offscreenCmdBuffer, phase);
+    }
+  };
+
+  for (const auto &culler : instanceCullers) {
+    culler.Dispatch(offscreenCmdBuffer, InstanceCuller::Phase::Early);
   }
+  vkCmdBeginRenderPass(offscreenCmdBuffer, &renderPassBeginInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+  drawPhase(InstanceCuller::Phase::Early);
+  vkCmdEndRenderPass(offscreenCmdBuffer);
 
-  // Floor
-  {
-    vkCmdBindVertexBuffers(offscreenCmdBuffer, 0, 1,
-                           &models.floor.vertices.buffer, offsets);
-    vkCmdBindIndexBuffer(offscreenCmdBuffer, models.floor.indices.buffer, 0,
-                         VK_INDEX_TYPE_UINT32);
-    const auto &floor = config["Floor"];
-    const auto scale = glm::vec3(floor["Scale"].get<float>());
-    const auto trans = glm::vec3(floor["Position"][0].get<float>(),
-                                 floor["Position"][1].get<float>(),
-                                 floor["Position"][2].get<float>());
-    auto model = glm::translate(glm::mat4(1.0f), trans);
-    model = glm::scale(model, scale);
-    vkCmdPushConstants(offscreenCmdBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
-    vkCmdDrawIndexed(offscreenCmdBuffer, models.floor.indexCount, 1, 0, 0, 0);
+  depthPyramid.Build(offscreenCmdBuffer);
+
+  for (const auto &culler : instanceCullers) {
+    culler.Dispatch(offscreenCmdBuffer, InstanceCuller::Phase::Late);
   }
+  renderPassBeginInfo.renderPass = framebuffer.loadRenderPass;
+  vkCmdBeginRenderPass(offscreenCmdBuffer, &renderPassBeginInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+  drawPhase(InstanceCuller::Phase::Late);
   vkCmdEndRenderPass(offscreenCmdBuffer);
+  gBuffer.TransitionDepthToRead(offscreenCmdBuffer);
   VK_CHECK_RESULT(vkEndCommandBuffer(offscreenCmdBuffer));
 }
 
@@ -629,6 +995,117 @@ void Deferred::BuildDeferredCommandBuffer() {
 // Update
 //*-----------------------------------------------------------------------------
 
+/**
+ * @brief BVHで視錐台と交差するオブジェクトを求めます。
+ * @return 前回から可視オブジェクトが変わった場合はtrue
+ */
+bool Deferred::UpdateVisibleObjects() {
+  const auto planes = Frustum::ExtractPlanes(camera.GetProjectionMatrix() *
+                                             camera.GetViewMatrix());
+  std::vector<uint32_t> visible{};
+  bvh.QueryFrustum(planes, visible);
+  std::sort(visible.begin(), visible.end());
+  if (settings.softwareOcclusion) {
+    CullOccludedObjects(visible);
+  }
+  if (visible == visibleObjects) {
+    return false;
+  }
+  visibleObjects = std::move(visible);
+  return true;
+}
+
+/**
+ * @brief
+ * 視錐台内の遮蔽物をCPUでラスタライズし、隠れているオブジェクトを可視リストから除きます。
+ * @note
+ * AABBの最も手前の深度は自身の表面より手前にあるため、遮蔽物が自身を隠すことはありません。
+ */
+void Deferred::CullOccludedObjects(std::vector<uint32_t> &visible) {
+  occlusionRasterizer.Begin(camera.GetProjectionMatrix() *
+                            camera.GetViewMatrix());
+  std::vector<AABB> bounds(sceneObjects.size());
+  for (const uint32_t index : visible) {
+    const auto &object = sceneObjects[index];
+    const auto &world = sceneGraph.GetWorldMatrix(object.node);
+    bounds[index] =
+        AABB(object.model->dim.min, object.model->dim.max).Transform(world);
+    if (!object.model->occluder.indices.empty()) {
+      occlusionRasterizer.AddOccluder(object.model->occluder, world);
+    }
+  }
+  occlusionRasterizer.Rasterize(threadPool.get());
+  occlusionRasterizer.Cull(bounds, visible);
+}
+
+/**
+ * @brief 描画リストにパイプライン、記述子セット、メッシュを登録し、ソートキーのIDを固定します。
+ */
+void Deferred::SetupDrawList() {
+  drawList.RegisterPipeline(pipelines.offscreen);
+  drawList.RegisterDescriptorSet(descriptorSets.offscreen);
+  for (const auto &object : sceneObjects) {
+    drawList.RegisterMesh(object.model->vertices.buffer,
+                          object.model->indices.buffer);
+  }
+}
+
+/**
+ * @brief 可視オブジェクトを状態と深度のソートキーで並べた描画リストを作ります。
+ * @return 前回から記録順が変わった場合はtrue
+ */
+bool Deferred::UpdateDrawList() {
+  drawList.Clear();
+  drawList.SetDepthRange(camera.GetNear(), camera.GetFar());
+  const auto view = camera.GetViewMatrix();
+  for (const uint32_t index : visibleObjects) {
+    const auto &object = sceneObjects[index];
+    const auto &world = sceneGraph.GetWorldMatrix(object.node);
+    const AABB local(object.model->dim.min, object.model->dim.max);
+    const glm::vec4 center(local.Transform(world).Center(), 1.0f);
+
+    DrawItem item{};
+    item.depth = -(view * center).z;
+    item.pipeline = pipelines.offscreen;
+    item.pipelineLayout = pipelineLayout;
+    item.descriptorSet = descriptorSets.offscreen;
+    item.vertexBuffer = object.model->vertices.buffer;
+    item.indexBuffer = object.model->indices.buffer;
+    item.indexCount = object.model->indexCount;
+    item.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+    drawList.Add(item, &world, sizeof(world));
+  }
+  drawList.Sort();
+
+  std::vector<uint32_t> order(drawList.order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = visibleObjects[drawList.order[i]];
+  }
+  if (order == drawOrder) {
+    return false;
+  }
+  drawOrder = std::move(order);
+  return true;
+}
+
+/**
+ * @brief GPUカリングのカメラを更新します。
+ * @note
+ * ピラミッドは前フレームのEarlyの深度から作られています。カメラの移動による誤判定は、
+ * Lateで現在の深度に対して再判定されるため、描画結果には影響しません。
+ */
+void Deferred::UpdateInstanceCullers() {
+  if (!settings.occlusionCulling) {
+    return;
+  }
+  const auto viewProj = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+  const auto height = static_cast<float>(gBuffer.framebuffer.height);
+  for (auto &culler : instanceCullers) {
+    // 描画リストと同じく、常に最も詳細なLODを描画します。
+    culler.Update(viewProj, camera, height, 0.0f, true);
+  }
+}
+
 void Deferred::UpdateUniformBuffers() {
   const auto CAMERA_RADIUS = config["Camera"]["Radius"].get<float>();
   camera.SetupOrient(glm::vec3(CAMERA_RADIUS * std::sin(camAngle), 1.0f,
@@ -653,20 +1130,11 @@ void Deferred::UpdateOffscreenUniformBuffers() {
 
 void Deferred::UpdateCompositionUniformBuffers() {
   uboComposition.viewPos = glm::vec4(camera.GetPosition(), 0.0f);
+  uboComposition.invViewProj = glm::inverse(camera.GetProjectionMatrix() *
+                                            camera.GetViewMatrix());
 
-  int i = 0;
-  for (const auto &light : config["Lights"]) {
-    for (int j = 0; j < 4; j++) {
-      uboComposition.lights[i].pos[j] = light["Position"][j].get<float>();
-    }
-    for (int j = 0; j < 3; j++) {
-      uboComposition.lights[i].color[j] = light["Color"][j].get<float>();
-    }
-    uboComposition.lights[i].radius = light["Radius"].get<float>();
-    i++;
-  }
-
-  uboComposition.lightsNum = static_cast<int>(config["Lights"].size());
+  lightClusters.Update(camera);
+  uboComposition.clusters = lightClusters.GetParams();
   uboComposition.dispTarget = settings.dispRenderTarget;
 
   uniformBuffers.composition.Copy(&uboComposition, sizeof(uboComposition));
@@ -674,7 +1142,21 @@ void Deferred::UpdateCompositionUniformBuffers() {
 
 void Deferred::OnUpdateUIOverlay() {
   if (uiOverlay.Combo("Display Render Target", &settings.dispRenderTarget,
-                      {"Final Result", "Position", "Normal", "Albedo"})) {
+                      {"Final Result", "Position", "Normal", "Albedo",
+                       "Light Clusters"})) {
     UpdateCompositionUniformBuffers();
   }
+  if (uiOverlay.Checkbox("Software Occlusion", &settings.softwareOcclusion) &&
+      !settings.occlusionCulling) {
+    UpdateVisibleObjects();
+    UpdateDrawList();
+    BuildDeferredCommandBuffer();
+  }
+  if (IsGpuCullingAvailable() &&
+      uiOverlay.Checkbox("Occlusion Culling", &settings.occlusionCulling)) {
+    UpdateInstanceCullers();
+    UpdateVisibleObjects();
+    UpdateDrawList();
+    BuildDeferredCommandBuffer();
+  }
 }
@@ -2,14 +2,24 @@
 
 #include "VK/VkBase.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "Geometry/BVH.h"
+#include "Scene/SceneGraph.h"
+#include "Utils/ThreadPool.h"
+#include "VK/AssetRegistry.h"
 #include "VK/Buffer.h"
-#include "VK/Framebuffer.h"
+#include "VK/DepthPyramid.h"
+#include "VK/DrawList.h"
+#include "VK/GBuffer.h"
+#include "VK/InstanceCuller.h"
+#include "VK/LightClusters.h"
 #include "VK/Model.h"
 #include "VK/Texture.h"
 #include "View/Camera.h"
+#include "View/OcclusionRasterizer.h"
 
 class Deferred : public VkBase {
 public:
@@ -18,9 +28,12 @@ public:
   void OnRender() override;
   void OnUpdate(float t) override;
   void OnUpdateUIOverlay() override;
+  [[nodiscard]] VkPhysicalDeviceFeatures GetEnabledFeatures() const override;
 
   void LoadAssets();
   void PrepareOffscreenFramebuffer();
+  void PrepareOcclusionRasterizer();
+  void PrepareLights();
   void PrepareUniformBuffers();
 
   void UpdateUniformBuffers();
@@ -31,14 +44,35 @@ public:
   void SetupPipelines();
   void SetupDescriptorPool();
   void SetupDescriptorSet();
+  void SetupOcclusionCulling();
+
+  void SetupRenderPass() override;
+  void SetupDepthStencil() override;
+  void SetupFramebuffers() override;
+  void UpdateGBufferDescriptors();
 
   void BuildCommandBuffers() override;
+  void BuildSubpassCommandBuffers();
 
   void BuildDeferredCommandBuffer();
+  void BuildSceneBVH();
+  bool UpdateVisibleObjects();
+  void CullOccludedObjects(std::vector<uint32_t> &visible);
+  void SetupDrawList();
+  bool UpdateDrawList();
+  void UpdateInstanceCullers();
 
   void ViewChanged() override;
 
 private:
+  /** @brief G-Bufferを別のレンダーパスで描く場合だけ、GPUの遮蔽カリングを使えます。 */
+  [[nodiscard]] bool IsGpuCullingAvailable() const;
+  /** @brief 合成でG-Bufferを読む記述子の種類を返します。 */
+  [[nodiscard]] VkDescriptorType GetGBufferDescriptorType() const;
+
+  /** @brief CPUの遮蔽カリングの深度の幅(ピクセル) */
+  static constexpr uint32_t kOcclusionWidth = 320;
+
   VertexLayout vertexLayout{
       {
           VertexLayoutComponent::Position,
@@ -47,27 +81,56 @@ private:
       },
   };
 
+  AssetRegistry assetRegistry{};
   struct {
-    Model teapot;
-    Model torus;
-    Model floor;
+    ModelHandle teapot;
+    ModelHandle torus;
+    ModelHandle floor;
   } models;
+  SceneGraph sceneGraph{};
+  struct {
+    NodeId teapot = kInvalidNode;
+    NodeId torus = kInvalidNode;
+    NodeId floor = kInvalidNode;
+  } nodes;
+
+  /** @brief BVHのオブジェクトIDごとの描画対象 */
+  struct SceneObject {
+    ModelHandle model;
+    NodeId node = kInvalidNode;
+  };
+  std::vector<SceneObject> sceneObjects{};
+  BVH bvh{};
+  /** @brief オフスクリーンのコマンドバッファに記録したオブジェクト(昇順) */
+  std::vector<uint32_t> visibleObjects{};
+  /** @brief 大きな遮蔽物を描き込み、記録前に隠れたオブジェクトを除くCPUの深度 */
+  OcclusionRasterizer occlusionRasterizer{};
+  std::unique_ptr<ThreadPool> threadPool{};
+  /** @brief 可視オブジェクトを状態と深度で並べ替えた描画リスト */
+  DrawList drawList{};
+  /** @brief 描画リストの記録順に並べたオブジェクト */
+  std::vector<uint32_t> drawOrder{};
+
+  /** @brief sceneObjectsと同じ順の、GPUで遮蔽カリングを行うオブジェクト */
+  std::vector<InstanceCuller> instanceCullers{};
+  /** @brief instanceCullersごとのインスタンスを参照する記述子セット */
+  std::vector<VkDescriptorSet> instancedDescriptorSets{};
+  /** @brief G-Bufferの深度から作る階層深度 */
+  DepthPyramid depthPyramid{};
 
   struct {
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
   } uboOffscreenVS;
 
-  struct Light {
-    alignas(16) glm::vec4 pos;
-    alignas(16) glm::vec3 color;
-    alignas(4) float radius;
-  };
+  /** @brief 合成で評価するライトをクラスタごとに振り分けます。 */
+  LightClusters lightClusters{};
 
   struct {
-    Light lights[8];
     alignas(16) glm::vec4 viewPos;
-    alignas(4) int lightsNum;
+    /** @brief G-Bufferの深度からワールド空間の位置を復元します。 */
+    alignas(16) glm::mat4 invViewProj;
+    alignas(16) LightClusters::Params clusters;
     alignas(4) int dispTarget;
   } uboComposition;
 
@@ -79,16 +142,24 @@ private:
   struct {
     VkPipeline offscreen;
     VkPipeline composition;
+    /** @brief 間接描画でインスタンスバッファから行列を読むオフスクリーン用 */
+    VkPipeline instanced = VK_NULL_HANDLE;
   } pipelines;
   VkPipelineLayout pipelineLayout;
 
   struct {
-    VkDescriptorSet offscreen;
-    VkDescriptorSet composition;
+    VkDescriptorSet offscreen = VK_NULL_HANDLE;
+    VkDescriptorSet composition = VK_NULL_HANDLE;
   } descriptorSets;
   VkDescriptorSetLayout descriptorSetLayout;
 
-  Framebuffer offscreenFramebuffer;
+  /**
+   * @brief ワールド空間の法線とアルベドを書き込みます。
+   * @note
+   * Subpassesでは、スワップチェーンと同じレンダーパスのサブパス0で書き込み、
+   * サブパス1の合成で入力アタッチメントとして読みます。
+   */
+  GBuffer gBuffer{};
 
   VkCommandBuffer offscreenCmdBuffer = VK_NULL_HANDLE;
   VkSemaphore offscreenSemaphore = VK_NULL_HANDLE;
@@ -100,5 +171,9 @@ private:
 
   struct Settings {
     int dispRenderTarget = 0;
+    bool occlusionCulling = false;
+    bool softwareOcclusion = false;
+    /** @brief G-Bufferと合成を1つのレンダーパスのサブパスで行います。 */
+    bool subpasses = false;
   } settings;
 };
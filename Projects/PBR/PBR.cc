@@ -3,13 +3,19 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <array>
 #include <boost/assert.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
 #include <vector>
 
 #include "VK/Common.h"
 #include "VK/Initializer.h"
 #include "VK/Utils.h"
+#include "View/Frustum.h"
 
 //*-----------------------------------------------------------------------------
 // Overrides functions
@@ -20,6 +26,14 @@ void PBR::OnPostInit() {
 
   PrepareCamera();
   LoadAssets();
+  if (!models.spot->meshlets.meshlets.empty()) {
+    meshletCuller.Setup(device, *models.spot,
+                        static_cast<uint32_t>(config["Spot"]["Positions"].size()),
+                        queue, pipelineCache);
+  }
+  SetupInstanceCullers();
+  PrepareLights();
+  PrepareDepthPrepass();
   PrepareUniformBuffers();
 
   SetupDescriptorSetLayout();
@@ -32,14 +46,32 @@ void PBR::OnPostInit() {
 }
 
 void PBR::OnPreDestroy() {
-  models.floor.Destroy(device);
-  models.spot.Destroy(device);
+  if (InstanceCuller::IsSupported(device)) {
+    instanceCullers.floor.Destroy(device);
+    instanceCullers.spot.Destroy(device);
+  }
+  meshletCuller.Destroy(device);
+  if (depthPyramid.pipeline != VK_NULL_HANDLE) {
+    depthPyramid.Destroy(device);
+  }
+  tiledLightCuller.Destroy(device);
+  depthPrepass.Destroy(device);
+  assetRegistry.Destroy(device);
 
   uniformBuffers.params.Destroy(device);
   uniformBuffers.object.Destroy(device);
+  materialBuffer.Destroy(device);
+  instanceBuffer.Destroy(device);
 
   vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+  vkDestroyPipeline(device, prepassPipelines.instancedShade, nullptr);
+  vkDestroyPipeline(device, prepassPipelines.shade, nullptr);
+  vkDestroyPipeline(device, prepassPipelines.instancedDepth, nullptr);
+  vkDestroyPipeline(device, prepassPipelines.depth, nullptr);
+  vkDestroyPipeline(device, instancedDepthPipeline, nullptr);
+  vkDestroyPipeline(device, depthPipeline, nullptr);
+  vkDestroyPipeline(device, instancedPipeline, nullptr);
   vkDestroyPipeline(device, pipeline, nullptr);
   vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 }
@@ -51,6 +83,12 @@ void PBR::OnPreDestroy() {
  * これにより、Vulkanの最大の利点の１つである、複数のスレッドから事前に作業を生成できます。
  */
 void PBR::BuildCommandBuffers() {
+  CullObjects();
+  BuildDrawBatches();
+  UpdateMaterials();
+  UpdateInstanceCullers();
+  UpdateUniformBufferFS();
+
   VkCommandBufferBeginInfo commandBufferBeginInfo =
       Initializer::CommandBufferBeginInfo();
 
@@ -70,116 +108,297 @@ void PBR::BuildCommandBuffers() {
   renderPassBeginInfo.clearValueCount = 2;
   renderPassBeginInfo.pClearValues = clear.data();
 
+  // 深度のプリパスは深度アタッチメントだけをクリアします。
+  VkRenderPassBeginInfo prepassBeginInfo = Initializer::RenderPassBeginInfo();
+  prepassBeginInfo.renderPass = depthPrepass.renderPass;
+  prepassBeginInfo.framebuffer = depthPrepass.framebuffer;
+  prepassBeginInfo.renderArea.extent.width = depthPrepass.width;
+  prepassBeginInfo.renderArea.extent.height = depthPrepass.height;
+  prepassBeginInfo.clearValueCount = 1;
+  prepassBeginInfo.pClearValues = &clear[1];
+
   for (size_t i = 0; i < drawCmdBuffers.size(); i++) {
     // ターゲットフレームバッファを設定します。
     renderPassBeginInfo.framebuffer = framebuffers[i];
     VK_CHECK_RESULT(
         vkBeginCommandBuffer(drawCmdBuffers[i], &commandBufferBeginInfo));
 
-    // デフォルトのレンダーパス設定で指定された最初のサブパスを開始します。
-    // これにより、色と奥行きのアタッチメントがクリアされます。
-    vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo,
-                         VK_SUBPASS_CONTENTS_INLINE);
+    // GPUカリングはレンダーパスの外で記録します。
+    if (settings.gpuDriven) {
+      instanceCullers.spot.Dispatch(drawCmdBuffers[i]);
+      instanceCullers.floor.Dispatch(drawCmdBuffers[i]);
+    } else if (settings.meshletCulling) {
+      meshletCuller.Dispatch(drawCmdBuffers[i]);
+    }
 
     // ビューポートとシザーの更新
     VkViewport viewport = Initializer::Viewport(
         static_cast<float>(swapchain.extent.width),
         static_cast<float>(swapchain.extent.height), 0.0f, 1.0f);
-    vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
     VkRect2D scissor = Initializer::Rect2D(swapchain.extent.width,
                                            swapchain.extent.height, 0, 0);
+
+    // Forward+では、深度だけを描画してからタイルごとにライトを振り分けます。
+    // メッシュレットの遮蔽カリングでは、同じ深度から次のフレームで使う深度ピラミッドを作ります。
+    if (settings.forwardPlus || IsMeshletOcclusionEnabled()) {
+      vkCmdBeginRenderPass(drawCmdBuffers[i], &prepassBeginInfo,
+                           VK_SUBPASS_CONTENTS_INLINE);
+      vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+      vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+      DrawScene(drawCmdBuffers[i], depthPipeline, instancedDepthPipeline,
+                true);
+      vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+      if (IsMeshletOcclusionEnabled()) {
+        depthPyramid.Build(drawCmdBuffers[i]);
+      }
+      if (settings.forwardPlus) {
+        tiledLightCuller.Dispatch(drawCmdBuffers[i]);
+      }
+    }
+
+    // デフォルトのレンダーパス設定で指定された最初のサブパスを開始します。
+    // これにより、色と奥行きのアタッチメントがクリアされます。
+    vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
     vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-    // 記述子セットとパイプラインのバインド
-    vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-    vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      pipeline);
-
-    // Spotの頂点バッファとインデックスバッファをバインドします。
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1,
-                           &models.spot.vertices.buffer, offsets);
-    vkCmdBindIndexBuffer(drawCmdBuffers[i], models.spot.indices.buffer, 0,
-                         VK_INDEX_TYPE_UINT32);
-    // Spot左側
-    {
-      const auto &spot = config["Spot"];
-      const auto trans = glm::vec3(spot["Positions"][0][0].get<float>(),
-                                   spot["Positions"][0][1].get<float>(),
-                                   spot["Positions"][0][2].get<float>());
-      const auto model = glm::translate(glm::mat4(1.0f), trans);
-      vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout,
-                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
-      Material mat{};
-      mat.rough = settings.metalRough;
-      mat.metal = 1.0f;
-      mat.reflect = settings.dielectricReflectance;
-      mat.r = settings.metalSpecular.r;
-      mat.g = settings.metalSpecular.g;
-      mat.b = settings.metalSpecular.b;
-      vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout,
-                         VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(model),
-                         sizeof(mat), &mat);
-      vkCmdDrawIndexed(drawCmdBuffers[i], models.spot.indexCount, 1, 0, 0, 0);
+    if (settings.depthPrepass) {
+      // 先に深度だけを描画し、最も手前のフラグメントだけをシェーディングします。
+      DrawScene(drawCmdBuffers[i], prepassPipelines.depth,
+                prepassPipelines.instancedDepth, true);
+      DrawScene(drawCmdBuffers[i], prepassPipelines.shade,
+                prepassPipelines.instancedShade, false);
+    } else {
+      DrawScene(drawCmdBuffers[i], pipeline, instancedPipeline, false);
     }
-    // Spot右側
-    {
-      const auto &spot = config["Spot"];
-      const auto trans = glm::vec3(spot["Positions"][1][0].get<float>(),
-                                   spot["Positions"][1][1].get<float>(),
-                                   spot["Positions"][1][2].get<float>());
-      const auto model = glm::translate(glm::mat4(1.0f), trans);
-      vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout,
-                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
-      Material mat{};
-      mat.rough = settings.dielectricRough;
-      mat.metal = 0.0f;
-      mat.reflect = settings.dielectricReflectance;
-      mat.r = settings.dielectricBaseColor.r;
-      mat.g = settings.dielectricBaseColor.g;
-      mat.b = settings.dielectricBaseColor.b;
-      vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout,
-                         VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(model),
-                         sizeof(mat), &mat);
-      vkCmdDrawIndexed(drawCmdBuffers[i], models.spot.indexCount, 1, 0, 0, 0);
+
+    DrawUI(drawCmdBuffers[i]);
+
+    vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+    // レンダーパスを終了すると、フレームバッファのカラーアタッチメントに移行する暗黙のバリアが追加されます。
+    VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+  }
+}
+
+/**
+ * @brief 現在の描画方法(GPU駆動、インスタンス描画、メッシュレット)でシーンを描画します。
+ * @param scenePipeline プッシュ定数で描画対象を受け取るパイプライン
+ * @param sceneInstancedPipeline ストレージバッファから描画対象を読むパイプライン
+ * @param depthOnly 位置だけを詰めた頂点バッファをバインドします。
+ */
+void PBR::DrawScene(VkCommandBuffer commandBuffer, VkPipeline scenePipeline,
+                    VkPipeline sceneInstancedPipeline, bool depthOnly) const {
+  const auto vertexBuffer = [depthOnly](const Model &model) {
+    return depthOnly ? &model.positions.buffer : &model.vertices.buffer;
+  };
+
+  VkDeviceSize offsets[] = {0};
+  if (settings.gpuDriven) {
+    // 描画数とLODはコンピュートシェーダが決めるため、ここでは最大数ぶん記録するだけです。
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      sceneInstancedPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, &indirectDescriptorSets.spot,
+                            0, nullptr);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer(*models.spot),
+                           offsets);
+    instanceCullers.spot.Draw(commandBuffer);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, &indirectDescriptorSets.floor,
+                            0, nullptr);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer(*models.floor),
+                           offsets);
+    instanceCullers.floor.Draw(commandBuffer);
+    return;
+  }
+
+  if (!settings.meshletCulling) {
+    // 同じメッシュの可視インスタンスを1回の描画にまとめます。
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      sceneInstancedPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, &instancedDescriptorSet, 0,
+                            nullptr);
+    const Model *bound = nullptr;
+    for (const auto &batch : drawBatches) {
+      if (batch.model != bound) {
+        bound = batch.model;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer(*bound),
+                               offsets);
+        vkCmdBindIndexBuffer(commandBuffer, bound->indices.buffer, 0,
+                             VK_INDEX_TYPE_UINT32);
+      }
+      for (const auto &mesh : batch.model->meshes) {
+        const auto &lod = mesh.GetLod(batch.level);
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, batch.instanceCount,
+                         lod.indexBase, 0, batch.firstInstance);
+      }
     }
+    return;
+  }
 
+  // 記述子セットとパイプラインのバインド
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    scenePipeline);
+
+  // メッシュレットカリングではSpotの可視三角形をインスタンスごとに間接描画します。
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer(*models.spot),
+                         offsets);
+  const auto spotCount =
+      static_cast<uint32_t>(sceneGraph.GetChildren(nodes.spot).size());
+  for (const uint32_t object : visibleObjects) {
+    const Material mat = GetMaterial(object);
     // Floor
-    {
-      vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1,
-                             &models.floor.vertices.buffer, offsets);
-      vkCmdBindIndexBuffer(drawCmdBuffers[i], models.floor.indices.buffer, 0,
+    if (object == spotCount) {
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer(*models.floor),
+                             offsets);
+      vkCmdBindIndexBuffer(commandBuffer, models.floor->indices.buffer, 0,
                            VK_INDEX_TYPE_UINT32);
 
-      const auto trans = glm::vec3(config["Floor"]["Position"][0].get<float>(),
-                                   config["Floor"]["Position"][1].get<float>(),
-                                   config["Floor"]["Position"][2].get<float>());
-      auto model = glm::translate(glm::mat4(1.0f), trans);
-      model =
-          glm::scale(model, glm::vec3(config["Floor"]["Scale"].get<float>()));
-      vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout,
+      const auto &model = sceneGraph.GetWorldMatrix(nodes.floor);
+      vkCmdPushConstants(commandBuffer, pipelineLayout,
                          VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
-      Material mat{};
-      mat.rough = 1.0f;
-      mat.metal = 0.0f;
-      mat.reflect = 1.0f;
-      mat.r = 0.0f;
-      mat.g = 0.0f;
-      mat.b = 0.0f;
-      vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout,
-                         VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(model),
-                         sizeof(mat), &mat);
-      vkCmdDrawIndexed(drawCmdBuffers[i], models.floor.indexCount, 1, 0, 0, 0);
+      vkCmdPushConstants(commandBuffer, pipelineLayout,
+                         VK_SHADER_STAGE_VERTEX_BIT, sizeof(model), sizeof(mat),
+                         &mat);
+      vkCmdDrawIndexed(commandBuffer, models.floor->indexCount, 1, 0, 0, 0);
+      continue;
     }
 
-    DrawUI(drawCmdBuffers[i]);
+    // Spot
+    const auto model = GetSpotMatrix(object);
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, sizeof(model), sizeof(mat),
+                       &mat);
+    meshletCuller.Draw(commandBuffer, object);
+  }
+}
 
-    vkCmdEndRenderPass(drawCmdBuffers[i]);
+/**
+ * @brief
+ * 可視な描画対象を画面空間誤差から選択したLODごとにまとめ、
+ * バッチ順にinstanceBufferへ書き込みます。
+ * @note
+ * Floorは常にLOD 0の1インスタンスで、Spotのバッチの後に並びます。
+ */
+void PBR::BuildDrawBatches() {
+  const auto spotCount =
+      static_cast<uint32_t>(sceneGraph.GetChildren(nodes.spot).size());
+
+  // (モデル, LOD)をキーに可視オブジェクトを並べ替えます。
+  drawLods = SelectLods();
+  std::vector<std::pair<uint32_t, uint32_t>> keys;
+  keys.reserve(visibleObjects.size());
+  for (size_t i = 0; i < visibleObjects.size(); i++) {
+    const uint32_t object = visibleObjects[i];
+    keys.emplace_back(object == spotCount ? std::numeric_limits<uint32_t>::max()
+                                          : drawLods[i],
+                      object);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  drawBatches.clear();
+  auto *instances = static_cast<GpuInstance *>(instanceBuffer.mapped);
+  for (uint32_t i = 0; i < static_cast<uint32_t>(keys.size()); i++) {
+    const auto [level, object] = keys[i];
+    const bool floor = object == spotCount;
+    instances[i] = {};
+    instances[i].model = floor ? sceneGraph.GetWorldMatrix(nodes.floor)
+                               : GetSpotMatrix(object);
+    instances[i].material = object;
+
+    const Model *model = floor ? models.floor.get() : models.spot.get();
+    const uint32_t batchLevel = floor ? 0 : level;
+    if (drawBatches.empty() || drawBatches.back().model != model ||
+        drawBatches.back().level != batchLevel) {
+      drawBatches.push_back({model, batchLevel, i, 0});
+    }
+    drawBatches.back().instanceCount++;
+  }
+}
 
-    // レンダーパスを終了すると、フレームバッファのカラーアタッチメントに移行する暗黙のバリアが追加されます。
-    VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+/**
+ * @brief visibleObjectsの各描画対象のLODを画面空間誤差から選択します。
+ * @note Floorは常にLOD 0です。
+ */
+std::vector<uint32_t> PBR::SelectLods() const {
+  const auto spotCount =
+      static_cast<uint32_t>(sceneGraph.GetChildren(nodes.spot).size());
+  const auto height = static_cast<float>(swapchain.extent.height);
+
+  std::vector<uint32_t> lods;
+  lods.reserve(visibleObjects.size());
+  for (const uint32_t object : visibleObjects) {
+    lods.push_back(object == spotCount
+                       ? 0
+                       : models.spot->SelectLod(GetSpotMatrix(object), camera,
+                                                height, settings.lodPixelError));
+  }
+  return lods;
+}
+
+glm::mat4 PBR::GetSpotMatrix(uint32_t index) const {
+  return sceneGraph.GetWorldMatrix(sceneGraph.GetChildren(nodes.spot)[index]);
+}
+
+PBR::Material PBR::GetMaterial(uint32_t object) const {
+  Material mat{};
+  if (object == sceneGraph.GetChildren(nodes.spot).size()) {
+    // Floor
+    mat.rough = 1.0f;
+    mat.metal = 0.0f;
+    mat.reflect = 1.0f;
+    mat.r = 0.0f;
+    mat.g = 0.0f;
+    mat.b = 0.0f;
+  } else if (object == 0) {
+    // Spot左側は金属
+    mat.rough = settings.metalRough;
+    mat.metal = 1.0f;
+    mat.reflect = settings.dielectricReflectance;
+    mat.r = settings.metalSpecular.r;
+    mat.g = settings.metalSpecular.g;
+    mat.b = settings.metalSpecular.b;
+  } else {
+    // それ以外は誘電体
+    mat.rough = settings.dielectricRough;
+    mat.metal = 0.0f;
+    mat.reflect = settings.dielectricReflectance;
+    mat.r = settings.dielectricBaseColor.r;
+    mat.g = settings.dielectricBaseColor.g;
+    mat.b = settings.dielectricBaseColor.b;
+  }
+  return mat;
+}
+
+/**
+ * @brief モデルの境界をワールド行列で変換し、カリング用のAABB配列を作り直します。
+ */
+void PBR::UpdateObjectBounds() {
+  objectBounds.Clear();
+  const AABB spot(models.spot->dim.min, models.spot->dim.max);
+  for (const NodeId node : sceneGraph.GetChildren(nodes.spot)) {
+    objectBounds.Add(spot.Transform(sceneGraph.GetWorldMatrix(node)));
   }
+  const AABB floor(models.floor->dim.min, models.floor->dim.max);
+  objectBounds.Add(floor.Transform(sceneGraph.GetWorldMatrix(nodes.floor)));
+}
+
+/**
+ * @brief 現在のカメラの視錐台と交差する描画対象だけをvisibleObjectsに残します。
+ */
+void PBR::CullObjects() {
+  const auto planes = Frustum::ExtractPlanes(camera.GetProjectionMatrix() *
+                                             camera.GetViewMatrix());
+  FrustumCuller::Cull(planes, objectBounds, visibleObjects);
 }
 
 void PBR::OnUpdate(float t) {
@@ -190,6 +409,40 @@ void PBR::OnUpdate(float t) {
   lightAngle =
       glm::mod(lightAngle + LIGHT_ROTATE_SPEED * deltaT, glm::two_pi<float>());
   UpdateUniformBufferFS();
+
+  // CPUで選んだ可視性とLODはコマンドバッファに記録されているため、
+  // カメラや解像度で変わったときは記録し直します。(GPU駆動ではシェーダが毎フレーム選びます)
+  if (!settings.gpuDriven) {
+    const auto recordedObjects = visibleObjects;
+    CullObjects();
+    if (visibleObjects != recordedObjects || SelectLods() != drawLods) {
+      BuildCommandBuffers();
+    }
+  }
+}
+
+/**
+ * @brief ウィンドウのサイズが変わったときは、Forward+の深度とタイルをスワップチェーンの大きさで作り直します。
+ * @note
+ * 作り直したレンダーパスは以前と互換性があるため、パイプラインはそのまま使えます。
+ */
+void PBR::SetupFramebuffers() {
+  VkBase::SetupFramebuffers();
+  if (depthPrepass.framebuffer == VK_NULL_HANDLE) {
+    return;
+  }
+
+  tiledLightCuller.Destroy(device);
+  tiledLightCuller = TiledLightCuller{};
+  if (depthPyramid.pipeline != VK_NULL_HANDLE) {
+    depthPyramid.Destroy(device);
+    depthPyramid = DepthPyramid{};
+  }
+  depthPrepass.Destroy(device);
+  depthPrepass = Framebuffer{};
+  SetupDepthPrepass();
+  UpdateLightDescriptors();
+  tiledLightCuller.Update(camera);
 }
 
 void PBR::ViewChanged() {
@@ -197,6 +450,15 @@ void PBR::ViewChanged() {
   UpdateUniformBufferVS();
 }
 
+VkPhysicalDeviceFeatures PBR::GetEnabledFeatures() const {
+  VkPhysicalDeviceFeatures enabledFeatures = VkBase::GetEnabledFeatures();
+  // GPU駆動の描画で使用します。
+  enabledFeatures.multiDrawIndirect = device.features.multiDrawIndirect;
+  enabledFeatures.drawIndirectFirstInstance =
+      device.features.drawIndirectFirstInstance;
+  return enabledFeatures;
+}
+
 //*-----------------------------------------------------------------------------
 // Assets
 //*-----------------------------------------------------------------------------
@@ -204,14 +466,42 @@ void PBR::ViewChanged() {
 void PBR::LoadAssets() {
   // Spot
   {
-    const auto &modelPath = config["Spot"]["Model"].get<std::string>();
-    models.spot.LoadFromFile(device, modelPath, queue, vertexLayout);
+    const auto &spot = config["Spot"];
+    const auto &modelPath = spot["Model"].get<std::string>();
+    ModelCreateInfo modelCreateInfo{};
+    modelCreateInfo.buildPositions = true;
+    if (spot.contains("Lod")) {
+      const auto &lod = spot["Lod"];
+      modelCreateInfo.lod.levels = lod["Levels"].get<uint32_t>();
+      modelCreateInfo.lod.reduction = lod["Reduction"].get<float>();
+      modelCreateInfo.lod.maxError = lod["MaxError"].get<float>();
+      modelCreateInfo.lod.lockBorder = lod["LockBorder"].get<bool>();
+      modelCreateInfo.lod.normalWeight = lod["NormalWeight"].get<float>();
+      settings.lodPixelError = lod["PixelError"].get<float>();
+    }
+    if (spot.contains("Meshlets")) {
+      const auto &meshlets = spot["Meshlets"];
+      modelCreateInfo.buildMeshlets = meshlets["Enabled"].get<bool>();
+      settings.meshletCulling = modelCreateInfo.buildMeshlets;
+      settings.meshletOcclusion = meshlets["Occlusion"].get<bool>();
+    }
+    models.spot = assetRegistry.LoadModel(device, modelPath, queue,
+                                          vertexLayout, modelCreateInfo);
   }
   // Floor
   {
     const auto &modelPath = config["Floor"]["Model"].get<std::string>();
-    models.floor.LoadFromFile(device, modelPath, queue, vertexLayout);
+    ModelCreateInfo modelCreateInfo{};
+    modelCreateInfo.buildPositions = true;
+    models.floor = assetRegistry.LoadModel(device, modelPath, queue,
+                                           vertexLayout, modelCreateInfo);
   }
+
+  // 配置はシーングラフで管理します。
+  nodes.spot = sceneGraph.Load(config["Spot"], "Spot");
+  nodes.floor = sceneGraph.Load(config["Floor"], "Floor");
+  sceneGraph.UpdateWorldMatrices();
+  UpdateObjectBounds();
 }
 
 //*-----------------------------------------------------------------------------
@@ -229,6 +519,18 @@ void PBR::SetupDescriptorSetLayout() {
                                               VK_SHADER_STAGE_VERTEX_BIT, 0),
       Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                                               VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+      // 以下は間接描画用の頂点シェーダのみが参照します。
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_VERTEX_BIT, 2),
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_VERTEX_BIT, 3),
+      // 以下はForward+のライトのリストで、フラグメントシェーダが参照します。
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+      Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_SHADER_STAGE_FRAGMENT_BIT, 6),
   };
 
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
@@ -241,11 +543,10 @@ void PBR::SetupDescriptorSetLayout() {
   VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
       Initializer::PipelineLayoutCreateInfo(&descriptorSetLayout);
 
+  // マテリアルは頂点シェーダからフラットな出力としてフラグメントシェーダへ渡します。
   std::vector<VkPushConstantRange> pushConstantRanges = {
       Initializer::PushConstantRange(VK_SHADER_STAGE_VERTEX_BIT,
-                                     sizeof(glm::mat4), 0),
-      Initializer::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT,
-                                     sizeof(Material), sizeof(glm::mat4)),
+                                     sizeof(glm::mat4) + sizeof(Material), 0),
   };
   pipelineLayoutCreateInfo.pushConstantRangeCount =
       static_cast<uint32_t>(pushConstantRanges.size());
@@ -258,11 +559,12 @@ void PBR::SetupDescriptorPool() {
   // APIに記述子の最大数を通知する必要があります。
   std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {
       Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16),
+      Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 18),
   };
 
   // グローバル記述子プールを生成します。
   VkDescriptorPoolCreateInfo descriptorPoolInfo =
-      Initializer::DescriptorPoolCreateInfo(descriptorPoolSizes, 2);
+      Initializer::DescriptorPoolCreateInfo(descriptorPoolSizes, 4);
 
   VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr,
                                          &descriptorPool));
@@ -287,6 +589,66 @@ void PBR::SetupDescriptorSet() {
   vkUpdateDescriptorSets(device,
                          static_cast<uint32_t>(writeDescriptorSets.size()),
                          writeDescriptorSets.data(), 0, nullptr);
+
+  // インスタンス描画では全モデルで1つのインスタンスバッファを共有し、
+  // 間接描画ではモデルごとにインスタンスバッファを切り替えます。
+  std::vector<std::pair<VkDescriptorSet *, const Buffer *>> instancedSets = {
+      {&instancedDescriptorSet, &instanceBuffer},
+  };
+  if (InstanceCuller::IsSupported(device)) {
+    instancedSets.emplace_back(&indirectDescriptorSets.spot,
+                               &instanceCullers.spot.instances);
+    instancedSets.emplace_back(&indirectDescriptorSets.floor,
+                               &instanceCullers.floor.instances);
+  }
+  for (auto [set, instances] : instancedSets) {
+    VK_CHECK_RESULT(
+        vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, set));
+    const std::array<VkWriteDescriptorSet, 4> instancedWrites = {
+        Initializer::WriteDescriptorSet(*set,
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
+                                        &uniformBuffers.object.descriptor),
+        Initializer::WriteDescriptorSet(*set,
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
+                                        &uniformBuffers.params.descriptor),
+        Initializer::WriteDescriptorSet(*set,
+                                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2,
+                                        &instances->descriptor),
+        Initializer::WriteDescriptorSet(*set,
+                                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3,
+                                        &materialBuffer.descriptor),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(instancedWrites.size()),
+                           instancedWrites.data(), 0, nullptr);
+  }
+  UpdateLightDescriptors();
+}
+
+/**
+ * @brief すべての記述子セットにForward+のライトのリスト(Binding 4から6)を書き込みます。
+ * @note タイル単位のライトカリングを作り直したときにも呼び出します。
+ */
+void PBR::UpdateLightDescriptors() {
+  std::vector<VkDescriptorSet> sets = {descriptorSet, instancedDescriptorSet};
+  if (InstanceCuller::IsSupported(device)) {
+    sets.emplace_back(indirectDescriptorSets.spot);
+    sets.emplace_back(indirectDescriptorSets.floor);
+  }
+  for (const VkDescriptorSet set : sets) {
+    const std::array<VkWriteDescriptorSet, 3> lightWrites = {
+        Initializer::WriteDescriptorSet(set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                        4, &tiledLightCuller.lights.descriptor),
+        Initializer::WriteDescriptorSet(
+            set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5,
+            &tiledLightCuller.tileLights.descriptor),
+        Initializer::WriteDescriptorSet(
+            set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6,
+            &tiledLightCuller.lightIndices.descriptor),
+    };
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(lightWrites.size()),
+                           lightWrites.data(), 0, nullptr);
+  }
 }
 
 /**
@@ -398,7 +760,79 @@ void PBR::SetupPipelines() {
 
   // グラフィックスパイプラインを作成した後は、シェーダーモジュールは不要になります。
   vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+  // インスタンス描画用のパイプラインは頂点シェーダだけが異なります。
+  // 直接描画のfirstInstanceは機能を必要としないため、常に作成します。
+  shaderStages[0] =
+      CreateShader(device, config["IndirectVertexShader"].get<std::string>(),
+                   VK_SHADER_STAGE_VERTEX_BIT);
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &instancedPipeline));
+
+  // プリパスの後のシェーディングは深度を書き込まず、プリパスと等しい深度だけを通します。
+  depthStencilState.depthWriteEnable = VK_FALSE;
+  depthStencilState.depthCompareOp = VK_COMPARE_OP_EQUAL;
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &prepassPipelines.instancedShade));
+  vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+  shaderStages[0] =
+      CreateShader(device, config["VertexShader"].get<std::string>(),
+                   VK_SHADER_STAGE_VERTEX_BIT);
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &prepassPipelines.shade));
+  vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
   vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+
+  // 深度だけを描画するパイプラインは、位置だけを詰めた頂点ストリームを読み、
+  // フラグメントシェーダを持ちません。
+  vertexInputBindings = {
+      Initializer::VertexInputBindingDescription(0, 3 * sizeof(float),
+                                                 VK_VERTEX_INPUT_RATE_VERTEX),
+  };
+  vertexInputAttributes = {
+      Initializer::VertexInputAttributeDescription(
+          0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+  };
+  vertexInputState = Initializer::PipelineVertexInputStateCreateInfo(
+      vertexInputBindings, vertexInputAttributes);
+  depthStencilState.depthWriteEnable = VK_TRUE;
+  depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  pipelineCreateInfo.stageCount = 1;
+
+  // メインのレンダーパスではカラーを書き込みません。
+  blendAttachmentState.colorWriteMask = 0;
+  shaderStages[0] = CreateShader(
+      device, config["DepthIndirectVertexShader"].get<std::string>(),
+      VK_SHADER_STAGE_VERTEX_BIT);
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &prepassPipelines.instancedDepth));
+
+  // Forward+のプリパスはカラーアタッチメントがないため、ブレンドステートも空にします。
+  pipelineCreateInfo.renderPass = depthPrepass.renderPass;
+  colorBlendState.attachmentCount = 0;
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &instancedDepthPipeline));
+  vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+  shaderStages[0] =
+      CreateShader(device, config["DepthVertexShader"].get<std::string>(),
+                   VK_SHADER_STAGE_VERTEX_BIT);
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &depthPipeline));
+
+  pipelineCreateInfo.renderPass = renderPass;
+  colorBlendState.attachmentCount = 1;
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                            &pipelineCreateInfo, nullptr,
+                                            &prepassPipelines.depth));
+  vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
 }
 
 //*-----------------------------------------------------------------------------
@@ -419,6 +853,127 @@ void PBR::PrepareCamera() {
                           1.0f, 100.0f);
 }
 
+/**
+ * @brief 設定ファイルのライトと、Forward+で追加するライトを用意します。
+ * @note
+ * 位置を持つライトはRangeを影響範囲とし、指定がなければ強度がkLightCutoffまで減衰する距離とします。<br>
+ * 追加のライトはシード値を固定した乱数で床の上に配置します。
+ */
+void PBR::PrepareLights() {
+  lights.clear();
+  for (const auto &light : config["Lights"]) {
+    const auto intensity = light["Intensity"].get<float>();
+    GpuLight &dst = lights.emplace_back();
+    dst.color = glm::vec3(intensity);
+    dst.radius = light.contains("Range")
+                     ? light["Range"].get<float>()
+                     : std::sqrt(intensity / kLightCutoff);
+    // 位置を持たないライトはUpdateUniformBufferFSで回転させます。
+    if (light.contains("Position")) {
+      for (int j = 0; j < 4; j++) {
+        dst.position[j] = light["Position"][j].get<float>();
+      }
+    }
+  }
+
+  if (!config.contains("ForwardPlus") ||
+      !config["ForwardPlus"].contains("RandomLights")) {
+    return;
+  }
+  const auto &random = config["ForwardPlus"]["RandomLights"];
+  const auto count = random["Count"].get<uint32_t>();
+  const auto intensity = random["Intensity"].get<float>();
+  const auto range = random["Range"].get<float>();
+  const auto extent = random["Extent"].get<float>();
+  const auto minHeight = random["Height"][0].get<float>();
+  const auto maxHeight = random["Height"][1].get<float>();
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
+  std::uniform_real_distribution<float> distXZ(-extent, extent);
+  std::uniform_real_distribution<float> distY(minHeight, maxHeight);
+  for (uint32_t i = 0; i < count; i++) {
+    GpuLight &dst = lights.emplace_back();
+    dst.position = glm::vec4(distXZ(gen), distY(gen), distXZ(gen), 1.0f);
+    dst.color = intensity * glm::vec3(dist01(gen), dist01(gen), dist01(gen));
+    dst.radius = range;
+  }
+}
+
+/**
+ * @brief 深度のプリパスの有無を決め、Forward+の深度のプリパスと、
+ * その深度を読むタイル単位のライトカリングを用意します。
+ * @note
+ * DepthPrepassはtrue, falseまたは"Auto"で、"Auto"ではIsDepthPrepassPreferredで判断します。
+ */
+void PBR::PrepareDepthPrepass() {
+  settings.forwardPlus = config.contains("ForwardPlus") &&
+                         config["ForwardPlus"]["Enabled"].get<bool>();
+  if (config.contains("DepthPrepass")) {
+    const auto &depthPrepassConfig = config["DepthPrepass"];
+    settings.depthPrepassAuto = !depthPrepassConfig.is_boolean();
+    settings.depthPrepass = settings.depthPrepassAuto
+                                ? IsDepthPrepassPreferred()
+                                : depthPrepassConfig.get<bool>();
+  }
+  SetupDepthPrepass();
+}
+
+/**
+ * @brief メインのレンダーパスで深度のプリパスを行うべきかを返します。
+ * @note
+ * Forward+では既にタイルのカリングのために深度を描画しているため、
+ * さらにプリパスを行うと頂点処理が3回になります。
+ */
+bool PBR::IsDepthPrepassPreferred() const {
+  return !settings.forwardPlus && lights.size() >= kDepthPrepassMinLights;
+}
+
+/**
+ * @brief メッシュレットカリングで深度ピラミッドによる遮蔽判定を行うかを返します。
+ */
+bool PBR::IsMeshletOcclusionEnabled() const {
+  return !settings.gpuDriven && settings.meshletCulling &&
+         settings.meshletOcclusion;
+}
+
+/**
+ * @brief スワップチェーンの大きさでForward+の深度のプリパスとタイル単位のライトカリングを生成します。
+ */
+void PBR::SetupDepthPrepass() {
+  depthPrepass.width = swapchain.extent.width;
+  depthPrepass.height = swapchain.extent.height;
+
+  // タイルの深度の範囲を求めるため、サンプリングできる形式にします。
+  AttachmentCreateInfo attachmentCreateInfo{};
+  attachmentCreateInfo.width = depthPrepass.width;
+  attachmentCreateInfo.height = depthPrepass.height;
+  attachmentCreateInfo.layerCount = 1;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_SAMPLED_BIT;
+  attachmentCreateInfo.format = device.FindSupportedDepthFormat(true);
+  depthPrepass.AddAttachment(device, attachmentCreateInfo);
+  VK_CHECK_RESULT(depthPrepass.CreateRenderPass(device));
+
+  const uint32_t maxLightIndices =
+      config.contains("ForwardPlus")
+          ? config["ForwardPlus"]["MaxLightIndices"].get<uint32_t>()
+          : kDefaultMaxLightIndices;
+  tiledLightCuller.Setup(device, depthPrepass.attachments[0],
+                         depthPrepass.width, depthPrepass.height,
+                         static_cast<uint32_t>(lights.size()), maxLightIndices,
+                         pipelineCache);
+
+  // メッシュレットの遮蔽カリングは、前のフレームのプリパスの深度から作ったピラミッドで判定します。
+  if (!models.spot->meshlets.meshlets.empty()) {
+    depthPyramid.Setup(device, depthPrepass.attachments[0], depthPrepass.width,
+                       depthPrepass.height, queue, pipelineCache);
+    meshletCuller.SetDepthPyramid(device, depthPyramid.descriptor,
+                                  depthPyramid.width, depthPyramid.height,
+                                  depthPyramid.levels);
+  }
+}
+
 /**
  * @brief
  * シェーダーユニフォームを含むユニフォームバッファブロックを準備して初期化します。
@@ -440,6 +995,23 @@ void PBR::PrepareUniformBuffers() {
                                    sizeof(uboFS), &uboFS));
   VK_CHECK_RESULT(uniformBuffers.params.Map(device));
 
+  // 描画対象(Spotの各配置とFloor)ごとのマテリアル
+  VK_CHECK_RESULT(materialBuffer.Create(
+      device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      (sceneGraph.GetChildren(nodes.spot).size() + 1) * sizeof(GpuMaterial)));
+  VK_CHECK_RESULT(materialBuffer.Map(device));
+  UpdateMaterials();
+
+  // インスタンス描画で参照するインスタンス(描画バッチ順)
+  VK_CHECK_RESULT(instanceBuffer.Create(
+      device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      (sceneGraph.GetChildren(nodes.spot).size() + 1) * sizeof(GpuInstance)));
+  VK_CHECK_RESULT(instanceBuffer.Map(device));
+
   UpdateUniformBufferVS();
   UpdateUniformBufferFS();
 }
@@ -456,29 +1028,88 @@ void PBR::UpdateUniformBufferVS() {
 
   // ユニフォームバッファへコピーします。
   uniformBuffers.object.Copy(&uboVS, sizeof(uboVS));
+  tiledLightCuller.Update(camera);
+
+  if (!models.spot->meshlets.meshlets.empty()) {
+    std::vector<glm::mat4> instances(meshletCuller.instanceCount);
+    for (uint32_t i = 0; i < meshletCuller.instanceCount; i++) {
+      instances[i] = GetSpotMatrix(i);
+    }
+    meshletCuller.Update(uboVS.viewProj, camera.GetPosition(), instances,
+                         IsMeshletOcclusionEnabled());
+  }
+  UpdateInstanceCullers();
+}
+
+/**
+ * @brief 描画対象ごとのインスタンスをGPUカリング用のバッファへ書き込みます。
+ * @note マテリアル番号は描画対象の番号と同じです。
+ */
+void PBR::SetupInstanceCullers() {
+  if (!InstanceCuller::IsSupported(device)) {
+    return;
+  }
+  settings.gpuDriven = config.contains("GpuDriven") &&
+                       config["GpuDriven"].get<bool>();
+  // GPU駆動の描画はメッシュレットカリングより優先されます。
+  settings.meshletCulling = settings.meshletCulling && !settings.gpuDriven;
+
+  const auto &spots = sceneGraph.GetChildren(nodes.spot);
+  const auto spotCount = static_cast<uint32_t>(spots.size());
+  instanceCullers.spot.Setup(device, *models.spot, spotCount, queue,
+                             pipelineCache);
+  for (uint32_t i = 0; i < spotCount; i++) {
+    instanceCullers.spot.SetInstance(i, GetSpotMatrix(i), i);
+  }
+  instanceCullers.spot.SetInstanceCount(spotCount);
+
+  instanceCullers.floor.Setup(device, *models.floor, 1, queue, pipelineCache);
+  instanceCullers.floor.SetInstance(0, sceneGraph.GetWorldMatrix(nodes.floor),
+                                    spotCount);
+  instanceCullers.floor.SetInstanceCount(1);
+}
+
+void PBR::UpdateInstanceCullers() {
+  if (!InstanceCuller::IsSupported(device)) {
+    return;
+  }
+  const auto height = static_cast<float>(swapchain.extent.height);
+  for (auto *culler : {&instanceCullers.spot, &instanceCullers.floor}) {
+    culler->Update(uboVS.viewProj, camera, height, settings.lodPixelError);
+  }
+}
+
+void PBR::UpdateMaterials() {
+  const auto objectCount =
+      static_cast<uint32_t>(sceneGraph.GetChildren(nodes.spot).size()) + 1;
+  auto *materials = static_cast<GpuMaterial *>(materialBuffer.mapped);
+  for (uint32_t i = 0; i < objectCount; i++) {
+    const Material mat = GetMaterial(i);
+    materials[i].params = glm::vec4(mat.rough, mat.metal, mat.reflect, 0.0f);
+    materials[i].color = glm::vec4(mat.r, mat.g, mat.b, 1.0f);
+  }
 }
 
 void PBR::UpdateUniformBufferFS() {
   uboFS.eye = camera.GetPosition();
+  uboFS.tiled = settings.forwardPlus ? 1 : 0;
 
-  uboFS.lightsNum = static_cast<int>(config["Lights"].size());
-  for (int i = 0; i < uboFS.lightsNum; i++) {
-    const auto &light = config["Lights"][i];
-
-    uboFS.lights[i].intensity = light["Intensity"].get<float>();
+  // 位置を持たないライトは、設定された半径と高さで回転させます。
+  const auto &configLights = config["Lights"];
+  for (size_t i = 0; i < configLights.size(); i++) {
+    const auto &light = configLights[i];
     if (light.contains("Position")) {
-      for (int j = 0; j < 4; j++) {
-        uboFS.lights[i].pos[j] = light["Position"][j].get<float>();
-      }
-    } else {
-      const auto radius = light["Radius"].get<float>();
-      uboFS.lights[i].pos.x = radius * std::sin(lightAngle);
-      uboFS.lights[i].pos.y = light["Height"].get<float>();
-      uboFS.lights[i].pos.z = radius * std::cos(lightAngle);
-      uboFS.lights[i].pos.w =
-          light["Type"].get<std::string>() == "Directional" ? 0.0f : 1.0f;
+      continue;
     }
+    const auto radius = light["Radius"].get<float>();
+    lights[i].position.x = radius * std::sin(lightAngle);
+    lights[i].position.y = light["Height"].get<float>();
+    lights[i].position.z = radius * std::cos(lightAngle);
+    lights[i].position.w =
+        light["Type"].get<std::string>() == "Directional" ? 0.0f : 1.0f;
   }
+  tiledLightCuller.SetLights(lights);
+  uboFS.lights = tiledLightCuller.GetParams();
 
   uniformBuffers.params.Copy(&uboFS, sizeof(uboFS));
 }
@@ -490,4 +1121,32 @@ void PBR::OnUpdateUIOverlay() {
                        &settings.dielectricBaseColor);
   uiOverlay.SliderFloat("Non-Metal Roughness", &settings.dielectricRough, 0.0f,
                         1.0f);
+  uiOverlay.SliderFloat("LOD Pixel Error", &settings.lodPixelError, 0.0f,
+                        16.0f);
+  // GPU駆動の描画とメッシュレットカリングは、どちらか一方だけを有効にします。
+  bool cullingChanged = false;
+  if (!models.spot->meshlets.meshlets.empty()) {
+    if (uiOverlay.Checkbox("Meshlet Culling", &settings.meshletCulling)) {
+      settings.gpuDriven = settings.gpuDriven && !settings.meshletCulling;
+      cullingChanged = true;
+    }
+    cullingChanged |=
+        uiOverlay.Checkbox("Meshlet Occlusion", &settings.meshletOcclusion);
+  }
+  if (InstanceCuller::IsSupported(device) &&
+      uiOverlay.Checkbox("GPU Driven", &settings.gpuDriven)) {
+    settings.meshletCulling = settings.meshletCulling && !settings.gpuDriven;
+    cullingChanged = true;
+  }
+  if (cullingChanged) {
+    // 遮蔽判定の有無はカリングのユニフォームバッファに書き込みます。
+    UpdateUniformBufferVS();
+  }
+  if (uiOverlay.Checkbox("Forward+", &settings.forwardPlus) &&
+      settings.depthPrepassAuto) {
+    settings.depthPrepass = IsDepthPrepassPreferred();
+  }
+  if (uiOverlay.Checkbox("Depth Prepass", &settings.depthPrepass)) {
+    settings.depthPrepassAuto = false;
+  }
 }
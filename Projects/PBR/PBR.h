@@ -5,10 +5,18 @@
 #include <string>
 #include <vector>
 
+#include "Scene/SceneGraph.h"
+#include "VK/AssetRegistry.h"
 #include "VK/Buffer.h"
+#include "VK/DepthPyramid.h"
+#include "VK/Framebuffer.h"
+#include "VK/InstanceCuller.h"
+#include "VK/MeshletCuller.h"
 #include "VK/Model.h"
 #include "VK/Texture.h"
+#include "VK/TiledLightCuller.h"
 #include "View/Camera.h"
+#include "View/FrustumCuller.h"
 
 enum struct MetalColor : std::uint32_t {
   Nil,
@@ -33,32 +41,59 @@ public:
 
   void PrepareCamera();
   void LoadAssets();
+  void PrepareLights();
+  void PrepareDepthPrepass();
+  void SetupDepthPrepass();
   void PrepareUniformBuffers();
   void UpdateUniformBufferVS();
   void UpdateUniformBufferFS();
+  void SetupInstanceCullers();
+  void UpdateInstanceCullers();
+  void UpdateMaterials();
 
   void SetupDescriptorSetLayout();
   void SetupPipelines();
   void SetupDescriptorPool();
   void SetupDescriptorSet();
+  void UpdateLightDescriptors();
 
+  void SetupFramebuffers() override;
   void BuildCommandBuffers() override;
+  void BuildDrawBatches();
+  [[nodiscard]] std::vector<uint32_t> SelectLods() const;
+  void DrawScene(VkCommandBuffer commandBuffer, VkPipeline scenePipeline,
+                 VkPipeline sceneInstancedPipeline, bool depthOnly) const;
+  [[nodiscard]] glm::mat4 GetSpotMatrix(uint32_t index) const;
+  void UpdateObjectBounds();
+  void CullObjects();
 
   void ViewChanged() override;
+  [[nodiscard]] VkPhysicalDeviceFeatures GetEnabledFeatures() const override;
 
 private:
+  /** @brief 範囲を指定しないライトは、強度がこの値まで減衰する距離を影響範囲とします。 */
+  static constexpr float kLightCutoff = 0.01f;
+  /** @brief Forward+で全タイルが共有するライトのインデックスの既定の最大数 */
+  static constexpr uint32_t kDefaultMaxLightIndices = 1u << 20;
+  /**
+   * @brief DepthPrepassが"Auto"のとき、プリパスを有効にするライト数の下限
+   * @note
+   * ライトが少なければシェーディングが軽く、頂点処理を2回行う分だけ損になります。<br>
+   * Forward+が有効なときはライト数によらずプリパスを行いません。(IsDepthPrepassPreferred)
+   */
+  static constexpr size_t kDepthPrepassMinLights = 16;
+  [[nodiscard]] bool IsDepthPrepassPreferred() const;
+  [[nodiscard]] bool IsMeshletOcclusionEnabled() const;
+
   struct UniformBufferObjectVS {
     alignas(16) glm::mat4 viewProj;
   } uboVS;
 
-  struct Light {
-    alignas(16) glm::vec4 pos;
-    alignas(4) float intensity;
-  };
   struct UniformBufferObjectFS {
     alignas(16) glm::vec3 eye;
-    Light lights[8];
-    alignas(4) int lightsNum;
+    /** @brief 0以外ならタイルのライトのリストを使用します。 */
+    alignas(4) int tiled;
+    alignas(16) TiledLightCuller::Params lights;
   } uboFS;
 
   struct Material {
@@ -69,11 +104,50 @@ private:
     float g;
     float b;
   };
+  /** @brief 間接描画で参照するマテリアルです。(std430) */
+  struct GpuMaterial {
+    /** @brief x: ラフネス, y: 金属度, z: 反射率 */
+    glm::vec4 params;
+    glm::vec4 color;
+  };
+  /**
+   * @brief 描画対象(Spotの各配置、Floorの順)のマテリアルを返します。
+   */
+  [[nodiscard]] Material GetMaterial(uint32_t object) const;
   VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
   VkPipeline pipeline = VK_NULL_HANDLE;
+  /**
+   * @brief インスタンスとマテリアルをストレージバッファから読むパイプライン
+   * @note インスタンス描画と間接描画で共用します。
+   */
+  VkPipeline instancedPipeline = VK_NULL_HANDLE;
+  /** @brief Forward+の深度のプリパスで深度だけを描画するパイプライン */
+  VkPipeline depthPipeline = VK_NULL_HANDLE;
+  VkPipeline instancedDepthPipeline = VK_NULL_HANDLE;
+  /**
+   * @brief メインのレンダーパスで深度のプリパスを行うパイプライン
+   * @note
+   * 深度だけを先に描画し、深度が等しいフラグメントだけをシェーディングすることで、
+   * 重なった面のシェーディング(オーバードロー)をなくします。
+   */
+  struct {
+    /** @brief 位置だけの頂点ストリームで深度だけを書き込みます。 */
+    VkPipeline depth = VK_NULL_HANDLE;
+    VkPipeline instancedDepth = VK_NULL_HANDLE;
+    /** @brief 深度の書き込みを無効にし、等しい深度だけをシェーディングします。 */
+    VkPipeline shade = VK_NULL_HANDLE;
+    VkPipeline instancedShade = VK_NULL_HANDLE;
+  } prepassPipelines;
 
   VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
   VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  /** @brief インスタンス描画用(Binding 2がinstanceBuffer) */
+  VkDescriptorSet instancedDescriptorSet = VK_NULL_HANDLE;
+  /** @brief 間接描画用(Binding 2がモデルごとのインスタンスバッファ) */
+  struct {
+    VkDescriptorSet spot = VK_NULL_HANDLE;
+    VkDescriptorSet floor = VK_NULL_HANDLE;
+  } indirectDescriptorSets;
 
   Camera camera{};
 
@@ -82,15 +156,64 @@ private:
       VertexLayoutComponent::Normal,
   }};
 
+  AssetRegistry assetRegistry{};
   struct {
-    Model spot;
-    Model floor;
+    ModelHandle spot;
+    ModelHandle floor;
   } models;
+  SceneGraph sceneGraph{};
+  struct {
+    /** @brief 子ノードがSpot.Positionsの各配置です。 */
+    NodeId spot = kInvalidNode;
+    NodeId floor = kInvalidNode;
+  } nodes;
 
   struct {
     Buffer object{};
     Buffer params{};
   } uniformBuffers;
+  /** @brief 描画対象ごとのGpuMaterial */
+  Buffer materialBuffer{};
+  /** @brief インスタンス描画で参照する、描画バッチ順に並べたGpuInstance */
+  Buffer instanceBuffer{};
+
+  /**
+   * @brief 同じメッシュ(モデルとLOD)を1回の描画にまとめたものです。
+   * @note インスタンスはinstanceBufferのfirstInstanceから連続しています。
+   */
+  struct DrawBatch {
+    const Model *model;
+    uint32_t level;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+  };
+  std::vector<DrawBatch> drawBatches{};
+  /** @brief drawBatchesを作ったときのvisibleObjectsごとのLOD */
+  std::vector<uint32_t> drawLods{};
+
+  /**
+   * @brief 描画対象のワールド空間AABB
+   * @note 先頭からSpotの各配置、最後がFloorです。
+   */
+  AABBArray objectBounds{};
+  /** @brief 視錐台内にある描画対象のインデックス(昇順) */
+  std::vector<uint32_t> visibleObjects{};
+
+  /** @brief Spotの2インスタンスをメッシュレット単位でカリングします。 */
+  MeshletCuller meshletCuller{};
+  /** @brief メッシュレットの遮蔽カリングで使う、深度のプリパスから作る深度ピラミッド */
+  DepthPyramid depthPyramid{};
+  /** @brief GPU駆動の描画で、モデルごとにインスタンスをカリングします。 */
+  struct {
+    InstanceCuller spot{};
+    InstanceCuller floor{};
+  } instanceCullers;
+
+  /** @brief 設定ファイルのライト(先頭)と、Forward+で追加するライト */
+  std::vector<GpuLight> lights{};
+  /** @brief Forward+でライトを振り分けるための深度のプリパス */
+  Framebuffer depthPrepass{};
+  TiledLightCuller tiledLightCuller{};
 
   float prevTime = 0.0f;
   float lightAngle = 0.0f;
@@ -103,5 +226,27 @@ private:
     glm::vec3 dielectricBaseColor{0.2f, 0.33f, 0.17f};
     float dielectricRough = 0.5f;
     float dielectricReflectance = 0.5f;
+
+    /** @brief LOD選択で許容する画面上の誤差(ピクセル) */
+    float lodPixelError = 1.0f;
+
+    /** @brief LODの代わりにGPUメッシュレットカリングを使用します。 */
+    bool meshletCulling = false;
+    /**
+     * @brief 深度ピラミッドによる遮蔽カリングを行います。
+     * @note 前のフレームの深度で判定するため、見え始めは1フレーム遅れます。
+     */
+    bool meshletOcclusion = false;
+    /**
+     * @brief カリングとLOD選択をGPUで行い、間接描画します。
+     * @note メッシュレットカリングより優先されます。
+     */
+    bool gpuDriven = false;
+    /** @brief 深度のプリパスとタイル単位のライトカリングを行います。 */
+    bool forwardPlus = false;
+    /** @brief メインのレンダーパスで深度のプリパスを行います。 */
+    bool depthPrepass = false;
+    /** @brief DepthPrepassが"Auto"で、Forward+の切り替えに合わせて決め直します。 */
+    bool depthPrepassAuto = false;
   } settings;
 };
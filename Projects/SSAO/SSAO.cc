@@ -5,7 +5,10 @@
 
 #include <array>
 #include <boost/assert.hpp>
+#include <cstddef>
+#include <filesystem>
 #include <random>
+#include <utility>
 #include <vector>
 
 #include "VK/Common.h"
@@ -24,44 +27,93 @@ void SSAO::OnPostInit() {
   LoadAssets();
   PrepareOffscreenFramebuffer();
   PrepareUniformBuffers();
+  PrepareInstanceBuffer();
 
   SetupDescriptorPool();
   SetupDescriptorSet();
   SetupPipelines();
 
+  profiler.Setup(device, static_cast<uint32_t>(drawCmdBuffers.size()), queue);
   BuildCommandBuffers();
 }
 
 void SSAO::OnPreDestroy() {
+  vkDestroyPipeline(device, pipelines.temporal, nullptr);
+  vkDestroyPipeline(device, pipelines.upsample, nullptr);
+  vkDestroyPipeline(device, pipelines.downsample, nullptr);
   vkDestroyPipeline(device, pipelines.lighting, nullptr);
-  vkDestroyPipeline(device, pipelines.blur, nullptr);
   vkDestroyPipeline(device, pipelines.ssao, nullptr);
   vkDestroyPipeline(device, pipelines.gBuffer, nullptr);
 
+  vkDestroyPipelineLayout(device, pipelineLayouts.temporal, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayouts.upsample, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayouts.downsample, nullptr);
   vkDestroyPipelineLayout(device, pipelineLayouts.lighting, nullptr);
-  vkDestroyPipelineLayout(device, pipelineLayouts.blur, nullptr);
   vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
   vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
 
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.temporal, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.upsample, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.downsample,
+                               nullptr);
   vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.lighting, nullptr);
-  vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.blur, nullptr);
   vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
   vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
 
-  frameBuffers.blur.Destroy(device);
-  frameBuffers.ssao.Destroy(device);
-  frameBuffers.gBuffer.Destroy(device);
+  DestroyAOFramebuffers();
+  gBuffer.Destroy(device);
+  profiler.Destroy(device);
 
+  uniformBuffers.temporal.Destroy(device);
+  uniformBuffers.upsample.Destroy(device);
   uniformBuffers.lighting.Destroy(device);
   uniformBuffers.ssao.Destroy(device);
   uniformBuffers.gBuffer.Destroy(device);
+  instanceBuffer.Destroy(device);
 
+  textureStreamer.Destroy(device);
+  assetArchive.Destroy(device);
   textures.noise.Destroy(device);
   textures.wall.Destroy(device);
   textures.floor.Destroy(device);
 
-  models.floor.Destroy(device);
-  models.teapot.Destroy(device);
+  assetRegistry.Destroy(device);
+}
+
+void SSAO::OnUpdate(float) {
+  if (!settings.textureStreaming) {
+    return;
+  }
+
+  // 床と壁の画面上のテクセル密度から必要なミップレベルを要求します。
+  const float height = static_cast<float>(swapchain.extent.height);
+  if (streamingHandles.floor) {
+    textureStreamer.RequestByDensity(*streamingHandles.floor,
+                                     models.floor->dim, GetFloorMatrix(),
+                                     camera, height, uvScales.floor);
+  }
+  if (streamingHandles.wall) {
+    for (uint32_t i = 0; i < 2; i++) {
+      textureStreamer.RequestByDensity(*streamingHandles.wall,
+                                       models.wall->dim, GetWallMatrix(i),
+                                       camera, height, uvScales.wall);
+    }
+  }
+
+  // イメージが作り直された場合は記述子とコマンドバッファを更新します。
+  if (textureStreamer.Update(device)) {
+    UpdateTextureDescriptors();
+    BuildCommandBuffers();
+  }
+}
+
+void SSAO::OnRender() {
+  if (settings.temporal) {
+    AdvanceTemporalFrame();
+  }
+  VkBase::OnRender();
+  // 提出したコマンドバッファはSubmitFrameで完了しています。
+  profiler.Resolve(device, currentBuffer);
 }
 
 void SSAO::ViewChanged() { UpdateUniformBuffers(); }
@@ -71,6 +123,26 @@ void SSAO::ViewChanged() { UpdateUniformBuffers(); }
 //*-----------------------------------------------------------------------------
 
 void SSAO::LoadAssets() {
+  if (config.contains("TextureStreaming")) {
+    const auto &streaming = config["TextureStreaming"];
+    settings.textureStreaming = streaming["Enabled"].get<bool>();
+
+    TextureStreamerCreateInfo streamerCreateInfo{};
+    streamerCreateInfo.budget =
+        streaming["BudgetMB"].get<VkDeviceSize>() * 1024 * 1024;
+    streamerCreateInfo.tailSize = streaming["TailSize"].get<uint32_t>();
+    textureStreamer.Setup(queue, streamerCreateInfo);
+  } else {
+    settings.textureStreaming = false;
+  }
+  // アーカイブはTools/AssetPackで作成します。無ければ個別のファイルから読み込みます。
+  if (config.contains("Archive")) {
+    const auto archivePath = config["Archive"].get<std::string>();
+    if (std::filesystem::exists(archivePath)) {
+      assetArchive.Setup(device, archivePath);
+    }
+  }
+
   ModelCreateInfo modelCreateInfo{};
   // Teapot
   {
@@ -78,29 +150,62 @@ void SSAO::LoadAssets() {
     modelCreateInfo.color = glm::vec3(teapot["Color"][0].get<float>(),
                                       teapot["Color"][1].get<float>(),
                                       teapot["Color"][2].get<float>());
-    models.teapot.LoadFromFile(device,
-                               config["Teapot"]["Model"].get<std::string>(),
-                               queue, vertexLayout, modelCreateInfo);
+    models.teapot = assetRegistry.LoadModel(
+        device, teapot["Model"].get<std::string>(), queue, vertexLayout,
+        modelCreateInfo);
   }
 
   // Floor
   {
     const auto &floor = config["Floor"];
-    modelCreateInfo.uvscale = glm::vec3(4.0f, 4.0f, 4.0f);
-    models.floor.LoadFromFile(device,
-                              config["Floor"]["Model"].get<std::string>(),
-                              queue, vertexLayout, modelCreateInfo);
-    textures.floor.Load(device, floor["Texture"].get<std::string>(), queue);
+    models.floor = assetRegistry.LoadModel(
+        device, floor["Model"].get<std::string>(), queue, vertexLayout,
+        modelCreateInfo);
+    uvScales.floor = floor["UVScale"].get<float>();
+    LoadTexture(textures.floor, floor["Texture"].get<std::string>(),
+                streamingHandles.floor);
   }
 
   // Wall
   {
     const auto &wall = config["Wall"];
-    modelCreateInfo.uvscale = glm::vec3(16.0f, 16.0f, 16.0f);
-    textures.wall.Load(device, wall["Texture"].get<std::string>(), queue);
+    // 床と同じファイルなら同じGPU上のコピーを共有し、UVの繰り返しはインスタンスごとに与えます。
+    models.wall = assetRegistry.LoadModel(
+        device, wall["Model"].get<std::string>(), queue, vertexLayout,
+        modelCreateInfo);
+    uvScales.wall = wall["UVScale"].get<float>();
+    LoadTexture(textures.wall, wall["Texture"].get<std::string>(),
+                streamingHandles.wall);
+  }
+
+  // アーカイブに含まれるテクスチャはまとめて読み込みます。
+  if (!archiveRequests.empty()) {
+    assetArchive.LoadTextures(device, queue, archiveRequests);
+    archiveRequests.clear();
   }
 }
 
+/**
+ * @brief ストリーミングが有効ならミップテイルのみを読み込み、そうでなければ全ミップを読み込みます。
+ * @note アーカイブに含まれるテクスチャは要求を積むだけで、LoadAssetsの最後にまとめて読み込みます。
+ */
+void SSAO::LoadTexture(Texture2D &texture, const std::string &filepath,
+                       std::optional<uint32_t> &handle) {
+  // アーカイブにまとめたテクスチャは、ストリーミングより優先してまとめて転送します。
+  if (assetArchive.Contains(filepath)) {
+    archiveRequests.push_back({filepath, &texture});
+    return;
+  }
+  if (settings.textureStreaming) {
+    handle = textureStreamer.Register(device, filepath,
+                                      VK_FORMAT_R8G8B8A8_UNORM, texture);
+    if (handle) {
+      return;
+    }
+  }
+  texture.Load(device, filepath, queue);
+}
+
 //*-----------------------------------------------------------------------------
 // Setup
 //*-----------------------------------------------------------------------------
@@ -110,7 +215,7 @@ void SSAO::SetupDescriptorPool() {
   std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {
       Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16),
       Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                      16),
+                                      24),
   };
 
   // グローバル記述子プールを生成します。
@@ -159,14 +264,6 @@ void SSAO::SetupDescriptorSet() {
                                     nullptr, &descriptorSetLayouts.gBuffer));
 
     pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.gBuffer;
-    std::vector<VkPushConstantRange> pushConstantRanges = {
-        Initializer::PushConstantRange(VK_SHADER_STAGE_VERTEX_BIT |
-                                           VK_SHADER_STAGE_FRAGMENT_BIT,
-                                       sizeof(pushConsts), 0),
-    };
-    pipelineLayoutCreateInfo.pushConstantRangeCount =
-        static_cast<uint32_t>(pushConstantRanges.size());
-    pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
     VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
                                            nullptr, &pipelineLayouts.gBuffer));
 
@@ -187,9 +284,6 @@ void SSAO::SetupDescriptorSet() {
     vkUpdateDescriptorSets(device,
                            static_cast<uint32_t>(writeDescriptorSets.size()),
                            writeDescriptorSets.data(), 0, nullptr);
-
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
   }
 
   // SSAO
@@ -221,23 +315,8 @@ void SSAO::SetupDescriptorSet() {
     VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
                                              &descriptorSets.ssao));
 
-    imageDescriptors = {
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler,
-            frameBuffers.gBuffer.attachments[0].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler,
-            frameBuffers.gBuffer.attachments[1].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-    };
+    // 深度と法線はAOの解像度によって変わるため、UpdateAODescriptorsで設定します。
     writeDescriptorSets = {
-        Initializer::WriteDescriptorSet(
-            descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0,
-            &imageDescriptors[0]),
-        Initializer::WriteDescriptorSet(
-            descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
-            &imageDescriptors[1]),
         Initializer::WriteDescriptorSet(
             descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2,
             &textures.noise.descriptor),
@@ -250,36 +329,145 @@ void SSAO::SetupDescriptorSet() {
                            writeDescriptorSets.data(), 0, nullptr);
   }
 
-  // Blur
+  // Downsample
+  {
+    descriptorSetLayoutBindings = {
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+    };
+    descriptorSetLayoutCreateInfo =
+        Initializer::DescriptorSetLayoutCreateInfo(descriptorSetLayoutBindings);
+    VK_CHECK_RESULT(
+        vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                    nullptr, &descriptorSetLayouts.downsample));
+
+    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(
+        device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.downsample));
+
+    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                             &descriptorSets.downsample));
+
+    imageDescriptors = {
+        gBuffer.GetDescriptor(GBuffer::kDepth),
+        gBuffer.GetDescriptor(GBuffer::kNormal),
+    };
+    writeDescriptorSets = {
+        Initializer::WriteDescriptorSet(
+            descriptorSets.downsample,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+        Initializer::WriteDescriptorSet(
+            descriptorSets.downsample,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),
+        Initializer::WriteDescriptorSet(descriptorSets.downsample,
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
+                                        &uniformBuffers.upsample.descriptor),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writeDescriptorSets.size()),
+                           writeDescriptorSets.data(), 0, nullptr);
+  }
+
+  // Upsample
   {
     descriptorSetLayoutBindings = {
         Initializer::DescriptorSetLayoutBinding(
             VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
             VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
     };
     descriptorSetLayoutCreateInfo =
         Initializer::DescriptorSetLayoutCreateInfo(descriptorSetLayoutBindings);
     VK_CHECK_RESULT(
         vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
-                                    nullptr, &descriptorSetLayouts.blur));
+                                    nullptr, &descriptorSetLayouts.upsample));
 
-    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.blur;
+    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.upsample;
     VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
-                                           nullptr, &pipelineLayouts.blur));
+                                           nullptr, &pipelineLayouts.upsample));
 
-    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayouts.blur;
+    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayouts.upsample;
     VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
-                                             &descriptorSets.blur));
+                                             &descriptorSets.upsample));
 
+    // 縮小したAOと深度、法線はUpdateAODescriptorsで設定します。
     imageDescriptors = {
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler, frameBuffers.ssao.attachments[0].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        gBuffer.GetDescriptor(GBuffer::kDepth),
+        gBuffer.GetDescriptor(GBuffer::kNormal),
     };
     writeDescriptorSets = {
         Initializer::WriteDescriptorSet(
-            descriptorSets.blur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0,
-            &imageDescriptors[0]),
+            descriptorSets.upsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            3, &imageDescriptors[0]),
+        Initializer::WriteDescriptorSet(
+            descriptorSets.upsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            4, &imageDescriptors[1]),
+        Initializer::WriteDescriptorSet(descriptorSets.upsample,
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5,
+                                        &uniformBuffers.upsample.descriptor),
+    };
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writeDescriptorSets.size()),
+                           writeDescriptorSets.data(), 0, nullptr);
+  }
+
+  // Temporal
+  {
+    descriptorSetLayoutBindings = {
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+        Initializer::DescriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+    };
+    descriptorSetLayoutCreateInfo =
+        Initializer::DescriptorSetLayoutCreateInfo(descriptorSetLayoutBindings);
+    VK_CHECK_RESULT(
+        vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                    nullptr, &descriptorSetLayouts.temporal));
+
+    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.temporal;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
+                                           nullptr, &pipelineLayouts.temporal));
+
+    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayouts.temporal;
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                                             &descriptorSets.temporal));
+
+    // AOと深度、法線、履歴はUpdateAODescriptorsで設定します。
+    writeDescriptorSets = {
+        Initializer::WriteDescriptorSet(descriptorSets.temporal,
+                                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4,
+                                        &uniformBuffers.temporal.descriptor),
     };
     vkUpdateDescriptorSets(device,
                            static_cast<uint32_t>(writeDescriptorSets.size()),
@@ -322,24 +510,9 @@ void SSAO::SetupDescriptorSet() {
                                              &descriptorSets.lighting));
 
     imageDescriptors = {
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler,
-            frameBuffers.gBuffer.attachments[0].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler,
-            frameBuffers.gBuffer.attachments[1].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler,
-            frameBuffers.gBuffer.attachments[2].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler, frameBuffers.ssao.attachments[0].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-        Initializer::DescriptorImageInfo(
-            frameBuffers.gBuffer.sampler, frameBuffers.blur.attachments[0].view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        gBuffer.GetDescriptor(GBuffer::kDepth),
+        gBuffer.GetDescriptor(GBuffer::kNormal),
+        gBuffer.GetDescriptor(GBuffer::kAlbedo),
     };
     writeDescriptorSets = {
         Initializer::WriteDescriptorSet(descriptorSets.lighting,
@@ -354,17 +527,83 @@ void SSAO::SetupDescriptorSet() {
         Initializer::WriteDescriptorSet(
             descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
             3, &imageDescriptors[2]),
-        Initializer::WriteDescriptorSet(
-            descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            4, &imageDescriptors[3]),
-        Initializer::WriteDescriptorSet(
-            descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            5, &imageDescriptors[4]),
     };
     vkUpdateDescriptorSets(device,
                            static_cast<uint32_t>(writeDescriptorSets.size()),
                            writeDescriptorSets.data(), 0, nullptr);
   }
+
+  UpdateAODescriptors();
+}
+
+/**
+ * @brief AOの解像度で作り直すアタッチメントを記述子セットに書き込みます。
+ * @note
+ * 縮小した場合、SSAOは縮小した深度と法線から計算し、拡大のパスでぼかしも行います。
+ */
+void SSAO::UpdateAODescriptors() {
+  const bool reduced = GetAODivisor() > 1;
+  const auto attachment = [this](const Framebuffer &framebuffer,
+                                 uint32_t index) {
+    return Initializer::DescriptorImageInfo(
+        gBuffer.framebuffer.sampler, framebuffer.attachments[index].view,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  };
+  const VkDescriptorImageInfo depth = gBuffer.GetDescriptor(GBuffer::kDepth);
+  const VkDescriptorImageInfo normal = gBuffer.GetDescriptor(GBuffer::kNormal);
+  const VkDescriptorImageInfo lowDepth = attachment(frameBuffers.downsample, 0);
+  const VkDescriptorImageInfo lowNormal =
+      attachment(frameBuffers.downsample, 1);
+  const VkDescriptorImageInfo ao = attachment(frameBuffers.ssao, 0);
+  const VkDescriptorImageInfo aoUpsample = attachment(frameBuffers.upsample, 0);
+  const VkDescriptorImageInfo aoTemporal = attachment(frameBuffers.temporal, 0);
+  const VkDescriptorImageInfo history = attachment(frameBuffers.history, 0);
+  // GTAOを選んだ場合やレイヤーに分けて計算した場合、続くパスはその結果を読みます。
+  const VkDescriptorImageInfo &aoSource =
+      settings.aoMethod == 1   ? gtao.descriptor
+      : settings.deinterleaved ? deinterleavedSSAO.descriptor
+                               : ao;
+  // 蓄積する場合、続くパスは履歴と混ぜたAOを読みます。
+  const VkDescriptorImageInfo &aoResult =
+      settings.temporal ? aoTemporal : aoSource;
+
+  constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  const std::array<VkWriteDescriptorSet, 11> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(descriptorSets.ssao, type, 0,
+                                      reduced ? &lowDepth : &depth),
+      Initializer::WriteDescriptorSet(descriptorSets.ssao, type, 1,
+                                      reduced ? &lowNormal : &normal),
+      Initializer::WriteDescriptorSet(descriptorSets.temporal, type, 0,
+                                      &aoSource),
+      Initializer::WriteDescriptorSet(descriptorSets.temporal, type, 1,
+                                      reduced ? &lowDepth : &depth),
+      Initializer::WriteDescriptorSet(descriptorSets.temporal, type, 2,
+                                      reduced ? &lowNormal : &normal),
+      Initializer::WriteDescriptorSet(descriptorSets.temporal, type, 3,
+                                      &history),
+      Initializer::WriteDescriptorSet(descriptorSets.upsample, type, 0,
+                                      &aoResult),
+      Initializer::WriteDescriptorSet(descriptorSets.upsample, type, 1,
+                                      &lowDepth),
+      Initializer::WriteDescriptorSet(descriptorSets.upsample, type, 2,
+                                      &lowNormal),
+      Initializer::WriteDescriptorSet(descriptorSets.lighting, type, 4,
+                                      reduced ? &aoUpsample : &aoResult),
+      Initializer::WriteDescriptorSet(
+          descriptorSets.lighting, type, 5,
+          reduced ? &aoUpsample : &blur.descriptor),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+
+  blur.SetSource(device, aoResult, reduced ? &lowDepth : &depth);
+  gtao.SetSource(device, reduced ? lowDepth : depth,
+                 reduced ? lowNormal : normal);
+  deinterleavedSSAO.SetSource(device, reduced ? lowDepth : depth,
+                              reduced ? lowNormal : normal,
+                              textures.noise.descriptor,
+                              uniformBuffers.ssao.descriptor);
 }
 
 /**
@@ -372,6 +611,23 @@ void SSAO::SetupDescriptorSet() {
  * Vulkanは、レンダリングパイプラインの概念を用いてFixedStatusをカプセル化し、OpenGLの複雑なステートマシンを置き換えます。<br>
  * パイプラインはGPUに保存およびハッシュされ、パイプラインの変更が非常に高速になります。
  */
+/**
+ * @brief ストリーミングで作り直された床と壁のテクスチャをG-Bufferの記述子セットに書き込みます。
+ */
+void SSAO::UpdateTextureDescriptors() {
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+      Initializer::WriteDescriptorSet(
+          descriptorSets.gBuffer, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+          &textures.floor.descriptor),
+      Initializer::WriteDescriptorSet(
+          descriptorSets.gBuffer, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2,
+          &textures.wall.descriptor),
+  };
+  vkUpdateDescriptorSets(device,
+                         static_cast<uint32_t>(writeDescriptorSets.size()),
+                         writeDescriptorSets.data(), 0, nullptr);
+}
+
 void SSAO::SetupPipelines() {
   // 入力アセンブリステートはプリミティブがどのようにアセンブルされるかを記述します。
   // このパイプラインでは、頂点データを三角形リストとしてアセンブルします。
@@ -488,32 +744,93 @@ void SSAO::SetupPipelines() {
     vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
   }
 
-  // Blur pipeline
+  // Upsample pipeline
+  // 解像度を変えてもアタッチメントの形式は同じため、レンダーパスの互換性は保たれます。
   {
-    pipelineCreateInfo.renderPass = frameBuffers.blur.renderPass;
-    pipelineCreateInfo.layout = pipelineLayouts.blur;
+    pipelineCreateInfo.renderPass = frameBuffers.upsample.renderPass;
+    pipelineCreateInfo.layout = pipelineLayouts.upsample;
     shaderStages = {
-        CreateShader(device,
-                     pipelinesConfig["Blur"]["VertexShader"].get<std::string>(),
-                     VK_SHADER_STAGE_VERTEX_BIT),
         CreateShader(
             device,
-            pipelinesConfig["Blur"]["FragmentShader"].get<std::string>(),
+            pipelinesConfig["Upsample"]["VertexShader"].get<std::string>(),
+            VK_SHADER_STAGE_VERTEX_BIT),
+        CreateShader(
+            device,
+            pipelinesConfig["Upsample"]["FragmentShader"].get<std::string>(),
             VK_SHADER_STAGE_FRAGMENT_BIT),
     };
 
     VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
                                               &pipelineCreateInfo, nullptr,
-                                              &pipelines.blur));
+                                              &pipelines.upsample));
     vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
     vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
   }
 
+  // Temporal pipeline
+  {
+    pipelineCreateInfo.renderPass = frameBuffers.temporal.renderPass;
+    pipelineCreateInfo.layout = pipelineLayouts.temporal;
+    shaderStages = {
+        CreateShader(
+            device,
+            pipelinesConfig["Temporal"]["VertexShader"].get<std::string>(),
+            VK_SHADER_STAGE_VERTEX_BIT),
+        CreateShader(
+            device,
+            pipelinesConfig["Temporal"]["FragmentShader"].get<std::string>(),
+            VK_SHADER_STAGE_FRAGMENT_BIT),
+    };
+
+    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                              &pipelineCreateInfo, nullptr,
+                                              &pipelines.temporal));
+    vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+    vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+  }
+
+  // Downsample pipeline
+  {
+    pipelineCreateInfo.renderPass = frameBuffers.downsample.renderPass;
+    pipelineCreateInfo.layout = pipelineLayouts.downsample;
+    shaderStages = {
+        CreateShader(
+            device,
+            pipelinesConfig["Downsample"]["VertexShader"].get<std::string>(),
+            VK_SHADER_STAGE_VERTEX_BIT),
+        CreateShader(
+            device,
+            pipelinesConfig["Downsample"]["FragmentShader"].get<std::string>(),
+            VK_SHADER_STAGE_FRAGMENT_BIT),
+    };
+
+    // 深度と法線の2つのカラーアタッチメントに書き込みます。
+    const std::array<VkPipelineColorBlendAttachmentState, 2>
+        colorBlendAttachmentStates = {
+            Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
+            Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
+        };
+    VkPipelineColorBlendStateCreateInfo downsampleColorBlendState =
+        Initializer::PipelineColorBlendStateCreateInfo(
+            static_cast<uint32_t>(colorBlendAttachmentStates.size()),
+            colorBlendAttachmentStates.data());
+    pipelineCreateInfo.pColorBlendState = &downsampleColorBlendState;
+
+    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                              &pipelineCreateInfo, nullptr,
+                                              &pipelines.downsample));
+    vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+    vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+    pipelineCreateInfo.pColorBlendState = &colorBlendState;
+  }
+
   // G-Buffer pipeline
   {
     std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
         Initializer::VertexInputBindingDescription(0, vertexLayout.Stride(),
                                                    VK_VERTEX_INPUT_RATE_VERTEX),
+        Initializer::VertexInputBindingDescription(
+            1, sizeof(Instance), VK_VERTEX_INPUT_RATE_INSTANCE),
     };
     std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
         // location = 0 : position
@@ -528,6 +845,21 @@ void SSAO::SetupPipelines() {
         // location = 3 : uv
         Initializer::VertexInputAttributeDescription(
             0, 3, VK_FORMAT_R32G32_SFLOAT, 9 * sizeof(float)),
+        // location = 4-7 : instance model matrix
+        Initializer::VertexInputAttributeDescription(
+            1, 4, VK_FORMAT_R32G32B32A32_SFLOAT, 0),
+        Initializer::VertexInputAttributeDescription(
+            1, 5, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float)),
+        Initializer::VertexInputAttributeDescription(
+            1, 6, VK_FORMAT_R32G32B32A32_SFLOAT, 8 * sizeof(float)),
+        Initializer::VertexInputAttributeDescription(
+            1, 7, VK_FORMAT_R32G32B32A32_SFLOAT, 12 * sizeof(float)),
+        // location = 8 : instance uv scale
+        Initializer::VertexInputAttributeDescription(
+            1, 8, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, uvScale)),
+        // location = 9 : instance texture index
+        Initializer::VertexInputAttributeDescription(
+            1, 9, VK_FORMAT_R32_SINT, offsetof(Instance, tex)),
     };
     VkPipelineVertexInputStateCreateInfo vertexInputState =
         Initializer::PipelineVertexInputStateCreateInfo(vertexInputBindings,
@@ -542,15 +874,15 @@ void SSAO::SetupPipelines() {
         VK_SHADER_STAGE_FRAGMENT_BIT);
 
     // レンダーパスは別にします。
-    pipelineCreateInfo.renderPass = frameBuffers.gBuffer.renderPass;
+    pipelineCreateInfo.renderPass = gBuffer.framebuffer.renderPass;
     pipelineCreateInfo.layout = pipelineLayouts.gBuffer;
 
     // カラーアタッチメントに何も描画しないようにします。
-    std::array<VkPipelineColorBlendAttachmentState, 3>
+    std::array<VkPipelineColorBlendAttachmentState,
+               GBuffer::kColorAttachmentCount>
         colorBlendAttachmentStates = {
             Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
             Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
-            Initializer::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
         };
     colorBlendState.attachmentCount =
         static_cast<uint32_t>(colorBlendAttachmentStates.size());
@@ -572,51 +904,73 @@ void SSAO::SetupPipelines() {
  * @brief オフスクリーンレンダリング用に新しいフレームバッファを用意します。
  */
 void SSAO::PrepareOffscreenFramebuffer() {
+  // G-Buffer
+  // 位置は深度から復元するため、法線とアルベドだけを書き込みます。
+  gBuffer.Setup(device, swapchain.extent.width, swapchain.extent.height);
+
+  if (config.contains("AOResolution")) {
+    const auto resolution = config["AOResolution"].get<std::string>();
+    settings.aoResolution = resolution == "Quarter" ? 2
+                            : resolution == "Half"  ? 1
+                                                    : 0;
+  }
+  if (config.contains("AOMethod")) {
+    settings.aoMethod = config["AOMethod"].get<std::string>() == "GTAO" ? 1 : 0;
+  }
+  if (config.contains("GTAO")) {
+    const auto &gtaoConfig = config["GTAO"];
+    settings.bentNormals = gtaoConfig["BentNormals"].get<bool>();
+    gtaoParams.sliceCount = gtaoConfig["Slices"].get<int32_t>();
+    gtaoParams.stepsPerSlice = gtaoConfig["StepsPerSlice"].get<int32_t>();
+  }
+  if (config.contains("DeinterleavedSSAO")) {
+    settings.deinterleaved = config["DeinterleavedSSAO"].get<bool>();
+  }
+  if (config.contains("TemporalSSAO")) {
+    const auto &temporalConfig = config["TemporalSSAO"];
+    settings.temporal = temporalConfig["Enabled"].get<bool>();
+    settings.temporalSamples = temporalConfig["SamplesPerFrame"].get<int>();
+    BOOST_ASSERT_MSG(settings.temporalSamples > 0 &&
+                         KERNEL_SIZE % settings.temporalSamples == 0,
+                     "SamplesPerFrame must divide the kernel size!");
+  }
+  PrepareAOFramebuffers();
+}
+
+/**
+ * @brief AOの解像度に合わせて、SSAOとその前後のパスのフレームバッファを用意します。
+ * @note 端数のピクセルも覆うように切り上げます。
+ */
+void SSAO::PrepareAOFramebuffers() {
+  const uint32_t divisor = GetAODivisor();
 
   AttachmentCreateInfo attachmentCreateInfo{};
-  attachmentCreateInfo.width = swapchain.extent.width;
-  attachmentCreateInfo.height = swapchain.extent.height;
+  attachmentCreateInfo.width = (swapchain.extent.width + divisor - 1) / divisor;
+  attachmentCreateInfo.height =
+      (swapchain.extent.height + divisor - 1) / divisor;
   attachmentCreateInfo.layerCount = 1;
+  attachmentCreateInfo.usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-  // G-Buffer
+  // Downsample
+  // 深度はG-Bufferと同じ値を書き込み、SSAOのシェーダーをそのまま使います。
   {
-    frameBuffers.gBuffer.width = swapchain.extent.width;
-    frameBuffers.gBuffer.height = swapchain.extent.height;
-
-    attachmentCreateInfo.usage =
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    attachmentCreateInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    // POSITION (World Space)
-    frameBuffers.gBuffer.AddAttachment(device, attachmentCreateInfo);
-
-    // NORMAL (World Space)
-    frameBuffers.gBuffer.AddAttachment(device, attachmentCreateInfo);
-
-    // ALBEDO (Color)
-    attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-    frameBuffers.gBuffer.AddAttachment(device, attachmentCreateInfo);
-
-    // Depth attachment
-    attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    attachmentCreateInfo.format = device.FindSupportedDepthFormat();
-    frameBuffers.gBuffer.AddAttachment(device, attachmentCreateInfo);
-
-    // カラーアタッチメントからサンプラーを生成します。
-    VK_CHECK_RESULT(frameBuffers.gBuffer.CreateSampler(
-        device, VK_FILTER_NEAREST, VK_FILTER_NEAREST,
-        VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-
-    // フレームバッファ用のデフォルトのレンダーパスを生成します。
-    VK_CHECK_RESULT(frameBuffers.gBuffer.CreateRenderPass(device));
+    frameBuffers.downsample.width = attachmentCreateInfo.width;
+    frameBuffers.downsample.height = attachmentCreateInfo.height;
+
+    attachmentCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+    frameBuffers.downsample.AddAttachment(device, attachmentCreateInfo);
+    attachmentCreateInfo.format = gBuffer.normalFormat;
+    frameBuffers.downsample.AddAttachment(device, attachmentCreateInfo);
+
+    VK_CHECK_RESULT(frameBuffers.downsample.CreateRenderPass(device));
   }
 
   // SSAO
   {
-    frameBuffers.ssao.width = swapchain.extent.width;
-    frameBuffers.ssao.height = swapchain.extent.height;
+    frameBuffers.ssao.width = attachmentCreateInfo.width;
+    frameBuffers.ssao.height = attachmentCreateInfo.height;
 
-    attachmentCreateInfo.usage =
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     attachmentCreateInfo.format = VK_FORMAT_R8_UNORM;
     frameBuffers.ssao.AddAttachment(device, attachmentCreateInfo);
 
@@ -624,16 +978,89 @@ void SSAO::PrepareOffscreenFramebuffer() {
   }
 
   // SSAO Blur
+  blur.Setup(device, attachmentCreateInfo.width, attachmentCreateInfo.height,
+             queue, pipelineCache);
+
+  // Deinterleaved SSAO
+  deinterleavedSSAO.Setup(device, attachmentCreateInfo.width,
+                          attachmentCreateInfo.height, KERNEL_SIZE, queue,
+                          pipelineCache);
+
+  // GTAO
+  gtao.Setup(device, attachmentCreateInfo.width, attachmentCreateInfo.height,
+             queue, pipelineCache, settings.bentNormals);
+
+  // Temporal
+  // 履歴へ複製するため、転送元と転送先として使えるようにします。
+  {
+    frameBuffers.temporal.width = attachmentCreateInfo.width;
+    frameBuffers.temporal.height = attachmentCreateInfo.height;
+    frameBuffers.history.width = attachmentCreateInfo.width;
+    frameBuffers.history.height = attachmentCreateInfo.height;
+
+    AttachmentCreateInfo temporalCreateInfo = attachmentCreateInfo;
+    temporalCreateInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    temporalCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_SAMPLED_BIT |
+                               VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    frameBuffers.temporal.AddAttachment(device, temporalCreateInfo);
+    VK_CHECK_RESULT(frameBuffers.temporal.CreateRenderPass(device));
+
+    temporalCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_SAMPLED_BIT |
+                               VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    frameBuffers.history.AddAttachment(device, temporalCreateInfo);
+
+    // 履歴は描画せずに読むため、最初のフレームまでに読み取り用のレイアウトへ移行します。
+    const FramebufferAttachment &history = frameBuffers.history.attachments[0];
+    VkCommandBuffer commandBuffer =
+        device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    TransitionImageLayout(commandBuffer, history.image,
+                          history.subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    const VkClearColorValue clearColor = {{1.0f, 0.0f, 0.0f, 0.0f}};
+    vkCmdClearColorImage(commandBuffer, history.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+                         &history.subresourceRange);
+    TransitionImageLayout(commandBuffer, history.image,
+                          history.subresourceRange,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    device.FlushCommandBuffer(commandBuffer, queue);
+  }
+
+  // Upsample
   {
-    frameBuffers.blur.width = swapchain.extent.width;
-    frameBuffers.blur.height = swapchain.extent.height;
+    frameBuffers.upsample.width = swapchain.extent.width;
+    frameBuffers.upsample.height = swapchain.extent.height;
 
-    frameBuffers.blur.AddAttachment(device, attachmentCreateInfo);
+    attachmentCreateInfo.width = swapchain.extent.width;
+    attachmentCreateInfo.height = swapchain.extent.height;
+    frameBuffers.upsample.AddAttachment(device, attachmentCreateInfo);
 
-    VK_CHECK_RESULT(frameBuffers.blur.CreateRenderPass(device));
+    VK_CHECK_RESULT(frameBuffers.upsample.CreateRenderPass(device));
   }
 }
 
+void SSAO::DestroyAOFramebuffers() {
+  frameBuffers.history.Destroy(device);
+  frameBuffers.temporal.Destroy(device);
+  frameBuffers.upsample.Destroy(device);
+  gtao.Destroy(device);
+  deinterleavedSSAO.Destroy(device);
+  blur.Destroy(device);
+  frameBuffers.ssao.Destroy(device);
+  frameBuffers.downsample.Destroy(device);
+  frameBuffers.history = Framebuffer{};
+  frameBuffers.temporal = Framebuffer{};
+  frameBuffers.upsample = Framebuffer{};
+  gtao = GTAO{};
+  deinterleavedSSAO = DeinterleavedSSAO{};
+  blur = SeparableBlur{};
+  frameBuffers.ssao = Framebuffer{};
+  frameBuffers.downsample = Framebuffer{};
+}
+
 /**
  * @brief
  * シェーダーユニフォームを含むユニフォームバッファブロックを準備して初期化します。
@@ -662,6 +1089,20 @@ void SSAO::PrepareUniformBuffers() {
                                      sizeof(uboLighting), &uboLighting));
   VK_CHECK_RESULT(uniformBuffers.lighting.Map(device));
 
+  VK_CHECK_RESULT(
+      uniformBuffers.upsample.Create(device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     sizeof(uboUpsample), &uboUpsample));
+  VK_CHECK_RESULT(uniformBuffers.upsample.Map(device));
+
+  VK_CHECK_RESULT(
+      uniformBuffers.temporal.Create(device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     sizeof(uboTemporal), &uboTemporal));
+  VK_CHECK_RESULT(uniformBuffers.temporal.Map(device));
+
   std::random_device rd;
   std::mt19937 engine(rd());
   UniformDistribution dist;
@@ -670,6 +1111,10 @@ void SSAO::PrepareUniformBuffers() {
   {
     uboSSAO.radius = 0.5f;
     uboSSAO.bias = 0.025f;
+    uboSSAO.sampleOffset = 0;
+    uboSSAO.sampleStride = 1;
+    uboSSAO.sampleCount = KERNEL_SIZE;
+    uboSSAO.noiseRotation = 0.0f;
     for (size_t i = 0; i < KERNEL_SIZE; i++) {
       glm::vec3 randDir = dist.OnHemisphere(engine);
       const float scale = static_cast<float>(i * i) /
@@ -696,6 +1141,11 @@ void SSAO::PrepareUniformBuffers() {
                               ROT_TEX_SIZE, queue, VK_FILTER_NEAREST);
   }
 
+  // Temporal
+  {
+    uboTemporal.reset = 1;
+  }
+
   // Lighting
   {
     uboLighting.displayRenderTarget = 0;
@@ -706,6 +1156,39 @@ void SSAO::PrepareUniformBuffers() {
   UpdateUniformBuffers();
 }
 
+/**
+ * @brief G-Bufferパスのインスタンスをモデルごとに並べ、描画グループを作ります。
+ * @note
+ * 配置は静的なため、インスタンスは一度だけ書き込みます。<br>
+ * 床と壁はアセットレジストリで同じモデルに重複排除されるため、1つのグループになります。
+ */
+void SSAO::PrepareInstanceBuffer() {
+  const std::array<std::pair<const Model *, Instance>, 4> instances = {{
+      {models.teapot.get(), {GetTeapotMatrix(), glm::vec2(1.0f), 0, 0}},
+      {models.floor.get(),
+       {GetFloorMatrix(), glm::vec2(uvScales.floor), 1, 0}},
+      {models.wall.get(), {GetWallMatrix(0), glm::vec2(uvScales.wall), 2, 0}},
+      {models.wall.get(), {GetWallMatrix(1), glm::vec2(uvScales.wall), 2, 0}},
+  }};
+
+  std::vector<Instance> data;
+  drawGroups.clear();
+  for (const auto &[model, instance] : instances) {
+    const auto index = static_cast<uint32_t>(data.size());
+    data.push_back(instance);
+    if (drawGroups.empty() || drawGroups.back().model != model) {
+      drawGroups.push_back({model, index, 0});
+    }
+    drawGroups.back().instanceCount++;
+  }
+
+  VK_CHECK_RESULT(instanceBuffer.Create(
+      device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      data.size() * sizeof(Instance), data.data()));
+}
+
 //*-----------------------------------------------------------------------------
 // Render
 //*-----------------------------------------------------------------------------
@@ -720,28 +1203,74 @@ void SSAO::BuildCommandBuffers() {
   VkCommandBufferBeginInfo commandBufferBeginInfo =
       Initializer::CommandBufferBeginInfo();
 
+  // フレームバッファ全体に1枚の三角形を描くパスを記録します。
+  const auto drawFullscreen = [](VkCommandBuffer commandBuffer,
+                                 const Framebuffer &framebuffer,
+                                 VkPipeline pipeline, VkPipelineLayout layout,
+                                 VkDescriptorSet descriptorSet) {
+    std::vector<VkClearValue> clearValues(framebuffer.attachments.size());
+    for (auto &clearValue : clearValues) {
+      clearValue.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    }
+
+    VkRenderPassBeginInfo renderPassBeginInfo =
+        Initializer::RenderPassBeginInfo();
+    renderPassBeginInfo.renderPass = framebuffer.renderPass;
+    renderPassBeginInfo.framebuffer = framebuffer.framebuffer;
+    renderPassBeginInfo.renderArea.extent.width = framebuffer.width;
+    renderPassBeginInfo.renderArea.extent.height = framebuffer.height;
+    renderPassBeginInfo.clearValueCount =
+        static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    const VkViewport viewport =
+        Initializer::Viewport(static_cast<float>(framebuffer.width),
+                              static_cast<float>(framebuffer.height), 0.0f,
+                              1.0f);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    const VkRect2D scissor =
+        Initializer::Rect2D(framebuffer.width, framebuffer.height, 0, 0);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            layout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipeline);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+    vkCmdEndRenderPass(commandBuffer);
+  };
+
   for (size_t i = 0; i < drawCmdBuffers.size(); i++) {
 
     VK_CHECK_RESULT(
         vkBeginCommandBuffer(drawCmdBuffers[i], &commandBufferBeginInfo));
 
+    // パスごとのGPU時間はコマンドバッファごとのクエリに記録します。
+    const auto frame = static_cast<uint32_t>(i);
+    profiler.Reset(drawCmdBuffers[i], frame);
+
     VkRenderPassBeginInfo renderPassBeginInfo =
         Initializer::RenderPassBeginInfo();
 
     // Fill G-Buffer
     {
+      const uint32_t scope =
+          profiler.Begin(drawCmdBuffers[i], frame, "G-Buffer");
+
       // フラグメントシェーダーで使用するすべてのアタッチメントをこの値でクリアします。
-      std::array<VkClearValue, 4> clearValues{};
-      clearValues[0].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
-      clearValues[1].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
-      clearValues[2].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
-      clearValues[3].depthStencil = {1.0f, 0};
-
-      renderPassBeginInfo.renderPass = frameBuffers.gBuffer.renderPass;
-      renderPassBeginInfo.framebuffer = frameBuffers.gBuffer.framebuffer;
-      renderPassBeginInfo.renderArea.extent.width = frameBuffers.gBuffer.width;
-      renderPassBeginInfo.renderArea.extent.height =
-          frameBuffers.gBuffer.height;
+      std::array<VkClearValue, 3> clearValues{};
+      clearValues[GBuffer::kNormal].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+      clearValues[GBuffer::kAlbedo].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+      clearValues[GBuffer::kDepth].depthStencil = {1.0f, 0};
+
+      const Framebuffer &framebuffer = gBuffer.framebuffer;
+      renderPassBeginInfo.renderPass = framebuffer.renderPass;
+      renderPassBeginInfo.framebuffer = framebuffer.framebuffer;
+      renderPassBeginInfo.renderArea.extent.width = framebuffer.width;
+      renderPassBeginInfo.renderArea.extent.height = framebuffer.height;
       renderPassBeginInfo.clearValueCount =
           static_cast<uint32_t>(clearValues.size());
       renderPassBeginInfo.pClearValues = clearValues.data();
@@ -750,11 +1279,11 @@ void SSAO::BuildCommandBuffers() {
                            VK_SUBPASS_CONTENTS_INLINE);
 
       VkViewport viewport = Initializer::Viewport(
-          static_cast<float>(frameBuffers.gBuffer.width),
-          static_cast<float>(frameBuffers.gBuffer.height), 0.0f, 1.0f);
+          static_cast<float>(framebuffer.width),
+          static_cast<float>(framebuffer.height), 0.0f, 1.0f);
       vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-      VkRect2D scissor = Initializer::Rect2D(frameBuffers.gBuffer.width,
-                                             frameBuffers.gBuffer.height, 0, 0);
+      VkRect2D scissor =
+          Initializer::Rect2D(framebuffer.width, framebuffer.height, 0, 0);
       vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
       vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -763,103 +1292,60 @@ void SSAO::BuildCommandBuffers() {
           drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
           pipelineLayouts.gBuffer, 0, 1, &descriptorSets.gBuffer, 0, nullptr);
       VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(drawCmdBuffers[i], 1, 1, &instanceBuffer.buffer,
+                             offsets);
 
-      // Teapot
-      {
+      // 床と壁は同じモデルのため、1回のインスタンス描画にまとまります。
+      for (const auto &group : drawGroups) {
         vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1,
-                               &models.teapot.vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(drawCmdBuffers[i], models.teapot.indices.buffer, 0,
-                             VK_INDEX_TYPE_UINT32);
-        const auto &teapot = config["Teapot"];
-        const auto scale = glm::vec3(teapot["Scale"].get<float>());
-        const auto trans = glm::vec3(teapot["Position"][0].get<float>(),
-                                     teapot["Position"][1].get<float>(),
-                                     teapot["Position"][2].get<float>());
-        auto model = glm::translate(glm::mat4(1.0f), trans);
-        model = glm::rotate(model, glm::radians(30.0f),
-                            glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, scale);
-        pushConsts.model = model;
-        pushConsts.tex = 0;
-        vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.gBuffer,
-                           VK_SHADER_STAGE_VERTEX_BIT |
-                               VK_SHADER_STAGE_FRAGMENT_BIT,
-                           0, sizeof(pushConsts), &pushConsts);
-        vkCmdDrawIndexed(drawCmdBuffers[i], models.teapot.indexCount, 1, 0, 0,
-                         0);
+                               &group.model->vertices.buffer, offsets);
+        vkCmdBindIndexBuffer(drawCmdBuffers[i], group.model->indices.buffer,
+                             0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(drawCmdBuffers[i], group.model->indexCount,
+                         group.instanceCount, 0, 0, group.firstInstance);
       }
 
-      // Floor
-      {
-        vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1,
-                               &models.floor.vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(drawCmdBuffers[i], models.floor.indices.buffer, 0,
-                             VK_INDEX_TYPE_UINT32);
-        const auto scale = glm::vec3(4.0f);
-        const auto trans = glm::vec3(0.0f, 0.0f, 0.0f);
-        auto model = glm::translate(glm::mat4(1.0f), trans);
-        model = glm::scale(model, scale);
-        pushConsts.model = model;
-        pushConsts.tex = 1;
-        vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.gBuffer,
-                           VK_SHADER_STAGE_VERTEX_BIT |
-                               VK_SHADER_STAGE_FRAGMENT_BIT,
-                           0, sizeof(pushConsts), &pushConsts);
-        vkCmdDrawIndexed(drawCmdBuffers[i], models.floor.indexCount, 1, 0, 0,
-                         0);
-      }
+      vkCmdEndRenderPass(drawCmdBuffers[i]);
+      profiler.End(drawCmdBuffers[i], frame, scope);
 
-      // Wall1
-      {
-        vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1,
-                               &models.floor.vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(drawCmdBuffers[i], models.floor.indices.buffer, 0,
-                             VK_INDEX_TYPE_UINT32);
-        const auto scale = glm::vec3(4.0f);
-        const auto trans = glm::vec3(0.0f, 0.0f, -2.0f);
-        auto model = glm::translate(glm::mat4(1.0f), trans);
-        model = glm::rotate(model, glm::radians(90.0f),
-                            glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::scale(model, scale);
-        pushConsts.model = model;
-        pushConsts.tex = 2;
-        vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.gBuffer,
-                           VK_SHADER_STAGE_VERTEX_BIT |
-                               VK_SHADER_STAGE_FRAGMENT_BIT,
-                           0, sizeof(pushConsts), &pushConsts);
-        vkCmdDrawIndexed(drawCmdBuffers[i], models.floor.indexCount, 1, 0, 0,
-                         0);
-      }
+      // 続くパスは深度から位置を復元します。
+      gBuffer.TransitionDepthToRead(drawCmdBuffers[i]);
+    }
 
-      // Wall2
-      {
-        vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1,
-                               &models.floor.vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(drawCmdBuffers[i], models.floor.indices.buffer, 0,
-                             VK_INDEX_TYPE_UINT32);
-        const auto scale = glm::vec3(4.0f);
-        const auto trans = glm::vec3(-2.0f, 0.0f, 0.0f);
-        auto model = glm::translate(glm::mat4(1.0f), trans);
-        model = glm::rotate(model, glm::radians(90.0f),
-                            glm::vec3(0.0f, 1.0f, 0.0f));
-        model =
-            glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0, 0.0f));
-        model = glm::scale(model, scale);
-        pushConsts.model = model;
-        pushConsts.tex = 2;
-        vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.gBuffer,
-                           VK_SHADER_STAGE_VERTEX_BIT |
-                               VK_SHADER_STAGE_FRAGMENT_BIT,
-                           0, sizeof(pushConsts), &pushConsts);
-        vkCmdDrawIndexed(drawCmdBuffers[i], models.floor.indexCount, 1, 0, 0,
-                         0);
-      }
+    // 縮小した解像度では、深度と法線を縮小してからSSAOを計算し、
+    // ぼかしの代わりに元の深度と法線に沿って拡大します。
+    const bool reduced = GetAODivisor() > 1;
+
+    // Downsample
+    if (reduced) {
+      const uint32_t scope =
+          profiler.Begin(drawCmdBuffers[i], frame, "Downsample");
+      drawFullscreen(drawCmdBuffers[i], frameBuffers.downsample,
+                     pipelines.downsample, pipelineLayouts.downsample,
+                     descriptorSets.downsample);
+      profiler.End(drawCmdBuffers[i], frame, scope);
+    }
 
-      vkCmdEndRenderPass(drawCmdBuffers[i]);
+    // GTAO
+    if (settings.aoMethod == 1) {
+      const uint32_t scope = profiler.Begin(drawCmdBuffers[i], frame, "GTAO");
+      gtao.Dispatch(drawCmdBuffers[i]);
+      profiler.End(drawCmdBuffers[i], frame, scope);
+    }
+
+    // Deinterleaved SSAO
+    // 再結合した結果を、通常のSSAOと同じように続くパスが読みます。
+    if (settings.aoMethod == 0 && settings.deinterleaved) {
+      const uint32_t scope =
+          profiler.Begin(drawCmdBuffers[i], frame, "SSAO (4x4)");
+      deinterleavedSSAO.Dispatch(drawCmdBuffers[i]);
+      profiler.End(drawCmdBuffers[i], frame, scope);
     }
 
     // SSAO
-    {
+    if (settings.aoMethod == 0 && !settings.deinterleaved) {
+      const uint32_t scope = profiler.Begin(drawCmdBuffers[i], frame, "SSAO");
+
       std::vector<VkClearValue> clearValues(2);
       clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
       clearValues[1].depthStencil = {1.0f, 0};
@@ -891,45 +1377,76 @@ void SSAO::BuildCommandBuffers() {
       vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
       vkCmdEndRenderPass(drawCmdBuffers[i]);
+      profiler.End(drawCmdBuffers[i], frame, scope);
     }
 
-    // Blur
-    {
-      std::vector<VkClearValue> clearValues(2);
-      clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-      clearValues[1].depthStencil = {1.0f, 0};
-
-      renderPassBeginInfo.renderPass = frameBuffers.blur.renderPass;
-      renderPassBeginInfo.framebuffer = frameBuffers.blur.framebuffer;
-      renderPassBeginInfo.renderArea.extent.width = frameBuffers.blur.width;
-      renderPassBeginInfo.renderArea.extent.height = frameBuffers.blur.height;
-      renderPassBeginInfo.clearValueCount =
-          static_cast<uint32_t>(clearValues.size());
-      renderPassBeginInfo.pClearValues = clearValues.data();
-
-      vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo,
-                           VK_SUBPASS_CONTENTS_INLINE);
-
-      VkViewport viewport = Initializer::Viewport(
-          static_cast<float>(frameBuffers.blur.width),
-          static_cast<float>(frameBuffers.blur.height), 0.0f, 1.0f);
-      vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-      VkRect2D scissor = Initializer::Rect2D(frameBuffers.blur.width,
-                                             frameBuffers.blur.height, 0, 0);
-      vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+    // Temporal
+    // 履歴と混ぜた結果を次のフレームの履歴として複製します。
+    if (settings.temporal) {
+      const uint32_t scope =
+          profiler.Begin(drawCmdBuffers[i], frame, "Temporal");
+      drawFullscreen(drawCmdBuffers[i], frameBuffers.temporal,
+                     pipelines.temporal, pipelineLayouts.temporal,
+                     descriptorSets.temporal);
+
+      const FramebufferAttachment &src = frameBuffers.temporal.attachments[0];
+      const FramebufferAttachment &dst = frameBuffers.history.attachments[0];
+      TransitionImageLayout(drawCmdBuffers[i], src.image, src.subresourceRange,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT);
+      TransitionImageLayout(drawCmdBuffers[i], dst.image, dst.subresourceRange,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+      VkImageCopy imageCopy{};
+      imageCopy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+      imageCopy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+      imageCopy.extent = {frameBuffers.temporal.width,
+                          frameBuffers.temporal.height, 1};
+      vkCmdCopyImage(drawCmdBuffers[i], src.image,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.image,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy);
+
+      TransitionImageLayout(drawCmdBuffers[i], src.image, src.subresourceRange,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+      TransitionImageLayout(drawCmdBuffers[i], dst.image, dst.subresourceRange,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+      profiler.End(drawCmdBuffers[i], frame, scope);
+    }
 
-      vkCmdBindDescriptorSets(
-          drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-          pipelineLayouts.blur, 0, 1, &descriptorSets.blur, 0, nullptr);
-      vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        pipelines.blur);
-      vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+    // Blur
+    // 深度をガイドにしたバイラテラルぼかしで、輪郭をまたいでAOを混ぜないようにします。
+    if (!reduced && uboLighting.useBlur) {
+      const uint32_t scope = profiler.Begin(drawCmdBuffers[i], frame, "Blur");
+      blur.Dispatch(drawCmdBuffers[i], BlurFilter::Bilateral, blurParams);
+      profiler.End(drawCmdBuffers[i], frame, scope);
+    }
 
-      vkCmdEndRenderPass(drawCmdBuffers[i]);
+    // Upsample
+    if (reduced) {
+      const uint32_t scope =
+          profiler.Begin(drawCmdBuffers[i], frame, "Upsample");
+      drawFullscreen(drawCmdBuffers[i], frameBuffers.upsample,
+                     pipelines.upsample, pipelineLayouts.upsample,
+                     descriptorSets.upsample);
+      profiler.End(drawCmdBuffers[i], frame, scope);
     }
 
     // Lighting
     {
+      const uint32_t scope =
+          profiler.Begin(drawCmdBuffers[i], frame, "Lighting");
+
       std::array<VkClearValue, 2> clear{};
       clear[0].color = {{0.1f, 0.1f, 0.1f, 1.0f}};
       clear[1].depthStencil = {1.0f, 0};
@@ -965,6 +1482,7 @@ void SSAO::BuildCommandBuffers() {
       DrawUI(drawCmdBuffers[i]);
 
       vkCmdEndRenderPass(drawCmdBuffers[i]);
+      profiler.End(drawCmdBuffers[i], frame, scope);
     }
 
     // レンダーパスを終了すると、フレームバッファのカラーアタッチメントに移行する暗黙のバリアが追加されます。
@@ -976,6 +1494,36 @@ void SSAO::BuildCommandBuffers() {
 // Update
 //*-----------------------------------------------------------------------------
 
+glm::mat4 SSAO::GetTeapotMatrix() const {
+  const auto &teapot = config["Teapot"];
+  const auto scale = glm::vec3(teapot["Scale"].get<float>());
+  const auto trans = glm::vec3(teapot["Position"][0].get<float>(),
+                               teapot["Position"][1].get<float>(),
+                               teapot["Position"][2].get<float>());
+  auto model = glm::translate(glm::mat4(1.0f), trans);
+  model =
+      glm::rotate(model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  return glm::scale(model, scale);
+}
+
+glm::mat4 SSAO::GetFloorMatrix() const {
+  return glm::scale(glm::mat4(1.0f), glm::vec3(4.0f));
+}
+
+glm::mat4 SSAO::GetWallMatrix(uint32_t index) const {
+  glm::mat4 model{1.0f};
+  if (index == 0) {
+    model = glm::translate(model, glm::vec3(0.0f, 0.0f, -2.0f));
+  } else {
+    model = glm::translate(model, glm::vec3(-2.0f, 0.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(90.0f),
+                        glm::vec3(0.0f, 1.0f, 0.0f));
+  }
+  model =
+      glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+  return glm::scale(model, glm::vec3(4.0f));
+}
+
 void SSAO::UpdateUniformBuffers() {
   const auto cameraConfig = config["Camera"];
   camera.SetupOrient(glm::vec3(cameraConfig["Position"][0].get<float>(),
@@ -993,6 +1541,9 @@ void SSAO::UpdateUniformBuffers() {
   UpdateGBufferUniformBuffer();
   UpdateSSAOUniformBuffer();
   UpdateLightingUniformBuffer();
+  UpdateUpsampleUniformBuffer();
+  UpdateTemporalUniformBuffer();
+  UpdateGTAOUniformBuffer();
 }
 
 void SSAO::UpdateGBufferUniformBuffer() {
@@ -1006,6 +1557,9 @@ void SSAO::UpdateGBufferUniformBuffer() {
 
 void SSAO::UpdateSSAOUniformBuffer() {
   uboSSAO.proj = camera.GetProjectionMatrix();
+  uboSSAO.invProj = glm::inverse(uboSSAO.proj);
+  // ぼかしのパラメータはコマンドバッファに記録されます。
+  blurParams.depthParams = SeparableBlur::GetDepthParams(uboSSAO.invProj);
 
   uniformBuffers.ssao.Copy(&uboSSAO, sizeof(uboSSAO));
 }
@@ -1025,10 +1579,110 @@ void SSAO::UpdateLightingUniformBuffer() {
   }
 
   uboLighting.lightsNum = static_cast<int>(config["Lights"].size());
+  uboLighting.invProj = glm::inverse(camera.GetProjectionMatrix());
 
   uniformBuffers.lighting.Copy(&uboLighting, sizeof(uboLighting));
 }
 
+void SSAO::UpdateUpsampleUniformBuffer() {
+  uboUpsample.invProj = glm::inverse(camera.GetProjectionMatrix());
+  uboUpsample.scale = static_cast<int>(GetAODivisor());
+  uboUpsample.useBlur = uboLighting.useBlur;
+
+  uniformBuffers.upsample.Copy(&uboUpsample, sizeof(uboUpsample));
+}
+
+void SSAO::UpdateTemporalUniformBuffer() {
+  const glm::mat4 view = camera.GetViewMatrix();
+  const glm::mat4 proj = camera.GetProjectionMatrix();
+  uboTemporal.invProj = glm::inverse(proj);
+  uboTemporal.invView = glm::inverse(view);
+  uboTemporal.prevViewProj = prevViewProj;
+  // カーネルを一巡するフレーム数で平均するように混ぜます。
+  uboTemporal.blend = static_cast<float>(settings.temporalSamples) /
+                      static_cast<float>(KERNEL_SIZE);
+
+  uniformBuffers.temporal.Copy(&uboTemporal, sizeof(uboTemporal));
+}
+
+void SSAO::UpdateGTAOUniformBuffer() {
+  // 探索の半径はSSAOと共有します。
+  gtaoParams.radius = uboSSAO.radius;
+  gtao.Update(camera.GetProjectionMatrix(), gtaoParams);
+}
+
+/**
+ * @note
+ * フレームkでは kernel[k % n + i * n] (n = KERNEL_SIZE / temporalSamples)
+ * を評価するため、nフレームでカーネル全体を一巡します。<br>
+ * カーネルは中心に近い順に並んでいるため、飛び飛びに選ぶことで各フレームの偏りを抑えます。
+ * ノイズの回転は黄金比で進め、巡回ごとに異なる方向を使います。
+ */
+void SSAO::AdvanceTemporalFrame() {
+  const int frames = static_cast<int>(KERNEL_SIZE) / settings.temporalSamples;
+  uboSSAO.sampleOffset = static_cast<int>(temporalFrame % frames);
+  uboSSAO.sampleStride = frames;
+  uboSSAO.sampleCount = settings.temporalSamples;
+  const float golden = 0.618034f;
+  uboSSAO.noiseRotation =
+      glm::two_pi<float>() *
+      glm::fract(static_cast<float>(temporalFrame) * golden);
+  uniformBuffers.ssao.Copy(&uboSSAO, sizeof(uboSSAO));
+  // GTAOはスライスの向きとステップの位置をフレームごとにずらします。
+  gtaoParams.frame = temporalFrame;
+  UpdateGTAOUniformBuffer();
+
+  // 前のフレームの行列で履歴を再投影します。
+  UpdateTemporalUniformBuffer();
+  prevViewProj = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+  uboTemporal.reset = 0;
+  temporalFrame++;
+}
+
+uint32_t SSAO::GetAODivisor() const { return 1u << settings.aoResolution; }
+
+/**
+ * @brief AOの解像度を変更し、アタッチメントと記述子、コマンドバッファを作り直します。
+ */
+void SSAO::ChangeAOResolution() {
+  // 使用中のアタッチメントを破棄するため、GPUの処理が終わるまで待ちます。
+  WaitIdle();
+  DestroyAOFramebuffers();
+  PrepareAOFramebuffers();
+  UpdateAODescriptors();
+  UpdateUpsampleUniformBuffer();
+  UpdateGTAOUniformBuffer();
+  // 作り直した履歴は使えないため、次のフレームで初期化します。
+  uboTemporal.reset = 1;
+  BuildCommandBuffers();
+}
+
+void SSAO::ChangeAOMethod() {
+  WaitIdle();
+  UpdateAODescriptors();
+  // 異なる方法のAOは混ぜないよう、履歴を初期化します。
+  uboTemporal.reset = 1;
+  BuildCommandBuffers();
+}
+
+void SSAO::ChangeTemporal() {
+  WaitIdle();
+  if (!settings.temporal) {
+    // カーネル全体を毎フレーム評価する元の設定に戻します。
+    uboSSAO.sampleOffset = 0;
+    uboSSAO.sampleStride = 1;
+    uboSSAO.sampleCount = KERNEL_SIZE;
+    uboSSAO.noiseRotation = 0.0f;
+    UpdateSSAOUniformBuffer();
+    gtaoParams.frame = 0;
+    UpdateGTAOUniformBuffer();
+  }
+  temporalFrame = 0;
+  uboTemporal.reset = 1;
+  UpdateAODescriptors();
+  BuildCommandBuffers();
+}
+
 void SSAO::OnUpdateUIOverlay() {
   if (uiOverlay.Combo("Display Render Target", &uboLighting.displayRenderTarget,
                       {"Final Result", "Only SSAO", "No SSAO", "Position",
@@ -1037,9 +1691,30 @@ void SSAO::OnUpdateUIOverlay() {
   }
   if (uiOverlay.Checkbox("Use Blur", &uboLighting.useBlur)) {
     UpdateLightingUniformBuffer();
+    UpdateUpsampleUniformBuffer();
+    BuildCommandBuffers();
+  }
+  if (uiOverlay.SliderInt("Blur Radius", &blurParams.radius, 1,
+                          SeparableBlur::kMaxRadius)) {
+    BuildCommandBuffers();
+  }
+  if (uiOverlay.Combo("AO Method", &settings.aoMethod, {"SSAO", "GTAO"})) {
+    ChangeAOMethod();
+  }
+  if (settings.aoMethod == 0 &&
+      uiOverlay.Checkbox("Deinterleaved", &settings.deinterleaved)) {
+    ChangeAOMethod();
+  }
+  if (uiOverlay.Combo("AO Resolution", &settings.aoResolution,
+                      {"Full", "Half", "Quarter"})) {
+    ChangeAOResolution();
+  }
+  if (uiOverlay.Checkbox("Temporal Accumulation", &settings.temporal)) {
+    ChangeTemporal();
   }
   if (uiOverlay.SliderFloat("Sampling Radius", &uboSSAO.radius, 0.1f, 1.0f)) {
     UpdateSSAOUniformBuffer();
+    UpdateGTAOUniformBuffer();
   }
   if (uiOverlay.SliderFloat("Sampling Bias", &uboSSAO.bias, 0.0f, 0.1f)) {
     UpdateSSAOUniformBuffer();
@@ -1048,4 +1723,15 @@ void SSAO::OnUpdateUIOverlay() {
                             10.0f)) {
     UpdateLightingUniformBuffer();
   }
+  if (settings.aoMethod == 1) {
+    if (uiOverlay.SliderInt("GTAO Slices", &gtaoParams.sliceCount, 1, 8)) {
+      UpdateGTAOUniformBuffer();
+    }
+    if (uiOverlay.SliderInt("GTAO Steps", &gtaoParams.stepsPerSlice, 1, 16)) {
+      UpdateGTAOUniformBuffer();
+    }
+  }
+  if (uiOverlay.Header("GPU Time")) {
+    profiler.Draw(uiOverlay);
+  }
 }
@@ -2,39 +2,73 @@
 
 #include "VK/VkBase.h"
 
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "VK/AssetArchive.h"
+#include "VK/AssetRegistry.h"
 #include "VK/Buffer.h"
+#include "VK/DeinterleavedSSAO.h"
 #include "VK/Framebuffer.h"
+#include "VK/GBuffer.h"
+#include "VK/GTAO.h"
+#include "VK/GpuProfiler.h"
 #include "VK/Model.h"
+#include "VK/SeparableBlur.h"
 #include "VK/Texture.h"
+#include "VK/TextureStreamer.h"
 #include "View/Camera.h"
 
 class SSAO : public VkBase {
 public:
   void OnPostInit() override;
   void OnPreDestroy() override;
+  void OnUpdate(float t) override;
+  void OnRender() override;
   void OnUpdateUIOverlay() override;
 
   void LoadAssets();
+  void LoadTexture(Texture2D &texture, const std::string &filepath,
+                   std::optional<uint32_t> &handle);
   void PrepareOffscreenFramebuffer();
+  void PrepareAOFramebuffers();
+  void DestroyAOFramebuffers();
   void PrepareUniformBuffers();
+  void PrepareInstanceBuffer();
 
   void UpdateUniformBuffers();
   void UpdateGBufferUniformBuffer();
   void UpdateSSAOUniformBuffer();
   void UpdateLightingUniformBuffer();
+  void UpdateUpsampleUniformBuffer();
+  void UpdateTemporalUniformBuffer();
+  void UpdateGTAOUniformBuffer();
 
   void SetupDescriptorPool();
   void SetupDescriptorSet();
+  void UpdateTextureDescriptors();
+  void UpdateAODescriptors();
   void SetupPipelines();
 
   void BuildCommandBuffers() override;
+  [[nodiscard]] glm::mat4 GetTeapotMatrix() const;
+  [[nodiscard]] glm::mat4 GetFloorMatrix() const;
+  [[nodiscard]] glm::mat4 GetWallMatrix(uint32_t index) const;
 
   void ViewChanged() override;
 
 private:
+  /** @brief AOを計算する解像度の縮小率(1, 2, 4)を返します。 */
+  [[nodiscard]] uint32_t GetAODivisor() const;
+  void ChangeAOResolution();
+  /** @brief AOの計算方法を切り替えます。 */
+  void ChangeAOMethod();
+  /** @brief 時間方向の蓄積の有効・無効を切り替えます。 */
+  void ChangeTemporal();
+  /** @brief 次のフレームで使うカーネルの部分集合とノイズの回転を進めます。 */
+  void AdvanceTemporalFrame();
+
   static constexpr inline size_t KERNEL_SIZE = 64;
   static constexpr inline size_t ROT_TEX_SIZE = 4;
 
@@ -47,10 +81,17 @@ private:
       },
   };
 
+  AssetRegistry assetRegistry{};
   struct {
-    Model teapot;
-    Model floor;
+    ModelHandle teapot;
+    ModelHandle floor;
+    ModelHandle wall;
   } models;
+  /** @brief インスタンスごとのテクスチャの繰り返し回数 */
+  struct {
+    float floor = 1.0f;
+    float wall = 1.0f;
+  } uvScales;
 
   struct {
     Texture2D floor;
@@ -58,10 +99,24 @@ private:
     Texture2D noise;
   } textures;
 
-  struct PushConstants {
-    alignas(16) glm::mat4 model;
-    alignas(4) int tex;
-  } pushConsts;
+  /**
+   * @brief G-Bufferパスでインスタンスごとに読む頂点属性です。
+   * @note tex 0: 頂点カラー, 1: 床のテクスチャ, 2: 壁のテクスチャ
+   */
+  struct Instance {
+    glm::mat4 model;
+    glm::vec2 uvScale;
+    int32_t tex;
+    int32_t padding;
+  };
+  /** @brief 同じモデルの連続したインスタンスを1回で描画します。 */
+  struct DrawGroup {
+    const Model *model;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+  };
+  std::vector<DrawGroup> drawGroups{};
+  Buffer instanceBuffer{};
 
   struct {
     alignas(16) glm::mat4 view;
@@ -71,8 +126,20 @@ private:
   struct {
     alignas(16) glm::vec4 kernel[KERNEL_SIZE];
     alignas(16) glm::mat4 proj;
+    /** @brief G-Bufferの深度からビュー空間の位置を復元します。 */
+    alignas(16) glm::mat4 invProj;
     alignas(4) float radius;
     alignas(4) float bias;
+    /**
+     * @brief フレームごとに評価するカーネルの部分集合です。
+     * @note kernel[sampleOffset + i * sampleStride] (0 <= i < sampleCount)
+     * を評価します。
+     */
+    alignas(4) int sampleOffset;
+    alignas(4) int sampleStride;
+    alignas(4) int sampleCount;
+    /** @brief ノイズテクスチャの回転ベクトルに加える回転角(ラジアン) */
+    alignas(4) float noiseRotation;
   } uboSSAO;
 
   struct Light {
@@ -87,49 +154,136 @@ private:
     alignas(4) int displayRenderTarget;
     alignas(4) bool useBlur;
     alignas(4) float ao;
+    alignas(16) glm::mat4 invProj;
   } uboLighting;
 
+  /**
+   * @brief 縮小と拡大のパスで使うパラメータです。
+   * @note 拡大は元の解像度の深度と法線を手がかりに、縮小したAOを補間します。
+   */
+  struct {
+    alignas(16) glm::mat4 invProj;
+    alignas(4) int scale;
+    alignas(4) bool useBlur;
+  } uboUpsample;
+
+  /**
+   * @brief 時間方向の蓄積で前のフレームのAOを再投影するパラメータです。
+   * @note 深度か法線が前のフレームと一致しない場合は履歴を捨てます。
+   */
+  struct {
+    alignas(16) glm::mat4 invProj;
+    alignas(16) glm::mat4 invView;
+    alignas(16) glm::mat4 prevViewProj;
+    /** @brief 現在のフレームの結果を混ぜる割合 */
+    alignas(4) float blend;
+    /** @brief 0以外の場合、履歴を使わずに現在のフレームの結果で初期化します。 */
+    alignas(4) int reset;
+  } uboTemporal;
+
   struct {
     Buffer gBuffer;
     Buffer ssao;
     Buffer blur;
     Buffer lighting;
+    Buffer upsample;
+    Buffer temporal;
   } uniformBuffers;
 
   struct {
     VkPipeline gBuffer;
     VkPipeline ssao;
-    VkPipeline blur;
     VkPipeline lighting;
+    VkPipeline downsample;
+    VkPipeline upsample;
+    VkPipeline temporal;
   } pipelines;
 
   struct {
     VkPipelineLayout gBuffer;
     VkPipelineLayout ssao;
-    VkPipelineLayout blur;
     VkPipelineLayout lighting;
+    VkPipelineLayout downsample;
+    VkPipelineLayout upsample;
+    VkPipelineLayout temporal;
   } pipelineLayouts;
 
   struct {
     VkDescriptorSet gBuffer;
     VkDescriptorSet ssao;
-    VkDescriptorSet blur;
     VkDescriptorSet lighting;
-    const uint32_t maxSets = 4;
+    VkDescriptorSet downsample;
+    VkDescriptorSet upsample;
+    VkDescriptorSet temporal;
+    const uint32_t maxSets = 6;
   } descriptorSets;
 
   struct {
     VkDescriptorSetLayout gBuffer;
     VkDescriptorSetLayout ssao;
-    VkDescriptorSetLayout blur;
     VkDescriptorSetLayout lighting;
+    VkDescriptorSetLayout downsample;
+    VkDescriptorSetLayout upsample;
+    VkDescriptorSetLayout temporal;
   } descriptorSetLayouts;
 
+  /** @brief ビュー空間の法線とアルベドを書き込みます。 */
+  GBuffer gBuffer{};
+  /**
+   * @brief upsample以外はAOの解像度で、解像度を変えると作り直します。
+   */
   struct {
-    Framebuffer gBuffer;
     Framebuffer ssao;
-    Framebuffer blur;
+    /** @brief ブロックで最も手前の深度(R32)と、その法線 */
+    Framebuffer downsample;
+    /** @brief 元の解像度に戻したAO */
+    Framebuffer upsample;
+    /** @brief 履歴と混ぜたAO(r)と、再投影の検証に使う距離(g)と法線(ba) */
+    Framebuffer temporal;
+    /** @brief 前のフレームのtemporalの複製(レンダーパスは持ちません) */
+    Framebuffer history;
   } frameBuffers;
+  /** @brief 元の解像度のAOを深度に沿ってぼかします。AOの解像度で作り直します。 */
+  SeparableBlur blur{};
+  SeparableBlur::Params blurParams{};
+  /** @brief 深度と法線をレイヤーに分けて計算するSSAO。AOの解像度で作り直します。 */
+  DeinterleavedSSAO deinterleavedSSAO{};
+  /** @brief SSAOの代わりに使う地平線ベースのAO。AOの解像度で作り直します。 */
+  GTAO gtao{};
+  GTAO::Params gtaoParams{};
+  /** @brief パスごとのGPU時間 */
+  GpuProfiler profiler{};
+
+  /** @brief ストリーミングしないテクスチャをまとめて読み込むアーカイブ */
+  AssetArchive assetArchive{};
+  std::vector<AssetArchiveTextureRequest> archiveRequests{};
+  /** @brief 床と壁のテクスチャのミップを画面上の密度に応じて読み込みます。 */
+  TextureStreamer textureStreamer{};
+  struct {
+    std::optional<uint32_t> floor;
+    std::optional<uint32_t> wall;
+  } streamingHandles;
 
   Camera camera{};
+
+  struct Settings {
+    bool textureStreaming = false;
+    /** @brief AOの計算方法 0: SSAO, 1: GTAO */
+    int aoMethod = 0;
+    /** @brief SSAOを4x4のレイヤーに分けて計算します。 */
+    bool deinterleaved = false;
+    /** @brief GTAOでベントノーマルも出力します。 */
+    bool bentNormals = false;
+    /** @brief AOの解像度 0: Full, 1: Half, 2: Quarter */
+    int aoResolution = 0;
+    /** @brief フレームごとにカーネルの一部だけを評価し、履歴に蓄積します。 */
+    bool temporal = false;
+    /** @brief 蓄積する場合に1フレームで評価するサンプル数 */
+    int temporalSamples = 8;
+  } settings;
+
+  /** @brief 蓄積を始めてからのフレーム数 */
+  uint32_t temporalFrame = 0;
+  /** @brief 前のフレームのビュー射影行列 */
+  glm::mat4 prevViewProj{1.0f};
 };
@@ -40,7 +40,7 @@ void TextureMapping::OnPostInit() {
 }
 
 void TextureMapping::OnPreDestroy() {
-  texture.Destroy(device);
+  assetRegistry.Destroy(device);
 
   uniformBuffer.Destroy(device);
   indexBuffer.Destroy(device);
@@ -130,8 +130,9 @@ void TextureMapping::ViewChanged() { UpdateUniformBuffers(); }
 //*-----------------------------------------------------------------------------
 
 void TextureMapping::LoadAssets() {
-  texture.Load(device, "./Assets/Textures/dds/dxt5/Brick/ruin_wall_01.dds",
-               queue, VK_FORMAT_BC3_SRGB_BLOCK);
+  texture = assetRegistry.LoadTexture(
+      device, "./Assets/Textures/dds/dxt5/Brick/ruin_wall_01.dds", queue,
+      VK_FORMAT_BC3_SRGB_BLOCK);
 }
 
 //*-----------------------------------------------------------------------------
@@ -305,7 +306,7 @@ void TextureMapping::SetupDescriptorSet() {
                                       &uniformBuffer.descriptor),
       Initializer::WriteDescriptorSet(descriptorSet,
                                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                      1, &texture.descriptor),
+                                      1, &texture->descriptor),
   };
   vkUpdateDescriptorSets(device,
                          static_cast<uint32_t>(writeDescriptorSets.size()),
@@ -386,7 +387,7 @@ void TextureMapping::UpdateUniformBuffers() {
 
 void TextureMapping::OnUpdateUIOverlay() {
   if (uiOverlay.SliderFloat("Lod bias", &ubo.lodBias, 0.0f,
-                            static_cast<float>(texture.mipLevels))) {
+                            static_cast<float>(texture->mipLevels))) {
     UpdateUniformBuffers();
   }
 }
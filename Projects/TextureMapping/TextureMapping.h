@@ -4,6 +4,7 @@
 
 #include <vector>
 
+#include "VK/AssetRegistry.h"
 #include "VK/Buffer.h"
 #include "VK/Texture.h"
 #include "View/Camera.h"
@@ -30,7 +31,8 @@ public:
   void ViewChanged() override;
 
 private:
-  Texture2D texture;
+  AssetRegistry assetRegistry{};
+  TextureHandle texture;
 
   struct UniformBufferObject {
     alignas(16) glm::mat4 mvp;
@@ -80,6 +80,33 @@ class Converter(object):
         else:
             self.logger.info('Finished convert: {}'.format(src))
 
+    def png2bc(self, texcook, fmt='bc7', quality='high'):
+        self.logger.info('png -> ktx({}): start convert.'.format(fmt))
+
+        for root, dirs, files in os.walk(self.TEXTURES_PATH.joinpath('png')):
+            [self.to_bc(texcook, f, root, fmt, quality)
+             for f in files if f.endswith('png')]
+
+        self.logger.info('png -> ktx({}): finished convert.'.format(fmt))
+
+    def to_bc(self, texcook, png, target_dir, fmt, quality):
+        src = str(Path(target_dir).joinpath(png))
+        dst = Path(target_dir).parent.parent.joinpath(
+            'ktx', fmt, Path(target_dir).name,
+            Path(png).with_suffix('.ktx').name)
+        dst.parent.mkdir(parents=True, exist_ok=True)
+        self.logger.debug('src - {}'.format(src))
+        self.logger.debug('dst - {}'.format(dst))
+
+        # ビルドしたTexCookを使用します。
+        self.logger.info('Start convert: {}'.format(src))
+        cp = subprocess.run(
+            [texcook, '--format', fmt, '--quality', quality, src, str(dst)])
+        if cp.returncode != 0:
+            self.logger.error('Failed to convert: {}'.format(src))
+        else:
+            self.logger.info('Finished convert: {}'.format(src))
+
 if __name__ == '__main__':
     converter = Converter()
     converter.png2ktx()
@@ -0,0 +1,79 @@
+/**
+ * @brief ディレクトリ以下のアセットを1つのアーカイブにまとめるオフラインツール
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "IO/Archive.h"
+
+namespace {
+void PrintUsage() {
+  std::cerr << "Usage: AssetPack [options] <output.vkpak> <directory>...\n"
+               "  --compress    compress blobs with LZ4 when it saves space\n";
+}
+
+std::vector<std::byte> ReadAll(const std::filesystem::path &path) {
+  std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+  std::vector<std::byte> data(static_cast<size_t>(ifs.tellg()));
+  ifs.seekg(0);
+  ifs.read(reinterpret_cast<char *>(data.data()),
+           static_cast<std::streamsize>(data.size()));
+  return data;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  bool compress = false;
+  std::vector<std::string> args{};
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if (arg == "--compress") {
+      compress = true;
+    } else {
+      args.emplace_back(arg);
+    }
+  }
+  if (args.size() < 2) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  ArchiveWriter writer{};
+  if (!writer.Open(args[0])) {
+    return EXIT_FAILURE;
+  }
+
+  // エントリ名は実行時と同じく作業ディレクトリからの相対パスになります。
+  uint64_t totalSize = 0;
+  size_t entryCount = 0;
+  for (size_t i = 1; i < args.size(); i++) {
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator(args[i])) {
+      if (!entry.is_regular_file()) {
+        continue;
+      }
+      const std::vector<std::byte> data = ReadAll(entry.path());
+      if (!writer.Add(entry.path().generic_string(), data, compress)) {
+        std::cerr << "Failed to add " << entry.path() << std::endl;
+        return EXIT_FAILURE;
+      }
+      totalSize += data.size();
+      entryCount++;
+    }
+  }
+  if (!writer.Close()) {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << args[0] << ": " << entryCount << " entries, " << totalSize
+            << " bytes -> " << std::filesystem::file_size(args[0]) << " bytes"
+            << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/**
+ * @brief 画像をミップ付きのBC圧縮KTXに変換するオフラインツール
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include "Image/BlockCompression.h"
+#include "Image/KtxFormat.h"
+#include "Image/KtxWriter.h"
+#include "Image/MipChain.h"
+#include "Utils/ThreadPool.h"
+
+namespace {
+struct Options {
+  std::string input{};
+  std::string output{};
+  BCFormat format = BCFormat::BC7;
+  BCQuality quality = BCQuality::High;
+  bool srgb = true;
+  bool normalMap = false;
+  size_t threadCount = 0;
+};
+
+void PrintUsage() {
+  std::cerr
+      << "Usage: TexCook [options] <input> <output.ktx>\n"
+         "  --format bc1|bc3|bc4|bc5|bc7  (default: bc7)\n"
+         "  --quality fast|high           (default: high)\n"
+         "  --linear                      RGB is not sRGB encoded\n"
+         "  --normal                      tangent-space normal map (implies "
+         "--linear)\n"
+         "  --threads N                   worker threads (default: all)\n";
+}
+
+std::optional<BCFormat> ParseFormat(std::string_view name) {
+  if (name == "bc1") {
+    return BCFormat::BC1;
+  }
+  if (name == "bc3") {
+    return BCFormat::BC3;
+  }
+  if (name == "bc4") {
+    return BCFormat::BC4;
+  }
+  if (name == "bc5") {
+    return BCFormat::BC5;
+  }
+  if (name == "bc7") {
+    return BCFormat::BC7;
+  }
+  return std::nullopt;
+}
+
+std::optional<Options> ParseOptions(int argc, char **argv) {
+  Options options{};
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--format" && hasValue) {
+      const auto format = ParseFormat(argv[++i]);
+      if (!format) {
+        return std::nullopt;
+      }
+      options.format = *format;
+    } else if (arg == "--quality" && hasValue) {
+      const std::string_view quality = argv[++i];
+      if (quality != "fast" && quality != "high") {
+        return std::nullopt;
+      }
+      options.quality =
+          quality == "fast" ? BCQuality::Fast : BCQuality::High;
+    } else if (arg == "--linear") {
+      options.srgb = false;
+    } else if (arg == "--normal") {
+      options.normalMap = true;
+      options.srgb = false;
+    } else if (arg == "--threads" && hasValue) {
+      options.threadCount = std::strtoul(argv[++i], nullptr, 10);
+    } else if (options.input.empty()) {
+      options.input = arg;
+    } else if (options.output.empty()) {
+      options.output = arg;
+    } else {
+      return std::nullopt;
+    }
+  }
+  if (options.input.empty() || options.output.empty()) {
+    return std::nullopt;
+  }
+  // BC4/BC5はsRGBフォーマットを持ちません。
+  if (options.format == BCFormat::BC4 || options.format == BCFormat::BC5) {
+    options.srgb = false;
+  }
+  return options;
+}
+
+/** @brief KTXヘッダに書き込むglInternalFormatとglBaseInternalFormatを返します。 */
+std::pair<uint32_t, uint32_t> GetGLFormat(BCFormat format, bool srgb) {
+  switch (format) {
+  case BCFormat::BC1:
+    return {srgb ? Ktx::kCompressedSRGB_BC1 : Ktx::kCompressedRGB_BC1,
+            Ktx::kRGB};
+  case BCFormat::BC3:
+    return {srgb ? Ktx::kCompressedSRGBA_BC3 : Ktx::kCompressedRGBA_BC3,
+            Ktx::kRGBA};
+  case BCFormat::BC4:
+    return {Ktx::kCompressedR_BC4, Ktx::kRed};
+  case BCFormat::BC5:
+    return {Ktx::kCompressedRG_BC5, Ktx::kRG};
+  case BCFormat::BC7:
+    return {srgb ? Ktx::kCompressedSRGBA_BC7 : Ktx::kCompressedRGBA_BC7,
+            Ktx::kRGBA};
+  }
+  return {0, 0};
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  stbi_uc *pixels =
+      stbi_load(options->input.c_str(), &width, &height, &channels, 4);
+  if (pixels == nullptr) {
+    std::cerr << "Failed to load " << options->input << ": "
+              << stbi_failure_reason() << std::endl;
+    return EXIT_FAILURE;
+  }
+  Image base{};
+  base.width = static_cast<uint32_t>(width);
+  base.height = static_cast<uint32_t>(height);
+  base.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(pixels);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  MipChainCreateInfo mipCreateInfo{};
+  mipCreateInfo.srgb = options->srgb;
+  mipCreateInfo.normalMap = options->normalMap;
+  const std::vector<Image> levels = GenerateMipChain(base, mipCreateInfo);
+
+  const auto [glInternalFormat, glBaseInternalFormat] =
+      GetGLFormat(options->format, options->srgb);
+  KtxWriter writer(glInternalFormat, glBaseInternalFormat, base.width,
+                   base.height);
+  ThreadPool threadPool(options->threadCount);
+  for (const auto &level : levels) {
+    writer.AddLevel(
+        CompressImage(options->format, options->quality, level, &threadPool));
+  }
+  if (!writer.Write(options->output)) {
+    return EXIT_FAILURE;
+  }
+
+  const auto elapsed = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  std::cout << options->input << " -> " << options->output << " ("
+            << base.width << "x" << base.height << ", " << levels.size()
+            << " levels, " << elapsed << "s)" << std::endl;
+  return EXIT_SUCCESS;
+}